@@ -52,8 +52,7 @@ void TraceLine (vec3_t start, vec3_t end, vec3_t impact)
 {
 	trace_t	trace;
 
-	memset (&trace, 0, sizeof(trace));
-	SV_RecursiveHullCheck (cl.worldmodel->hulls, 0, 0, 1, start, end, &trace);
+	trace = CL_Move (start, vec3_origin, vec3_origin, end, NULL);
 
 	VectorCopy (trace.endpos, impact);
 }
@@ -0,0 +1,716 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_loadgen.c -- fake network clients for server load testing
+
+/*
+Every bot is a real network connection made through the datagram driver.
+Bots go through the signon like a normal client does and then send random
+moves with the same encoding as CL_SendMove. Server messages are walked
+like CL_ParseServerMessage does, but only the signon stages, level changes
+and svc_time are kept.
+
+Connecting blocks until the server answers, so bots can't connect to a
+server running in the same process. Run the generator as a separate
+headless process, sized to have enough sockets:
+	quake -dedicated 16 -port 26001 +sys_ticrate 0.014 +loadgen <server> 16
+and watch the server side with "sv_statsreport 5" on the server.
+*/
+
+#include "quakedef.h"
+
+#define	MAX_LOADBOTS	MAX_SCOREBOARD
+
+typedef struct
+{
+	qsocket_t	*netcon;
+	int			signon;			// 0 to SIGNONS
+	sizebuf_t	message;		// reliable commands waiting to be sent
+	byte		message_buf[256];
+	float		servertime;		// from the last svc_time, for ping calculation
+
+	vec3_t		angles;
+	float		yawspeed;
+	int			forwardmove;
+	int			sidemove;
+	int			buttons;
+	int			impulse;
+	double		nextmovechange;
+} loadbot_t;
+
+static loadbot_t	loadbots[MAX_LOADBOTS];
+
+static double	loadgen_lastreport;
+static int		loadgen_bytesin;
+static int		loadgen_bytesout;
+static int		loadgen_dropped;
+
+cvar_t	loadgen_report = {"loadgen_report", "5"};	// seconds between reports, 0 - never
+
+
+static int LoadGen_NumBots (qboolean ingame)
+{
+	int		i, c;
+
+	c = 0;
+	for (i=0 ; i<MAX_LOADBOTS ; i++)
+	{
+		if (!loadbots[i].netcon)
+			continue;
+		if (ingame && loadbots[i].signon != SIGNONS)
+			continue;
+		c++;
+	}
+	return c;
+}
+
+
+static void LoadGen_Drop (loadbot_t *bot, qboolean crash)
+{
+	sizebuf_t	buf;
+	byte		data[4];
+
+	if (!crash)
+	{
+		buf.data = data;
+		buf.maxsize = sizeof(data);
+		buf.cursize = 0;
+		MSG_WriteByte (&buf, clc_disconnect);
+		NET_SendUnreliableMessage (bot->netcon, &buf);
+	}
+	else
+		loadgen_dropped++;
+
+	NET_Close (bot->netcon);
+	bot->netcon = NULL;
+}
+
+
+/*
+=====================
+LoadGen_Connect
+
+The tail of NET_Connect, without the host search, which takes time
+=====================
+*/
+static qsocket_t *LoadGen_Connect (char *host)
+{
+	qsocket_t	*ret;
+
+	SetNetTime ();
+
+	for (net_driverlevel=0 ; net_driverlevel<net_numdrivers; net_driverlevel++)
+	{
+		if (net_drivers[net_driverlevel].initialized == false)
+			continue;
+		ret = net_drivers[net_driverlevel].Connect (host);
+		if (ret)
+			return ret;
+	}
+	return NULL;
+}
+
+
+// same as CL_SignonReply, but the name and color go with begin
+static void LoadGen_SignonReply (loadbot_t *bot)
+{
+	int		n;
+
+	n = bot - loadbots;
+
+	switch (bot->signon)
+	{
+	case 1:
+		MSG_WriteByte (&bot->message, clc_stringcmd);
+		MSG_WriteString (&bot->message, "prespawn");
+		break;
+
+	case 2:
+		MSG_WriteByte (&bot->message, clc_stringcmd);
+		MSG_WriteString (&bot->message, "spawn ");
+		break;
+
+	case 3:
+		MSG_WriteByte (&bot->message, clc_stringcmd);
+		MSG_WriteString (&bot->message, "begin");
+		bot->signon = SIGNONS;
+
+	// only now, what the server prints for them would come in the middle
+	// of the signon messages
+		MSG_WriteByte (&bot->message, clc_stringcmd);
+		MSG_WriteString (&bot->message, va("name \"bot%i\"\n", n));
+
+		MSG_WriteByte (&bot->message, clc_stringcmd);
+		MSG_WriteString (&bot->message, va("color %i %i\n", n & 15, (n + 3) & 15));
+		break;
+	}
+}
+
+
+static void LoadGen_SkipCoords (int count)
+{
+	while (count--)
+		MSG_ReadCoord ();
+}
+
+
+// same layout as CL_ParseBaseline
+static void LoadGen_SkipBaseline (void)
+{
+	int		i;
+
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	for (i=0 ; i<3 ; i++)
+	{
+		MSG_ReadCoord ();
+		MSG_ReadAngle ();
+	}
+}
+
+
+// same layout as CL_ParseUpdate
+static void LoadGen_SkipUpdate (int bits)
+{
+	if (bits & U_MOREBITS)
+		bits |= (MSG_ReadByte () << 8);
+
+	if (bits & U_LONGENTITY)
+		MSG_ReadShort ();
+	else
+		MSG_ReadByte ();
+
+	if (bits & U_MODEL)
+		MSG_ReadByte ();
+	if (bits & U_FRAME)
+		MSG_ReadByte ();
+	if (bits & U_COLORMAP)
+		MSG_ReadByte ();
+	if (bits & U_SKIN)
+		MSG_ReadByte ();
+	if (bits & U_EFFECTS)
+		MSG_ReadByte ();
+	if (bits & U_ORIGIN1)
+		MSG_ReadCoord ();
+	if (bits & U_ANGLE1)
+		MSG_ReadAngle ();
+	if (bits & U_ORIGIN2)
+		MSG_ReadCoord ();
+	if (bits & U_ANGLE2)
+		MSG_ReadAngle ();
+	if (bits & U_ORIGIN3)
+		MSG_ReadCoord ();
+	if (bits & U_ANGLE3)
+		MSG_ReadAngle ();
+}
+
+
+// same layout as CL_ParseClientdata
+static void LoadGen_SkipClientdata (int bits)
+{
+	int		i;
+
+	if (bits & SU_VIEWHEIGHT)
+		MSG_ReadChar ();
+	if (bits & SU_IDEALPITCH)
+		MSG_ReadChar ();
+	for (i=0 ; i<3 ; i++)
+	{
+		if (bits & (SU_PUNCH1<<i) )
+			MSG_ReadChar ();
+		if (bits & (SU_VELOCITY1<<i) )
+			MSG_ReadChar ();
+	}
+	MSG_ReadLong ();		// items, always sent
+	if (bits & SU_WEAPONFRAME)
+		MSG_ReadByte ();
+	if (bits & SU_ARMOR)
+		MSG_ReadByte ();
+	if (bits & SU_WEAPON)
+		MSG_ReadByte ();
+	MSG_ReadShort ();		// health
+	MSG_ReadByte ();		// ammo
+	for (i=0 ; i<4 ; i++)
+		MSG_ReadByte ();
+	MSG_ReadByte ();		// active weapon
+}
+
+
+// same layout as CL_ParseStartSoundPacket
+static void LoadGen_SkipSound (void)
+{
+	int		field_mask;
+
+	field_mask = MSG_ReadByte ();
+	if (field_mask & SND_VOLUME)
+		MSG_ReadByte ();
+	if (field_mask & SND_ATTENUATION)
+		MSG_ReadByte ();
+	MSG_ReadShort ();
+	MSG_ReadByte ();
+	LoadGen_SkipCoords (3);
+}
+
+
+// same layout as CL_ParseTEnt, returns false for an unknown type
+static qboolean LoadGen_SkipTempEntity (void)
+{
+	switch (MSG_ReadByte ())
+	{
+	case TE_WIZSPIKE:
+	case TE_KNIGHTSPIKE:
+	case TE_SPIKE:
+	case TE_SUPERSPIKE:
+	case TE_GUNSHOT:
+	case TE_EXPLOSION:
+	case TE_TAREXPLOSION:
+	case TE_LAVASPLASH:
+	case TE_TELEPORT:
+#ifdef QUAKE2
+	case TE_IMPLOSION:
+#endif
+		LoadGen_SkipCoords (3);
+		return true;
+
+	case TE_LIGHTNING1:
+	case TE_LIGHTNING2:
+	case TE_LIGHTNING3:
+	case TE_BEAM:
+		MSG_ReadShort ();
+		LoadGen_SkipCoords (6);
+		return true;
+
+	case TE_EXPLOSION2:
+		LoadGen_SkipCoords (3);
+		MSG_ReadByte ();
+		MSG_ReadByte ();
+		return true;
+
+#ifdef QUAKE2
+	case TE_RAILTRAIL:
+		LoadGen_SkipCoords (6);
+		return true;
+#endif
+	}
+	return false;
+}
+
+
+/*
+=====================
+LoadGen_ParseMessage
+
+Walks net_message the way CL_ParseServerMessage does, keeping only the
+signon stages, level changes and svc_time, and skipping every other payload
+by its layout. Anything the bot can't walk, like an unknown command or a
+truncated payload, ends the message instead of being guessed at, so data
+inside other payloads is never taken for a command. Returns false if the
+server disconnected the bot.
+=====================
+*/
+static qboolean LoadGen_ParseMessage (loadbot_t *bot)
+{
+	int		cmd, i;
+	char	*str;
+
+	MSG_BeginReading ();
+
+	while (1)
+	{
+		if (msg_badread)
+		{
+			Con_DPrintf ("loadgen: bot%i: bad server message\n", (int)(bot - loadbots));
+			return true;
+		}
+
+		cmd = MSG_ReadByte ();
+		if (cmd == -1)
+			return true;		// end of message
+
+		if (cmd & 128)
+		{
+			LoadGen_SkipUpdate (cmd&127);
+			continue;
+		}
+
+		switch (cmd)
+		{
+		default:
+			Con_DPrintf ("loadgen: bot%i: unknown server command %i\n", (int)(bot - loadbots), cmd);
+			return true;
+
+		case svc_nop:
+		case svc_killedmonster:
+		case svc_foundsecret:
+		case svc_intermission:
+		case svc_sellscreen:
+			break;
+
+		case svc_disconnect:
+			return false;
+
+		case svc_time:
+			bot->servertime = MSG_ReadFloat ();
+			break;
+
+		case svc_clientdata:
+			LoadGen_SkipClientdata (MSG_ReadShort ());
+			break;
+
+		case svc_version:
+			MSG_ReadLong ();
+			break;
+
+		case svc_print:
+		case svc_centerprint:
+		case svc_finale:
+		case svc_cutscene:
+			MSG_ReadString ();
+			break;
+
+		case svc_stufftext:
+		// changelevel, wait for the new serverinfo; SV_SendReconnect
+		// sends the command on its own
+			str = MSG_ReadString ();
+			if (Q_strcmp (str, "reconnect\n") == 0)
+				bot->signon = 0;
+			break;
+
+		case svc_damage:
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			LoadGen_SkipCoords (3);
+			break;
+
+		case svc_serverinfo:
+			MSG_ReadLong ();
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			MSG_ReadString ();
+			for (i=0 ; i<2 ; i++)	// model, then sound precaches
+				while (MSG_ReadString ()[0] && !msg_badread)
+					;
+			break;
+
+		case svc_setangle:
+			MSG_ReadAngle ();
+			MSG_ReadAngle ();
+			MSG_ReadAngle ();
+			break;
+
+		case svc_setview:
+		case svc_stopsound:
+			MSG_ReadShort ();
+			break;
+
+		case svc_lightstyle:
+		case svc_updatename:
+			MSG_ReadByte ();
+			MSG_ReadString ();
+			break;
+
+		case svc_sound:
+			LoadGen_SkipSound ();
+			break;
+
+		case svc_updatefrags:
+			MSG_ReadByte ();
+			MSG_ReadShort ();
+			break;
+
+		case svc_updatecolors:
+		case svc_cdtrack:
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			break;
+
+		case svc_particle:
+			LoadGen_SkipCoords (3);
+			MSG_ReadChar ();
+			MSG_ReadChar ();
+			MSG_ReadChar ();
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			break;
+
+		case svc_spawnbaseline:
+			MSG_ReadShort ();
+			LoadGen_SkipBaseline ();
+			break;
+
+		case svc_spawnstatic:
+			LoadGen_SkipBaseline ();
+			break;
+
+		case svc_temp_entity:
+			if (!LoadGen_SkipTempEntity ())
+			{
+				Con_DPrintf ("loadgen: bot%i: unknown temp entity\n", (int)(bot - loadbots));
+				return true;
+			}
+			break;
+
+		case svc_setpause:
+			MSG_ReadByte ();
+			break;
+
+		case svc_signonnum:
+			i = MSG_ReadByte ();
+			if (!msg_badread && i == bot->signon + 1)
+			{
+				bot->signon++;
+				LoadGen_SignonReply (bot);
+			}
+			break;
+
+		case svc_updatestat:
+			MSG_ReadByte ();
+			MSG_ReadLong ();
+			break;
+
+		case svc_spawnstaticsound:
+			LoadGen_SkipCoords (3);
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			break;
+		}
+	}
+}
+
+
+/*
+=====================
+LoadGen_ReadMessages
+=====================
+*/
+static void LoadGen_ReadMessages (loadbot_t *bot)
+{
+	int		ret;
+
+	while (bot->netcon)
+	{
+		ret = NET_GetMessage (bot->netcon);
+		if (ret == 0)
+			break;
+		if (ret == -1)
+		{
+			LoadGen_Drop (bot, true);
+			break;
+		}
+
+		loadgen_bytesin += net_message.cursize;
+
+		if (!LoadGen_ParseMessage (bot))
+		{
+			LoadGen_Drop (bot, true);
+			break;
+		}
+	}
+}
+
+
+static void LoadGen_SendMove (loadbot_t *bot)
+{
+	sizebuf_t	buf;
+	byte		data[128];
+	int			i;
+
+	if (realtime >= bot->nextmovechange)
+	{
+		bot->forwardmove = (rand () % 3 - 1) * 400;
+		bot->sidemove = (rand () % 3 - 1) * 350;
+		bot->yawspeed = (rand () % 361) - 180;
+		bot->buttons = rand () & 3;
+		bot->impulse = (rand () & 7) == 0 ? 1 + rand () % 8 : 0;
+		bot->nextmovechange = realtime + 0.5 + (rand () & 1023) * (1.5 / 1024.0);
+	}
+	bot->angles[YAW] = anglemod (bot->angles[YAW] + bot->yawspeed * host_frametime);
+
+	buf.maxsize = sizeof(data);
+	buf.cursize = 0;
+	buf.data = data;
+
+	MSG_WriteByte (&buf, clc_move);
+	MSG_WriteFloat (&buf, bot->servertime);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteAngle (&buf, bot->angles[i]);
+	MSG_WriteShort (&buf, bot->forwardmove);
+	MSG_WriteShort (&buf, bot->sidemove);
+	MSG_WriteShort (&buf, 0);
+	MSG_WriteByte (&buf, bot->buttons);
+	MSG_WriteByte (&buf, bot->impulse);
+#ifdef QUAKE2
+	MSG_WriteByte (&buf, 0);
+#endif
+	bot->impulse = 0;
+
+	if (NET_SendUnreliableMessage (bot->netcon, &buf) == -1)
+	{
+		LoadGen_Drop (bot, true);
+		return;
+	}
+	loadgen_bytesout += buf.cursize;
+}
+
+
+static void LoadGen_Report (void)
+{
+	double	elapsed;
+
+	elapsed = realtime - loadgen_lastreport;
+	if (elapsed <= 0.0)
+		elapsed = 1.0;
+
+	Con_Printf ("loadgen: %2i/%2i bots in game %6.1f kb/s in %6.1f kb/s out %i dropped\n",
+		LoadGen_NumBots (true), LoadGen_NumBots (false),
+		loadgen_bytesin / elapsed / 1024.0, loadgen_bytesout / elapsed / 1024.0, loadgen_dropped);
+
+	loadgen_bytesin = loadgen_bytesout = 0;
+	loadgen_lastreport = realtime;
+}
+
+
+/*
+=====================
+CL_LoadGenFrame
+=====================
+*/
+void CL_LoadGenFrame (void)
+{
+	int			i;
+	loadbot_t	*bot;
+
+	for (i=0, bot=loadbots ; i<MAX_LOADBOTS ; i++, bot++)
+	{
+		if (!bot->netcon)
+			continue;
+
+		LoadGen_ReadMessages (bot);
+		if (!bot->netcon)
+			continue;
+
+		if (bot->message.cursize && NET_CanSendMessage (bot->netcon))
+		{
+			loadgen_bytesout += bot->message.cursize;
+			if (NET_SendMessage (bot->netcon, &bot->message) == -1)
+			{
+				LoadGen_Drop (bot, true);
+				continue;
+			}
+			SZ_Clear (&bot->message);
+		}
+
+		if (bot->signon == SIGNONS)
+			LoadGen_SendMove (bot);
+	}
+
+	if (loadgen_report.value > 0 && realtime - loadgen_lastreport >= loadgen_report.value && LoadGen_NumBots (false))
+		LoadGen_Report ();
+}
+
+
+/*
+=====================
+CL_LoadGen_f
+
+loadgen <host> <count> : connect more bots
+loadgen stop : disconnect all bots
+loadgen : print statistics
+=====================
+*/
+void CL_LoadGen_f (void)
+{
+	int			i, count;
+	loadbot_t	*bot;
+	char		*host;
+
+	if (Cmd_Argc () == 1)
+	{
+		LoadGen_Report ();
+		return;
+	}
+
+	if (Cmd_Argc () == 2 && Q_strcmp (Cmd_Argv (1), "stop") == 0)
+	{
+		for (i=0 ; i<MAX_LOADBOTS ; i++)
+			if (loadbots[i].netcon)
+				LoadGen_Drop (&loadbots[i], false);
+		return;
+	}
+
+	if (Cmd_Argc () != 3)
+	{
+		Con_Printf ("loadgen <host> <count> : connect bots\n");
+		Con_Printf ("loadgen stop : disconnect bots\n");
+		return;
+	}
+
+	host = Cmd_Argv (1);
+	if (Q_strcasecmp (host, "local") == 0)
+	{
+		Con_Printf ("loopback supports only one client, use the network address\n");
+		return;
+	}
+
+	count = Q_atoi (Cmd_Argv (2));
+	for (i=0, bot=loadbots ; i<MAX_LOADBOTS && count > 0 ; i++, bot++)
+	{
+		if (bot->netcon)
+			continue;
+
+		bot->netcon = LoadGen_Connect (host);
+		if (!bot->netcon)
+		{
+			Con_Printf ("loadgen: unable to connect bot%i, start with -dedicated <count> to have enough sockets\n", i);
+			break;
+		}
+
+		bot->signon = 0;
+		bot->message.data = bot->message_buf;
+		bot->message.maxsize = sizeof(bot->message_buf);
+		SZ_Clear (&bot->message);
+		bot->servertime = 0;
+		VectorCopy (vec3_origin, bot->angles);
+		bot->angles[YAW] = rand () % 360;
+		bot->nextmovechange = 0;
+		count--;
+	}
+
+	loadgen_bytesin = loadgen_bytesout = 0;
+	loadgen_lastreport = realtime;
+	Con_Printf ("loadgen: %i bots connected\n", LoadGen_NumBots (false));
+}
+
+
+/*
+=====================
+CL_InitLoadGen
+
+Called for dedicated servers too
+=====================
+*/
+void CL_InitLoadGen (void)
+{
+	Cvar_RegisterVariable (&loadgen_report);
+	Cmd_AddCommand ("loadgen", CL_LoadGen_f);
+}
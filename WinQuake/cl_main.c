@@ -99,6 +99,7 @@ void CL_ClearState (void)
 	memset (cl_lightstyle, 0, sizeof(cl_lightstyle));
 	memset (cl_temp_entities, 0, sizeof(cl_temp_entities));
 	memset (cl_beams, 0, sizeof(cl_beams));
+	CL_ClearSolids ();
 
 //
 // allocate the efrags and chain together into a free list
@@ -226,6 +227,11 @@ Con_DPrintf ("CL_SignonReply: %i\n", cls.signon);
 		
 	case 4:
 		SCR_EndLoadingPlaque ();		// allow normal screen updates
+		if (cls.maploadstart)
+		{
+			Con_DPrintf ("%s: %.3f s to the first frame\n", cl.worldmodel->name, Sys_FloatTime () - cls.maploadstart);
+			cls.maploadstart = 0;
+		}
 		break;
 	}
 }
@@ -474,6 +480,7 @@ void CL_RelinkEntities (void)
 	frac = CL_LerpPoint ();
 
 	cl_numvisedicts = 0;
+	CL_ClearSolids ();
 
 //
 // interpolate player info
@@ -627,6 +634,7 @@ void CL_RelinkEntities (void)
 			R_RocketTrail (oldorg, ent->origin, 6);
 
 		ent->forcelink = false;
+		CL_LinkSolid (ent);
 
 		if (i == cl.viewentity && !chase_active.value)
 			continue;
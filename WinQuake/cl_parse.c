@@ -247,6 +247,7 @@ void CL_ParseServerInfo (void)
 	int		nummodels, numsounds;
 	char	model_precache[MAX_MODELS][MAX_QPATH];
 	char	sound_precache[MAX_SOUNDS][MAX_QPATH];
+	double	time;
 	
 	Con_DPrintf ("Serverinfo packet received.\n");
 //
@@ -324,16 +325,34 @@ void CL_ParseServerInfo (void)
 // now we try to load everything else until a cache allocation fails
 //
 
+	time = Sys_FloatTime ();
+#ifdef GLQUAKE
+	GL_ClearTextureStats ();
+	GL_ClearMeshStats ();
+#endif
+
+	// read the other models from disk while the world is processed
+	for (i=2 ; i<nummodels ; i++)
+		Mod_Prefetch (model_precache[i]);
+
 	for (i=1 ; i<nummodels ; i++)
 	{
 		cl.model_precache[i] = Mod_ForName (model_precache[i], false);
 		if (cl.model_precache[i] == NULL)
 		{
 			Con_Printf("Model %s not found\n", model_precache[i]);
+			COM_ClearPrefetch ();
 			return;
 		}
 		CL_KeepaliveMessage ();
 	}
+	COM_ClearPrefetch ();
+
+	Con_DPrintf ("%i models loaded in %.3f s\n", nummodels - 1, Sys_FloatTime () - time);
+#ifdef GLQUAKE
+	GL_PrintTextureStats ();
+	GL_PrintMeshStats ();
+#endif
 
 	S_BeginPrecaching ();
 	for (i=1 ; i<numsounds ; i++)
@@ -0,0 +1,160 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_world.c -- client side tracing against the world and brush entities
+
+#include "quakedef.h"
+
+// the brush entities of the last message, the client doesn't know which
+// of them are solid, so func_illusionary is clipped against as well
+
+#define	MAX_CLSOLIDS	256
+
+static entity_t	*cl_solids[MAX_CLSOLIDS];
+static int		cl_numsolids;
+
+/*
+===============
+CL_ClearSolids
+===============
+*/
+void CL_ClearSolids (void)
+{
+	cl_numsolids = 0;
+}
+
+/*
+===============
+CL_LinkSolid
+
+Called for every entity that is relinked, keeps the brush models
+===============
+*/
+void CL_LinkSolid (entity_t *ent)
+{
+	if (ent->model->type != mod_brush || ent->model->name[0] != '*')
+		return;		// not a bsp submodel
+	if (cl_numsolids == MAX_CLSOLIDS)
+		return;
+
+	cl_solids[cl_numsolids++] = ent;
+}
+
+/*
+==================
+CL_ClipMoveToEntity
+
+Rotated brush models are clipped against as if they weren't
+==================
+*/
+static trace_t CL_ClipMoveToEntity (entity_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+{
+	hull_t		*hull;
+	vec3_t		offset;
+
+	hull = CM_HullForSize (ent->model, mins, maxs);
+
+// calculate an offset value to center the origin
+	VectorSubtract (hull->clip_mins, mins, offset);
+	VectorAdd (offset, ent->origin, offset);
+
+	return CM_ClipHull (hull, offset, start, end);
+}
+
+/*
+==================
+CL_Move
+
+Same as SV_Move against the world and the brush entities, for network games
+too. hitent is set to the number of the entity that was hit, or -1.
+==================
+*/
+trace_t CL_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int *hitent)
+{
+	trace_t		trace, total;
+	vec3_t		boxmins, boxmaxs;
+	entity_t	*ent;
+	int			i;
+
+	if (hitent)
+		*hitent = -1;
+
+	if (!cl.worldmodel)
+	{
+		memset (&total, 0, sizeof(total));
+		total.fraction = 1;
+		VectorCopy (end, total.endpos);
+		return total;
+	}
+
+// the area of the whole move
+	for (i=0 ; i<3 ; i++)
+	{
+		if (end[i] > start[i])
+		{
+			boxmins[i] = start[i] + mins[i] - 1;
+			boxmaxs[i] = end[i] + maxs[i] + 1;
+		}
+		else
+		{
+			boxmins[i] = end[i] + mins[i] - 1;
+			boxmaxs[i] = start[i] + maxs[i] + 1;
+		}
+	}
+
+// clip to world
+	total = CL_ClipMoveToEntity (&cl_entities[0], start, mins, maxs, end);
+	if (hitent && (total.fraction < 1 || total.startsolid))
+		*hitent = 0;
+
+// clip to brush entities
+	for (i=0 ; i<cl_numsolids ; i++)
+	{
+		if (total.allsolid)
+			break;
+
+		ent = cl_solids[i];
+		if (ent->origin[0] + ent->model->mins[0] > boxmaxs[0]
+		|| ent->origin[1] + ent->model->mins[1] > boxmaxs[1]
+		|| ent->origin[2] + ent->model->mins[2] > boxmaxs[2]
+		|| ent->origin[0] + ent->model->maxs[0] < boxmins[0]
+		|| ent->origin[1] + ent->model->maxs[1] < boxmins[1]
+		|| ent->origin[2] + ent->model->maxs[2] < boxmins[2])
+			continue;
+
+		trace = CL_ClipMoveToEntity (ent, start, mins, maxs, end);
+		if (trace.allsolid || trace.startsolid || trace.fraction < total.fraction)
+		{
+			if (hitent)
+				*hitent = ent - cl_entities;
+			if (total.startsolid)
+			{
+				total = trace;
+				total.startsolid = true;
+			}
+			else
+				total = trace;
+		}
+		else if (trace.startsolid)
+			total.startsolid = true;
+	}
+
+	return total;
+}
@@ -137,6 +137,8 @@ typedef struct
 	int			signon;			// 0 to SIGNONS
 	struct qsocket_s	*netcon;
 	sizebuf_t	message;		// writing buffer to send to server
+
+	double		maploadstart;	// realtime of the map or changelevel command, 0 = none
 	
 } client_static_t;
 
@@ -339,6 +341,12 @@ void CL_BaseMove (usercmd_t *cmd);
 float CL_KeyState (kbutton_t *key);
 char *Key_KeynumToString (int keynum);
 
+//
+// cl_loadgen.c
+//
+void CL_InitLoadGen (void);
+void CL_LoadGenFrame (void);
+
 //
 // cl_demo.c
 //
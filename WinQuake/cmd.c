@@ -29,12 +29,22 @@ void Cmd_ForwardToServer (void);
 typedef struct cmdalias_s
 {
 	struct cmdalias_s	*next;
+	struct cmdalias_s	*hashnext;
 	char	name[MAX_ALIAS_NAME];
 	char	*value;
 } cmdalias_t;
 
 cmdalias_t	*cmd_alias;
 
+// commands and aliases are also chained by COM_HashName, newest first like
+// the lists, so a lookup finds the same one a walk of the list would
+
+#define	CMD_HASH_SIZE	256		// power of two
+
+static	cmdalias_t	*cmd_aliashash[CMD_HASH_SIZE];
+
+cmdstats_t	cmd_stats;
+
 int trashtest;
 int *trashspot;
 
@@ -345,6 +355,7 @@ void Cmd_Alias_f (void)
 	char		cmd[1024];
 	int			i, c;
 	char		*s;
+	int			hash;
 
 	if (Cmd_Argc() == 1)
 	{
@@ -362,8 +373,11 @@ void Cmd_Alias_f (void)
 	}
 
 	// if the alias allready exists, reuse it
-	for (a = cmd_alias ; a ; a=a->next)
+	hash = COM_HashName (s) & (CMD_HASH_SIZE-1);
+	cmd_stats.aliaslookups++;
+	for (a = cmd_aliashash[hash] ; a ; a=a->hashnext)
 	{
+		cmd_stats.compares++;
 		if (!strcmp(s, a->name))
 		{
 			Z_Free (a->value);
@@ -376,6 +390,8 @@ void Cmd_Alias_f (void)
 		a = Z_Malloc (sizeof(cmdalias_t));
 		a->next = cmd_alias;
 		cmd_alias = a;
+		a->hashnext = cmd_aliashash[hash];
+		cmd_aliashash[hash] = a;
 	}
 	strcpy (a->name, s);	
 
@@ -404,6 +420,7 @@ void Cmd_Alias_f (void)
 typedef struct cmd_function_s
 {
 	struct cmd_function_s	*next;
+	struct cmd_function_s	*hashnext;
 	char					*name;
 	xcommand_t				function;
 } cmd_function_t;
@@ -420,6 +437,9 @@ cmd_source_t	cmd_source;
 
 
 static	cmd_function_t	*cmd_functions;		// possible commands to execute
+static	cmd_function_t	*cmd_hash[CMD_HASH_SIZE];
+
+void Cmd_Stats_f (void);
 
 /*
 ============
@@ -437,6 +457,7 @@ void Cmd_Init (void)
 	Cmd_AddCommand ("alias",Cmd_Alias_f);
 	Cmd_AddCommand ("cmd", Cmd_ForwardToServer);
 	Cmd_AddCommand ("wait", Cmd_Wait_f);
+	Cmd_AddCommand ("cmd_stats", Cmd_Stats_f);
 }
 
 /*
@@ -533,6 +554,7 @@ Cmd_AddCommand
 void	Cmd_AddCommand (char *cmd_name, xcommand_t function)
 {
 	cmd_function_t	*cmd;
+	int				hash;
 	
 	if (host_initialized)	// because hunk allocation would get stomped
 		Sys_Error ("Cmd_AddCommand after host_initialized");
@@ -545,13 +567,10 @@ void	Cmd_AddCommand (char *cmd_name, xcommand_t function)
 	}
 	
 // fail if the command already exists
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	if (Cmd_Exists (cmd_name))
 	{
-		if (!Q_strcmp (cmd_name, cmd->name))
-		{
-			Con_Printf ("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Con_Printf ("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = Hunk_Alloc (sizeof(cmd_function_t));
@@ -559,6 +578,10 @@ void	Cmd_AddCommand (char *cmd_name, xcommand_t function)
 	cmd->function = function;
 	cmd->next = cmd_functions;
 	cmd_functions = cmd;
+
+	hash = COM_HashName (cmd_name) & (CMD_HASH_SIZE-1);
+	cmd->hashnext = cmd_hash[hash];
+	cmd_hash[hash] = cmd;
 }
 
 /*
@@ -570,8 +593,10 @@ qboolean	Cmd_Exists (char *cmd_name)
 {
 	cmd_function_t	*cmd;
 
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	cmd_stats.cmdlookups++;
+	for (cmd=cmd_hash[COM_HashName (cmd_name) & (CMD_HASH_SIZE-1)] ; cmd ; cmd=cmd->hashnext)
 	{
+		cmd_stats.compares++;
 		if (!Q_strcmp (cmd_name,cmd->name))
 			return true;
 	}
@@ -609,13 +634,13 @@ char *Cmd_CompleteCommand (char *partial)
 Cmd_ExecuteString
 
 A complete command line has been parsed, so try to execute it
-FIXME: lookupnoadd the token to speed search?
 ============
 */
 void	Cmd_ExecuteString (char *text, cmd_source_t src)
 {	
 	cmd_function_t	*cmd;
 	cmdalias_t		*a;
+	int				hash;
 
 	cmd_source = src;
 	Cmd_TokenizeString (text);
@@ -624,9 +649,13 @@ void	Cmd_ExecuteString (char *text, cmd_source_t src)
 	if (!Cmd_Argc())
 		return;		// no tokens
 
+	hash = COM_HashName (cmd_argv[0]) & (CMD_HASH_SIZE-1);
+
 // check functions
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	cmd_stats.cmdlookups++;
+	for (cmd=cmd_hash[hash] ; cmd ; cmd=cmd->hashnext)
 	{
+		cmd_stats.compares++;
 		if (!Q_strcasecmp (cmd_argv[0],cmd->name))
 		{
 			cmd->function ();
@@ -635,8 +664,10 @@ void	Cmd_ExecuteString (char *text, cmd_source_t src)
 	}
 
 // check alias
-	for (a=cmd_alias ; a ; a=a->next)
+	cmd_stats.aliaslookups++;
+	for (a=cmd_aliashash[hash] ; a ; a=a->hashnext)
 	{
+		cmd_stats.compares++;
 		if (!Q_strcasecmp (cmd_argv[0], a->name))
 		{
 			Cbuf_InsertText (a->value);
@@ -704,3 +735,24 @@ int Cmd_CheckParm (char *parm)
 			
 	return 0;
 }
+
+/*
+================
+Cmd_Stats_f
+
+cmd_stats [reset]
+================
+*/
+void Cmd_Stats_f (void)
+{
+	int		lookups;
+
+	lookups = cmd_stats.cmdlookups + cmd_stats.aliaslookups + cmd_stats.cvarlookups;
+	Con_Printf ("%i command, %i alias, %i cvar lookups, %.2f names compared per lookup\n",
+		cmd_stats.cmdlookups, cmd_stats.aliaslookups, cmd_stats.cvarlookups,
+		lookups ? (float)cmd_stats.compares / lookups : 0.0f);
+	Con_Printf ("%i cvar lookups from progs, %i cached\n", cmd_stats.progslookups, cmd_stats.progshits);
+
+	if (Cmd_Argc () > 1 && !Q_strcmp (Cmd_Argv (1), "reset"))
+		memset (&cmd_stats, 0, sizeof(cmd_stats));
+}
@@ -120,3 +120,16 @@ void	Cmd_Print (char *text);
 // used by command functions to send output to either the graphics console or
 // passed as a print message to the client
 
+// name lookups, printed by "cmd_stats"
+typedef struct
+{
+	int		cmdlookups;
+	int		aliaslookups;
+	int		cvarlookups;
+	int		compares;		// names compared by all of them
+	int		progslookups;	// cvar () and cvar_set () from progs
+	int		progshits;		// of them found in the progs cache
+} cmdstats_t;
+
+extern	cmdstats_t	cmd_stats;
+
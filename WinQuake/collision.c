@@ -0,0 +1,524 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// collision.c -- tracing through the clipping hulls of brush models
+
+#include "quakedef.h"
+
+/*
+===============================================================================
+
+HULL BOXES
+
+===============================================================================
+*/
+
+/*
+===================
+CM_InitBoxHull
+
+Set up the planes and clipnodes so that the six floats of a bounding box
+can just be stored out and get a proper hull_t structure.
+===================
+*/
+void CM_InitBoxHull (boxhull_t *box)
+{
+	int			i;
+	int			side;
+
+	box->hull.clipnodes = box->clipnodes;
+	box->hull.planes = box->planes;
+	box->hull.nodes = box->nodes;
+	box->hull.firstclipnode = 0;
+	box->hull.lastclipnode = 5;
+
+	for (i=0 ; i<6 ; i++)
+	{
+		box->clipnodes[i].planenum = i;
+		
+		side = i&1;
+		
+		box->clipnodes[i].children[side] = CONTENTS_EMPTY;
+		if (i != 5)
+			box->clipnodes[i].children[side^1] = i + 1;
+		else
+			box->clipnodes[i].children[side^1] = CONTENTS_SOLID;
+		
+		box->planes[i].type = i>>1;
+		box->planes[i].normal[i>>1] = 1;
+
+		box->nodes[i].type = i>>1;
+		box->nodes[i].normal[i>>1] = 1;
+		box->nodes[i].children[0] = box->clipnodes[i].children[0];
+		box->nodes[i].children[1] = box->clipnodes[i].children[1];
+	}
+}
+
+
+/*
+===================
+CM_HullForBox
+
+To keep everything totally uniform, bounding boxes are turned into small
+BSP trees instead of being compared directly.
+===================
+*/
+hull_t *CM_HullForBox (boxhull_t *box, vec3_t mins, vec3_t maxs)
+{
+	box->planes[0].dist = maxs[0];
+	box->planes[1].dist = mins[0];
+	box->planes[2].dist = maxs[1];
+	box->planes[3].dist = mins[1];
+	box->planes[4].dist = maxs[2];
+	box->planes[5].dist = mins[2];
+
+	box->nodes[0].dist = maxs[0];
+	box->nodes[1].dist = mins[0];
+	box->nodes[2].dist = maxs[1];
+	box->nodes[3].dist = mins[1];
+	box->nodes[4].dist = maxs[2];
+	box->nodes[5].dist = mins[2];
+
+	return &box->hull;
+}
+
+/*
+===================
+CM_HullForSize
+
+The bsp compiler only builds hulls for points, players and shamblers, so
+anything in between clips like the next smaller one
+===================
+*/
+hull_t *CM_HullForSize (model_t *model, vec3_t mins, vec3_t maxs)
+{
+	vec3_t		size;
+
+	VectorSubtract (maxs, mins, size);
+	if (size[0] < 3)
+		return &model->hulls[0];
+	if (size[0] <= 32)
+		return &model->hulls[1];
+	return &model->hulls[2];
+}
+
+
+/*
+===============================================================================
+
+POINT TESTING IN HULLS
+
+===============================================================================
+*/
+
+
+/*
+==================
+CM_HullPointContents
+
+==================
+*/
+int CM_HullPointContents (hull_t *hull, int num, vec3_t p)
+{
+	float		d;
+	mclipnode_t	*node;
+
+	while (num >= 0)
+	{
+		if (num < hull->firstclipnode || num > hull->lastclipnode)
+			Sys_Error ("CM_HullPointContents: bad node number");
+	
+		node = hull->nodes + num;
+		
+		if (node->type < 3)
+			d = p[node->type] - node->dist;
+		else
+			d = DotProduct (node->normal, p) - node->dist;
+		if (d < 0)
+			num = node->children[1];
+		else
+			num = node->children[0];
+	}
+	
+	return num;
+}
+
+
+/*
+===============================================================================
+
+LINE TESTING IN HULLS
+
+===============================================================================
+*/
+
+// 1/32 epsilon to keep floating point happy
+#define	DIST_EPSILON	(0.03125)
+
+/*
+==================
+CM_RecursiveHullCheck
+
+==================
+*/
+qboolean CM_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
+{
+	dclipnode_t	*node;
+	mplane_t	*plane;
+	float		t1, t2;
+	float		frac;
+	int			i;
+	vec3_t		mid;
+	int			side;
+	float		midf;
+
+// check for empty
+	if (num < 0)
+	{
+		if (num != CONTENTS_SOLID)
+		{
+			trace->allsolid = false;
+			if (num == CONTENTS_EMPTY)
+				trace->inopen = true;
+			else
+				trace->inwater = true;
+		}
+		else
+			trace->startsolid = true;
+		return true;		// empty
+	}
+
+	if (num < hull->firstclipnode || num > hull->lastclipnode)
+		Sys_Error ("CM_RecursiveHullCheck: bad node number");
+
+//
+// find the point distances
+//
+	node = hull->clipnodes + num;
+	plane = hull->planes + node->planenum;
+
+	if (plane->type < 3)
+	{
+		t1 = p1[plane->type] - plane->dist;
+		t2 = p2[plane->type] - plane->dist;
+	}
+	else
+	{
+		t1 = DotProduct (plane->normal, p1) - plane->dist;
+		t2 = DotProduct (plane->normal, p2) - plane->dist;
+	}
+	
+#if 1
+	if (t1 >= 0 && t2 >= 0)
+		return CM_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
+	if (t1 < 0 && t2 < 0)
+		return CM_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
+#else
+	if ( (t1 >= DIST_EPSILON && t2 >= DIST_EPSILON) || (t2 > t1 && t1 >= 0) )
+		return CM_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
+	if ( (t1 <= -DIST_EPSILON && t2 <= -DIST_EPSILON) || (t2 < t1 && t1 <= 0) )
+		return CM_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
+#endif
+
+// put the crosspoint DIST_EPSILON pixels on the near side
+	if (t1 < 0)
+		frac = (t1 + DIST_EPSILON)/(t1-t2);
+	else
+		frac = (t1 - DIST_EPSILON)/(t1-t2);
+	if (frac < 0)
+		frac = 0;
+	if (frac > 1)
+		frac = 1;
+		
+	midf = p1f + (p2f - p1f)*frac;
+	for (i=0 ; i<3 ; i++)
+		mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+
+	side = (t1 < 0);
+
+// move up to the node
+	if (!CM_RecursiveHullCheck (hull, node->children[side], p1f, midf, p1, mid, trace) )
+		return false;
+
+#ifdef PARANOID
+	if (CM_HullPointContents (sv_hullmodel, mid, node->children[side])
+	== CONTENTS_SOLID)
+	{
+		Con_Printf ("mid PointInHullSolid\n");
+		return false;
+	}
+#endif
+	
+	if (CM_HullPointContents (hull, node->children[side^1], mid)
+	!= CONTENTS_SOLID)
+// go past the node
+		return CM_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
+	
+	if (trace->allsolid)
+		return false;		// never got out of the solid area
+		
+//==================
+// the other side of the node is solid, this is the impact point
+//==================
+	if (!side)
+	{
+		VectorCopy (plane->normal, trace->plane.normal);
+		trace->plane.dist = plane->dist;
+	}
+	else
+	{
+		VectorSubtract (vec3_origin, plane->normal, trace->plane.normal);
+		trace->plane.dist = -plane->dist;
+	}
+
+	while (CM_HullPointContents (hull, hull->firstclipnode, mid)
+	== CONTENTS_SOLID)
+	{ // shouldn't really happen, but does occasionally
+		frac -= 0.1;
+		if (frac < 0)
+		{
+			trace->fraction = midf;
+			VectorCopy (mid, trace->endpos);
+			trace->backedup = true;
+			return false;
+		}
+		midf = p1f + (p2f - p1f)*frac;
+		for (i=0 ; i<3 ; i++)
+			mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+	}
+
+	trace->fraction = midf;
+	VectorCopy (mid, trace->endpos);
+
+	return false;
+}
+
+
+/*
+==================
+CM_HullCheck
+
+Same as CM_RecursiveHullCheck, with the recursion turned into a loop. The
+near side of every crossed node is traced first, the frames on the stack
+remember where to go on when it comes out empty.
+==================
+*/
+#define	MAX_HULLSTACK	256
+
+typedef struct
+{
+	mclipnode_t	*node;
+	int			side;
+	float		frac;
+	float		p1f, p2f, midf;
+	vec3_t		p1, p2, mid;
+} hullframe_t;
+
+qboolean CM_HullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
+{
+	hullframe_t	stack[MAX_HULLSTACK];
+	hullframe_t	*f;
+	int			depth;
+	mclipnode_t	*node;
+	float		t1, t2;
+	float		frac, midf;
+	vec3_t		start, end, mid;
+	int			i, side;
+	int			startnum;
+	float		startp1f, startp2f;
+
+	startnum = num;
+	startp1f = p1f;
+	startp2f = p2f;
+	VectorCopy (p1, start);
+	VectorCopy (p2, end);
+	depth = 0;
+
+	while (1)
+	{
+		while (num >= 0)
+		{
+			if (num < hull->firstclipnode || num > hull->lastclipnode)
+				Sys_Error ("CM_HullCheck: bad node number");
+
+		//
+		// find the point distances
+		//
+			node = hull->nodes + num;
+
+			if (node->type < 3)
+			{
+				t1 = start[node->type] - node->dist;
+				t2 = end[node->type] - node->dist;
+			}
+			else
+			{
+				t1 = DotProduct (node->normal, start) - node->dist;
+				t2 = DotProduct (node->normal, end) - node->dist;
+			}
+
+			if (t1 >= 0 && t2 >= 0)
+			{
+				num = node->children[0];
+				continue;
+			}
+			if (t1 < 0 && t2 < 0)
+			{
+				num = node->children[1];
+				continue;
+			}
+
+			if (depth == MAX_HULLSTACK)
+			{	// deeper than any sane map, the flags set so far are set again
+				return CM_RecursiveHullCheck (hull, startnum, startp1f, startp2f, p1, p2, trace);
+			}
+
+		// put the crosspoint DIST_EPSILON pixels on the near side
+			if (t1 < 0)
+				frac = (t1 + DIST_EPSILON)/(t1-t2);
+			else
+				frac = (t1 - DIST_EPSILON)/(t1-t2);
+			if (frac < 0)
+				frac = 0;
+			if (frac > 1)
+				frac = 1;
+
+			f = &stack[depth++];
+			f->node = node;
+			f->frac = frac;
+			f->p1f = p1f;
+			f->p2f = p2f;
+			f->midf = p1f + (p2f - p1f)*frac;
+			for (i=0 ; i<3 ; i++)
+				f->mid[i] = start[i] + frac*(end[i] - start[i]);
+			VectorCopy (start, f->p1);
+			VectorCopy (end, f->p2);
+			f->side = (t1 < 0);
+
+		// move up to the node
+			num = node->children[f->side];
+			p2f = f->midf;
+			VectorCopy (f->mid, end);
+		}
+
+	// reached a leaf
+		if (num != CONTENTS_SOLID)
+		{
+			trace->allsolid = false;
+			if (num == CONTENTS_EMPTY)
+				trace->inopen = true;
+			else
+				trace->inwater = true;
+		}
+		else
+			trace->startsolid = true;
+
+		if (!depth)
+			return true;		// empty
+
+	// back to the last crossed node, its near side was traced
+		f = &stack[--depth];
+		node = f->node;
+		side = f->side;
+
+		if (CM_HullPointContents (hull, node->children[side^1], f->mid)
+		!= CONTENTS_SOLID)
+		{	// go past the node
+			num = node->children[side^1];
+			p1f = f->midf;
+			p2f = f->p2f;
+			VectorCopy (f->mid, start);
+			VectorCopy (f->p2, end);
+			continue;
+		}
+
+		if (trace->allsolid)
+			return false;		// never got out of the solid area
+
+	//==================
+	// the other side of the node is solid, this is the impact point
+	//==================
+		if (!side)
+		{
+			VectorCopy (node->normal, trace->plane.normal);
+			trace->plane.dist = node->dist;
+		}
+		else
+		{
+			VectorSubtract (vec3_origin, node->normal, trace->plane.normal);
+			trace->plane.dist = -node->dist;
+		}
+
+		frac = f->frac;
+		midf = f->midf;
+		VectorCopy (f->mid, mid);
+		while (CM_HullPointContents (hull, hull->firstclipnode, mid)
+		== CONTENTS_SOLID)
+		{ // shouldn't really happen, but does occasionally
+			frac -= 0.1;
+			if (frac < 0)
+			{
+				trace->fraction = midf;
+				VectorCopy (mid, trace->endpos);
+				trace->backedup = true;
+				return false;
+			}
+			midf = f->p1f + (f->p2f - f->p1f)*frac;
+			for (i=0 ; i<3 ; i++)
+				mid[i] = f->p1[i] + frac*(f->p2[i] - f->p1[i]);
+		}
+
+		trace->fraction = midf;
+		VectorCopy (mid, trace->endpos);
+
+		return false;
+	}
+}
+
+
+/*
+==================
+CM_ClipHull
+==================
+*/
+trace_t CM_ClipHull (hull_t *hull, vec3_t offset, vec3_t start, vec3_t end)
+{
+	trace_t		trace;
+	vec3_t		start_l, end_l;
+
+// fill in a default trace
+	memset (&trace, 0, sizeof(trace_t));
+	trace.fraction = 1;
+	trace.allsolid = true;
+	VectorCopy (end, trace.endpos);
+
+	VectorSubtract (start, offset, start_l);
+	VectorSubtract (end, offset, end_l);
+
+	CM_HullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	if (trace.backedup)
+		Con_DPrintf ("backup past 0\n");
+
+// fix trace up by the offset
+	if (trace.fraction != 1)
+		VectorAdd (trace.endpos, offset, trace.endpos);
+
+	return trace;
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// collision.h -- tracing through the clipping hulls of brush models
+
+// Nothing in here knows about edicts or client entities, the server world
+// and the client both clip against model_t hulls with these, placed
+// wherever their entities are. trace->ent is left alone.
+
+typedef struct
+{
+	vec3_t	normal;
+	float	dist;
+} plane_t;
+
+typedef struct
+{
+	qboolean	allsolid;	// if true, plane is not valid
+	qboolean	startsolid;	// if true, the initial point was in a solid area
+	qboolean	inopen, inwater;
+	float	fraction;		// time completed, 1.0 = didn't hit anything
+	vec3_t	endpos;			// final position
+	plane_t	plane;			// surface normal at impact
+	edict_t	*ent;			// entity the surface is on
+	qboolean	backedup;	// the impact point was backed up past the start
+} trace_t;
+
+// a bounding box as a small bsp tree, so boxes are clipped against exactly
+// like brush models. Every thread that clips needs its own.
+
+typedef struct boxhull_s
+{
+	hull_t		hull;
+	dclipnode_t	clipnodes[6];
+	mplane_t	planes[6];
+	mclipnode_t	nodes[6];
+} boxhull_t;
+
+void CM_InitBoxHull (boxhull_t *box);
+
+hull_t *CM_HullForBox (boxhull_t *box, vec3_t mins, vec3_t maxs);
+// sets the box to mins/maxs and returns its hull
+
+hull_t *CM_HullForSize (model_t *model, vec3_t mins, vec3_t maxs);
+// the hull of a brush model to clip a box of mins/maxs size against
+
+int CM_HullPointContents (hull_t *hull, int num, vec3_t p);
+// the CONTENTS_* value of the hull at p
+
+qboolean CM_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+qboolean CM_HullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+// traces a line through a hull, the second one without recursion
+
+trace_t CM_ClipHull (hull_t *hull, vec3_t offset, vec3_t start, vec3_t end);
+// traces start to end through a hull placed at offset, a fraction of 1
+// leaves endpos at end
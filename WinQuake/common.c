@@ -285,6 +285,29 @@ int Q_strcasecmp (char *s1, char *s2)
 	return Q_strncasecmp (s1, s2, 99999);
 }
 
+/*
+============
+COM_HashName
+
+Folds case the same way as Q_strcasecmp, so names that only differ in case
+end up in the same hash chain
+============
+*/
+unsigned COM_HashName (char *name)
+{
+	unsigned	hash;
+	int			c;
+
+	hash = 0;
+	while ((c = *name++) != 0)
+	{
+		if (c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
+		hash = hash * 31 + c;
+	}
+	return hash;
+}
+
 int Q_atoi (char *str)
 {
 	int             val;
@@ -1286,7 +1309,7 @@ void COM_WriteFile (char *filename, void *data, int len)
 		return;
 	}
 	
-	Sys_Printf ("COM_WriteFile: %s\n", name);
+	Con_LogPrintf (LOG_FILES, "COM_WriteFile: %s\n", name);
 	Sys_FileWrite (handle, data, len);
 	Sys_FileClose (handle);
 }
@@ -1296,7 +1319,7 @@ void COM_WriteFile (char *filename, void *data, int len)
 ============
 COM_CreatePath
 
-Only used for CopyFile
+Creates the directories leading to the file
 ============
 */
 void    COM_CreatePath (char *path)
@@ -1350,13 +1373,15 @@ void COM_CopyFile (char *netpath, char *cachepath)
 
 /*
 ===========
-COM_FindFile
+COM_SearchFile
 
 Finds the file in the search path.
-Sets com_filesize and one of handle or file
+Sets one of handle or file and returns the file length.
+Opening a FILE doesn't touch any global state, so it can be done from other
+threads than the main one. Only the main thread may log.
 ===========
 */
-int COM_FindFile (char *filename, int *handle, FILE **file)
+static int COM_SearchFile (char *filename, int *handle, FILE **file, qboolean log)
 {
 	searchpath_t    *search;
 	char            netpath[MAX_OSPATH];
@@ -1390,7 +1415,8 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 			for (i=0 ; i<pak->numfiles ; i++)
 				if (!strcmp (pak->files[i].name, filename))
 				{       // found it!
-					Sys_Printf ("PackFile: %s : %s\n",pak->filename, filename);
+					if (log)
+						Con_LogPrintf (LOG_FILES, "PackFile: %s : %s\n",pak->filename, filename);
 					if (handle)
 					{
 						*handle = pak->handle;
@@ -1402,8 +1428,7 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 						if (*file)
 							fseek (*file, pak->files[i].filepos, SEEK_SET);
 					}
-					com_filesize = pak->files[i].filelen;
-					return com_filesize;
+					return pak->files[i].filelen;
 				}
 		}
 		else
@@ -1442,31 +1467,51 @@ int COM_FindFile (char *filename, int *handle, FILE **file)
 				strcpy (netpath, cachepath);
 			}	
 
-			Sys_Printf ("FindFile: %s\n",netpath);
-			com_filesize = Sys_FileOpenRead (netpath, &i);
+			if (log)
+				Con_LogPrintf (LOG_FILES, "FindFile: %s\n",netpath);
 			if (handle)
-				*handle = i;
-			else
 			{
-				Sys_FileClose (i);
-				*file = fopen (netpath, "rb");
+				*handle = -1;
+				return Sys_FileOpenRead (netpath, handle);
 			}
-			return com_filesize;
+
+			*file = fopen (netpath, "rb");
+			if (!*file)
+				return -1;
+			fseek (*file, 0, SEEK_END);
+			i = ftell (*file);
+			fseek (*file, 0, SEEK_SET);
+			return i;
 		}
 		
 	}
 	
-	Sys_Printf ("FindFile: can't find %s\n", filename);
+	if (log)
+		Con_LogPrintf (LOG_FILES, "FindFile: can't find %s\n", filename);
 	
 	if (handle)
 		*handle = -1;
 	else
 		*file = NULL;
-	com_filesize = -1;
 	return -1;
 }
 
 
+/*
+===========
+COM_FindFile
+
+Finds the file in the search path.
+Sets com_filesize and one of handle or file
+===========
+*/
+int COM_FindFile (char *filename, int *handle, FILE **file)
+{
+	com_filesize = COM_SearchFile (filename, handle, file, true);
+	return com_filesize;
+}
+
+
 /*
 ===========
 COM_OpenFile
@@ -1494,6 +1539,18 @@ int COM_FOpenFile (char *filename, FILE **file)
 	return COM_FindFile (filename, NULL, file);
 }
 
+/*
+============
+COM_ThreadFOpenFile
+
+COM_FOpenFile for threads other than the main one, leaves com_filesize alone
+============
+*/
+int COM_ThreadFOpenFile (char *filename, FILE **file)
+{
+	return COM_SearchFile (filename, NULL, file, false);
+}
+
 /*
 ============
 COM_CloseFile
@@ -1513,6 +1570,320 @@ void COM_CloseFile (int h)
 }
 
 
+/*
+=============================================================================
+
+PREFETCHING
+
+Files that are going to be loaded soon, like the precached models of a new
+level, are read by a thread of their own into malloc'd buffers while the
+main thread is busy with something else. COM_LoadFile then copies them from
+there instead of reading the disk, the buffers it returns are allocated the
+same way as before.
+
+=============================================================================
+*/
+
+#define	MAX_PREFETCH		256
+#define	PREFETCH_MEMORY		(32*1024*1024)	// bigger files are read when loaded
+
+typedef enum {pf_free, pf_queued, pf_reading, pf_done} pfstate_t;
+
+typedef struct
+{
+	char		name[MAX_QPATH];
+	pfstate_t	state;
+	byte		*data;		// NULL if the file couldn't be read
+	int			len;
+} prefetch_t;
+
+cvar_t	com_prefetch = {"com_prefetch", "1"};
+
+static prefetch_t	prefetch[MAX_PREFETCH];
+static int			prefetchmemory;		// bytes of data waiting to be taken
+static void			*prefetchmutex;		// guards prefetch and prefetchmemory
+static void			*prefetchsem;		// posted for every queued file
+static void			*prefetchdonesem;	// posted for every read file
+static void			*prefetchthread;
+static qboolean		prefetchquit;
+static int			prefetchhits, prefetchmisses;
+
+static int COM_PrefetchThread (void *arg)
+{
+	prefetch_t	*p;
+	char		name[MAX_QPATH];
+	FILE		*f;
+	byte		*data;
+	int			i, len;
+	qboolean	fits;
+
+	UNUSED(arg);
+
+	while (1)
+	{
+		Jobs_SemaphoreWait (prefetchsem);
+		if (prefetchquit)
+			break;
+
+		Jobs_LockMutex (prefetchmutex);
+		for (i=0, p=prefetch ; i<MAX_PREFETCH ; i++, p++)
+			if (p->state == pf_queued)
+				break;
+		if (i == MAX_PREFETCH)
+		{	// taken or cleared before it was read
+			Jobs_UnlockMutex (prefetchmutex);
+			continue;
+		}
+		p->state = pf_reading;
+		strcpy (name, p->name);
+		Jobs_UnlockMutex (prefetchmutex);
+
+		data = NULL;
+		len = COM_ThreadFOpenFile (name, &f);
+		if (f)
+		{
+			Jobs_LockMutex (prefetchmutex);
+			fits = prefetchmemory + len <= PREFETCH_MEMORY;
+			if (fits)
+				prefetchmemory += len;
+			Jobs_UnlockMutex (prefetchmutex);
+
+			if (fits)
+			{
+				data = malloc (len);
+				if (!data || fread (data, 1, len, f) != len)
+				{
+					free (data);
+					data = NULL;
+				}
+			}
+			fclose (f);
+
+			if (fits && !data)
+			{
+				Jobs_LockMutex (prefetchmutex);
+				prefetchmemory -= len;
+				Jobs_UnlockMutex (prefetchmutex);
+			}
+		}
+
+		Jobs_LockMutex (prefetchmutex);
+		p->data = data;
+		p->len = len;
+		p->state = pf_done;
+		Jobs_UnlockMutex (prefetchmutex);
+		Jobs_SemaphorePost (prefetchdonesem);
+	}
+
+	return 0;
+}
+
+/*
+============
+COM_PrefetchFile
+
+Starts reading a file in the background, if it isn't already
+============
+*/
+void COM_PrefetchFile (char *path)
+{
+	int			i, freeslot;
+	prefetch_t	*p;
+
+	if (!prefetchthread || !com_prefetch.value || strlen (path) >= MAX_QPATH)
+		return;
+
+	Jobs_LockMutex (prefetchmutex);
+	freeslot = -1;
+	for (i=0, p=prefetch ; i<MAX_PREFETCH ; i++, p++)
+	{
+		if (p->state == pf_free)
+		{
+			if (freeslot == -1)
+				freeslot = i;
+		}
+		else if (!strcmp (p->name, path))
+		{
+			Jobs_UnlockMutex (prefetchmutex);
+			return;
+		}
+	}
+	if (freeslot != -1)
+	{
+		p = &prefetch[freeslot];
+		strcpy (p->name, path);
+		p->data = NULL;
+		p->state = pf_queued;
+	}
+	Jobs_UnlockMutex (prefetchmutex);
+
+	if (freeslot != -1)
+		Jobs_SemaphorePost (prefetchsem);
+}
+
+/*
+============
+COM_TakePrefetched
+
+Returns the malloc'd data of a prefetched file, waiting for it if it's being
+read, or NULL if the file has to be read now
+============
+*/
+static byte *COM_TakePrefetched (char *path, int *len)
+{
+	int			i;
+	prefetch_t	*p;
+	byte		*data;
+
+	if (!prefetchthread)
+		return NULL;
+
+	Jobs_LockMutex (prefetchmutex);
+	for (i=0, p=prefetch ; i<MAX_PREFETCH ; i++, p++)
+		if (p->state != pf_free && !strcmp (p->name, path))
+			break;
+	if (i == MAX_PREFETCH)
+	{
+		Jobs_UnlockMutex (prefetchmutex);
+		return NULL;
+	}
+
+	// the posts of files nobody waited for wake this up early, so check again
+	while (p->state == pf_reading)
+	{
+		Jobs_UnlockMutex (prefetchmutex);
+		Jobs_SemaphoreWait (prefetchdonesem);
+		Jobs_LockMutex (prefetchmutex);
+	}
+
+	data = NULL;
+	if (p->state == pf_done)
+	{
+		data = p->data;
+		*len = p->len;
+		if (data)
+			prefetchmemory -= p->len;
+	}
+	p->state = pf_free;		// still queued, it's needed now
+	p->data = NULL;
+	Jobs_UnlockMutex (prefetchmutex);
+
+	if (data)
+		prefetchhits++;
+	else
+		prefetchmisses++;
+
+	return data;
+}
+
+/*
+============
+COM_ClearPrefetch
+
+Frees the prefetched files that weren't loaded
+============
+*/
+void COM_ClearPrefetch (void)
+{
+	int			i, unused;
+	prefetch_t	*p;
+	qboolean	reading;
+
+	if (!prefetchthread)
+		return;
+
+	Con_DPrintf ("prefetch: %i hits, %i misses\n", prefetchhits, prefetchmisses);
+	prefetchhits = prefetchmisses = 0;
+
+	unused = 0;
+	Jobs_LockMutex (prefetchmutex);
+	do
+	{
+		reading = false;
+		for (i=0, p=prefetch ; i<MAX_PREFETCH ; i++, p++)
+		{
+			if (p->state == pf_reading)
+			{
+				reading = true;
+				continue;
+			}
+			if (p->state == pf_done)
+				unused++;
+			if (p->data)
+			{
+				prefetchmemory -= p->len;
+				free (p->data);
+				p->data = NULL;
+			}
+			p->state = pf_free;
+		}
+
+		if (reading)
+		{
+			Jobs_UnlockMutex (prefetchmutex);
+			Jobs_SemaphoreWait (prefetchdonesem);
+			Jobs_LockMutex (prefetchmutex);
+		}
+	} while (reading);
+	Jobs_UnlockMutex (prefetchmutex);
+
+	if (unused)
+		Con_DPrintf ("prefetch: %i files not loaded\n", unused);
+}
+
+/*
+============
+COM_InitPrefetch
+
+Jobs_Init must have been called
+============
+*/
+void COM_InitPrefetch (void)
+{
+	Cvar_RegisterVariable (&com_prefetch);
+
+	COM_StartPrefetch ();
+}
+
+/*
+============
+COM_StartPrefetch
+
+Starts the thread again after COM_ShutdownPrefetch, for a forked server
+============
+*/
+void COM_StartPrefetch (void)
+{
+	prefetchquit = false;
+	prefetchmutex = Jobs_CreateMutex ();
+	prefetchsem = Jobs_CreateSemaphore ();
+	prefetchdonesem = Jobs_CreateSemaphore ();
+	prefetchthread = Jobs_CreateThread (COM_PrefetchThread, "prefetch", NULL);
+}
+
+/*
+============
+COM_ShutdownPrefetch
+============
+*/
+void COM_ShutdownPrefetch (void)
+{
+	if (!prefetchthread)
+		return;
+
+	COM_ClearPrefetch ();
+
+	prefetchquit = true;
+	Jobs_SemaphorePost (prefetchsem);
+	Jobs_WaitThread (prefetchthread);
+	prefetchthread = NULL;
+
+	Jobs_DestroySemaphore (prefetchdonesem);
+	Jobs_DestroySemaphore (prefetchsem);
+	Jobs_DestroyMutex (prefetchmutex);
+}
+
+
 /*
 ============
 COM_LoadFile
@@ -1530,13 +1901,23 @@ byte *COM_LoadFile (char *path, int usehunk)
 	byte    *buf;
 	char    base[32];
 	int             len;
+	byte	*prefetched;
 
 	buf = NULL;     // quiet compiler warning
 
-// look for it in the filesystem or pack files
-	len = COM_OpenFile (path, &h);
-	if (h == -1)
-		return NULL;
+// take it from the prefetch thread or look for it in the filesystem or pack files
+	prefetched = COM_TakePrefetched (path, &len);
+	if (prefetched)
+	{
+		h = -1;
+		com_filesize = len;
+	}
+	else
+	{
+		len = COM_OpenFile (path, &h);
+		if (h == -1)
+			return NULL;
+	}
 	
 // extract the filename base name for hunk tag
 	COM_FileBase (path, base);
@@ -1565,8 +1946,16 @@ byte *COM_LoadFile (char *path, int usehunk)
 	((byte *)buf)[len] = 0;
 
 	Draw_BeginDisc ();
-	Sys_FileRead (h, buf, len);                     
-	COM_CloseFile (h);
+	if (prefetched)
+	{
+		memcpy (buf, prefetched, len);
+		free (prefetched);
+	}
+	else
+	{
+		Sys_FileRead (h, buf, len);                     
+		COM_CloseFile (h);
+	}
 	Draw_EndDisc ();
 
 	return buf;
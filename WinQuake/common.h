@@ -134,6 +134,7 @@ int Q_strcmp (char *s1, char *s2);
 int Q_strncmp (char *s1, char *s2, int count);
 int Q_strcasecmp (char *s1, char *s2);
 int Q_strncasecmp (char *s1, char *s2, int n);
+unsigned COM_HashName (char *name);
 int	Q_atoi (char *str);
 float Q_atof (char *str);
 
@@ -169,8 +170,10 @@ struct cache_user_s;
 extern	char	com_gamedir[MAX_OSPATH];
 
 void COM_WriteFile (char *filename, void *data, int len);
+void COM_CreatePath (char *path);
 int COM_OpenFile (char *filename, int *hndl);
 int COM_FOpenFile (char *filename, FILE **file);
+int COM_ThreadFOpenFile (char *filename, FILE **file);
 void COM_CloseFile (int h);
 
 byte *COM_LoadStackFile (char *path, void *buffer, int bufsize);
@@ -178,6 +181,12 @@ byte *COM_LoadTempFile (char *path);
 byte *COM_LoadHunkFile (char *path);
 void COM_LoadCacheFile (char *path, struct cache_user_s *cu);
 
+void COM_InitPrefetch (void);
+void COM_StartPrefetch (void);
+void COM_ShutdownPrefetch (void);
+void COM_PrefetchFile (char *path);
+void COM_ClearPrefetch (void);
+
 
 extern	struct cvar_s	registered;
 
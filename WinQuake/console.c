@@ -46,6 +46,8 @@ int			con_x;				// offset in current line for next print
 char		*con_text=0;
 
 cvar_t		con_notifytime = {"con_notifytime","3"};		//seconds
+cvar_t		con_updaterate = {"con_updaterate","20"};		// redraws per second while loading, 0 = every message
+cvar_t		log_categories = {"log_categories","0"};		// LOG_* bits that Con_LogPrintf prints
 
 #define	NUM_CON_TIMES 4
 float		con_times[NUM_CON_TIMES];	// realtime time the line was generated
@@ -54,6 +56,7 @@ float		con_times[NUM_CON_TIMES];	// realtime time the line was generated
 int			con_vislines;
 
 qboolean	con_debuglog;
+double		con_lastupdate;			// Sys_FloatTime of the last redraw while loading
 
 #define		MAXCMDLINE	256
 extern	char	key_lines[32][MAXCMDLINE];
@@ -67,6 +70,8 @@ int			con_notifylines;		// scan lines to clear for notify lines
 
 extern void M_Menu_Main_f (void);
 
+static void Con_OpenLog (void);
+
 /*
 ================
 Con_ToggleConsole_f
@@ -214,20 +219,10 @@ Con_Init
 */
 void Con_Init (void)
 {
-#define MAXGAMEDIRLEN	1000
-	char	temp[MAXGAMEDIRLEN+1];
-	char	*t2 = "/qconsole.log";
-
 	con_debuglog = COM_CheckParm("-condebug");
 
 	if (con_debuglog)
-	{
-		if (strlen (com_gamedir) < (MAXGAMEDIRLEN - strlen (t2)))
-		{
-			sprintf (temp, "%s%s", com_gamedir, t2);
-			unlink (temp);
-		}
-	}
+		Con_OpenLog ();
 
 	con_text = Hunk_AllocName (CON_TEXTSIZE, "context");
 	Q_memset (con_text, ' ', CON_TEXTSIZE);
@@ -240,6 +235,8 @@ void Con_Init (void)
 // register our commands
 //
 	Cvar_RegisterVariable (&con_notifytime);
+	Cvar_RegisterVariable (&con_updaterate);
+	Cvar_RegisterVariable (&log_categories);
 
 	Cmd_AddCommand ("toggleconsole", Con_ToggleConsole_f);
 	Cmd_AddCommand ("messagemode", Con_MessageMode_f);
@@ -348,23 +345,201 @@ void Con_Print (char *txt)
 }
 
 
+/*
+==============================================================================
+
+LOG FILE
+
+==============================================================================
+*/
+
+// -condebug appends every message to qconsole.log. The file stays open and
+// the messages only go into a ring buffer, a thread of its own writes them
+// out, so printing never waits for the disk. Only the main thread prints and
+// only the log thread writes, so each end of the ring has one writer and the
+// two counters are enough to share it.
+
+#define	LOG_BUFFERSIZE	(256*1024)		// power of two
+#define	MAXPRINTMSG		4096
+
+static char		con_logbuffer[LOG_BUFFERSIZE];
+static int		con_loghead;			// bytes put in, set by the main thread
+static int		con_logtail;			// bytes written out, set by the log thread
+static int		con_logquit;
+static int		con_logfile = -1;
+static void		*con_logthread;
+static void		*con_logsem;			// posted for every message
+static void		*con_logdonesem;		// posted after every write
+
+/*
+================
+Con_LogThread
+================
+*/
+static int Con_LogThread (void *arg)
+{
+	unsigned	head, tail, ofs, len;
+	int			quit;
+
+	UNUSED(arg);
+
+	tail = Jobs_AtomicGet (&con_logtail);
+	do
+	{
+		Jobs_SemaphoreWait (con_logsem);
+
+		// anything put in before the quit gets written
+		quit = Jobs_AtomicGet (&con_logquit);
+		head = Jobs_AtomicGet (&con_loghead);
+		while (tail != head)
+		{
+			ofs = tail & (LOG_BUFFERSIZE-1);
+			len = head - tail;
+			if (len > LOG_BUFFERSIZE - ofs)
+				len = LOG_BUFFERSIZE - ofs;
+			write (con_logfile, con_logbuffer + ofs, len);
+			tail += len;
+		}
+
+		Jobs_AtomicSet (&con_logtail, tail);
+		Jobs_SemaphorePost (con_logdonesem);
+	} while (!quit);
+
+	return 0;
+}
+
+/*
+================
+Con_StartLog
+
+Starts the log thread again after Con_StopLog, for a forked server
+================
+*/
+void Con_StartLog (void)
+{
+	if (con_logfile == -1 || con_logthread)
+		return;
+
+	Jobs_AtomicSet (&con_logquit, 0);
+	con_logsem = Jobs_CreateSemaphore ();
+	con_logdonesem = Jobs_CreateSemaphore ();
+	con_logthread = Jobs_CreateThread (Con_LogThread, "log", NULL);
+	if (!con_logthread)
+	{
+		Jobs_DestroySemaphore (con_logsem);
+		Jobs_DestroySemaphore (con_logdonesem);
+	}
+}
+
+/*
+================
+Con_StopLog
+
+Writes out everything that was printed, the messages after this are written
+right away
+================
+*/
+void Con_StopLog (void)
+{
+	if (!con_logthread)
+		return;
+
+	Jobs_AtomicSet (&con_logquit, 1);
+	Jobs_SemaphorePost (con_logsem);
+	Jobs_WaitThread (con_logthread);
+	con_logthread = NULL;
+
+	Jobs_DestroySemaphore (con_logsem);
+	Jobs_DestroySemaphore (con_logdonesem);
+}
+
+/*
+================
+Con_OpenLog
+================
+*/
+static void Con_OpenLog (void)
+{
+	char	*name;
+
+	name = va("%s/qconsole.log", com_gamedir);
+	unlink (name);
+	con_logfile = open (name, O_WRONLY | O_CREAT | O_APPEND, 0666);
+	if (con_logfile == -1)
+		return;
+
+	Con_StartLog ();
+}
+
+/*
+================
+Con_LogText
+================
+*/
+static void Con_LogText (char *text)
+{
+	unsigned	head, tail, len, ofs, count;
+
+	len = strlen (text);
+
+	if (!con_logthread)
+	{
+		if (con_logfile != -1)
+			write (con_logfile, text, len);
+		return;
+	}
+
+	head = Jobs_AtomicGet (&con_loghead);
+	while (len)
+	{
+		// the posts of writes nobody waited for wake this up early, so check again
+		while ( (tail = Jobs_AtomicGet (&con_logtail)) == head - LOG_BUFFERSIZE)
+		{
+			Jobs_SemaphorePost (con_logsem);
+			Jobs_SemaphoreWait (con_logdonesem);
+		}
+
+		ofs = head & (LOG_BUFFERSIZE-1);
+		count = LOG_BUFFERSIZE - (head - tail);
+		if (count > LOG_BUFFERSIZE - ofs)
+			count = LOG_BUFFERSIZE - ofs;
+		if (count > len)
+			count = len;
+
+		memcpy (con_logbuffer + ofs, text, count);
+		text += count;
+		len -= count;
+		head += count;
+		Jobs_AtomicSet (&con_loghead, head);
+	}
+
+	Jobs_SemaphorePost (con_logsem);
+}
+
 /*
 ================
-Con_DebugLog
+Con_LogPrintf
+
+For messages that would be too many to print all the time, like every file
+that is opened. They only go to stdout and the log file, and only if the
+category is in log_categories.
 ================
 */
-void Con_DebugLog(char *file, char *fmt, ...)
+void Con_LogPrintf (int category, char *fmt, ...)
 {
-    va_list argptr; 
-    static char data[1024];
-    int fd;
-    
-    va_start(argptr, fmt);
-    vsprintf(data, fmt, argptr);
-    va_end(argptr);
-    fd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0666);
-    write(fd, data, strlen(data));
-    close(fd);
+	va_list		argptr;
+	char		msg[MAXPRINTMSG];
+
+	if (!((int)log_categories.value & category))
+		return;
+
+	va_start (argptr,fmt);
+	vsprintf (msg,fmt,argptr);
+	va_end (argptr);
+
+	Sys_Printf ("%s", msg);
+	if (con_debuglog)
+		Con_LogText (msg);
 }
 
 
@@ -375,13 +550,13 @@ Con_Printf
 Handles cursor positioning, line wrapping, etc
 ================
 */
-#define	MAXPRINTMSG	4096
 // FIXME: make a buffer size safe vsprintf?
 void Con_Printf (char *fmt, ...)
 {
 	va_list		argptr;
 	char		msg[MAXPRINTMSG];
 	static qboolean	inupdate;
+	double		time;
 	
 	va_start (argptr,fmt);
 	vsprintf (msg,fmt,argptr);
@@ -392,7 +567,7 @@ void Con_Printf (char *fmt, ...)
 
 // log all messages to file
 	if (con_debuglog)
-		Con_DebugLog(va("%s/qconsole.log",com_gamedir), "%s", msg);
+		Con_LogText (msg);
 
 	if (!con_initialized)
 		return;
@@ -406,10 +581,16 @@ void Con_Printf (char *fmt, ...)
 // update the screen if the console is displayed
 	if (cls.signon != SIGNONS && !scr_disabled_for_loading )
 	{
+	// a map load prints hundreds of lines, draw them at con_updaterate
+		time = Sys_FloatTime ();
+		if (con_updaterate.value > 0 && time - con_lastupdate < 1.0 / con_updaterate.value)
+			return;
+
 	// protect against infinite loop if something in SCR_UpdateScreen calls
 	// Con_Printd
 		if (!inupdate)
 		{
+			con_lastupdate = time;
 			inupdate = true;
 			SCR_UpdateScreen ();
 			inupdate = false;
@@ -38,6 +38,13 @@ void Con_Print (char *txt);
 void Con_Printf (char *fmt, ...);
 void Con_DPrintf (char *fmt, ...);
 void Con_SafePrintf (char *fmt, ...);
+void Con_StartLog (void);
+void Con_StopLog (void);
+
+// categories of Con_LogPrintf, the bits of the log_categories cvar
+#define	LOG_FILES		1		// every file that is found, opened or written
+
+void Con_LogPrintf (int category, char *fmt, ...);
 void Con_Clear_f (void);
 void Con_DrawNotify (void);
 void Con_ClearNotify (void);
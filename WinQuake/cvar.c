@@ -25,6 +25,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 cvar_t	*cvar_vars;
 char	*cvar_null_string = "";
 
+#define	CVAR_HASH_SIZE	256		// power of two
+
+static	cvar_t	*cvar_hash[CVAR_HASH_SIZE];
+
 #define MAX_HIDDEN_CVARS 64
 cvar_t	hidden_cvars[ MAX_HIDDEN_CVARS ];
 int		hidden_cvars_num = 0;
@@ -69,9 +73,13 @@ cvar_t *Cvar_FindVar (char *var_name)
 {
 	cvar_t	*var;
 	
-	for (var=cvar_vars ; var ; var=var->next)
+	cmd_stats.cvarlookups++;
+	for (var=cvar_hash[COM_HashName (var_name) & (CVAR_HASH_SIZE-1)] ; var ; var=var->hashnext)
+	{
+		cmd_stats.compares++;
 		if (!Q_strcmp (var_name, var->name))
 			return var;
+	}
 
 	return NULL;
 }
@@ -140,7 +148,6 @@ Cvar_Set
 void Cvar_Set (char *var_name, char *value)
 {
 	cvar_t	*var;
-	qboolean changed;
 	
 	var = Cvar_FindVar (var_name);
 	if (!var)
@@ -149,6 +156,18 @@ void Cvar_Set (char *var_name, char *value)
 		return;
 	}
 
+	Cvar_SetVar (var, value);
+}
+
+/*
+============
+Cvar_SetVar
+============
+*/
+void Cvar_SetVar (cvar_t *var, char *value)
+{
+	qboolean changed;
+
 	changed = Q_strcmp(var->string, value);
 	
 	Z_Free (var->string);	// free the old value string
@@ -187,6 +206,7 @@ Adds a freestanding variable to the variable list.
 void Cvar_RegisterVariable (cvar_t *variable)
 {
 	char	*oldstr;
+	int		hash;
 	
 // first check to see if it has allready been defined
 	if (Cvar_FindVar (variable->name))
@@ -211,6 +231,10 @@ void Cvar_RegisterVariable (cvar_t *variable)
 // link the variable in
 	variable->next = cvar_vars;
 	cvar_vars = variable;
+
+	hash = COM_HashName (variable->name) & (CVAR_HASH_SIZE-1);
+	variable->hashnext = cvar_hash[hash];
+	cvar_hash[hash] = variable;
 }
 
 /*
@@ -245,7 +269,7 @@ qboolean	Cvar_Command (void)
 		return true;
 	}
 
-	Cvar_Set (v->name, Cmd_Argv(1));
+	Cvar_SetVar (v, Cmd_Argv(1));
 	return true;
 }
 
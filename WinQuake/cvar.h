@@ -62,6 +62,7 @@ typedef struct cvar_s
 	qboolean server;		// notifies players when changed
 	float	value;
 	struct cvar_s *next;
+	struct cvar_s *hashnext;
 } cvar_t;
 
 void 	Cvar_RegisterVariable (cvar_t *variable);
@@ -71,6 +72,9 @@ void 	Cvar_RegisterVariable (cvar_t *variable);
 void 	Cvar_Set (char *var_name, char *value);
 // equivelant to "<name> <variable>" typed at the console
 
+void	Cvar_SetVar (cvar_t *var, char *value);
+// Cvar_Set for a variable that was already looked up
+
 void	Cvar_SetValue (char *var_name, float value);
 // expands value to a string and calls Cvar_Set
 
@@ -202,6 +202,8 @@ void D_DrawSurfaces (void)
 	}
 	else
 	{
+		D_CacheSurfaces ();
+
 		for (s = &surfaces[1] ; s<surface_p ; s++)
 		{
 			if (!s->spans)
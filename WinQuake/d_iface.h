@@ -36,19 +36,20 @@ typedef enum {
 	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
-typedef struct particle_s
+// every field is an array, the live particles are packed at the start
+typedef struct
 {
 // driver-usable fields
-	vec3_t		org;
-	float		color;
+	float		*org[3];
+	byte		*color;
+	int			numparticles;
 // drivers never touch the following fields
-	struct particle_s	*next;
-	vec3_t		vel;
-	float		ramp;
-	float		die;
-	ptype_t		type;
-} particle_t;
+	float		*vel[3];
+	float		*ramp;
+	float		*die;
+	byte		*type;		// ptype_t
+	int			maxparticles;
+} particles_t;
 
 #define PARTICLE_Z_CLIP	8.0
 
@@ -149,7 +150,8 @@ void D_DisableBackBufferAccess (void);
 void D_EndDirectRect (int x, int y, int width, int height);
 void D_PolysetDraw (void);
 void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts);
-void D_DrawParticle (particle_t *pparticle);
+void D_FlushPolysets (void);
+void D_DrawParticles (particles_t *pparticles);
 void D_DrawPoly (void);
 void D_DrawSprite (void);
 void D_DrawSurfaces (void);
@@ -165,11 +167,6 @@ void D_WarpScreen (void);
 
 void D_UpdateRects (vrect_t *prect);
 
-// currently for internal use only, and should be a do-nothing function in
-// hardware drivers
-// FIXME: this should go away
-void D_PolysetUpdateTables (void);
-
 // these are currently for internal use only, and should not be used by drivers
 extern int				r_skydirect;
 extern byte				*r_skysource;
@@ -199,9 +196,7 @@ typedef struct
 	int			surfheight;	// in mipmapped texels
 } drawsurf_t;
 
-extern drawsurf_t	r_drawsurf;
-
-void R_DrawSurface (void);
+void R_DrawSurface (drawsurf_t *ds);
 void R_GenTile (msurface_t *psurf, void *pdest);
 
 
@@ -29,6 +29,11 @@ cvar_t	d_subdiv16 = {"d_subdiv16", "1"};
 cvar_t	d_mipcap = {"d_mipcap", "0"};
 cvar_t	d_mipscale = {"d_mipscale", "1"};
 
+extern cvar_t	d_surfcacheauto;
+extern cvar_t	d_surfcachemax;
+extern cvar_t	d_surfjobs;
+extern cvar_t	d_polysetjobs;
+
 surfcache_t		*d_initial_rover;
 qboolean		d_roverwrapped;
 int				d_minmip;
@@ -42,7 +47,7 @@ void (*d_drawspans) (espan_t *pspan);
 void (*d_drawturbulent) (espan_t *pspan);
 void (*d_drawskyscans) (espan_t *pspan);
 void (*d_drawparticlepixels) (void);
-void (*d_drawpolysetspans) (spanpackage_t *pspanpackage);
+void (*d_drawpolysetspans) (polysetctx_t *ps, spanpackage_t *pspanpackage);
 void (*d_spritedrawspans) (sspan_t *pspan);
 
 /*
@@ -58,6 +63,10 @@ void D_Init (void)
 	Cvar_RegisterVariable (&d_subdiv16);
 	Cvar_RegisterVariable (&d_mipcap);
 	Cvar_RegisterVariable (&d_mipscale);
+	Cvar_RegisterVariable (&d_surfcacheauto);
+	Cvar_RegisterVariable (&d_surfcachemax);
+	Cvar_RegisterVariable (&d_surfjobs);
+	Cvar_RegisterVariable (&d_polysetjobs);
 
 	r_drawpolys = false;
 	r_worldpolysbacktofront = false;
@@ -49,6 +49,7 @@ typedef struct surfcache_s
 	struct surfcache_s 	**owner;		// NULL is an empty chunk of memory
 	int					lightadj[MAXLIGHTMAPS]; // checked for strobe flush
 	int					dlight;
+	int					framecount;	// last frame the block was used in
 	int					size;		// including header
 	unsigned			width;
 	unsigned			height;		// DEBUG only needed for debug
@@ -93,12 +94,15 @@ void D_DrawSkyScans32 (espan_t *pspan);
 void D_DrawParticlePixels8(void);
 void D_DrawParticlePixels32(void);
 
-void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage);
-void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage);
+typedef struct polysetctx_s polysetctx_t;	// rasterizer state of one thread
+
+void D_PolysetDrawSpans8 (polysetctx_t *ps, spanpackage_t *pspanpackage);
+void D_PolysetDrawSpans32 (polysetctx_t *ps, spanpackage_t *pspanpackage);
 
 void R_ShowSubDiv (void);
 void (*prealspandrawer)(void);
 surfcache_t	*D_CacheSurface (msurface_t *surface, int miplevel);
+void		D_CacheSurfaces (void);
 
 extern int D_MipLevelForScale (float scale);
 
@@ -124,7 +128,7 @@ extern void (*d_drawspans) (espan_t *pspan);
 extern void (*d_drawturbulent) (espan_t *pspan);
 extern void (*d_drawskyscans) (espan_t *pspan);
 extern void (*d_drawparticlepixels) (void);
-extern void (*d_drawpolysetspans) (spanpackage_t *pspanpackage);
+extern void (*d_drawpolysetspans) (polysetctx_t *ps, spanpackage_t *pspanpackage);
 extern void (*d_spritedrawspans) (sspan_t *pspan);
 
 extern	cvar_t		r_particle_size;
\ No newline at end of file
@@ -291,50 +291,75 @@ void D_DrawParticlePixels32(void)
 
 /*
 ==============
-D_DrawParticle
+D_DrawParticles
+
+Transforms a batch of particles first, then projects and draws the
+visible ones
 ==============
 */
-void D_DrawParticle (particle_t *pparticle)
+#define	PARTICLE_BATCH	256
+
+void D_DrawParticles (particles_t *pparticles)
 {
-	vec3_t	local, transformed;
+	float	tx[PARTICLE_BATCH], ty[PARTICLE_BATCH], tz[PARTICLE_BATCH];
+	float	local[3];
+	float	*ox, *oy, *oz;
 	float	zi;
-	byte	*pdest;
-	short	*pz;
+	int		first, count, i;
 
-// transform point
-	VectorSubtract (pparticle->org, r_origin, local);
+	for (first=0 ; first<pparticles->numparticles ; first+=PARTICLE_BATCH)
+	{
+		count = pparticles->numparticles - first;
+		if (count > PARTICLE_BATCH)
+			count = PARTICLE_BATCH;
 
-	transformed[0] = DotProduct(local, r_pright);
-	transformed[1] = DotProduct(local, r_pup);
-	transformed[2] = DotProduct(local, r_ppn);		
+		ox = pparticles->org[0] + first;
+		oy = pparticles->org[1] + first;
+		oz = pparticles->org[2] + first;
 
-	if (transformed[2] < PARTICLE_Z_CLIP)
-		return;
+	// transform points
+		for (i=0 ; i<count ; i++)
+		{
+			local[0] = ox[i] - r_origin[0];
+			local[1] = oy[i] - r_origin[1];
+			local[2] = oz[i] - r_origin[2];
 
-// project the point
-// FIXME: preadjust xcenter and ycenter
-	zi = 1.0 / transformed[2];
-	part_u = (int)(xcenter + zi * transformed[0] + 0.5);
-	part_v = (int)(ycenter - zi * transformed[1] + 0.5);
+			tx[i] = DotProduct(local, r_pright);
+			ty[i] = DotProduct(local, r_pup);
+			tz[i] = DotProduct(local, r_ppn);
+		}
 
-	if ((part_v > d_vrectbottom_particle) || 
-		(part_u > d_vrectright_particle) ||
-		(part_v < d_vrecty) ||
-		(part_u < d_vrectx))
-	{
-		return;
-	}
+		for (i=0 ; i<count ; i++)
+		{
+			if (tz[i] < PARTICLE_Z_CLIP)
+				continue;
+
+		// project the point
+		// FIXME: preadjust xcenter and ycenter
+			zi = 1.0 / tz[i];
+			part_u = (int)(xcenter + zi * tx[i] + 0.5);
+			part_v = (int)(ycenter - zi * ty[i] + 0.5);
+
+			if ((part_v > d_vrectbottom_particle) || 
+				(part_u > d_vrectright_particle) ||
+				(part_v < d_vrecty) ||
+				(part_u < d_vrectx))
+			{
+				continue;
+			}
 
-	part_izi = (int)(zi * 0x8000);
+			part_izi = (int)(zi * 0x8000);
 
-	part_size = zi * d_pix_mul;
+			part_size = zi * d_pix_mul;
 
-	if (part_size < d_pix_min)
-		part_size = d_pix_min;
-	else if (part_size > d_pix_max)
-		part_size = d_pix_max;
+			if (part_size < d_pix_min)
+				part_size = d_pix_min;
+			else if (part_size > d_pix_max)
+				part_size = d_pix_max;
 
-	part_color = pparticle->color;
-	d_drawparticlepixels();
+			part_color = pparticles->color[first + i];
+			d_drawparticlepixels();
+		}
+	}
 }
 
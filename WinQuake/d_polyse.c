@@ -25,63 +25,115 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "r_local.h"
 #include "d_local.h"
 
+/*
+Alias models are not rasterized when they are set up. D_PolysetDraw records
+the front facing triangles of every draw, with the seam already fixed, and
+D_FlushPolysets rasterizes everything recorded so far on all threads. Each
+job draws all the triangles clipped to its own band of screen rows, in the
+recorded order, so every pixel and its z are written by one thread in the
+same order as before. All the rasterizer state lives in a polysetctx_t of
+the thread.
+*/
+
 #define DPS_MAXSPANS			MAXHEIGHT+1	
 									// 1 extra for spanpackage that marks end
 
+#define	MAX_POLYSETDRAWS	4096
+#define	MAX_POLYSETTRIS		32768
+#define	MAX_POLYSETTHREADS	17		// job workers and the main thread
+#define	MIN_POLYSETBANDROWS	8
+
 typedef struct {
 	int		isflattop;
 	int		numleftedges;
-	int		*pleftedgevert0;
-	int		*pleftedgevert1;
-	int		*pleftedgevert2;
+	int		leftedgevert0;		// indexes into polysetctx_t.p, -1 = none
+	int		leftedgevert1;
+	int		leftedgevert2;
 	int		numrightedges;
-	int		*prightedgevert0;
-	int		*prightedgevert1;
-	int		*prightedgevert2;
+	int		rightedgevert0;
+	int		rightedgevert1;
+	int		rightedgevert2;
 } edgetable;
 
-int	r_p0[6], r_p1[6], r_p2[6];
+static edgetable	edgetables[12] = {
+	{0, 1, 0, 2, -1, 2, 0, 1, 2 },
+	{0, 2, 1, 0, 2,   1, 1, 2, -1},
+	{1, 1, 0, 2, -1, 1, 1, 2, -1},
+	{0, 1, 1, 0, -1, 2, 1, 2, 0 },
+	{0, 2, 0, 2, 1,   1, 0, 1, -1},
+	{0, 1, 2, 1, -1, 1, 2, 0, -1},
+	{0, 1, 2, 1, -1, 2, 2, 0, 1 },
+	{0, 2, 2, 1, 0,   1, 2, 0, -1},
+	{0, 1, 1, 0, -1, 1, 1, 2, -1},
+	{1, 1, 2, 1, -1, 1, 0, 1, -1},
+	{1, 1, 1, 0, -1, 1, 2, 0, -1},
+	{0, 1, 0, 2, -1, 1, 0, 1, -1},
+};
 
-byte		*d_pcolormap;
+typedef struct
+{
+	int		v[3][6];		// u, v, s, t, l, 1/z
+} polysettri_t;
 
-int			d_aflatcolor;
-int			d_xdenom;
-
-edgetable	*pedgetable;
-
-edgetable	edgetables[12] = {
-	{0, 1, r_p0, r_p2, NULL, 2, r_p0, r_p1, r_p2 },
-	{0, 2, r_p1, r_p0, r_p2,   1, r_p1, r_p2, NULL},
-	{1, 1, r_p0, r_p2, NULL, 1, r_p1, r_p2, NULL},
-	{0, 1, r_p1, r_p0, NULL, 2, r_p1, r_p2, r_p0 },
-	{0, 2, r_p0, r_p2, r_p1,   1, r_p0, r_p1, NULL},
-	{0, 1, r_p2, r_p1, NULL, 1, r_p2, r_p0, NULL},
-	{0, 1, r_p2, r_p1, NULL, 2, r_p2, r_p0, r_p1 },
-	{0, 2, r_p2, r_p1, r_p0,   1, r_p2, r_p0, NULL},
-	{0, 1, r_p1, r_p0, NULL, 1, r_p1, r_p2, NULL},
-	{1, 1, r_p2, r_p1, NULL, 1, r_p0, r_p1, NULL},
-	{1, 1, r_p1, r_p0, NULL, 1, r_p2, r_p0, NULL},
-	{0, 1, r_p0, r_p2, NULL, 1, r_p0, r_p1, NULL},
+typedef struct
+{
+	void		*pskin;
+	int			skinwidth;
+	int			drawtype;		// recursive subdivision
+	qboolean	points;			// D_PolysetDrawFinalVerts, v[0] of every tri
+	byte		*colormap;
+	int			firsttri, numtris;
+	int			top, bottom;	// rows of the triangles
+} polysetdraw_t;
+
+// everything one thread needs to rasterize
+struct polysetctx_s
+{
+	int				top, bottom;	// rows of the band, bottom excluded
+
+	polysetdraw_t	*draw;
+	byte			*pcolormap;
+	byte			*skintable[MAX_LBM_HEIGHT];
+	byte			*skinstart;
+	int				skinwidth;
+
+	int				p[3][6];
+	edgetable		*pedgetable;
+	int				xdenom;
+
+	int				sstepxfrac, tstepxfrac, lstepx, ststepxwhole;
+	int				sstepx, tstepx, lstepy, sstepy, tstepy;
+	int				zistepx, zistepy;
+	int				aspancount, countextrastep;
+
+	int				ubasestep, errorterm, erroradjustup, erroradjustdown;
+
+	spanpackage_t	*pedgespanpackage;
+	int				spany;			// row of the first spanpackage drawn
+	byte			*pdest, *ptex;
+	short			*pz;
+	int				sfrac, tfrac, light, zi;
+	int				ptexextrastep, sfracextrastep;
+	int				tfracextrastep, lightextrastep, pdestextrastep;
+	int				lightbasestep, pdestbasestep, ptexbasestep;
+	int				sfracbasestep, tfracbasestep;
+	int				ziextrastep, zibasestep;
+	int				pzextrastep, pzbasestep;
+
+	spanpackage_t	spans[DPS_MAXSPANS + 1];
+						// one extra because of cache line pretouching
 };
 
-// FIXME: some of these can become statics
-int				a_sstepxfrac, a_tstepxfrac, r_lstepx, a_ststepxwhole;
-int				r_sstepx, r_tstepx, r_lstepy, r_sstepy, r_tstepy;
-int				r_zistepx, r_zistepy;
-int				d_aspancount, d_countextrastep;
-
-spanpackage_t			*a_spans;
-spanpackage_t			*d_pedgespanpackage;
-static int				ystart;
-byte					*d_pdest, *d_ptex;
-short					*d_pz;
-int						d_sfrac, d_tfrac, d_light, d_zi;
-int						d_ptexextrastep, d_sfracextrastep;
-int						d_tfracextrastep, d_lightextrastep, d_pdestextrastep;
-int						d_lightbasestep, d_pdestbasestep, d_ptexbasestep;
-int						d_sfracbasestep, d_tfracbasestep;
-int						d_ziextrastep, d_zibasestep;
-int						d_pzextrastep, d_pzbasestep;
+int			d_aflatcolor;
+
+cvar_t	d_polysetjobs = {"d_polysetjobs", "1"};
+
+static polysetdraw_t	d_polysetdraws[MAX_POLYSETDRAWS];
+static polysettri_t		d_polysettris[MAX_POLYSETTRIS];
+static int				d_numpolysetdraws, d_numpolysettris;
+static int				d_polysetbands, d_polysetbandrows;
+
+static polysetctx_t		d_polysetctx[MAX_POLYSETTHREADS];
 
 typedef struct {
 	int		quotient;
@@ -92,41 +144,121 @@ static adivtab_t	adivtab[32*32] = {
 #include "adivtab.h"
 };
 
-byte	*skintable[MAX_LBM_HEIGHT];
-int		skinwidth;
-byte	*skinstart;
+void D_PolysetCalcGradients (polysetctx_t *ps, int skinwidth);
+void D_DrawSubdiv (polysetctx_t *ps, polysettri_t *tri, int numtris);
+void D_DrawNonSubdiv (polysetctx_t *ps, polysettri_t *tri, int numtris);
+void D_PolysetRecursiveTriangle (polysetctx_t *ps, int *p1, int *p2, int *p3);
+void D_PolysetSetEdgeTable (polysetctx_t *ps);
+void D_RasterizeAliasPolySmooth (polysetctx_t *ps);
+void D_PolysetScanLeftEdge (polysetctx_t *ps, int height);
+
 
-void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage);
-void D_PolysetCalcGradients (int skinwidth);
-void D_DrawSubdiv (void);
-void D_DrawNonSubdiv (void);
-void D_PolysetRecursiveTriangle (int *p1, int *p2, int *p3);
-void D_PolysetSetEdgeTable (void);
-void D_RasterizeAliasPolySmooth (void);
-void D_PolysetScanLeftEdge (int height);
+/*
+================
+D_BeginPolysetDraw
+
+Continues the last draw if nothing but the triangles changed
+================
+*/
+static polysetdraw_t *D_BeginPolysetDraw (qboolean points)
+{
+	polysetdraw_t	*draw;
+
+	if (d_numpolysetdraws)
+	{
+		draw = &d_polysetdraws[d_numpolysetdraws - 1];
+		if (draw->pskin == r_affinetridesc.pskin
+			&& draw->skinwidth == r_affinetridesc.skinwidth
+			&& draw->drawtype == r_affinetridesc.drawtype
+			&& draw->points == points
+			&& draw->colormap == acolormap)
+			return draw;
+	}
+
+	if (d_numpolysetdraws == MAX_POLYSETDRAWS)
+		D_FlushPolysets ();
+
+	draw = &d_polysetdraws[d_numpolysetdraws++];
+	draw->pskin = r_affinetridesc.pskin;
+	draw->skinwidth = r_affinetridesc.skinwidth;
+	draw->drawtype = r_affinetridesc.drawtype;
+	draw->points = points;
+	draw->colormap = acolormap;
+	draw->firsttri = d_numpolysettris;
+	draw->numtris = 0;
+	draw->top = MAXHEIGHT;
+	draw->bottom = -1;
+
+	return draw;
+}
+
+/*
+================
+D_AllocPolysetTri
+================
+*/
+static polysettri_t *D_AllocPolysetTri (polysetdraw_t **draw, qboolean points)
+{
+	if (d_numpolysettris == MAX_POLYSETTRIS)
+	{
+		D_FlushPolysets ();
+		*draw = D_BeginPolysetDraw (points);
+	}
+
+	(*draw)->numtris++;
+	return &d_polysettris[d_numpolysettris++];
+}
 
 
 /*
 ================
 D_PolysetDraw
+
+Records the triangles of r_affinetridesc
 ================
 */
 void D_PolysetDraw (void)
 {
-	spanpackage_t	spans[DPS_MAXSPANS + 1 +
-			((CACHE_SIZE - 1) / sizeof(spanpackage_t)) + 1];
-						// one extra because of cache line pretouching
+	polysetdraw_t	*draw;
+	polysettri_t	*tri;
+	mtriangle_t		*ptri;
+	finalvert_t		*pfv, *index[3];
+	int				i, j, k;
 
-	a_spans = (spanpackage_t *)
-			(((long)&spans[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
+	draw = D_BeginPolysetDraw (false);
 
-	if (r_affinetridesc.drawtype)
-	{
-		D_DrawSubdiv ();
-	}
-	else
+	pfv = r_affinetridesc.pfinalverts;
+	ptri = r_affinetridesc.ptriangles;
+
+	for (i=0 ; i<r_affinetridesc.numtriangles ; i++, ptri++)
 	{
-		D_DrawNonSubdiv ();
+		index[0] = pfv + ptri->vertindex[0];
+		index[1] = pfv + ptri->vertindex[1];
+		index[2] = pfv + ptri->vertindex[2];
+
+		if (((index[0]->v[1]-index[1]->v[1]) *
+			 (index[0]->v[0]-index[2]->v[0]) -
+			 (index[0]->v[0]-index[1]->v[0]) * 
+			 (index[0]->v[1]-index[2]->v[1])) >= 0)
+		{
+			continue;
+		}
+
+		tri = D_AllocPolysetTri (&draw, false);
+
+		for (j=0 ; j<3 ; j++)
+		{
+			for (k=0 ; k<6 ; k++)
+				tri->v[j][k] = index[j]->v[k];
+
+			if (!ptri->facesfront && (index[j]->flags & ALIAS_ONSEAM))
+				tri->v[j][2] += r_affinetridesc.seamfixupX16;
+
+			if (tri->v[j][1] < draw->top)
+				draw->top = tri->v[j][1];
+			if (tri->v[j][1] > draw->bottom)
+				draw->bottom = tri->v[j][1];
+		}
 	}
 }
 
@@ -134,12 +266,17 @@ void D_PolysetDraw (void)
 /*
 ================
 D_PolysetDrawFinalVerts
+
+Records the verts to be drawn as points
 ================
 */
 void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts)
 {
-	int		i, z;
-	short	*zbuf;
+	polysetdraw_t	*draw;
+	polysettri_t	*tri;
+	int				i, k;
+
+	draw = D_BeginPolysetDraw (true);
 
 	for (i=0 ; i<numverts ; i++, fv++)
 	{
@@ -148,17 +285,14 @@ void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts)
 		if ((fv->v[0] < r_refdef.vrectright) &&
 			(fv->v[1] < r_refdef.vrectbottom))
 		{
-			z = fv->v[5]>>16;
-			zbuf = zspantable[fv->v[1]] + fv->v[0];
-			if (z >= *zbuf)
-			{
-				int		pix;
-				
-				*zbuf = z;
-				pix = skintable[fv->v[3]>>16][fv->v[2]>>16];
-				pix = ((byte *)acolormap)[pix + (fv->v[4] & 0xFF00) ];
-				d_viewbuffer[d_scantable[fv->v[1]] + fv->v[0]] = pix;
-			}
+			tri = D_AllocPolysetTri (&draw, true);
+			for (k=0 ; k<6 ; k++)
+				tri->v[0][k] = fv->v[k];
+
+			if (fv->v[1] < draw->top)
+				draw->top = fv->v[1];
+			if (fv->v[1] > draw->bottom)
+				draw->bottom = fv->v[1];
 		}
 	}
 }
@@ -166,61 +300,71 @@ void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts)
 
 /*
 ================
-D_DrawSubdiv
+D_PolysetDrawPoints
 ================
 */
-void D_DrawSubdiv (void)
+static void D_PolysetDrawPoints (polysetctx_t *ps, polysettri_t *tri, int numtris)
 {
-	mtriangle_t		*ptri;
-	finalvert_t		*pfv, *index0, *index1, *index2;
-	int				i;
-	int				lnumtriangles;
-
-	pfv = r_affinetridesc.pfinalverts;
-	ptri = r_affinetridesc.ptriangles;
-	lnumtriangles = r_affinetridesc.numtriangles;
+	int		i, z;
+	short	*zbuf;
+	int		*v;
 
-	for (i=0 ; i<lnumtriangles ; i++)
+	for (i=0 ; i<numtris ; i++, tri++)
 	{
-		index0 = pfv + ptri[i].vertindex[0];
-		index1 = pfv + ptri[i].vertindex[1];
-		index2 = pfv + ptri[i].vertindex[2];
-
-		if (((index0->v[1]-index1->v[1]) *
-			 (index0->v[0]-index2->v[0]) -
-			 (index0->v[0]-index1->v[0]) * 
-			 (index0->v[1]-index2->v[1])) >= 0)
-		{
+		v = tri->v[0];
+		if (v[1] < ps->top || v[1] >= ps->bottom)
 			continue;
-		}
-
-		d_pcolormap = &((byte *)acolormap)[index0->v[4] & 0xFF00];
 
-		if (ptri[i].facesfront)
+		z = v[5]>>16;
+		zbuf = zspantable[v[1]] + v[0];
+		if (z >= *zbuf)
 		{
-			D_PolysetRecursiveTriangle(index0->v, index1->v, index2->v);
+			int		pix;
+			
+			*zbuf = z;
+			pix = ps->skintable[v[3]>>16][v[2]>>16];
+			pix = ps->draw->colormap[pix + (v[4] & 0xFF00) ];
+			d_viewbuffer[d_scantable[v[1]] + v[0]] = pix;
 		}
-		else
-		{
-			int		s0, s1, s2;
+	}
+}
 
-			s0 = index0->v[2];
-			s1 = index1->v[2];
-			s2 = index2->v[2];
 
-			if (index0->flags & ALIAS_ONSEAM)
-				index0->v[2] += r_affinetridesc.seamfixupX16;
-			if (index1->flags & ALIAS_ONSEAM)
-				index1->v[2] += r_affinetridesc.seamfixupX16;
-			if (index2->flags & ALIAS_ONSEAM)
-				index2->v[2] += r_affinetridesc.seamfixupX16;
+/*
+================
+D_PolysetTriOutside
 
-			D_PolysetRecursiveTriangle(index0->v, index1->v, index2->v);
+True if the triangle can't touch the rows of the band
+================
+*/
+static qboolean D_PolysetTriOutside (polysetctx_t *ps, polysettri_t *tri)
+{
+	if (tri->v[0][1] < ps->top && tri->v[1][1] < ps->top && tri->v[2][1] < ps->top)
+		return true;
+	if (tri->v[0][1] >= ps->bottom && tri->v[1][1] >= ps->bottom && tri->v[2][1] >= ps->bottom)
+		return true;
+	return false;
+}
 
-			index0->v[2] = s0;
-			index1->v[2] = s1;
-			index2->v[2] = s2;
-		}
+
+/*
+================
+D_DrawSubdiv
+================
+*/
+void D_DrawSubdiv (polysetctx_t *ps, polysettri_t *tri, int numtris)
+{
+	int				i;
+
+	for (i=0 ; i<numtris ; i++, tri++)
+	{
+		if (D_PolysetTriOutside (ps, tri))
+			continue;
+
+		ps->pcolormap = &ps->draw->colormap[tri->v[0][4] & 0xFF00];
+
+		// the recursion doesn't change the verts
+		D_PolysetRecursiveTriangle (ps, tri->v[0], tri->v[1], tri->v[2]);
 	}
 }
 
@@ -230,65 +374,23 @@ void D_DrawSubdiv (void)
 D_DrawNonSubdiv
 ================
 */
-void D_DrawNonSubdiv (void)
+void D_DrawNonSubdiv (polysetctx_t *ps, polysettri_t *tri, int numtris)
 {
-	mtriangle_t		*ptri;
-	finalvert_t		*pfv, *index0, *index1, *index2;
 	int				i;
-	int				lnumtriangles;
 
-	pfv = r_affinetridesc.pfinalverts;
-	ptri = r_affinetridesc.ptriangles;
-	lnumtriangles = r_affinetridesc.numtriangles;
-
-	for (i=0 ; i<lnumtriangles ; i++, ptri++)
+	for (i=0 ; i<numtris ; i++, tri++)
 	{
-		index0 = pfv + ptri->vertindex[0];
-		index1 = pfv + ptri->vertindex[1];
-		index2 = pfv + ptri->vertindex[2];
-
-		d_xdenom = (index0->v[1]-index1->v[1]) *
-				(index0->v[0]-index2->v[0]) -
-				(index0->v[0]-index1->v[0])*(index0->v[1]-index2->v[1]);
-
-		if (d_xdenom >= 0)
-		{
+		if (D_PolysetTriOutside (ps, tri))
 			continue;
-		}
 
-		r_p0[0] = index0->v[0];		// u
-		r_p0[1] = index0->v[1];		// v
-		r_p0[2] = index0->v[2];		// s
-		r_p0[3] = index0->v[3];		// t
-		r_p0[4] = index0->v[4];		// light
-		r_p0[5] = index0->v[5];		// iz
-
-		r_p1[0] = index1->v[0];
-		r_p1[1] = index1->v[1];
-		r_p1[2] = index1->v[2];
-		r_p1[3] = index1->v[3];
-		r_p1[4] = index1->v[4];
-		r_p1[5] = index1->v[5];
-
-		r_p2[0] = index2->v[0];
-		r_p2[1] = index2->v[1];
-		r_p2[2] = index2->v[2];
-		r_p2[3] = index2->v[3];
-		r_p2[4] = index2->v[4];
-		r_p2[5] = index2->v[5];
-
-		if (!ptri->facesfront)
-		{
-			if (index0->flags & ALIAS_ONSEAM)
-				r_p0[2] += r_affinetridesc.seamfixupX16;
-			if (index1->flags & ALIAS_ONSEAM)
-				r_p1[2] += r_affinetridesc.seamfixupX16;
-			if (index2->flags & ALIAS_ONSEAM)
-				r_p2[2] += r_affinetridesc.seamfixupX16;
-		}
+		ps->xdenom = (tri->v[0][1]-tri->v[1][1]) *
+				(tri->v[0][0]-tri->v[2][0]) -
+				(tri->v[0][0]-tri->v[1][0])*(tri->v[0][1]-tri->v[2][1]);
+
+		memcpy (ps->p, tri->v, sizeof(ps->p));
 
-		D_PolysetSetEdgeTable ();
-		D_RasterizeAliasPolySmooth ();
+		D_PolysetSetEdgeTable (ps);
+		D_RasterizeAliasPolySmooth (ps);
 	}
 }
 
@@ -298,7 +400,7 @@ void D_DrawNonSubdiv (void)
 D_PolysetRecursiveTriangle
 ================
 */
-void D_PolysetRecursiveTriangle (int *lp1, int *lp2, int *lp3)
+void D_PolysetRecursiveTriangle (polysetctx_t *ps, int *lp1, int *lp2, int *lp3)
 {
 	int		*temp;
 	int		d;
@@ -306,6 +408,12 @@ void D_PolysetRecursiveTriangle (int *lp1, int *lp2, int *lp3)
 	int		z;
 	short	*zbuf;
 
+	// the split points stay inside, so nothing of this band is left
+	if (lp1[1] < ps->top && lp2[1] < ps->top && lp3[1] < ps->top)
+		return;
+	if (lp1[1] >= ps->bottom && lp2[1] >= ps->bottom && lp3[1] >= ps->bottom)
+		return;
+
 	d = lp2[0] - lp1[0];
 	if (d < -1 || d > 1)
 		goto split;
@@ -356,6 +464,8 @@ split:
 		goto nodraw;
 	if ((lp2[1] == lp1[1]) && (lp2[0] < lp1[0]))
 		goto nodraw;
+	if (new[1] < ps->top || new[1] >= ps->bottom)
+		goto nodraw;		// another band's row
 
 
 	z = new[5]>>16;
@@ -365,14 +475,14 @@ split:
 		int		pix;
 		
 		*zbuf = z;
-		pix = d_pcolormap[skintable[new[3]>>16][new[2]>>16]];
+		pix = ps->pcolormap[ps->skintable[new[3]>>16][new[2]>>16]];
 		d_viewbuffer[d_scantable[new[1]] + new[0]] = pix;
 	}
 
 nodraw:
 // recursively continue
-	D_PolysetRecursiveTriangle (lp3, lp1, new);
-	D_PolysetRecursiveTriangle (lp3, new, lp2);
+	D_PolysetRecursiveTriangle (ps, lp3, lp1, new);
+	D_PolysetRecursiveTriangle (ps, lp3, new, lp2);
 }
 
 
@@ -380,88 +490,175 @@ nodraw:
 /*
 ================
 D_PolysetUpdateTables
+
+Skin row pointers for the points and the recursive triangles
 ================
 */
-void D_PolysetUpdateTables (void)
+static void D_PolysetUpdateTables (polysetctx_t *ps)
 {
 	int		i;
 	byte	*s;
 	
-	if (r_affinetridesc.skinwidth != skinwidth ||
-		r_affinetridesc.pskin != skinstart)
+	if (ps->draw->skinwidth != ps->skinwidth ||
+		ps->draw->pskin != ps->skinstart)
 	{
-		skinwidth = r_affinetridesc.skinwidth;
-		skinstart = r_affinetridesc.pskin;
-		s = skinstart;
-		for (i=0 ; i<MAX_LBM_HEIGHT ; i++, s+=skinwidth)
-			skintable[i] = s;
+		ps->skinwidth = ps->draw->skinwidth;
+		ps->skinstart = ps->draw->pskin;
+		s = ps->skinstart;
+		for (i=0 ; i<MAX_LBM_HEIGHT ; i++, s+=ps->skinwidth)
+			ps->skintable[i] = s;
 	}
 }
 
 
+/*
+================
+D_RasterizePolysetBand
+================
+*/
+static void D_RasterizePolysetBand (int band, int thread, void *arg)
+{
+	polysetctx_t	*ps;
+	polysetdraw_t	*draw;
+	polysettri_t	*tri;
+	int				i;
+
+	UNUSED(arg);
+
+	ps = &d_polysetctx[thread];
+
+	// the first and last bands take everything above and below
+	ps->top = band ? r_refdef.vrect.y + band * d_polysetbandrows : -MAXHEIGHT;
+	ps->bottom = band < d_polysetbands - 1 ? r_refdef.vrect.y + (band + 1) * d_polysetbandrows : 2*MAXHEIGHT;
+
+	for (i=0, draw=d_polysetdraws ; i<d_numpolysetdraws ; i++, draw++)
+	{
+		if (!draw->numtris || draw->bottom < ps->top || draw->top >= ps->bottom)
+			continue;
+
+		ps->draw = draw;
+		tri = &d_polysettris[draw->firsttri];
+
+		if (draw->points)
+		{
+			D_PolysetUpdateTables (ps);
+			D_PolysetDrawPoints (ps, tri, draw->numtris);
+		}
+		else if (draw->drawtype)
+		{
+			D_PolysetUpdateTables (ps);
+			D_DrawSubdiv (ps, tri, draw->numtris);
+		}
+		else
+		{
+			D_DrawNonSubdiv (ps, tri, draw->numtris);
+		}
+	}
+}
+
+
+/*
+================
+D_FlushPolysets
+
+Rasterizes all the recorded draws. Must be called before anything else
+reads or writes the pixels or z of alias models.
+================
+*/
+void D_FlushPolysets (void)
+{
+	int		threads, rows;
+
+	if (!d_numpolysetdraws)
+		return;
+
+	threads = Jobs_NumThreads ();
+	rows = r_refdef.vrect.height;
+
+	// more bands than threads, models are rarely spread evenly
+	if (!d_polysetjobs.value || threads < 2 || threads > MAX_POLYSETTHREADS)
+		d_polysetbands = 1;
+	else
+		d_polysetbands = threads * 4;
+	if (d_polysetbands > rows / MIN_POLYSETBANDROWS)
+		d_polysetbands = rows / MIN_POLYSETBANDROWS;
+	if (d_polysetbands < 1)
+		d_polysetbands = 1;
+	d_polysetbandrows = (rows + d_polysetbands - 1) / d_polysetbands;
+
+	if (d_polysetbands == 1)
+		D_RasterizePolysetBand (0, 0, NULL);
+	else
+		Jobs_Run (D_RasterizePolysetBand, d_polysetbands, NULL);
+
+	d_numpolysetdraws = 0;
+	d_numpolysettris = 0;
+}
+
+
 
 /*
 ===================
 D_PolysetScanLeftEdge
 ====================
 */
-void D_PolysetScanLeftEdge (int height)
+void D_PolysetScanLeftEdge (polysetctx_t *ps, int height)
 {
 
 	do
 	{
-		d_pedgespanpackage->pdest = d_pdest;
-		d_pedgespanpackage->pz = d_pz;
-		d_pedgespanpackage->count = d_aspancount;
-		d_pedgespanpackage->ptex = d_ptex;
+		ps->pedgespanpackage->pdest = ps->pdest;
+		ps->pedgespanpackage->pz = ps->pz;
+		ps->pedgespanpackage->count = ps->aspancount;
+		ps->pedgespanpackage->ptex = ps->ptex;
 
-		d_pedgespanpackage->sfrac = d_sfrac;
-		d_pedgespanpackage->tfrac = d_tfrac;
+		ps->pedgespanpackage->sfrac = ps->sfrac;
+		ps->pedgespanpackage->tfrac = ps->tfrac;
 
 	// FIXME: need to clamp l, s, t, at both ends?
-		d_pedgespanpackage->light = d_light;
-		d_pedgespanpackage->zi = d_zi;
+		ps->pedgespanpackage->light = ps->light;
+		ps->pedgespanpackage->zi = ps->zi;
 
-		d_pedgespanpackage++;
+		ps->pedgespanpackage++;
 
-		errorterm += erroradjustup;
-		if (errorterm >= 0)
+		ps->errorterm += ps->erroradjustup;
+		if (ps->errorterm >= 0)
 		{
-			d_pdest += d_pdestextrastep * r_pixbytes;
-			d_pz += d_pzextrastep;
-			d_aspancount += d_countextrastep;
-			d_ptex += d_ptexextrastep;
-			d_sfrac += d_sfracextrastep;
-			d_ptex += d_sfrac >> 16;
-
-			d_sfrac &= 0xFFFF;
-			d_tfrac += d_tfracextrastep;
-			if (d_tfrac & 0x10000)
+			ps->pdest += ps->pdestextrastep * r_pixbytes;
+			ps->pz += ps->pzextrastep;
+			ps->aspancount += ps->countextrastep;
+			ps->ptex += ps->ptexextrastep;
+			ps->sfrac += ps->sfracextrastep;
+			ps->ptex += ps->sfrac >> 16;
+
+			ps->sfrac &= 0xFFFF;
+			ps->tfrac += ps->tfracextrastep;
+			if (ps->tfrac & 0x10000)
 			{
-				d_ptex += r_affinetridesc.skinwidth;
-				d_tfrac &= 0xFFFF;
+				ps->ptex += ps->draw->skinwidth;
+				ps->tfrac &= 0xFFFF;
 			}
-			d_light += d_lightextrastep;
-			d_zi += d_ziextrastep;
-			errorterm -= erroradjustdown;
+			ps->light += ps->lightextrastep;
+			ps->zi += ps->ziextrastep;
+			ps->errorterm -= ps->erroradjustdown;
 		}
 		else
 		{
-			d_pdest += d_pdestbasestep * r_pixbytes;
-			d_pz += d_pzbasestep;
-			d_aspancount += ubasestep;
-			d_ptex += d_ptexbasestep;
-			d_sfrac += d_sfracbasestep;
-			d_ptex += d_sfrac >> 16;
-			d_sfrac &= 0xFFFF;
-			d_tfrac += d_tfracbasestep;
-			if (d_tfrac & 0x10000)
+			ps->pdest += ps->pdestbasestep * r_pixbytes;
+			ps->pz += ps->pzbasestep;
+			ps->aspancount += ps->ubasestep;
+			ps->ptex += ps->ptexbasestep;
+			ps->sfrac += ps->sfracbasestep;
+			ps->ptex += ps->sfrac >> 16;
+			ps->sfrac &= 0xFFFF;
+			ps->tfrac += ps->tfracbasestep;
+			if (ps->tfrac & 0x10000)
 			{
-				d_ptex += r_affinetridesc.skinwidth;
-				d_tfrac &= 0xFFFF;
+				ps->ptex += ps->draw->skinwidth;
+				ps->tfrac &= 0xFFFF;
 			}
-			d_light += d_lightbasestep;
-			d_zi += d_zibasestep;
+			ps->light += ps->lightbasestep;
+			ps->zi += ps->zibasestep;
 		}
 	} while (--height);
 }
@@ -473,7 +670,7 @@ void D_PolysetScanLeftEdge (int height)
 D_PolysetSetUpForLineScan
 ====================
 */
-void D_PolysetSetUpForLineScan(fixed8_t startvertu, fixed8_t startvertv,
+void D_PolysetSetUpForLineScan(polysetctx_t *ps, fixed8_t startvertu, fixed8_t startvertv,
 		fixed8_t endvertu, fixed8_t endvertv)
 {
 	double		dm, dn;
@@ -482,7 +679,7 @@ void D_PolysetSetUpForLineScan(fixed8_t startvertu, fixed8_t startvertv,
 
 // TODO: implement x86 version
 
-	errorterm = -1;
+	ps->errorterm = -1;
 
 	tm = endvertu - startvertu;
 	tn = endvertv - startvertv;
@@ -491,18 +688,18 @@ void D_PolysetSetUpForLineScan(fixed8_t startvertu, fixed8_t startvertv,
 		((tn <= 16) && (tn >= -15)))
 	{
 		ptemp = &adivtab[((tm+15) << 5) + (tn+15)];
-		ubasestep = ptemp->quotient;
-		erroradjustup = ptemp->remainder;
-		erroradjustdown = tn;
+		ps->ubasestep = ptemp->quotient;
+		ps->erroradjustup = ptemp->remainder;
+		ps->erroradjustdown = tn;
 	}
 	else
 	{
 		dm = (double)tm;
 		dn = (double)tn;
 
-		FloorDivMod (dm, dn, &ubasestep, &erroradjustup);
+		FloorDivMod (dm, dn, &ps->ubasestep, &ps->erroradjustup);
 
-		erroradjustdown = dn;
+		ps->erroradjustdown = dn;
 	}
 }
 
@@ -513,55 +710,55 @@ void D_PolysetSetUpForLineScan(fixed8_t startvertu, fixed8_t startvertv,
 D_PolysetCalcGradients
 ================
 */
-void D_PolysetCalcGradients (int skinwidth)
+void D_PolysetCalcGradients (polysetctx_t *ps, int skinwidth)
 {
 	float	xstepdenominv, ystepdenominv, t0, t1;
 	float	p01_minus_p21, p11_minus_p21, p00_minus_p20, p10_minus_p20;
 
-	p00_minus_p20 = r_p0[0] - r_p2[0];
-	p01_minus_p21 = r_p0[1] - r_p2[1];
-	p10_minus_p20 = r_p1[0] - r_p2[0];
-	p11_minus_p21 = r_p1[1] - r_p2[1];
+	p00_minus_p20 = ps->p[0][0] - ps->p[2][0];
+	p01_minus_p21 = ps->p[0][1] - ps->p[2][1];
+	p10_minus_p20 = ps->p[1][0] - ps->p[2][0];
+	p11_minus_p21 = ps->p[1][1] - ps->p[2][1];
 
-	xstepdenominv = 1.0 / (float)d_xdenom;
+	xstepdenominv = 1.0 / (float)ps->xdenom;
 
 	ystepdenominv = -xstepdenominv;
 
 // ceil () for light so positive steps are exaggerated, negative steps
 // diminished,  pushing us away from underflow toward overflow. Underflow is
 // very visible, overflow is very unlikely, because of ambient lighting
-	t0 = r_p0[4] - r_p2[4];
-	t1 = r_p1[4] - r_p2[4];
-	r_lstepx = (int)
+	t0 = ps->p[0][4] - ps->p[2][4];
+	t1 = ps->p[1][4] - ps->p[2][4];
+	ps->lstepx = (int)
 			ceil((t1 * p01_minus_p21 - t0 * p11_minus_p21) * xstepdenominv);
-	r_lstepy = (int)
+	ps->lstepy = (int)
 			ceil((t1 * p00_minus_p20 - t0 * p10_minus_p20) * ystepdenominv);
 
-	t0 = r_p0[2] - r_p2[2];
-	t1 = r_p1[2] - r_p2[2];
-	r_sstepx = (int)((t1 * p01_minus_p21 - t0 * p11_minus_p21) *
+	t0 = ps->p[0][2] - ps->p[2][2];
+	t1 = ps->p[1][2] - ps->p[2][2];
+	ps->sstepx = (int)((t1 * p01_minus_p21 - t0 * p11_minus_p21) *
 			xstepdenominv);
-	r_sstepy = (int)((t1 * p00_minus_p20 - t0* p10_minus_p20) *
+	ps->sstepy = (int)((t1 * p00_minus_p20 - t0* p10_minus_p20) *
 			ystepdenominv);
 
-	t0 = r_p0[3] - r_p2[3];
-	t1 = r_p1[3] - r_p2[3];
-	r_tstepx = (int)((t1 * p01_minus_p21 - t0 * p11_minus_p21) *
+	t0 = ps->p[0][3] - ps->p[2][3];
+	t1 = ps->p[1][3] - ps->p[2][3];
+	ps->tstepx = (int)((t1 * p01_minus_p21 - t0 * p11_minus_p21) *
 			xstepdenominv);
-	r_tstepy = (int)((t1 * p00_minus_p20 - t0 * p10_minus_p20) *
+	ps->tstepy = (int)((t1 * p00_minus_p20 - t0 * p10_minus_p20) *
 			ystepdenominv);
 
-	t0 = r_p0[5] - r_p2[5];
-	t1 = r_p1[5] - r_p2[5];
-	r_zistepx = (int)((t1 * p01_minus_p21 - t0 * p11_minus_p21) *
+	t0 = ps->p[0][5] - ps->p[2][5];
+	t1 = ps->p[1][5] - ps->p[2][5];
+	ps->zistepx = (int)((t1 * p01_minus_p21 - t0 * p11_minus_p21) *
 			xstepdenominv);
-	r_zistepy = (int)((t1 * p00_minus_p20 - t0 * p10_minus_p20) *
+	ps->zistepy = (int)((t1 * p00_minus_p20 - t0 * p10_minus_p20) *
 			ystepdenominv);
 
-	a_sstepxfrac = r_sstepx & 0xFFFF;
-	a_tstepxfrac = r_tstepx & 0xFFFF;
+	ps->sstepxfrac = ps->sstepx & 0xFFFF;
+	ps->tstepxfrac = ps->tstepx & 0xFFFF;
 
-	a_ststepxwhole = skinwidth * (r_tstepx >> 16) + (r_sstepx >> 16);
+	ps->ststepxwhole = skinwidth * (ps->tstepx >> 16) + (ps->sstepx >> 16);
 }
 
 
@@ -583,13 +780,12 @@ void InitGel (byte *palette)
 #endif
 
 
-
 /*
 ================
 D_PolysetDrawSpans8
 ================
 */
-void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
+void D_PolysetDrawSpans8 (polysetctx_t *ps, spanpackage_t *pspanpackage)
 {
 	int		lcount;
 	byte	*lpdest;
@@ -598,23 +794,28 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 	int		llight;
 	int		lzi;
 	short	*lpz;
+	int		row;
 
+	row = ps->spany + (pspanpackage - ps->spans);
 	do
 	{
-		lcount = d_aspancount - pspanpackage->count;
+		if (row >= ps->bottom)
+			break;		// the rest is another band's
+
+		lcount = ps->aspancount - pspanpackage->count;
 
-		errorterm += erroradjustup;
-		if (errorterm >= 0)
+		ps->errorterm += ps->erroradjustup;
+		if (ps->errorterm >= 0)
 		{
-			d_aspancount += d_countextrastep;
-			errorterm -= erroradjustdown;
+			ps->aspancount += ps->countextrastep;
+			ps->errorterm -= ps->erroradjustdown;
 		}
 		else
 		{
-			d_aspancount += ubasestep;
+			ps->aspancount += ps->ubasestep;
 		}
 
-		if (lcount)
+		if (lcount && row >= ps->top)
 		{
 			lpdest = pspanpackage->pdest;
 			lptex = pspanpackage->ptex;
@@ -628,27 +829,28 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 			{
 				if ((lzi >> 16) >= *lpz)
 				{
-					*lpdest = ((byte *)acolormap)[*lptex + (llight & 0xFF00)];
+					*lpdest = ps->draw->colormap[*lptex + (llight & 0xFF00)];
 // gel mapping					*lpdest = gelmap[*lpdest];
 					*lpz = lzi >> 16;
 				}
 				lpdest++;
-				lzi += r_zistepx;
+				lzi += ps->zistepx;
 				lpz++;
-				llight += r_lstepx;
-				lptex += a_ststepxwhole;
-				lsfrac += a_sstepxfrac;
+				llight += ps->lstepx;
+				lptex += ps->ststepxwhole;
+				lsfrac += ps->sstepxfrac;
 				lptex += lsfrac >> 16;
 				lsfrac &= 0xFFFF;
-				ltfrac += a_tstepxfrac;
+				ltfrac += ps->tstepxfrac;
 				if (ltfrac & 0x10000)
 				{
-					lptex += r_affinetridesc.skinwidth;
+					lptex += ps->draw->skinwidth;
 					ltfrac &= 0xFFFF;
 				}
 			} while (--lcount);
 		}
 
+		row++;
 		pspanpackage++;
 	} while (pspanpackage->count != -999999);
 }
@@ -656,10 +858,10 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 
 /*
 ================
-D_PolysetDrawSpans8
+D_PolysetDrawSpans32
 ================
 */
-void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage)
+void D_PolysetDrawSpans32 (polysetctx_t *ps, spanpackage_t *pspanpackage)
 {
 	int		lcount;
 	int		*lpdest;
@@ -669,23 +871,28 @@ void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage)
 	int		lzi;
 	short	*lpz;
 	unsigned int color, ulight, comp[4];
+	int		row;
 
+	row = ps->spany + (pspanpackage - ps->spans);
 	do
 	{
-		lcount = d_aspancount - pspanpackage->count;
+		if (row >= ps->bottom)
+			break;		// the rest is another band's
+
+		lcount = ps->aspancount - pspanpackage->count;
 
-		errorterm += erroradjustup;
-		if (errorterm >= 0)
+		ps->errorterm += ps->erroradjustup;
+		if (ps->errorterm >= 0)
 		{
-			d_aspancount += d_countextrastep;
-			errorterm -= erroradjustdown;
+			ps->aspancount += ps->countextrastep;
+			ps->errorterm -= ps->erroradjustdown;
 		}
 		else
 		{
-			d_aspancount += ubasestep;
+			ps->aspancount += ps->ubasestep;
 		}
 
-		if (lcount)
+		if (lcount && row >= ps->top)
 		{
 			lpdest = (int*)pspanpackage->pdest;
 			lptex = pspanpackage->ptex;
@@ -722,22 +929,23 @@ void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage)
 					*lpz = lzi >> 16;
 				}
 				lpdest++;
-				lzi += r_zistepx;
+				lzi += ps->zistepx;
 				lpz++;
-				llight += r_lstepx;
-				lptex += a_ststepxwhole;
-				lsfrac += a_sstepxfrac;
+				llight += ps->lstepx;
+				lptex += ps->ststepxwhole;
+				lsfrac += ps->sstepxfrac;
 				lptex += lsfrac >> 16;
 				lsfrac &= 0xFFFF;
-				ltfrac += a_tstepxfrac;
+				ltfrac += ps->tstepxfrac;
 				if (ltfrac & 0x10000)
 				{
-					lptex += r_affinetridesc.skinwidth;
+					lptex += ps->draw->skinwidth;
 					ltfrac &= 0xFFFF;
 				}
 			} while (--lcount);
 		}
 
+		row++;
 		pspanpackage++;
 	} while (pspanpackage->count != -999999);
 }
@@ -748,17 +956,18 @@ void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage)
 D_RasterizeAliasPolySmooth
 ================
 */
-void D_RasterizeAliasPolySmooth (void)
+void D_RasterizeAliasPolySmooth (polysetctx_t *ps)
 {
 	int				initialleftheight, initialrightheight;
 	int				*plefttop, *prighttop, *pleftbottom, *prightbottom;
 	int				working_lstepx, originalcount;
+	int				ystart;
 
-	plefttop = pedgetable->pleftedgevert0;
-	prighttop = pedgetable->prightedgevert0;
+	plefttop = ps->p[ps->pedgetable->leftedgevert0];
+	prighttop = ps->p[ps->pedgetable->rightedgevert0];
 
-	pleftbottom = pedgetable->pleftedgevert1;
-	prightbottom = pedgetable->prightedgevert1;
+	pleftbottom = ps->p[ps->pedgetable->leftedgevert1];
+	prightbottom = ps->p[ps->pedgetable->rightedgevert1];
 
 	initialleftheight = pleftbottom[1] - plefttop[1];
 	initialrightheight = prightbottom[1] - prighttop[1];
@@ -767,7 +976,7 @@ void D_RasterizeAliasPolySmooth (void)
 // set the s, t, and light gradients, which are consistent across the triangle
 // because being a triangle, things are affine
 //
-	D_PolysetCalcGradients (r_affinetridesc.skinwidth);
+	D_PolysetCalcGradients (ps, ps->draw->skinwidth);
 
 //
 // rasterize the polygon
@@ -776,203 +985,204 @@ void D_RasterizeAliasPolySmooth (void)
 //
 // scan out the top (and possibly only) part of the left edge
 //
-	d_pedgespanpackage = a_spans;
+	ps->pedgespanpackage = ps->spans;
 
 	ystart = plefttop[1];
-	d_aspancount = plefttop[0] - prighttop[0];
+	ps->spany = ystart;
+	ps->aspancount = plefttop[0] - prighttop[0];
 
-	d_ptex = (byte *)r_affinetridesc.pskin + (plefttop[2] >> 16) +
-			(plefttop[3] >> 16) * r_affinetridesc.skinwidth;
+	ps->ptex = (byte *)ps->draw->pskin + (plefttop[2] >> 16) +
+			(plefttop[3] >> 16) * ps->draw->skinwidth;
 
-	d_sfrac = plefttop[2] & 0xFFFF;
-	d_tfrac = plefttop[3] & 0xFFFF;
+	ps->sfrac = plefttop[2] & 0xFFFF;
+	ps->tfrac = plefttop[3] & 0xFFFF;
 
-	d_light = plefttop[4];
-	d_zi = plefttop[5];
+	ps->light = plefttop[4];
+	ps->zi = plefttop[5];
 
-	d_pdest = (byte *)d_viewbuffer +
+	ps->pdest = (byte *)d_viewbuffer +
 			(ystart * screenwidth + plefttop[0]) * r_pixbytes;
-	d_pz = d_pzbuffer + ystart * d_zwidth + plefttop[0];
+	ps->pz = d_pzbuffer + ystart * d_zwidth + plefttop[0];
 
 	if (initialleftheight == 1)
 	{
-		d_pedgespanpackage->pdest = d_pdest;
-		d_pedgespanpackage->pz = d_pz;
-		d_pedgespanpackage->count = d_aspancount;
-		d_pedgespanpackage->ptex = d_ptex;
+		ps->pedgespanpackage->pdest = ps->pdest;
+		ps->pedgespanpackage->pz = ps->pz;
+		ps->pedgespanpackage->count = ps->aspancount;
+		ps->pedgespanpackage->ptex = ps->ptex;
 
-		d_pedgespanpackage->sfrac = d_sfrac;
-		d_pedgespanpackage->tfrac = d_tfrac;
+		ps->pedgespanpackage->sfrac = ps->sfrac;
+		ps->pedgespanpackage->tfrac = ps->tfrac;
 
 	// FIXME: need to clamp l, s, t, at both ends?
-		d_pedgespanpackage->light = d_light;
-		d_pedgespanpackage->zi = d_zi;
+		ps->pedgespanpackage->light = ps->light;
+		ps->pedgespanpackage->zi = ps->zi;
 
-		d_pedgespanpackage++;
+		ps->pedgespanpackage++;
 	}
 	else
 	{
-		D_PolysetSetUpForLineScan(plefttop[0], plefttop[1],
+		D_PolysetSetUpForLineScan(ps, plefttop[0], plefttop[1],
 							  pleftbottom[0], pleftbottom[1]);
 
-		d_pzbasestep = d_zwidth + ubasestep;
-		d_pzextrastep = d_pzbasestep + 1;
+		ps->pzbasestep = d_zwidth + ps->ubasestep;
+		ps->pzextrastep = ps->pzbasestep + 1;
 
-		d_pdestbasestep = screenwidth + ubasestep;
-		d_pdestextrastep = d_pdestbasestep + 1;
+		ps->pdestbasestep = screenwidth + ps->ubasestep;
+		ps->pdestextrastep = ps->pdestbasestep + 1;
 
 	// TODO: can reuse partial expressions here
 
 	// for negative steps in x along left edge, bias toward overflow rather than
 	// underflow (sort of turning the floor () we did in the gradient calcs into
 	// ceil (), but plus a little bit)
-		if (ubasestep < 0)
-			working_lstepx = r_lstepx - 1;
+		if (ps->ubasestep < 0)
+			working_lstepx = ps->lstepx - 1;
 		else
-			working_lstepx = r_lstepx;
+			working_lstepx = ps->lstepx;
 
-		d_countextrastep = ubasestep + 1;
-		d_ptexbasestep = ((r_sstepy + r_sstepx * ubasestep) >> 16) +
-				((r_tstepy + r_tstepx * ubasestep) >> 16) *
-				r_affinetridesc.skinwidth;
+		ps->countextrastep = ps->ubasestep + 1;
+		ps->ptexbasestep = ((ps->sstepy + ps->sstepx * ps->ubasestep) >> 16) +
+				((ps->tstepy + ps->tstepx * ps->ubasestep) >> 16) *
+				ps->draw->skinwidth;
 
-		d_sfracbasestep = (r_sstepy + r_sstepx * ubasestep) & 0xFFFF;
-		d_tfracbasestep = (r_tstepy + r_tstepx * ubasestep) & 0xFFFF;
+		ps->sfracbasestep = (ps->sstepy + ps->sstepx * ps->ubasestep) & 0xFFFF;
+		ps->tfracbasestep = (ps->tstepy + ps->tstepx * ps->ubasestep) & 0xFFFF;
 
-		d_lightbasestep = r_lstepy + working_lstepx * ubasestep;
-		d_zibasestep = r_zistepy + r_zistepx * ubasestep;
+		ps->lightbasestep = ps->lstepy + working_lstepx * ps->ubasestep;
+		ps->zibasestep = ps->zistepy + ps->zistepx * ps->ubasestep;
 
-		d_ptexextrastep = ((r_sstepy + r_sstepx * d_countextrastep) >> 16) +
-				((r_tstepy + r_tstepx * d_countextrastep) >> 16) *
-				r_affinetridesc.skinwidth;
+		ps->ptexextrastep = ((ps->sstepy + ps->sstepx * ps->countextrastep) >> 16) +
+				((ps->tstepy + ps->tstepx * ps->countextrastep) >> 16) *
+				ps->draw->skinwidth;
 
-		d_sfracextrastep = (r_sstepy + r_sstepx*d_countextrastep) & 0xFFFF;
-		d_tfracextrastep = (r_tstepy + r_tstepx*d_countextrastep) & 0xFFFF;
+		ps->sfracextrastep = (ps->sstepy + ps->sstepx*ps->countextrastep) & 0xFFFF;
+		ps->tfracextrastep = (ps->tstepy + ps->tstepx*ps->countextrastep) & 0xFFFF;
 
-		d_lightextrastep = d_lightbasestep + working_lstepx;
-		d_ziextrastep = d_zibasestep + r_zistepx;
+		ps->lightextrastep = ps->lightbasestep + working_lstepx;
+		ps->ziextrastep = ps->zibasestep + ps->zistepx;
 
-		D_PolysetScanLeftEdge (initialleftheight);
+		D_PolysetScanLeftEdge (ps, initialleftheight);
 	}
 
 //
 // scan out the bottom part of the left edge, if it exists
 //
-	if (pedgetable->numleftedges == 2)
+	if (ps->pedgetable->numleftedges == 2)
 	{
 		int		height;
 
 		plefttop = pleftbottom;
-		pleftbottom = pedgetable->pleftedgevert2;
+		pleftbottom = ps->p[ps->pedgetable->leftedgevert2];
 
 		height = pleftbottom[1] - plefttop[1];
 
 // TODO: make this a function; modularize this function in general
 
 		ystart = plefttop[1];
-		d_aspancount = plefttop[0] - prighttop[0];
-		d_ptex = (byte *)r_affinetridesc.pskin + (plefttop[2] >> 16) +
-				(plefttop[3] >> 16) * r_affinetridesc.skinwidth;
-		d_sfrac = 0;
-		d_tfrac = 0;
-		d_light = plefttop[4];
-		d_zi = plefttop[5];
+		ps->aspancount = plefttop[0] - prighttop[0];
+		ps->ptex = (byte *)ps->draw->pskin + (plefttop[2] >> 16) +
+				(plefttop[3] >> 16) * ps->draw->skinwidth;
+		ps->sfrac = 0;
+		ps->tfrac = 0;
+		ps->light = plefttop[4];
+		ps->zi = plefttop[5];
 
-		d_pdest = (byte *)d_viewbuffer + (ystart * screenwidth + plefttop[0]) * r_pixbytes;
-		d_pz = d_pzbuffer + ystart * d_zwidth + plefttop[0];
+		ps->pdest = (byte *)d_viewbuffer + (ystart * screenwidth + plefttop[0]) * r_pixbytes;
+		ps->pz = d_pzbuffer + ystart * d_zwidth + plefttop[0];
 
 		if (height == 1)
 		{
-			d_pedgespanpackage->pdest = d_pdest;
-			d_pedgespanpackage->pz = d_pz;
-			d_pedgespanpackage->count = d_aspancount;
-			d_pedgespanpackage->ptex = d_ptex;
+			ps->pedgespanpackage->pdest = ps->pdest;
+			ps->pedgespanpackage->pz = ps->pz;
+			ps->pedgespanpackage->count = ps->aspancount;
+			ps->pedgespanpackage->ptex = ps->ptex;
 
-			d_pedgespanpackage->sfrac = d_sfrac;
-			d_pedgespanpackage->tfrac = d_tfrac;
+			ps->pedgespanpackage->sfrac = ps->sfrac;
+			ps->pedgespanpackage->tfrac = ps->tfrac;
 
 		// FIXME: need to clamp l, s, t, at both ends?
-			d_pedgespanpackage->light = d_light;
-			d_pedgespanpackage->zi = d_zi;
+			ps->pedgespanpackage->light = ps->light;
+			ps->pedgespanpackage->zi = ps->zi;
 
-			d_pedgespanpackage++;
+			ps->pedgespanpackage++;
 		}
 		else
 		{
-			D_PolysetSetUpForLineScan(plefttop[0], plefttop[1],
+			D_PolysetSetUpForLineScan(ps, plefttop[0], plefttop[1],
 								  pleftbottom[0], pleftbottom[1]);
 
-			d_pdestbasestep = screenwidth + ubasestep;
-			d_pdestextrastep = d_pdestbasestep + 1;
+			ps->pdestbasestep = screenwidth + ps->ubasestep;
+			ps->pdestextrastep = ps->pdestbasestep + 1;
 
-			d_pzbasestep = d_zwidth + ubasestep;
-			d_pzextrastep = d_pzbasestep + 1;
+			ps->pzbasestep = d_zwidth + ps->ubasestep;
+			ps->pzextrastep = ps->pzbasestep + 1;
 
-			if (ubasestep < 0)
-				working_lstepx = r_lstepx - 1;
+			if (ps->ubasestep < 0)
+				working_lstepx = ps->lstepx - 1;
 			else
-				working_lstepx = r_lstepx;
+				working_lstepx = ps->lstepx;
 
-			d_countextrastep = ubasestep + 1;
-			d_ptexbasestep = ((r_sstepy + r_sstepx * ubasestep) >> 16) +
-					((r_tstepy + r_tstepx * ubasestep) >> 16) *
-					r_affinetridesc.skinwidth;
+			ps->countextrastep = ps->ubasestep + 1;
+			ps->ptexbasestep = ((ps->sstepy + ps->sstepx * ps->ubasestep) >> 16) +
+					((ps->tstepy + ps->tstepx * ps->ubasestep) >> 16) *
+					ps->draw->skinwidth;
 
-			d_sfracbasestep = (r_sstepy + r_sstepx * ubasestep) & 0xFFFF;
-			d_tfracbasestep = (r_tstepy + r_tstepx * ubasestep) & 0xFFFF;
+			ps->sfracbasestep = (ps->sstepy + ps->sstepx * ps->ubasestep) & 0xFFFF;
+			ps->tfracbasestep = (ps->tstepy + ps->tstepx * ps->ubasestep) & 0xFFFF;
 
-			d_lightbasestep = r_lstepy + working_lstepx * ubasestep;
-			d_zibasestep = r_zistepy + r_zistepx * ubasestep;
+			ps->lightbasestep = ps->lstepy + working_lstepx * ps->ubasestep;
+			ps->zibasestep = ps->zistepy + ps->zistepx * ps->ubasestep;
 
-			d_ptexextrastep = ((r_sstepy + r_sstepx * d_countextrastep) >> 16) +
-					((r_tstepy + r_tstepx * d_countextrastep) >> 16) *
-					r_affinetridesc.skinwidth;
+			ps->ptexextrastep = ((ps->sstepy + ps->sstepx * ps->countextrastep) >> 16) +
+					((ps->tstepy + ps->tstepx * ps->countextrastep) >> 16) *
+					ps->draw->skinwidth;
 
-			d_sfracextrastep = (r_sstepy+r_sstepx*d_countextrastep) & 0xFFFF;
-			d_tfracextrastep = (r_tstepy+r_tstepx*d_countextrastep) & 0xFFFF;
+			ps->sfracextrastep = (ps->sstepy+ps->sstepx*ps->countextrastep) & 0xFFFF;
+			ps->tfracextrastep = (ps->tstepy+ps->tstepx*ps->countextrastep) & 0xFFFF;
 
-			d_lightextrastep = d_lightbasestep + working_lstepx;
-			d_ziextrastep = d_zibasestep + r_zistepx;
+			ps->lightextrastep = ps->lightbasestep + working_lstepx;
+			ps->ziextrastep = ps->zibasestep + ps->zistepx;
 
-			D_PolysetScanLeftEdge (height);
+			D_PolysetScanLeftEdge (ps, height);
 		}
 	}
 
 // scan out the top (and possibly only) part of the right edge, updating the
 // count field
-	d_pedgespanpackage = a_spans;
+	ps->pedgespanpackage = ps->spans;
 
-	D_PolysetSetUpForLineScan(prighttop[0], prighttop[1],
+	D_PolysetSetUpForLineScan(ps, prighttop[0], prighttop[1],
 						  prightbottom[0], prightbottom[1]);
-	d_aspancount = 0;
-	d_countextrastep = ubasestep + 1;
-	originalcount = a_spans[initialrightheight].count;
-	a_spans[initialrightheight].count = -999999; // mark end of the spanpackages
-	d_drawpolysetspans (a_spans);
+	ps->aspancount = 0;
+	ps->countextrastep = ps->ubasestep + 1;
+	originalcount = ps->spans[initialrightheight].count;
+	ps->spans[initialrightheight].count = -999999; // mark end of the spanpackages
+	d_drawpolysetspans (ps, ps->spans);
 
 // scan out the bottom part of the right edge, if it exists
-	if (pedgetable->numrightedges == 2)
+	if (ps->pedgetable->numrightedges == 2)
 	{
 		int				height;
 		spanpackage_t	*pstart;
 
-		pstart = a_spans + initialrightheight;
+		pstart = ps->spans + initialrightheight;
 		pstart->count = originalcount;
 
-		d_aspancount = prightbottom[0] - prighttop[0];
+		ps->aspancount = prightbottom[0] - prighttop[0];
 
 		prighttop = prightbottom;
-		prightbottom = pedgetable->prightedgevert2;
+		prightbottom = ps->p[ps->pedgetable->rightedgevert2];
 
 		height = prightbottom[1] - prighttop[1];
 
-		D_PolysetSetUpForLineScan(prighttop[0], prighttop[1],
+		D_PolysetSetUpForLineScan(ps, prighttop[0], prighttop[1],
 							  prightbottom[0], prightbottom[1]);
 
-		d_countextrastep = ubasestep + 1;
-		a_spans[initialrightheight + height].count = -999999;
+		ps->countextrastep = ps->ubasestep + 1;
+		ps->spans[initialrightheight + height].count = -999999;
 											// mark end of the spanpackages
-		d_drawpolysetspans (pstart);
+		d_drawpolysetspans (ps, pstart);
 	}
 }
 
@@ -982,7 +1192,7 @@ void D_RasterizeAliasPolySmooth (void)
 D_PolysetSetEdgeTable
 ================
 */
-void D_PolysetSetEdgeTable (void)
+void D_PolysetSetEdgeTable (polysetctx_t *ps)
 {
 	int			edgetableindex;
 
@@ -993,14 +1203,14 @@ void D_PolysetSetEdgeTable (void)
 // determine which edges are right & left, and the order in which
 // to rasterize them
 //
-	if (r_p0[1] >= r_p1[1])
+	if (ps->p[0][1] >= ps->p[1][1])
 	{
-		if (r_p0[1] == r_p1[1])
+		if (ps->p[0][1] == ps->p[1][1])
 		{
-			if (r_p0[1] < r_p2[1])
-				pedgetable = &edgetables[2];
+			if (ps->p[0][1] < ps->p[2][1])
+				ps->pedgetable = &edgetables[2];
 			else
-				pedgetable = &edgetables[5];
+				ps->pedgetable = &edgetables[5];
 
 			return;
 		}
@@ -1010,32 +1220,32 @@ void D_PolysetSetEdgeTable (void)
 		}
 	}
 
-	if (r_p0[1] == r_p2[1])
+	if (ps->p[0][1] == ps->p[2][1])
 	{
 		if (edgetableindex)
-			pedgetable = &edgetables[8];
+			ps->pedgetable = &edgetables[8];
 		else
-			pedgetable = &edgetables[9];
+			ps->pedgetable = &edgetables[9];
 
 		return;
 	}
-	else if (r_p1[1] == r_p2[1])
+	else if (ps->p[1][1] == ps->p[2][1])
 	{
 		if (edgetableindex)
-			pedgetable = &edgetables[10];
+			ps->pedgetable = &edgetables[10];
 		else
-			pedgetable = &edgetables[11];
+			ps->pedgetable = &edgetables[11];
 
 		return;
 	}
 
-	if (r_p0[1] > r_p2[1])
+	if (ps->p[0][1] > ps->p[2][1])
 		edgetableindex += 2;
 
-	if (r_p1[1] > r_p2[1])
+	if (ps->p[1][1] > ps->p[2][1])
 		edgetableindex += 4;
 
-	pedgetable = &edgetables[edgetableindex];
+	ps->pedgetable = &edgetables[edgetableindex];
 }
 
 
@@ -32,6 +32,22 @@ surfcache_t                     *sc_rover, *sc_base;
 
 #define GUARDSIZE       4
 
+cvar_t	d_surfcacheauto = {"d_surfcacheauto", "1"};
+cvar_t	d_surfcachemax = {"d_surfcachemax", "262144"};	// kilobytes
+
+int		sc_hits, sc_misses, sc_evictions;
+
+static void		*sc_buffer;				// allocated by D_AllocCaches
+static int		sc_minsize;				// size requested by the video driver
+static qboolean	sc_fixedsize;			// set with -surfcachesize
+static int		sc_workingset;			// bytes of cache used by the current frame
+static int		sc_peakworkingset;
+static int		sc_thrashframes;
+static int		sc_framessinceresize;
+
+// frames to watch the working set before shrinking the cache
+#define SHRINK_FRAMES	1000
+
 
 int     D_SurfaceCacheForRes (int width, int height)
 {
@@ -99,6 +115,131 @@ void D_InitCaches (void *buffer, int size)
 }
 
 
+/*
+================
+D_AllocCaches
+
+Allocates a cache, that may grow or shrink itself later, see D_CheckCacheSize
+================
+*/
+void D_AllocCaches (int size)
+{
+	sc_buffer = malloc (size);
+	if (!sc_buffer)
+		Sys_Error ("D_AllocCaches: unable to allocate %ik surface cache", size/1024);
+
+	sc_minsize = size;
+	sc_fixedsize = COM_CheckParm ("-surfcachesize") != 0;
+	sc_thrashframes = 0;
+	sc_peakworkingset = 0;
+	sc_framessinceresize = 0;
+
+	D_InitCaches (sc_buffer, size);
+}
+
+
+/*
+================
+D_FreeCaches
+================
+*/
+void D_FreeCaches (void)
+{
+	D_FlushCaches ();
+
+	free (sc_buffer);
+	sc_buffer = NULL;
+	sc_base = NULL;
+	sc_rover = NULL;
+}
+
+
+int D_CacheSize (void)
+{
+	if (!sc_base)
+		return 0;
+	return sc_size + GUARDSIZE;
+}
+
+
+static void D_ResizeCaches (int size)
+{
+	void	*buffer;
+
+	buffer = malloc (size);
+	if (!buffer)
+	{
+		// stay with what we have
+		Con_Printf ("Unable to allocate %ik surface cache\n", size/1024);
+		sc_fixedsize = true;
+		return;
+	}
+
+	D_FlushCaches ();
+	free (sc_buffer);
+	sc_buffer = buffer;
+	D_InitCaches (sc_buffer, size);
+
+	sc_thrashframes = 0;
+	sc_peakworkingset = 0;
+	sc_framessinceresize = 0;
+}
+
+
+/*
+================
+D_CheckCacheSize
+
+Called between frames. Doubles the cache if it thrashed two frames in a row,
+up to d_surfcachemax, and halves it, but not below the initial size, if the
+frames have used less than a quarter of it for a while.
+Resets the per-frame statistics.
+================
+*/
+void D_CheckCacheSize (void)
+{
+	int		size, maxsize;
+
+	if (sc_buffer && d_surfcacheauto.value && !sc_fixedsize)
+	{
+		size = sc_size + GUARDSIZE;
+		maxsize = (int)d_surfcachemax.value * 1024;
+		if (maxsize < sc_minsize)
+			maxsize = sc_minsize;
+
+		if (r_cache_thrash)
+			sc_thrashframes++;
+		else
+			sc_thrashframes = 0;
+
+		if (sc_workingset > sc_peakworkingset)
+			sc_peakworkingset = sc_workingset;
+		sc_framessinceresize++;
+
+		if (sc_thrashframes >= 2 && size < maxsize)
+		{
+			size = size >= maxsize / 2 ? maxsize : size * 2;
+			D_ResizeCaches (size);
+		}
+		else if (sc_framessinceresize >= SHRINK_FRAMES)
+		{
+			if (size > sc_minsize && sc_peakworkingset < size / 4)
+				D_ResizeCaches (size / 2 < sc_minsize ? sc_minsize : size / 2);
+			else
+			{
+				sc_framessinceresize = 0;
+				sc_peakworkingset = 0;
+			}
+		}
+	}
+
+	sc_hits = 0;
+	sc_misses = 0;
+	sc_evictions = 0;
+	sc_workingset = 0;
+}
+
+
 /*
 ==================
 D_FlushCaches
@@ -159,7 +300,10 @@ surfcache_t     *D_SCAlloc (int width, int size)
 // colect and free surfcache_t blocks until the rover block is large enough
 	new = sc_rover;
 	if (sc_rover->owner)
+	{
 		*sc_rover->owner = NULL;
+		sc_evictions++;
+	}
 	
 	while (new->size < size)
 	{
@@ -168,7 +312,10 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		if (!sc_rover)
 			Sys_Error ("D_SCAlloc: hit the end of memory");
 		if (sc_rover->owner)
+		{
 			*sc_rover->owner = NULL;
+			sc_evictions++;
+		}
 			
 		new->size += sc_rover->size;
 		new->next = sc_rover->next;
@@ -259,78 +406,197 @@ int D_log2 (int num)
 
 /*
 ================
-D_CacheSurface
+D_SetupCacheSurface
+
+Returns false if the cache holds apropriate data for the surface already.
+Otherwise allocates the cache block if needed and sets up ds to draw it.
 ================
 */
-surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+static qboolean D_SetupCacheSurface (msurface_t *surface, int miplevel, drawsurf_t *ds)
 {
 	surfcache_t     *cache;
 
 //
 // if the surface is animating or flashing, flush the cache
 //
-	r_drawsurf.texture = R_TextureAnimation (surface->texinfo->texture);
-	r_drawsurf.lightadj[0] = d_lightstylevalue[surface->styles[0]];
-	r_drawsurf.lightadj[1] = d_lightstylevalue[surface->styles[1]];
-	r_drawsurf.lightadj[2] = d_lightstylevalue[surface->styles[2]];
-	r_drawsurf.lightadj[3] = d_lightstylevalue[surface->styles[3]];
+	ds->texture = R_TextureAnimation (surface->texinfo->texture);
+	ds->lightadj[0] = d_lightstylevalue[surface->styles[0]];
+	ds->lightadj[1] = d_lightstylevalue[surface->styles[1]];
+	ds->lightadj[2] = d_lightstylevalue[surface->styles[2]];
+	ds->lightadj[3] = d_lightstylevalue[surface->styles[3]];
 	
 //
 // see if the cache holds apropriate data
+// dynamic lights don't change within a frame, so a block lit by them is
+// good until the end of the frame it was drawn in
 //
 	cache = surface->cachespots[miplevel];
 
-	if (cache && !cache->dlight && surface->dlightframe != r_framecount
-			&& cache->texture == r_drawsurf.texture
-			&& cache->lightadj[0] == r_drawsurf.lightadj[0]
-			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
-			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
-			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
-		return cache;
+	if (cache && cache->texture == ds->texture
+			&& cache->lightadj[0] == ds->lightadj[0]
+			&& cache->lightadj[1] == ds->lightadj[1]
+			&& cache->lightadj[2] == ds->lightadj[2]
+			&& cache->lightadj[3] == ds->lightadj[3]
+			&& (cache->dlight ? cache->framecount == r_framecount
+				: surface->dlightframe != r_framecount) )
+	{
+		if (cache->framecount != r_framecount)
+		{
+			sc_hits++;
+			sc_workingset += cache->size;
+			cache->framecount = r_framecount;
+		}
+		return false;
+	}
+
+	sc_misses++;
 
 //
 // determine shape of surface
 //
 	surfscale = 1.0 / (1<<miplevel);
-	r_drawsurf.surfmip = miplevel;
-	r_drawsurf.surfwidth = surface->extents[0] >> miplevel;
-	r_drawsurf.rowpixels = r_drawsurf.surfwidth;
-	r_drawsurf.surfheight = surface->extents[1] >> miplevel;
+	ds->surfmip = miplevel;
+	ds->surfwidth = surface->extents[0] >> miplevel;
+	ds->rowpixels = ds->surfwidth;
+	ds->surfheight = surface->extents[1] >> miplevel;
 	
 //
 // allocate memory if needed
 //
 	if (!cache)     // if a texture just animated, don't reallocate it
 	{
-		cache = D_SCAlloc (r_drawsurf.surfwidth,
-						   r_drawsurf.surfwidth * r_drawsurf.surfheight);
+		cache = D_SCAlloc (ds->surfwidth,
+						   ds->surfwidth * ds->surfheight);
 		surface->cachespots[miplevel] = cache;
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
 	}
+	if (cache->framecount != r_framecount)
+		sc_workingset += cache->size;
+	cache->framecount = r_framecount;
 	
 	if (surface->dlightframe == r_framecount)
 		cache->dlight = 1;
 	else
 		cache->dlight = 0;
 
-	r_drawsurf.surfdat = (pixel_t *)cache->data;
+	ds->surfdat = (pixel_t *)cache->data;
 	
-	cache->texture = r_drawsurf.texture;
-	cache->lightadj[0] = r_drawsurf.lightadj[0];
-	cache->lightadj[1] = r_drawsurf.lightadj[1];
-	cache->lightadj[2] = r_drawsurf.lightadj[2];
-	cache->lightadj[3] = r_drawsurf.lightadj[3];
+	cache->texture = ds->texture;
+	cache->lightadj[0] = ds->lightadj[0];
+	cache->lightadj[1] = ds->lightadj[1];
+	cache->lightadj[2] = ds->lightadj[2];
+	cache->lightadj[3] = ds->lightadj[3];
+
+	ds->surf = surface;
+
+	c_surf++;
+
+	return true;
+}
+
+
+/*
+================
+D_CacheSurface
+================
+*/
+surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+{
+	drawsurf_t	ds;
 
 //
 // draw and light the surface texture
 //
-	r_drawsurf.surf = surface;
-
-	c_surf++;
-	R_DrawSurface ();
+	if (D_SetupCacheSurface (surface, miplevel, &ds))
+		R_DrawSurface (&ds);
 
 	return surface->cachespots[miplevel];
 }
 
 
+//=============================================================================
+
+#define	MAX_PENDINGSURFS	1024
+
+cvar_t	d_surfjobs = {"d_surfjobs", "1"};
+
+static drawsurf_t	d_pendingsurfs[MAX_PENDINGSURFS];
+
+
+static void D_DrawPendingSurface (int index, int thread, void *arg)
+{
+	UNUSED(thread);
+	UNUSED(arg);
+
+	R_DrawSurface (&d_pendingsurfs[index]);
+}
+
+
+/*
+================
+D_CacheSurfaces
+
+Builds the cache blocks of all the surfaces in the span list, that need it,
+on all threads at once, before D_DrawSurfaces walks the list and draws them.
+The blocks are allocated serially first. If the cache gets full and starts
+recycling blocks of this very list, building stops, and the surfaces that
+have lost their block are left to D_CacheSurface.
+================
+*/
+void D_CacheSurfaces (void)
+{
+	surf_t		*s;
+	msurface_t	*pface;
+	drawsurf_t	*ds;
+	int			miplevel;
+	int			i, count;
+
+	if (!d_surfjobs.value || Jobs_NumThreads () < 2)
+		return;
+
+	count = 0;
+	for (s = &surfaces[1] ; s<surface_p && count<MAX_PENDINGSURFS ; s++)
+	{
+		if (!s->spans)
+			continue;
+		if (s->flags & (SURF_DRAWSKY | SURF_DRAWBACKGROUND | SURF_DRAWTURB))
+			continue;
+
+		// for R_TextureAnimation
+		if (s->insubmodel)
+			currententity = s->entity;
+		else
+			currententity = &cl_entities[0];
+
+		pface = s->data;
+		miplevel = D_MipLevelForScale (s->nearzi * scale_for_mip
+			* pface->texinfo->mipadjust);
+
+		if (D_SetupCacheSurface (pface, miplevel, &d_pendingsurfs[count]))
+			count++;
+
+		if (r_cache_thrash)
+			break;
+	}
+	currententity = &cl_entities[0];
+
+	if (r_cache_thrash)
+	{
+		// drop the surfaces, whose blocks were given to other ones
+		for (i=0 ; i<count ; )
+		{
+			ds = &d_pendingsurfs[i];
+			if (ds->surf->cachespots[ds->surfmip]
+				&& ds->surf->cachespots[ds->surfmip]->data == (byte *)ds->surfdat)
+			{
+				i++;
+				continue;
+			}
+			c_surf--;
+			d_pendingsurfs[i] = d_pendingsurfs[--count];
+		}
+	}
+
+	Jobs_Run (D_DrawPendingSurface, count, NULL);
+}
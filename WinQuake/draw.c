@@ -1214,10 +1214,6 @@ void Draw_FadeScreen (void)
 	byte		*pbuf;
 	int			*pbuf32;
 
-	VID_UnlockBuffer ();
-	S_ExtraUpdate ();
-	VID_LockBuffer ();
-
 	if (r_pixbytes == 1)
 	{
 		for (y=0 ; y<vid.height ; y++)
@@ -1244,10 +1240,6 @@ void Draw_FadeScreen (void)
 				pbuf32[x] = ( pbuf32[x] & 0xFEFEFEFE ) >> 1;
 		}
 	}
-
-	VID_UnlockBuffer ();
-	S_ExtraUpdate ();
-	VID_LockBuffer ();
 }
 
 //=============================================================================
@@ -54,18 +54,42 @@ int		gl_filter_max = GL_LINEAR;
 
 int		texels;
 
-typedef struct
+typedef struct gltexture_s
 {
 	int		texnum;
 	char	identifier[64];
 	int		width, height;
-	qboolean	mipmap;
+	qboolean	mipmap, alpha;
+	unsigned	checksum;	// of the 8 bit data, levels may have textures of the same name
+	struct gltexture_s	*hashnext;
 } gltexture_t;
 
-#define	MAX_GLTEXTURES	1024
+#define	MAX_GLTEXTURES	4096
 gltexture_t	gltextures[MAX_GLTEXTURES];
 int			numgltextures;
 
+#define	GLTEXTURE_HASH_SIZE	256		// power of two
+static gltexture_t	*gltexture_hash[GLTEXTURE_HASH_SIZE];
+
+// textures loaded between GL_BeginTextureBatch and GL_EndTextureBatch
+// are converted on all threads at once and uploaded at the end
+typedef struct
+{
+	int			texnum;
+	byte		*data;		// 8 bit source, must live until the end of the batch
+	int			width, height;
+	qboolean	mipmap, alpha;
+	unsigned	*rgba;		// all mip levels, one after another
+} pendingtexture_t;
+
+static pendingtexture_t	pendingtextures[MAX_GLTEXTURES];
+static int				numpendingtextures;
+static int				texturebatchlevel;
+
+// for the load report
+static int		texstats_count;
+static double	texstats_converttime, texstats_uploadtime;
+
 
 void GL_Bind (int texnum)
 {
@@ -875,6 +899,42 @@ void GL_Set2D (void)
 
 //====================================================================
 
+static int GL_HashTextureName (char *identifier)
+{
+	unsigned	hash;
+
+	hash = 0;
+	while (*identifier)
+		hash = hash * 31 + *identifier++;
+
+	return hash & (GLTEXTURE_HASH_SIZE - 1);
+}
+
+static unsigned GL_TextureChecksum (byte *data, int size)
+{
+	unsigned	sum;
+	int			i;
+
+	sum = 2166136261u;
+	for (i=0 ; i<size ; i++)
+		sum = (sum ^ data[i]) * 16777619u;
+
+	return sum;
+}
+
+static gltexture_t *GL_LookupTexture (char *identifier)
+{
+	gltexture_t	*glt;
+
+	for (glt = gltexture_hash[GL_HashTextureName (identifier)] ; glt ; glt = glt->hashnext)
+	{
+		if (!strcmp (identifier, glt->identifier))
+			return glt;
+	}
+
+	return NULL;
+}
+
 /*
 ================
 GL_FindTexture
@@ -882,14 +942,11 @@ GL_FindTexture
 */
 int GL_FindTexture (char *identifier)
 {
-	int		i;
 	gltexture_t	*glt;
 
-	for (i=0, glt=gltextures ; i<numgltextures ; i++, glt++)
-	{
-		if (!strcmp (identifier, glt->identifier))
-			return gltextures[i].texnum;
-	}
+	glt = GL_LookupTexture (identifier);
+	if (glt)
+		return glt->texnum;
 
 	return -1;
 }
@@ -899,10 +956,11 @@ int GL_FindTexture (char *identifier)
 ================
 GL_MipMap
 
-Operates in place, quartering the size of the texture
+Quarters the size of the texture, out may be the same as in. Once one side
+is down to a pixel, the other one is halved.
 ================
 */
-void GL_MipMap (byte *in, int width, int height)
+void GL_MipMap (byte *in, byte *out, int width, int height)
 {
 	int			out_width, out_height;
 	int			x, y;
@@ -912,7 +970,20 @@ void GL_MipMap (byte *in, int width, int height)
 	out_width  = width  >> 1;
 	out_height = height >> 1;
 
-	dst = in;
+	dst = out;
+	if (!out_width || !out_height)
+	{	// a single row or column, average neighbouring pairs
+		x = (width > height ? width : height) >> 1;
+		for ( ; x > 0; x--, dst += 4, in += 8)
+		{
+			dst[0] = (in[0] + in[4])>>1;
+			dst[1] = (in[1] + in[5])>>1;
+			dst[2] = (in[2] + in[6])>>1;
+			dst[3] = (in[3] + in[7])>>1;
+		}
+		return;
+	}
+
 	for (y = 0; y < out_height; y++)
 	{
 		src[0] = in + ( (y * width ) << 3);
@@ -928,6 +999,32 @@ void GL_MipMap (byte *in, int width, int height)
 }
 
 
+static void GL_SetTextureParameters (qboolean mipmap)
+{
+	int			anisotropy;
+
+	if (mipmap)
+	{
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter_min);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
+
+		if (gl_texanisotropy.value > 0.0)
+		{
+			anisotropy = (int)gl_texanisotropy.value;
+			if (anisotropy > gl_max_texanisotropy)
+				anisotropy = gl_max_texanisotropy;
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy );
+		}
+	}
+	else
+	{
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter_max);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
+	}
+}
+
+
 /*
 ===============
 GL_Upload32
@@ -936,7 +1033,6 @@ GL_Upload32
 void GL_Upload32 (unsigned *data, int width, int height, qboolean mipmap, qboolean alpha)
 {
 	int			samples;
-	int			anisotropy;
 
 	if (width  > gl_max_size.value ||
 		height > gl_max_size.value)
@@ -961,7 +1057,7 @@ void GL_Upload32 (unsigned *data, int width, int height, qboolean mipmap, qboole
 		miplevel = 0;
 		while (width > 1 || height > 1)
 		{
-			GL_MipMap ((byte *)data, width, height);
+			GL_MipMap ((byte *)data, (byte *)data, width, height);
 			width  >>= 1;
 			height >>= 1;
 			if (width  < 1)
@@ -974,42 +1070,18 @@ void GL_Upload32 (unsigned *data, int width, int height, qboolean mipmap, qboole
 	}
 done: ;
 
-	if (mipmap)
-	{
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter_min);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
-
-		if (gl_texanisotropy.value > 0.0)
-		{
-			anisotropy = (int)gl_texanisotropy.value;
-			if (anisotropy > gl_max_texanisotropy)
-				anisotropy = gl_max_texanisotropy;
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy );
-		}
-	}
-	else
-	{
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter_max);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
-	}
+	GL_SetTextureParameters (mipmap);
 }
 
 /*
 ===============
-GL_Upload8
+GL_PaletteToRGBA
 ===============
 */
-void GL_Upload8 (byte *data, int width, int height,  qboolean mipmap, qboolean alpha)
+static void GL_PaletteToRGBA (byte *data, unsigned *trans, int s, qboolean alpha)
 {
 	const byte			c_first_fullbrigh = 256 - 32;
-	static	unsigned	trans[1024*1024];		// FIXME, temporary
-	int			i, s;
-	qboolean	noalpha;
-
-	s = width*height;
-	if (s > sizeof(trans))
-		Sys_Error ("GL_Upload8: temporary buffer too small\n");
+	int			i;
 
 	if (alpha)
 	{
@@ -1041,8 +1113,188 @@ void GL_Upload8 (byte *data, int width, int height,  qboolean mipmap, qboolean a
 				if( data[i+3] >= c_first_fullbrigh ) trans[i+3] &= 0x00FFFFFF;
 			}
 	}
+}
+
+/*
+===============
+GL_Upload8
+===============
+*/
+void GL_Upload8 (byte *data, int width, int height,  qboolean mipmap, qboolean alpha)
+{
+	unsigned	*trans;
+
+	trans = malloc (width * height * sizeof(*trans));
+	if (!trans)
+		Sys_Error ("GL_Upload8: not enough memory for %ix%i texture\n", width, height);
 
+	GL_PaletteToRGBA (data, trans, width * height, alpha);
 	GL_Upload32 (trans, width, height, mipmap, alpha);
+
+	free (trans);
+}
+
+//=============================================================================
+
+static void GL_NextMipSize (int *width, int *height)
+{
+	*width >>= 1;
+	*height >>= 1;
+	if (*width < 1)
+		*width = 1;
+	if (*height < 1)
+		*height = 1;
+}
+
+/*
+===============
+GL_ConvertPendingTexture
+
+Runs on the job threads, makes all the mip levels of a texture
+===============
+*/
+static void GL_ConvertPendingTexture (int index, int thread, void *arg)
+{
+	pendingtexture_t	*pt;
+	int			width, height, size;
+	unsigned	*level;
+
+	UNUSED(thread);
+	UNUSED(arg);
+
+	pt = &pendingtextures[index];
+
+	width = pt->width;
+	height = pt->height;
+	size = width * height;
+	if (pt->mipmap)
+	{
+		while (width > 1 || height > 1)
+		{
+			GL_NextMipSize (&width, &height);
+			size += width * height;
+		}
+		width = pt->width;
+		height = pt->height;
+	}
+
+	pt->rgba = malloc (size * sizeof(*pt->rgba));
+	if (!pt->rgba)
+		return;		// uploaded the usual way
+
+	level = pt->rgba;
+	GL_PaletteToRGBA (pt->data, level, width * height, pt->alpha);
+
+	if (pt->mipmap)
+	{
+		while (width > 1 || height > 1)
+		{
+			GL_MipMap ((byte *)level, (byte *)(level + width * height), width, height);
+			level += width * height;
+			GL_NextMipSize (&width, &height);
+		}
+	}
+}
+
+static void GL_UploadPendingTexture (pendingtexture_t *pt)
+{
+	int			samples;
+	int			width, height;
+	int			miplevel;
+	unsigned	*level;
+
+	GL_Bind (pt->texnum);
+
+	if (!pt->rgba)
+	{
+		GL_Upload8 (pt->data, pt->width, pt->height, pt->mipmap, pt->alpha);
+		return;
+	}
+
+	samples = pt->alpha ? gl_alpha_format : gl_solid_format;
+	width = pt->width;
+	height = pt->height;
+
+	texels += width * height;
+
+	level = pt->rgba;
+	glTexImage2D (GL_TEXTURE_2D, 0, samples, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+	if (pt->mipmap)
+	{
+		miplevel = 0;
+		while (width > 1 || height > 1)
+		{
+			level += width * height;
+			GL_NextMipSize (&width, &height);
+			miplevel++;
+			glTexImage2D (GL_TEXTURE_2D, miplevel, samples, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+		}
+	}
+
+	GL_SetTextureParameters (pt->mipmap);
+
+	free (pt->rgba);
+	pt->rgba = NULL;
+}
+
+/*
+================
+GL_BeginTextureBatch
+
+Textures loaded until GL_EndTextureBatch get their names right away, but
+are converted in parallel and uploaded by GL_EndTextureBatch. So the data
+passed to GL_LoadTexture must not be freed or changed before.
+Batches may nest, the outermost one does the work.
+================
+*/
+void GL_BeginTextureBatch (void)
+{
+	texturebatchlevel++;
+}
+
+/*
+================
+GL_EndTextureBatch
+================
+*/
+void GL_EndTextureBatch (void)
+{
+	int		i;
+	double	time1, time2, time3;
+
+	if (--texturebatchlevel > 0)
+		return;
+	texturebatchlevel = 0;
+
+	if (!numpendingtextures)
+		return;
+
+	time1 = Sys_FloatTime ();
+	Jobs_Run (GL_ConvertPendingTexture, numpendingtextures, NULL);
+	time2 = Sys_FloatTime ();
+
+	for (i=0 ; i<numpendingtextures ; i++)
+		GL_UploadPendingTexture (&pendingtextures[i]);
+	time3 = Sys_FloatTime ();
+
+	texstats_count += numpendingtextures;
+	texstats_converttime += time2 - time1;
+	texstats_uploadtime += time3 - time2;
+
+	numpendingtextures = 0;
+}
+
+void GL_ClearTextureStats (void)
+{
+	texstats_count = 0;
+	texstats_converttime = 0;
+	texstats_uploadtime = 0;
+}
+
+void GL_PrintTextureStats (void)
+{
+	Con_DPrintf ("%i textures: %.3f s converting on %i threads, %.3f s uploading\n",
+		texstats_count, texstats_converttime, Jobs_NumThreads (), texstats_uploadtime);
 }
 
 /*
@@ -1052,33 +1304,76 @@ GL_LoadTexture
 */
 int GL_LoadTexture (char *identifier, int width, int height, byte *data, qboolean mipmap, qboolean alpha)
 {
-	qboolean	noalpha;
-	int			i, p, s;
-	gltexture_t	*glt;
+	gltexture_t	*glt, *same;
+	pendingtexture_t	*pt;
+	int			hash;
+	unsigned	checksum;
 
 	// see if the texture is allready present
+	checksum = 0;
+	same = NULL;
 	if (identifier[0])
 	{
-		for (i=0, glt=gltextures ; i<numgltextures ; i++, glt++)
+		checksum = GL_TextureChecksum (data, width * height);
+		hash = GL_HashTextureName (identifier);
+		for (glt = gltexture_hash[hash] ; glt ; glt = glt->hashnext)
 		{
-			if (!strcmp (identifier, glt->identifier))
-			{
-				if (width != glt->width || height != glt->height)
-					Sys_Error ("GL_LoadTexture: cache mismatch");
-				return gltextures[i].texnum;
-			}
+			if (strcmp (identifier, glt->identifier))
+				continue;
+			if (width == glt->width && height == glt->height
+				&& mipmap == glt->mipmap && alpha == glt->alpha && checksum == glt->checksum)
+				return glt->texnum;
+			same = glt;
 		}
 	}
-	else {
+
+	// a texture with the same name but other contents, from another map or
+	// model, takes over its slot. The old texture object is left alone, it
+	// may still be drawn this frame.
+	if (same)
+		glt = same;
+	else
+	{
+		if (numgltextures == MAX_GLTEXTURES)
+			Sys_Error ("GL_LoadTexture: MAX_GLTEXTURES");
 		glt = &gltextures[numgltextures];
 		numgltextures++;
+
+		strcpy (glt->identifier, identifier);
+
+		// nameless textures are never looked up
+		if (identifier[0])
+		{
+			hash = GL_HashTextureName (identifier);
+			glt->hashnext = gltexture_hash[hash];
+			gltexture_hash[hash] = glt;
+		}
 	}
 
-	strcpy (glt->identifier, identifier);
 	glGenTextures( 1, &glt->texnum );
 	glt->width = width;
 	glt->height = height;
 	glt->mipmap = mipmap;
+	glt->alpha = alpha;
+	glt->checksum = checksum;
+
+	if (texturebatchlevel > 0)
+	{
+		if (width  > gl_max_size.value ||
+			height > gl_max_size.value)
+			Sys_Error ("GL_LoadTexture: too big");
+
+		pt = &pendingtextures[numpendingtextures];
+		numpendingtextures++;
+		pt->texnum = glt->texnum;
+		pt->data = data;
+		pt->width = width;
+		pt->height = height;
+		pt->mipmap = mipmap;
+		pt->alpha = alpha;
+		pt->rgba = NULL;
+		return glt->texnum;
+	}
 
 	GL_Bind( glt->texnum );
 
@@ -33,250 +33,358 @@ ALIAS MODEL DISPLAY LIST GENERATION
 model_t		*aliasmodel;
 aliashdr_t	*paliashdr;
 
-qboolean	used[8192];
-
-// the command list holds counts and s/t values that are valid for
-// every frame
-int		commands[8192];
-int		numcommands;
+// a vertex is made for every model vertex and, on the seam, again for
+// the back side, as the s coordinate differs
+#define	MAX_MESHVERTS	(MAXALIASVERTS*2)
 
 // all frames will have their vertexes rearranged and expanded
-// so they are in the order expected by the command list
-int		vertexorder[8192];
+// so they are in the order expected by the index list
+int		vertexorder[MAX_MESHVERTS];
 int		numorder;
 
+float	texcoords[MAX_MESHVERTS][2];	// valid for every frame
+
+unsigned short	indexes[MAXALIASTRIS*3];
+int		numindexes;
+
 int		allverts, alltris;
 
-int		stripverts[128];
-int		striptris[128];
-int		stripcount;
+static double	meshtime;		// for the load report
+static int		meshmodels;
 
 /*
-================
-StripLength
-================
-*/
-int	StripLength (int starttri, int startv)
-{
-	int			m1, m2;
-	int			j;
-	mtriangle_t	*last, *check;
-	int			k;
+=================================================================
 
-	used[starttri] = 2;
+VERTEX CACHE OPTIMIZATION
 
-	last = &triangles[starttri];
+Triangles are reordered with Tom Forsyth's "Linear-Speed Vertex Cache
+Optimisation": vertexes score for being recently used and for having
+few triangles left, and the triangle with the best sum of its vertex
+scores is added next. Only triangles using vertexes in the simulated
+cache are rescored, so it's linear in the number of triangles.
 
-	stripverts[0] = last->vertindex[(startv)%3];
-	stripverts[1] = last->vertindex[(startv+1)%3];
-	stripverts[2] = last->vertindex[(startv+2)%3];
+=================================================================
+*/
 
-	striptris[0] = starttri;
-	stripcount = 1;
+#define	VCACHE_SIZE		32
+#define	MAX_VALENCE		64		// scores for more triangles are the same
 
-	m1 = last->vertindex[(startv+2)%3];
-	m2 = last->vertindex[(startv+1)%3];
+typedef struct
+{
+	int		cachepos;			// -1 if not in the cache
+	int		numtris;			// not yet added
+	int		firsttri;			// in meshvertextris
+	float	score;
+} meshvertex_t;
+
+static meshvertex_t	meshverts[MAX_MESHVERTS];
+static int			meshvertextris[MAXALIASTRIS*3];
+static int			meshtris[MAXALIASTRIS][3];
+static float		meshtriscore[MAXALIASTRIS];
+static qboolean		meshtriadded[MAXALIASTRIS];
+
+static float	cachescores[VCACHE_SIZE];
+static float	valencescores[MAX_VALENCE];
+static qboolean	scoresinit;
+
+static void InitMeshScores (void)
+{
+	int		i;
 
-	// look for a matching triangle
-nexttri:
-	for (j=starttri+1, check=&triangles[starttri+1] ; j<pheader->numtris ; j++, check++)
+	for (i=0 ; i<VCACHE_SIZE ; i++)
 	{
-		if (check->facesfront != last->facesfront)
-			continue;
-		for (k=0 ; k<3 ; k++)
-		{
-			if (check->vertindex[k] != m1)
-				continue;
-			if (check->vertindex[ (k+1)%3 ] != m2)
-				continue;
+		// the last triangle's vertexes get a fixed score,
+		// so the next one doesn't strongly prefer a direction
+		if (i < 3)
+			cachescores[i] = 0.75;
+		else
+			cachescores[i] = pow (1.0 - (float)(i - 3) / (VCACHE_SIZE - 3), 1.5);
+	}
 
-			// this is the next part of the fan
+	valencescores[0] = 0;
+	for (i=1 ; i<MAX_VALENCE ; i++)
+		valencescores[i] = 2.0 * pow (i, -0.5);
 
-			// if we can't use this triangle, this tristrip is done
-			if (used[j])
-				goto done;
+	scoresinit = true;
+}
 
-			// the new edge
-			if (stripcount & 1)
-				m2 = check->vertindex[ (k+2)%3 ];
-			else
-				m1 = check->vertindex[ (k+2)%3 ];
+static float VertexScore (meshvertex_t *v)
+{
+	float	score;
 
-			stripverts[stripcount+2] = check->vertindex[ (k+2)%3 ];
-			striptris[stripcount] = j;
-			stripcount++;
+	if (!v->numtris)
+		return -1;		// no triangles need it
 
-			used[j] = 2;
-			goto nexttri;
-		}
-	}
-done:
+	score = 0;
+	if (v->cachepos >= 0)
+		score = cachescores[v->cachepos];
 
-	// clear the temp used flags
-	for (j=starttri+1 ; j<pheader->numtris ; j++)
-		if (used[j] == 2)
-			used[j] = 0;
+	if (v->numtris < MAX_VALENCE)
+		score += valencescores[v->numtris];
+	else
+		score += valencescores[MAX_VALENCE-1];
 
-	return stripcount;
+	return score;
 }
 
 /*
-===========
-FanLength
-===========
+================
+OptimizeTriangleOrder
+
+Reorders meshtris for the vertex cache
+================
 */
-int	FanLength (int starttri, int startv)
+static void OptimizeTriangleOrder (int numtris, int numverts)
 {
-	int		m1, m2;
-	int		j;
-	mtriangle_t	*last, *check;
-	int		k;
-
-	used[starttri] = 2;
-
-	last = &triangles[starttri];
-
-	stripverts[0] = last->vertindex[(startv)%3];
-	stripverts[1] = last->vertindex[(startv+1)%3];
-	stripverts[2] = last->vertindex[(startv+2)%3];
+	int				i, j, k, t;
+	int				cache[VCACHE_SIZE+3], newcache[VCACHE_SIZE+3];
+	int				cachesize, newcachesize;
+	int				order[MAXALIASTRIS];
+	int				numadded, best, nextscan;
+	float			bestscore;
+	meshvertex_t	*v;
+	int				*tri, *vt;
+	int				sorted[MAXALIASTRIS][3];
+
+	if (!scoresinit)
+		InitMeshScores ();
+
+	// triangles of every vertex
+	for (i=0 ; i<numverts ; i++)
+	{
+		meshverts[i].numtris = 0;
+		meshverts[i].cachepos = -1;
+	}
+	for (i=0 ; i<numtris ; i++)
+		for (j=0 ; j<3 ; j++)
+			meshverts[meshtris[i][j]].numtris++;
 
-	striptris[0] = starttri;
-	stripcount = 1;
+	k = 0;
+	for (i=0 ; i<numverts ; i++)
+	{
+		meshverts[i].firsttri = k;
+		k += meshverts[i].numtris;
+		meshverts[i].numtris = 0;
+	}
+	for (i=0 ; i<numtris ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
+		{
+			v = &meshverts[meshtris[i][j]];
+			meshvertextris[v->firsttri + v->numtris] = i;
+			v->numtris++;
+		}
+	}
 
-	m1 = last->vertindex[(startv+0)%3];
-	m2 = last->vertindex[(startv+2)%3];
+	for (i=0 ; i<numverts ; i++)
+		meshverts[i].score = VertexScore (&meshverts[i]);
 
+	best = -1;
+	bestscore = -1;
+	for (i=0 ; i<numtris ; i++)
+	{
+		meshtriadded[i] = false;
+		meshtriscore[i] = meshverts[meshtris[i][0]].score
+			+ meshverts[meshtris[i][1]].score + meshverts[meshtris[i][2]].score;
+		if (meshtriscore[i] > bestscore)
+		{
+			bestscore = meshtriscore[i];
+			best = i;
+		}
+	}
 
-	// look for a matching triangle
-nexttri:
-	for (j=starttri+1, check=&triangles[starttri+1] ; j<pheader->numtris ; j++, check++)
+	cachesize = 0;
+	nextscan = 0;
+	for (numadded = 0 ; numadded < numtris ; numadded++)
 	{
-		if (check->facesfront != last->facesfront)
-			continue;
-		for (k=0 ; k<3 ; k++)
+		if (best < 0)
 		{
-			if (check->vertindex[k] != m1)
-				continue;
-			if (check->vertindex[ (k+1)%3 ] != m2)
-				continue;
+			// nothing in the cache has triangles left, take the next one
+			while (meshtriadded[nextscan])
+				nextscan++;
+			best = nextscan;
+		}
 
-			// this is the next part of the fan
+		order[numadded] = best;
+		meshtriadded[best] = true;
+		tri = meshtris[best];
 
-			// if we can't use this triangle, this tristrip is done
-			if (used[j])
-				goto done;
+		// the triangle's vertexes go to the front of the cache
+		newcachesize = 0;
+		for (j=0 ; j<3 ; j++)
+		{
+			v = &meshverts[tri[j]];
 
-			// the new edge
-			m2 = check->vertindex[ (k+2)%3 ];
+			// remove the triangle from the vertex
+			vt = meshvertextris + v->firsttri;
+			for (k=0 ; k<v->numtris ; k++)
+			{
+				if (vt[k] == best)
+				{
+					vt[k] = vt[v->numtris-1];
+					break;
+				}
+			}
+			v->numtris--;
 
-			stripverts[stripcount+2] = m2;
-			striptris[stripcount] = j;
-			stripcount++;
+			newcache[newcachesize++] = tri[j];
+		}
+		for (i=0 ; i<cachesize ; i++)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				newcache[newcachesize++] = cache[i];
+		}
 
-			used[j] = 2;
-			goto nexttri;
+		// rescore the vertexes that were in the cache and the
+		// triangles using them, and find the best one
+		best = -1;
+		bestscore = -1;
+		cachesize = newcachesize < VCACHE_SIZE ? newcachesize : VCACHE_SIZE;
+		for (i=0 ; i<newcachesize ; i++)
+		{
+			v = &meshverts[newcache[i]];
+			v->cachepos = i < VCACHE_SIZE ? i : -1;
+			v->score = VertexScore (v);
+			cache[i] = newcache[i];
+		}
+		for (i=0 ; i<newcachesize ; i++)
+		{
+			v = &meshverts[newcache[i]];
+			vt = meshvertextris + v->firsttri;
+			for (k=0 ; k<v->numtris ; k++)
+			{
+				t = vt[k];
+				meshtriscore[t] = meshverts[meshtris[t][0]].score
+					+ meshverts[meshtris[t][1]].score + meshverts[meshtris[t][2]].score;
+				if (meshtriscore[t] > bestscore)
+				{
+					bestscore = meshtriscore[t];
+					best = t;
+				}
+			}
 		}
 	}
-done:
-
-	// clear the temp used flags
-	for (j=starttri+1 ; j<pheader->numtris ; j++)
-		if (used[j] == 2)
-			used[j] = 0;
 
-	return stripcount;
+	for (i=0 ; i<numtris ; i++)
+		for (j=0 ; j<3 ; j++)
+			sorted[i][j] = meshtris[order[i]][j];
+	memcpy (meshtris, sorted, numtris * sizeof(meshtris[0]));
 }
 
+/*
+================
+CacheMissRatio
+
+Vertexes transformed per triangle with a fifo cache of the given size,
+0.5 is the best for large meshes, 3 the worst
+================
+*/
+static float CacheMissRatio (int numtris, int size)
+{
+	int		fifo[VCACHE_SIZE];
+	int		i, j, head, misses;
+
+	for (i=0 ; i<size ; i++)
+		fifo[i] = -1;
+
+	head = 0;
+	misses = 0;
+	for (i=0 ; i<numtris*3 ; i++)
+	{
+		for (j=0 ; j<size ; j++)
+			if (fifo[j] == indexes[i])
+				break;
+		if (j != size)
+			continue;
+
+		misses++;
+		fifo[head] = indexes[i];
+		head = (head + 1) % size;
+	}
+
+	return numtris ? (float)misses / numtris : 0;
+}
 
 /*
 ================
 BuildTris
 
-Generate a list of trifans or strips
-for the model, which holds for all frames
+Generate an indexed triangle list for the model, which holds for all
+frames, ordered for the vertex cache
 ================
 */
 void BuildTris (void)
 {
 	int		i, j, k;
-	int		startv;
-	mtriangle_t	*last, *check;
-	int		m1, m2;
-	int		striplength;
-	trivertx_t	*v;
-	mtriangle_t *tv;
+	int		numverts;
+	int		meshvert[MAXALIASVERTS][2];		// for the front and back side
+	int		remap[MAX_MESHVERTS];
+	int		meshorder[MAX_MESHVERTS];
+	int		back;
 	float	s, t;
-	int		index;
-	int		len, bestlen, besttype;
-	int		bestverts[1024];
-	int		besttris[1024];
-	int		type;
 
 	//
-	// build tristrips
+	// make a vertex for every model vertex and side that's used
 	//
-	numorder = 0;
-	numcommands = 0;
-	memset (used, 0, sizeof(used));
+	for (i=0 ; i<pheader->numverts ; i++)
+		meshvert[i][0] = meshvert[i][1] = -1;
+
+	numverts = 0;
 	for (i=0 ; i<pheader->numtris ; i++)
 	{
-		// pick an unused triangle and start the trifan
-		if (used[i])
-			continue;
-
-		bestlen = 0;
-		for (type = 0 ; type < 2 ; type++)
-//	type = 1;
+		for (j=0 ; j<3 ; j++)
 		{
-			for (startv =0 ; startv < 3 ; startv++)
+			k = triangles[i].vertindex[j];
+			back = !triangles[i].facesfront && stverts[k].onseam;
+			if (meshvert[k][back] < 0)
 			{
-				if (type == 1)
-					len = StripLength (i, startv);
-				else
-					len = FanLength (i, startv);
-				if (len > bestlen)
-				{
-					besttype = type;
-					bestlen = len;
-					for (j=0 ; j<bestlen+2 ; j++)
-						bestverts[j] = stripverts[j];
-					for (j=0 ; j<bestlen ; j++)
-						besttris[j] = striptris[j];
-				}
+				meshorder[numverts] = k + back*MAXALIASVERTS;
+				meshvert[k][back] = numverts++;
 			}
+			meshtris[i][j] = meshvert[k][back];
 		}
+	}
 
-		// mark the tris on the best strip as used
-		for (j=0 ; j<bestlen ; j++)
-			used[besttris[j]] = 1;
+	OptimizeTriangleOrder (pheader->numtris, numverts);
 
-		if (besttype == 1)
-			commands[numcommands++] = (bestlen+2);
-		else
-			commands[numcommands++] = -(bestlen+2);
+	//
+	// number the vertexes in the order they are first used
+	//
+	for (i=0 ; i<numverts ; i++)
+		remap[i] = -1;
 
-		for (j=0 ; j<bestlen+2 ; j++)
+	numorder = 0;
+	numindexes = 0;
+	for (i=0 ; i<pheader->numtris ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
 		{
-			// emit a vertex into the reorder buffer
-			k = bestverts[j];
-			vertexorder[numorder++] = k;
-
-			// emit s/t coords into the commands stream
-			s = stverts[k].s;
-			t = stverts[k].t;
-			if (!triangles[besttris[0]].facesfront && stverts[k].onseam)
-				s += pheader->skinwidth / 2;	// on back side
-			s = (s + 0.5) / pheader->skinwidth;
-			t = (t + 0.5) / pheader->skinheight;
-
-			*(float *)&commands[numcommands++] = s;
-			*(float *)&commands[numcommands++] = t;
+			k = meshtris[i][j];
+			if (remap[k] < 0)
+			{
+				remap[k] = numorder;
+
+				// emit a vertex into the reorder buffer
+				back = meshorder[k] >= MAXALIASVERTS;
+				k = meshorder[k] - back*MAXALIASVERTS;
+				vertexorder[numorder] = k;
+
+				// emit s/t coords
+				s = stverts[k].s;
+				t = stverts[k].t;
+				if (back)
+					s += pheader->skinwidth / 2;	// on back side
+				texcoords[numorder][0] = (s + 0.5) / pheader->skinwidth;
+				texcoords[numorder][1] = (t + 0.5) / pheader->skinheight;
+
+				numorder++;
+			}
+			indexes[numindexes++] = remap[meshtris[i][j]];
 		}
 	}
 
-	commands[numcommands++] = 0;		// end of list marker
-
-	Con_DPrintf ("%3i tri %3i vert %3i cmd\n", pheader->numtris, numorder, numcommands);
+	Con_DPrintf ("%3i tri %3i vert, %.2f vertexes per tri\n", pheader->numtris, numorder,
+		CacheMissRatio (pheader->numtris, 16));
 
 	allverts += numorder;
 	alltris += pheader->numtris;
@@ -291,65 +399,33 @@ GL_MakeAliasModelDisplayLists
 void GL_MakeAliasModelDisplayLists (model_t *m, aliashdr_t *hdr)
 {
 	int		i, j;
-	maliasgroup_t	*paliasgroup;
-	int			*cmds;
+	float	*st;
+	unsigned short	*idx;
 	trivertx_t	*verts;
-	char	cache[MAX_QPATH], fullpath[MAX_OSPATH], *c;
-	FILE	*f;
-	int		len;
-	byte	*data;
+	double	time;
 
 	aliasmodel = m;
 	paliashdr = hdr;	// (aliashdr_t *)Mod_Extradata (m);
 
-	//
-	// look for a cached version
-	//
-	strcpy (cache, "glquake/");
-	COM_StripExtension (m->name+strlen("progs/"), cache+strlen("glquake/"));
-	strcat (cache, ".ms2");
+	time = Sys_FloatTime ();
 
-	COM_FOpenFile (cache, &f);	
-	if (f)
-	{
-		fread (&numcommands, 4, 1, f);
-		fread (&numorder, 4, 1, f);
-		fread (&commands, numcommands * sizeof(commands[0]), 1, f);
-		fread (&vertexorder, numorder * sizeof(vertexorder[0]), 1, f);
-		fclose (f);
-	}
-	else
-	{
-		//
-		// build it from scratch
-		//
-		Con_Printf ("meshing %s...\n",m->name);
-
-		BuildTris ();		// trifans or lists
-
-		//
-		// save out the cached version
-		//
-		sprintf (fullpath, "%s/%s", com_gamedir, cache);
-		f = fopen (fullpath, "wb");
-		if (f)
-		{
-			fwrite (&numcommands, 4, 1, f);
-			fwrite (&numorder, 4, 1, f);
-			fwrite (&commands, numcommands * sizeof(commands[0]), 1, f);
-			fwrite (&vertexorder, numorder * sizeof(vertexorder[0]), 1, f);
-			fclose (f);
-		}
-	}
+	BuildTris ();
 
+	meshtime += Sys_FloatTime () - time;
+	meshmodels++;
 
 	// save the data out
 
 	paliashdr->poseverts = numorder;
+	paliashdr->numindexes = numindexes;
 
-	cmds = Hunk_Alloc (numcommands * 4);
-	paliashdr->commands = (byte *)cmds - (byte *)paliashdr;
-	memcpy (cmds, commands, numcommands * 4);
+	st = Hunk_Alloc (numorder * sizeof(texcoords[0]));
+	paliashdr->texcoords = (byte *)st - (byte *)paliashdr;
+	memcpy (st, texcoords, numorder * sizeof(texcoords[0]));
+
+	idx = Hunk_Alloc (numindexes * sizeof(indexes[0]));
+	paliashdr->indexes = (byte *)idx - (byte *)paliashdr;
+	memcpy (idx, indexes, numindexes * sizeof(indexes[0]));
 
 	verts = Hunk_Alloc (paliashdr->numposes * paliashdr->poseverts 
 		* sizeof(trivertx_t) );
@@ -359,3 +435,13 @@ void GL_MakeAliasModelDisplayLists (model_t *m, aliashdr_t *hdr)
 			*verts++ = poseverts[i][vertexorder[j]];
 }
 
+void GL_ClearMeshStats (void)
+{
+	meshtime = 0;
+	meshmodels = 0;
+}
+
+void GL_PrintMeshStats (void)
+{
+	Con_DPrintf ("%i alias models meshed in %.3f s\n", meshmodels, meshtime);
+}
@@ -23,11 +23,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // models are the only shared resource between a client and server running
 // on the same machine.
 
+#include <stdint.h>
+
 #include "quakedef.h"
 
 model_t	*loadmodel;
 char	loadname[32];	// for hunk tags
 
+static modcache_t	loadcache;
+static qboolean		loadbadextents;		// Sys_Error can't be called from jobs
+
 void Mod_LoadSpriteModel (model_t *mod, void *buffer);
 void Mod_LoadBrushModel (model_t *mod, void *buffer);
 void Mod_LoadAliasModel (model_t *mod, void *buffer);
@@ -48,6 +53,7 @@ Mod_Init
 void Mod_Init (void)
 {
 	memset (mod_novis, 0xff, sizeof(mod_novis));
+	Mod_InitCache ();
 }
 
 /*
@@ -154,8 +160,13 @@ byte *Mod_DecompressVis (byte *in, model_t *model)
 
 byte *Mod_LeafPVS (mleaf_t *leaf, model_t *model)
 {
+	int		leafnum;
+
 	if (leaf == model->leafs)
 		return mod_novis;
+	leafnum = leaf - model->leafs - 1;
+	if (model->pvs && leafnum < model->numleafs)
+		return model->pvs + leafnum * ((model->numleafs+7)>>3);
 	return Mod_DecompressVis (leaf->compressed_vis, model);
 }
 
@@ -226,6 +237,32 @@ void Mod_TouchModel (char *name)
 	}
 }
 
+/*
+==================
+Mod_Prefetch
+
+Starts reading the file of a model that is going to be loaded soon
+==================
+*/
+void Mod_Prefetch (char *name)
+{
+	int		i;
+	model_t	*mod;
+
+	if (name[0] == '*')
+		return;		// submodels come with the world
+
+	for (i=0 , mod=mod_known ; i<mod_numknown ; i++, mod++)
+		if (!strcmp (mod->name, name) )
+		{
+			if (!mod->needload && (mod->type != mod_alias || Cache_Check (&mod->cache)))
+				return;
+			break;
+		}
+
+	COM_PrefetchFile (name);
+}
+
 /*
 ==================
 Mod_LoadModel
@@ -283,6 +320,9 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 
 // call the apropriate loader
 	mod->needload = false;
+
+	// the skins and textures point into buf
+	GL_BeginTextureBatch ();
 	
 	switch (LittleLong(*(unsigned *)buf))
 	{
@@ -299,6 +339,8 @@ model_t *Mod_LoadModel (model_t *mod, qboolean crash)
 		break;
 	}
 
+	GL_EndTextureBatch ();
+
 	return mod;
 }
 
@@ -496,7 +538,12 @@ void Mod_LoadLighting (lump_t *l)
 		return;
 	}
 	loadmodel->lightdata = Hunk_AllocName ( l->filelen, loadname);	
-	memcpy (loadmodel->lightdata, mod_base + l->fileofs, l->filelen);
+}
+
+static void Mod_FillLighting (lump_t *l)
+{
+	if (l->filelen)
+		memcpy (loadmodel->lightdata, mod_base + l->fileofs, l->filelen);
 }
 
 
@@ -513,7 +560,12 @@ void Mod_LoadVisibility (lump_t *l)
 		return;
 	}
 	loadmodel->visdata = Hunk_AllocName ( l->filelen, loadname);	
-	memcpy (loadmodel->visdata, mod_base + l->fileofs, l->filelen);
+}
+
+static void Mod_FillVisibility (lump_t *l)
+{
+	if (l->filelen)
+		memcpy (loadmodel->visdata, mod_base + l->fileofs, l->filelen);
 }
 
 
@@ -530,7 +582,12 @@ void Mod_LoadEntities (lump_t *l)
 		return;
 	}
 	loadmodel->entities = Hunk_AllocName ( l->filelen, loadname);	
-	memcpy (loadmodel->entities, mod_base + l->fileofs, l->filelen);
+}
+
+static void Mod_FillEntities (lump_t *l)
+{
+	if (l->filelen)
+		memcpy (loadmodel->entities, mod_base + l->fileofs, l->filelen);
 }
 
 
@@ -543,7 +600,7 @@ void Mod_LoadVertexes (lump_t *l)
 {
 	dvertex_t	*in;
 	mvertex_t	*out;
-	int			i, count;
+	int			count;
 
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -553,6 +610,17 @@ void Mod_LoadVertexes (lump_t *l)
 
 	loadmodel->vertexes = out;
 	loadmodel->numvertexes = count;
+}
+
+static void Mod_FillVertexes (lump_t *l)
+{
+	dvertex_t	*in;
+	mvertex_t	*out;
+	int			i, count;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->vertexes;
+	count = loadmodel->numvertexes;
 
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
@@ -571,7 +639,7 @@ void Mod_LoadSubmodels (lump_t *l)
 {
 	dmodel_t	*in;
 	dmodel_t	*out;
-	int			i, j, count;
+	int			count;
 
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -581,6 +649,17 @@ void Mod_LoadSubmodels (lump_t *l)
 
 	loadmodel->submodels = out;
 	loadmodel->numsubmodels = count;
+}
+
+static void Mod_FillSubmodels (lump_t *l)
+{
+	dmodel_t	*in;
+	dmodel_t	*out;
+	int			i, j, count;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->submodels;
+	count = loadmodel->numsubmodels;
 
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
@@ -607,7 +686,7 @@ void Mod_LoadEdges (lump_t *l)
 {
 	dedge_t *in;
 	medge_t *out;
-	int 	i, count;
+	int 	count;
 
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -617,6 +696,17 @@ void Mod_LoadEdges (lump_t *l)
 
 	loadmodel->edges = out;
 	loadmodel->numedges = count;
+}
+
+static void Mod_FillEdges (lump_t *l)
+{
+	dedge_t *in;
+	medge_t *out;
+	int 	i, count;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->edges;
+	count = loadmodel->numedges;
 
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
@@ -634,9 +724,7 @@ void Mod_LoadTexinfo (lump_t *l)
 {
 	texinfo_t *in;
 	mtexinfo_t *out;
-	int 	i, j, count;
-	int		miptex;
-	float	len1, len2;
+	int 	i, count;
 
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -647,6 +735,26 @@ void Mod_LoadTexinfo (lump_t *l)
 	loadmodel->texinfo = out;
 	loadmodel->numtexinfo = count;
 
+	if (loadmodel->textures)
+	{
+		for ( i=0 ; i<count ; i++, in++)
+			if (LittleLong (in->miptex) >= loadmodel->numtextures)
+				Sys_Error ("miptex >= loadmodel->numtextures");
+	}
+}
+
+static void Mod_FillTexinfo (lump_t *l)
+{
+	texinfo_t *in;
+	mtexinfo_t *out;
+	int 	i, j, count;
+	int		miptex;
+	float	len1, len2;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->texinfo;
+	count = loadmodel->numtexinfo;
+
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
 		for (j=0 ; j<8 ; j++)
@@ -679,8 +787,6 @@ void Mod_LoadTexinfo (lump_t *l)
 		}
 		else
 		{
-			if (miptex >= loadmodel->numtextures)
-				Sys_Error ("miptex >= loadmodel->numtextures");
 			out->texture = loadmodel->textures[miptex];
 			if (!out->texture)
 			{
@@ -739,8 +845,6 @@ void CalcSurfaceExtents (msurface_t *s)
 
 		s->texturemins[i] = bmins[i] * 16;
 		s->extents[i] = (bmaxs[i] - bmins[i]) * 16;
-		if ( !(tex->flags & TEX_SPECIAL) && s->extents[i] > 512 /* 256 */ )
-			Sys_Error ("Bad surface extents");
 	}
 }
 
@@ -754,8 +858,7 @@ void Mod_LoadFaces (lump_t *l)
 {
 	dface_t		*in;
 	msurface_t 	*out;
-	int			i, count, surfnum;
-	int			planenum, side;
+	int			count;
 
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -765,6 +868,21 @@ void Mod_LoadFaces (lump_t *l)
 
 	loadmodel->surfaces = out;
 	loadmodel->numsurfaces = count;
+}
+
+static void Mod_FillFaces (lump_t *l)
+{
+	dface_t		*in;
+	msurface_t 	*out;
+	int			i, count, surfnum;
+	int			planenum, side;
+	qboolean	cachedextents;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->surfaces;
+	count = loadmodel->numsurfaces;
+
+	cachedextents = Mod_CachedSurfaceExtents (&loadcache, loadmodel);
 
 	for ( surfnum=0 ; surfnum<count ; surfnum++, in++, out++)
 	{
@@ -781,7 +899,11 @@ void Mod_LoadFaces (lump_t *l)
 
 		out->texinfo = loadmodel->texinfo + LittleShort (in->texinfo);
 
-		CalcSurfaceExtents (out);
+		if (!cachedextents)
+			CalcSurfaceExtents (out);
+		// checked here for the cached ones too, the limit depends on the renderer
+		if ( !(out->texinfo->flags & TEX_SPECIAL) && (out->extents[0] > 512 /* 256 */ || out->extents[1] > 512 /* 256 */) )
+			loadbadextents = true;
 				
 	// lighting info
 
@@ -805,6 +927,9 @@ void Mod_LoadFaces (lump_t *l)
 			out->flags |= (SURF_DRAWTURB | SURF_DRAWTILED);
 
 	}
+
+	if (!cachedextents)
+		Mod_CacheSurfaceExtents (&loadcache, loadmodel);
 }
 
 
@@ -829,7 +954,7 @@ Mod_LoadNodes
 */
 void Mod_LoadNodes (lump_t *l)
 {
-	int			i, j, count, p;
+	int			count;
 	dnode_t		*in;
 	mnode_t 	*out;
 
@@ -841,6 +966,17 @@ void Mod_LoadNodes (lump_t *l)
 
 	loadmodel->nodes = out;
 	loadmodel->numnodes = count;
+}
+
+static void Mod_FillNodes (lump_t *l)
+{
+	int			i, j, count, p;
+	dnode_t		*in;
+	mnode_t 	*out;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->nodes;
+	count = loadmodel->numnodes;
 
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
@@ -878,7 +1014,7 @@ void Mod_LoadLeafs (lump_t *l)
 {
 	dleaf_t 	*in;
 	mleaf_t 	*out;
-	int			i, j, count, p;
+	int			count;
 
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -888,6 +1024,17 @@ void Mod_LoadLeafs (lump_t *l)
 
 	loadmodel->leafs = out;
 	loadmodel->numleafs = count;
+}
+
+static void Mod_FillLeafs (lump_t *l)
+{
+	dleaf_t 	*in;
+	mleaf_t 	*out;
+	int			i, j, count, p;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->leafs;
+	count = loadmodel->numleafs;
 
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
@@ -931,7 +1078,7 @@ Mod_LoadClipnodes
 void Mod_LoadClipnodes (lump_t *l)
 {
 	dclipnode_t *in, *out;
-	int			i, count;
+	int			count;
 	hull_t		*hull;
 
 	in = (void *)(mod_base + l->fileofs);
@@ -966,6 +1113,16 @@ void Mod_LoadClipnodes (lump_t *l)
 	hull->clip_maxs[0] = 32;
 	hull->clip_maxs[1] = 32;
 	hull->clip_maxs[2] = 64;
+}
+
+static void Mod_FillClipnodes (lump_t *l)
+{
+	dclipnode_t *in, *out;
+	int			i, count;
+
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->clipnodes;
+	count = loadmodel->numclipnodes;
 
 	for (i=0 ; i<count ; i++, out++, in++)
 	{
@@ -1014,6 +1171,37 @@ void Mod_MakeHull0 (void)
 	}
 }
 
+/*
+=================
+Mod_PackHull
+
+Copies the planes into the clipnodes, so tracing touches one cache line
+per node. Hulls 1 and 2 share their clipnodes and the packed nodes.
+=================
+*/
+static void Mod_PackHull (hull_t *hull, int count)
+{
+	dclipnode_t	*in;
+	mclipnode_t	*out;
+	mplane_t	*plane;
+	int			i;
+
+	out = Hunk_AllocName (count*sizeof(*out) + 31, loadname);
+	out = (mclipnode_t *)(((intptr_t)out + 31) & ~31);
+	hull->nodes = out;
+
+	for (i=0, in=hull->clipnodes ; i<count ; i++, in++, out++)
+	{
+		plane = hull->planes + in->planenum;
+		VectorCopy (plane->normal, out->normal);
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = in->children[0];
+		out->children[1] = in->children[1];
+		out->pad = 0;
+	}
+}
+
 /*
 =================
 Mod_LoadMarksurfaces
@@ -1039,6 +1227,22 @@ void Mod_LoadMarksurfaces (lump_t *l)
 		j = LittleShort(in[i]);
 		if (j >= loadmodel->numsurfaces)
 			Sys_Error ("Mod_ParseMarksurfaces: bad surface number");
+	}
+}
+
+static void Mod_FillMarksurfaces (lump_t *l)
+{
+	int		i, j, count;
+	short		*in;
+	msurface_t **out;
+	
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->marksurfaces;
+	count = loadmodel->nummarksurfaces;
+
+	for ( i=0 ; i<count ; i++)
+	{
+		j = LittleShort(in[i]);
 		out[i] = loadmodel->surfaces + j;
 	}
 }
@@ -1050,7 +1254,7 @@ Mod_LoadSurfedges
 */
 void Mod_LoadSurfedges (lump_t *l)
 {	
-	int		i, count;
+	int		count;
 	int		*in, *out;
 	
 	in = (void *)(mod_base + l->fileofs);
@@ -1061,6 +1265,16 @@ void Mod_LoadSurfedges (lump_t *l)
 
 	loadmodel->surfedges = out;
 	loadmodel->numsurfedges = count;
+}
+
+static void Mod_FillSurfedges (lump_t *l)
+{
+	int		i, count;
+	int		*in, *out;
+	
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->surfedges;
+	count = loadmodel->numsurfedges;
 
 	for ( i=0 ; i<count ; i++)
 		out[i] = LittleLong (in[i]);
@@ -1074,11 +1288,9 @@ Mod_LoadPlanes
 */
 void Mod_LoadPlanes (lump_t *l)
 {
-	int			i, j;
 	mplane_t	*out;
 	dplane_t 	*in;
 	int			count;
-	int			bits;
 	
 	in = (void *)(mod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
@@ -1088,6 +1300,19 @@ void Mod_LoadPlanes (lump_t *l)
 	
 	loadmodel->planes = out;
 	loadmodel->numplanes = count;
+}
+
+static void Mod_FillPlanes (lump_t *l)
+{
+	int			i, j;
+	mplane_t	*out;
+	dplane_t 	*in;
+	int			count;
+	int			bits;
+	
+	in = (void *)(mod_base + l->fileofs);
+	out = loadmodel->planes;
+	count = loadmodel->numplanes;
 
 	for ( i=0 ; i<count ; i++, in++, out++)
 	{
@@ -1123,6 +1348,80 @@ float RadiusFromBounds (vec3_t mins, vec3_t maxs)
 	return Length (corner);
 }
 
+/*
+=================
+Mod_FillLumps
+
+The Mod_Load* functions check and allocate the lumps in a fixed order on
+the main thread, so the hunk looks the same on every load. The lumps are
+then converted by jobs, a lump only waits for the lumps it reads.
+=================
+*/
+enum
+{
+	LJ_LIGHTING, LJ_VISIBILITY, LJ_ENTITIES, LJ_VERTEXES, LJ_EDGES,
+	LJ_SURFEDGES, LJ_PLANES, LJ_TEXINFO, LJ_FACES, LJ_MARKSURFACES,
+	LJ_LEAFS, LJ_NODES, LJ_CLIPNODES, LJ_SUBMODELS, NUM_LOADJOBS
+};
+
+typedef struct
+{
+	void		(*fill) (lump_t *l);
+	int			lump;
+	unsigned	deps;
+} loadjob_t;
+
+static loadjob_t	loadjobs[NUM_LOADJOBS] =
+{
+	{Mod_FillLighting, LUMP_LIGHTING, 0},
+	{Mod_FillVisibility, LUMP_VISIBILITY, 0},
+	{Mod_FillEntities, LUMP_ENTITIES, 0},
+	{Mod_FillVertexes, LUMP_VERTEXES, 0},
+	{Mod_FillEdges, LUMP_EDGES, 0},
+	{Mod_FillSurfedges, LUMP_SURFEDGES, 0},
+	{Mod_FillPlanes, LUMP_PLANES, 0},
+	{Mod_FillTexinfo, LUMP_TEXINFO, 0},
+	// extents need the vertexes of the edges, the cache is only used by faces
+	{Mod_FillFaces, LUMP_FACES, (1<<LJ_VERTEXES) | (1<<LJ_EDGES) | (1<<LJ_SURFEDGES) | (1<<LJ_TEXINFO)},
+	{Mod_FillMarksurfaces, LUMP_MARKSURFACES, 0},
+	// leafs flag the surfaces they mark
+	{Mod_FillLeafs, LUMP_LEAFS, (1<<LJ_FACES) | (1<<LJ_MARKSURFACES)},
+	// Mod_SetParent reads the leaf contents
+	{Mod_FillNodes, LUMP_NODES, 1<<LJ_LEAFS},
+	{Mod_FillClipnodes, LUMP_CLIPNODES, 0},
+	{Mod_FillSubmodels, LUMP_MODELS, 0},
+};
+
+static dheader_t	*loadheader;
+
+static void Mod_RunLoadJob (void *arg)
+{
+	loadjob_t	*job;
+
+	job = arg;
+	job->fill (&loadheader->lumps[job->lump]);
+}
+
+static void Mod_FillLumps (dheader_t *header)
+{
+	jobnode_t	nodes[NUM_LOADJOBS];
+	int			i;
+
+	for (i=0 ; i<NUM_LOADJOBS ; i++)
+	{
+		nodes[i].func = Mod_RunLoadJob;
+		nodes[i].arg = &loadjobs[i];
+		nodes[i].deps = loadjobs[i].deps;
+	}
+
+	loadheader = header;
+	loadbadextents = false;
+	Jobs_RunGraph (nodes, NUM_LOADJOBS);
+
+	if (loadbadextents)
+		Sys_Error ("Bad surface extents");
+}
+
 /*
 =================
 Mod_LoadBrushModel
@@ -1148,6 +1447,10 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	for (i=0 ; i<sizeof(dheader_t)/4 ; i++)
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
 
+	mod->checksum = Mod_BrushChecksum (header);
+	mod->pvs = NULL;		// submodels are copied before it's built
+	Mod_OpenCache (&loadcache, mod);
+
 // load into heap
 	
 	Mod_LoadVertexes (&header->lumps[LUMP_VERTEXES]);
@@ -1166,7 +1469,13 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	Mod_LoadEntities (&header->lumps[LUMP_ENTITIES]);
 	Mod_LoadSubmodels (&header->lumps[LUMP_MODELS]);
 
+	Mod_FillLumps (header);
+
 	Mod_MakeHull0 ();
+
+	Mod_PackHull (&mod->hulls[0], mod->numnodes);
+	Mod_PackHull (&mod->hulls[1], mod->numclipnodes);
+	mod->hulls[2].nodes = mod->hulls[1].nodes;
 	
 	mod->numframes = 2;		// regular and alternate animation
 	
@@ -1205,6 +1514,9 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 			mod = loadmodel;
 		}
 	}
+
+	Mod_BuildPVS (&loadcache, loadcache.model);
+	Mod_CloseCache (&loadcache);
 }
 
 /*
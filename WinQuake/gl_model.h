@@ -190,10 +190,21 @@ typedef struct mleaf_s
 	byte		ambient_sound_level[NUM_AMBIENTS];
 } mleaf_t;
 
+// a clipnode with its plane, what the tracer reads, 32 bytes aligned
+typedef struct
+{
+	vec3_t		normal;
+	float		dist;
+	int			type;			// of the plane, < 3 is axial
+	int			children[2];	// negative numbers are contents
+	int			pad;
+} mclipnode_t;
+
 typedef struct
 {
 	dclipnode_t	*clipnodes;
 	mplane_t	*planes;
+	mclipnode_t	*nodes;			// clipnodes and planes packed together
 	int			firstclipnode;
 	int			lastclipnode;
 	vec3_t		clip_mins;
@@ -304,7 +315,9 @@ typedef struct {
 	int					numposes;
 	int					poseverts;
 	int					posedata;	// numposes*poseverts trivert_t
-	int					commands;	// gl command list with embedded s/t
+	int					texcoords;	// poseverts s/t pairs, valid for every pose
+	int					indexes;	// numindexes shorts, a triangle list
+	int					numindexes;
 	int					gl_texturenum[MAX_SKINS][4];
 	int					texels[MAX_SKINS];	// only for player skins
 	maliasframedesc_t	frames[1];	// variable sized
@@ -405,6 +418,9 @@ typedef struct model_s
 	byte		*lightdata;
 	char		*entities;
 
+	byte		*pvs;			// decompressed visdata, NULL if too big
+	unsigned	checksum;		// of the bsp file, for the cache
+
 //
 // additional model data
 //
@@ -419,6 +435,7 @@ void	Mod_ClearAll (void);
 model_t *Mod_ForName (char *name, qboolean crash);
 void	*Mod_Extradata (model_t *mod);	// handles caching
 void	Mod_TouchModel (char *name);
+void	Mod_Prefetch (char *name);
 
 mleaf_t *Mod_PointInLeaf (float *p, model_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, model_t *model);
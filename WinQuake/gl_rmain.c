@@ -281,6 +281,10 @@ float	*shadedots = r_avertexnormal_dots[0];
 static int	posenum[2];
 static float pose_weight[2];
 
+// the interpolated pose, for drawing with arrays
+static float	aliasverts[MAXALIASVERTS*2][3];
+static float	aliascolors[MAXALIASVERTS*2][3];
+
 /*
 =============
 GL_DrawAliasFrame
@@ -288,56 +292,39 @@ GL_DrawAliasFrame
 */
 void GL_DrawAliasFrame (aliashdr_t *paliashdr)
 {
-	float	s, t;
 	float 	l;
-	int		i, j;
-	int		index;
-	trivertx_t	*v, *verts[2];
-	int		list;
-	int		*order;
-	vec3_t	point;
-	float	*normal;
-	int		count;
+	int		i;
+	trivertx_t	*verts[2];
 
 	verts[1] = (trivertx_t *)((byte *)paliashdr + paliashdr->posedata);
 	verts[0] = verts[1] + posenum[0] * paliashdr->poseverts;
 	verts[1] = verts[1] + posenum[1] * paliashdr->poseverts;
 
-	order = (int *)((byte *)paliashdr + paliashdr->commands);
-
-	while (1)
+	for (i=0 ; i<paliashdr->poseverts ; i++, verts[0]++, verts[1]++)
 	{
-		// get the vertex count and primitive type
-		count = *order++;
-		if (!count)
-			break;		// done
-		if (count < 0)
-		{
-			count = -count;
-			glBegin (GL_TRIANGLE_FAN);
-		}
-		else
-			glBegin (GL_TRIANGLE_STRIP);
+		// normals and vertexes come from the frame list
+		l = shadedots[verts[0]->lightnormalindex] * shadelight;
+		aliascolors[i][0] = aliascolors[i][1] = aliascolors[i][2] = l;
 
-		do
-		{
-			// texture coordinates come from the draw list
-			glTexCoord2f (((float *)order)[0], ((float *)order)[1]);
-			order += 2;
-
-			// normals and vertexes come from the frame list
-			l = shadedots[verts[0]->lightnormalindex] * shadelight;
-			glColor3f (l, l, l);
-			glVertex3f (
-				verts[0]->v[0] * pose_weight[0] + verts[1]->v[0] * pose_weight[1],
-				verts[0]->v[1] * pose_weight[0] + verts[1]->v[1] * pose_weight[1],
-				verts[0]->v[2] * pose_weight[0] + verts[1]->v[2] * pose_weight[1]);
-			verts[0]++;
-			verts[1]++;
-		} while (--count);
-
-		glEnd ();
+		aliasverts[i][0] = verts[0]->v[0] * pose_weight[0] + verts[1]->v[0] * pose_weight[1];
+		aliasverts[i][1] = verts[0]->v[1] * pose_weight[0] + verts[1]->v[1] * pose_weight[1];
+		aliasverts[i][2] = verts[0]->v[2] * pose_weight[0] + verts[1]->v[2] * pose_weight[1];
 	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	glVertexPointer( 3, GL_FLOAT, 0, aliasverts );
+	// texture coordinates come from the draw list
+	glTexCoordPointer( 2, GL_FLOAT, 0, (byte *)paliashdr + paliashdr->texcoords );
+	glColorPointer( 3, GL_FLOAT, 0, aliascolors );
+
+	glDrawElements( GL_TRIANGLES, paliashdr->numindexes, GL_UNSIGNED_SHORT, (byte *)paliashdr + paliashdr->indexes );
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
 }
 
 
@@ -350,70 +337,41 @@ extern	vec3_t			lightspot;
 
 void GL_DrawAliasShadow (aliashdr_t *paliashdr)
 {
-	float	s, t, l;
-	int		i, j;
-	int		index;
-	trivertx_t	*v, *verts[2];
-	int		list;
-	int		*order;
+	int		i;
+	trivertx_t	*verts[2];
 	vec3_t	point;
-	float	*normal;
 	float	height, lheight;
-	int		count;
 
 	lheight = currententity->origin[2] - lightspot[2];
 
-	height = 0;
 	verts[1] = (trivertx_t *)((byte *)paliashdr + paliashdr->posedata);
 	verts[0] = verts[1] + posenum[0] * paliashdr->poseverts;
 	verts[1] = verts[1] + posenum[1] * paliashdr->poseverts;
 
-	order = (int *)((byte *)paliashdr + paliashdr->commands);
-
 	height = -lheight + 1.0;
 
-	while (1)
+	for (i=0 ; i<paliashdr->poseverts ; i++, verts[0]++, verts[1]++)
 	{
-		// get the vertex count and primitive type
-		count = *order++;
-		if (!count)
-			break;		// done
-		if (count < 0)
-		{
-			count = -count;
-			glBegin (GL_TRIANGLE_FAN);
-		}
-		else
-			glBegin (GL_TRIANGLE_STRIP);
+		point[0] = verts[0]->v[0] * pose_weight[0] + verts[1]->v[0] * pose_weight[1];
+		point[1] = verts[0]->v[1] * pose_weight[0] + verts[1]->v[1] * pose_weight[1];
+		point[2] = verts[0]->v[2] * pose_weight[0] + verts[1]->v[2] * pose_weight[1];
+
+		// normals and vertexes come from the frame list
+		point[0] = point[0] * paliashdr->scale[0] + paliashdr->scale_origin[0];
+		point[1] = point[1] * paliashdr->scale[1] + paliashdr->scale_origin[1];
+		point[2] = point[2] * paliashdr->scale[2] + paliashdr->scale_origin[2];
+
+		aliasverts[i][0] = point[0] - shadevector[0]*(point[2]+lheight);
+		aliasverts[i][1] = point[1] - shadevector[1]*(point[2]+lheight);
+		aliasverts[i][2] = height;
+	}
 
-		do
-		{
-			// texture coordinates come from the draw list
-			// (skipped for shadows) glTexCoord2fv ((float *)order);
-			order += 2;
-
-			
-			point[0] = verts[0]->v[0] * pose_weight[0] + verts[1]->v[0] * pose_weight[1];
-			point[1] = verts[0]->v[1] * pose_weight[0] + verts[1]->v[1] * pose_weight[1];
-			point[2] = verts[0]->v[2] * pose_weight[0] + verts[1]->v[2] * pose_weight[1];
-
-			// normals and vertexes come from the frame list
-			point[0] = point[0] * paliashdr->scale[0] + paliashdr->scale_origin[0];
-			point[1] = point[1] * paliashdr->scale[1] + paliashdr->scale_origin[1];
-			point[2] = point[2] * paliashdr->scale[2] + paliashdr->scale_origin[2];
-
-			point[0] -= shadevector[0]*(point[2]+lheight);
-			point[1] -= shadevector[1]*(point[2]+lheight);
-			point[2] = height;
-//			height -= 0.001;
-			glVertex3fv (point);
-
-			verts[0]++;
-			verts[1]++;
-		} while (--count);
-
-		glEnd ();
-	}	
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer( 3, GL_FLOAT, 0, aliasverts );
+
+	glDrawElements( GL_TRIANGLES, paliashdr->numindexes, GL_UNSIGNED_SHORT, (byte *)paliashdr + paliashdr->indexes );
+
+	glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 
@@ -1051,8 +1009,6 @@ void R_RenderScene (void)
 
 	R_DrawWorld ();		// adds static entities to the list
 
-	S_ExtraUpdate ();	// don't let sound get messed up if going slow
-
 	R_DrawEntitiesOnList ();
 
 	DrawTextureChains ();
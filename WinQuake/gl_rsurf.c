@@ -994,6 +994,20 @@ void BuildSurfaceDisplayList (msurface_t *fa)
 
 }
 
+/*
+========================
+GL_FillSurfaceLightmap
+========================
+*/
+void GL_FillSurfaceLightmap (msurface_t *surf)
+{
+	byte	*base;
+
+	base = lightmaps + surf->lightmaptexturenum*lightmap_bytes*BLOCK_WIDTH*BLOCK_HEIGHT;
+	base += (surf->light_t * BLOCK_WIDTH + surf->light_s) * lightmap_bytes;
+	R_BuildLightMap (surf, base, BLOCK_WIDTH*lightmap_bytes);
+}
+
 /*
 ========================
 GL_CreateSurfaceLightmap
@@ -1001,8 +1015,7 @@ GL_CreateSurfaceLightmap
 */
 void GL_CreateSurfaceLightmap (msurface_t *surf)
 {
-	int		smax, tmax, s, t, l, i;
-	byte	*base;
+	int		smax, tmax;
 
 	if (surf->flags & (SURF_DRAWSKY|SURF_DRAWTURB))
 		return;
@@ -1011,9 +1024,153 @@ void GL_CreateSurfaceLightmap (msurface_t *surf)
 	tmax = (surf->extents[1]>>4)+1;
 
 	surf->lightmaptexturenum = AllocBlock (smax, tmax, &surf->light_s, &surf->light_t);
-	base = lightmaps + surf->lightmaptexturenum*lightmap_bytes*BLOCK_WIDTH*BLOCK_HEIGHT;
-	base += (surf->light_t * BLOCK_WIDTH + surf->light_s) * lightmap_bytes;
-	R_BuildLightMap (surf, base, BLOCK_WIDTH*lightmap_bytes);
+	GL_FillSurfaceLightmap (surf);
+}
+
+//=============================================================================
+
+// MCL_LIGHTMAPS lump, followed by a cachedlightmap_t for every surface
+typedef struct
+{
+	int		blockwidth, blockheight, maxlightmaps;
+	int		keeptjunctions;		// the polys are made with this
+	int		numsurfaces;
+	int		allocated[MAX_LIGHTMAPS][BLOCK_WIDTH];	// after the model
+} cachedlightmaps_t;
+
+typedef struct
+{
+	int		lightmaptexturenum;
+	int		light_s, light_t;
+} cachedlightmap_t;
+
+// MCL_POLYS lump is the number of verts and then the verts of every surface
+
+/*
+========================
+GL_LoadCachedSurfaces
+
+Only valid for the first model to allocate lightmap blocks
+========================
+*/
+qboolean GL_LoadCachedSurfaces (modcache_t *mc, model_t *m)
+{
+	cachedlightmaps_t	*header;
+	cachedlightmap_t	*in;
+	int			*polys, *p, *end;
+	int			i, size, numverts;
+	msurface_t	*fa;
+	glpoly_t	*poly;
+
+	header = Mod_CacheLump (mc, MCL_LIGHTMAPS, &size);
+	if (!header || size != sizeof(*header) + m->numsurfaces * sizeof(*in))
+		return false;
+	if (header->blockwidth != BLOCK_WIDTH || header->blockheight != BLOCK_HEIGHT
+		|| header->maxlightmaps != MAX_LIGHTMAPS || header->numsurfaces != m->numsurfaces
+		|| header->keeptjunctions != (gl_keeptjunctions.value != 0))
+		return false;
+
+	polys = Mod_CacheLump (mc, MCL_POLYS, &size);
+	if (!polys)
+		return false;
+
+	// check the polys before using anything
+	end = polys + size / sizeof(int);
+	p = polys;
+	for (i=0 ; i<m->numsurfaces ; i++)
+	{
+		if (p >= end)
+			return false;
+		numverts = *p++;
+		if (numverts < 0 || numverts > m->surfaces[i].numedges || numverts * VERTEXSIZE > end - p)
+			return false;
+		p += numverts * VERTEXSIZE;
+	}
+	if (p != end)
+		return false;
+
+	memcpy (allocated, header->allocated, sizeof(allocated));
+
+	in = (cachedlightmap_t *)(header + 1);
+	p = polys;
+	for (i=0, fa=m->surfaces ; i<m->numsurfaces ; i++, fa++, in++)
+	{
+		if (!(fa->flags & (SURF_DRAWSKY|SURF_DRAWTURB)))
+		{
+			fa->lightmaptexturenum = in->lightmaptexturenum;
+			fa->light_s = in->light_s;
+			fa->light_t = in->light_t;
+			GL_FillSurfaceLightmap (fa);
+		}
+
+		// same as BuildSurfaceDisplayList
+		numverts = *p++;
+		poly = Hunk_Alloc (sizeof(glpoly_t) + (fa->numedges-4) * VERTEXSIZE*sizeof(float));
+		poly->next = fa->polys;
+		poly->flags = fa->flags;
+		fa->polys = poly;
+		poly->numverts = numverts;
+		memcpy (poly->verts, p, numverts * VERTEXSIZE*sizeof(float));
+		p += numverts * VERTEXSIZE;
+	}
+
+	return true;
+}
+
+/*
+========================
+GL_CacheSurfaces
+========================
+*/
+void GL_CacheSurfaces (modcache_t *mc, model_t *m)
+{
+	cachedlightmaps_t	*header;
+	cachedlightmap_t	*out;
+	int			*polys, *p;
+	int			i, size;
+	msurface_t	*fa;
+
+	size = sizeof(*header) + m->numsurfaces * sizeof(*out);
+	header = malloc (size);
+	if (!header)
+		return;
+
+	header->blockwidth = BLOCK_WIDTH;
+	header->blockheight = BLOCK_HEIGHT;
+	header->maxlightmaps = MAX_LIGHTMAPS;
+	header->keeptjunctions = gl_keeptjunctions.value != 0;
+	header->numsurfaces = m->numsurfaces;
+	memcpy (header->allocated, allocated, sizeof(allocated));
+
+	out = (cachedlightmap_t *)(header + 1);
+	for (i=0, fa=m->surfaces ; i<m->numsurfaces ; i++, fa++, out++)
+	{
+		out->lightmaptexturenum = fa->lightmaptexturenum;
+		out->light_s = fa->light_s;
+		out->light_t = fa->light_t;
+	}
+
+	Mod_SetCacheLump (mc, MCL_LIGHTMAPS, header, size);
+	free (header);
+
+	size = 0;
+	for (i=0, fa=m->surfaces ; i<m->numsurfaces ; i++, fa++)
+		size += sizeof(int) + fa->polys->numverts * VERTEXSIZE*sizeof(float);
+
+	polys = malloc (size);
+	if (!polys)
+		return;
+
+	p = polys;
+	for (i=0, fa=m->surfaces ; i<m->numsurfaces ; i++, fa++)
+	{
+		*p++ = fa->polys->numverts;
+		memcpy (p, fa->polys->verts, fa->polys->numverts * VERTEXSIZE*sizeof(float));
+		p += fa->polys->numverts * VERTEXSIZE;
+	}
+
+	Mod_SetCacheLump (mc, MCL_POLYS, polys, size);
+	free (polys);
 }
 
 
@@ -1029,6 +1186,7 @@ void GL_BuildLightmaps (void)
 {
 	int		i, j;
 	model_t	*m;
+	modcache_t	mc;
 
 	memset (allocated, 0, sizeof(allocated));
 
@@ -1048,11 +1206,29 @@ void GL_BuildLightmaps (void)
 			continue;
 		r_pcurrentvertbase = m->vertexes;
 		currentmodel = m;
+
+		// the world allocates first, so only its blocks can be cached
+		if (j == 1)
+		{
+			Mod_OpenCache (&mc, m);
+			if (GL_LoadCachedSurfaces (&mc, m))
+			{
+				Mod_CloseCache (&mc);
+				continue;
+			}
+		}
+
 		for (i=0 ; i<m->numsurfaces ; i++)
 		{
 			GL_CreateSurfaceLightmap (m->surfaces + i);
 			BuildSurfaceDisplayList (m->surfaces + i);
 		}
+
+		if (j == 1)
+		{
+			GL_CacheSurfaces (&mc, m);
+			Mod_CloseCache (&mc);
+		}
 	}
 
  	if (!gl_texsort.value)
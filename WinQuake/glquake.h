@@ -39,6 +39,13 @@ void GL_Upload32 (unsigned *data, int width, int height,  qboolean mipmap, qbool
 void GL_Upload8 (byte *data, int width, int height,  qboolean mipmap, qboolean alpha);
 int GL_LoadTexture (char *identifier, int width, int height, byte *data, qboolean mipmap, qboolean alpha);
 int GL_FindTexture (char *identifier);
+void GL_BeginTextureBatch (void);
+void GL_EndTextureBatch (void);
+void GL_ClearTextureStats (void);
+void GL_PrintTextureStats (void);
+void GL_MakeAliasModelDisplayLists (model_t *m, aliashdr_t *hdr);
+void GL_ClearMeshStats (void);
+void GL_PrintMeshStats (void);
 
 typedef struct
 {
@@ -103,19 +110,20 @@ typedef enum {
 	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
-typedef struct particle_s
+// every field is an array, the live particles are packed at the start
+typedef struct
 {
 // driver-usable fields
-	vec3_t		org;
-	float		color;
+	float		*org[3];
+	byte		*color;
+	int			numparticles;
 // drivers never touch the following fields
-	struct particle_s	*next;
-	vec3_t		vel;
-	float		ramp;
-	float		die;
-	ptype_t		type;
-} particle_t;
+	float		*vel[3];
+	float		*ramp;
+	float		*die;
+	byte		*type;		// ptype_t
+	int			maxparticles;
+} particles_t;
 
 
 //====================================================
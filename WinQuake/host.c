@@ -135,6 +135,14 @@ void Host_Error (char *error, ...)
 	vsprintf (string,error,argptr);
 	va_end (argptr);
 	Con_Printf ("Host_Error: %s\n",string);
+
+// the error may have come from the middle of SV_SendClientMessages, don't
+// leave the datagrams of the client queued behind a batch that never ends
+	NET_Batch (false);
+
+// shutting down runs ClientDisconnect, which must not be taken for a part
+// of a "pr_jit 2" check the error broke off
+	pr_jitcheck = JITCHECK_OFF;
 	
 	if (sv.active)
 		Host_ShutdownServer (false);
@@ -642,6 +650,7 @@ void _Host_Frame (float time)
 	static double		time2 = 0;
 	static double		time3 = 0;
 	int			pass1, pass2, pass3;
+	double		servertime;
 
 	if (setjmp (host_abortserver) )
 		return;			// something bad happened, or the server disconnected
@@ -678,7 +687,11 @@ void _Host_Frame (float time)
 	Host_GetConsoleCommands ();
 	
 	if (sv.active)
+	{
+		servertime = Sys_PreciseTime ();
 		Host_ServerFrame ();
+		SV_FrameStats (Sys_PreciseTime () - servertime);
+	}
 
 //-------------------
 //
@@ -699,6 +712,9 @@ void _Host_Frame (float time)
 		CL_ReadFromServer ();
 	}
 
+// run load testing bots, if any
+	CL_LoadGenFrame ();
+
 // update video
 	if (host_speeds.value)
 		time1 = Sys_FloatTime ();
@@ -868,11 +884,14 @@ void Host_Init (quakeparms_t *parms)
 	W_LoadWadFile ("gfx.wad");
 	Key_Init ();
 	Con_Init ();	
+	Jobs_Init ();
+	COM_InitPrefetch ();
 	M_Init ();	
 	PR_Init ();
 	Mod_Init ();
 	NET_Init ();
 	SV_Init ();
+	CL_InitLoadGen ();
 
 	Con_Printf ("Exe: "__TIME__" "__DATE__"\n");
 	Con_Printf ("%4.1f megabyte heap\n",parms->memsize/ (1024*1024.0));
@@ -917,6 +936,162 @@ void Host_Init (quakeparms_t *parms)
 }
 
 
+/*
+===============================================================================
+
+SERVER POOL
+
+-pool <count> with -dedicated and +map loads the map once and forks count
+servers from it, on the ports from -port up. Everything loaded before the
+fork is shared copy on write, so a server only costs the memory it changes,
+and starts without loading anything. The first process stays behind to
+start servers again that crash, from the map as it was loaded.
+
+===============================================================================
+*/
+
+#define	MAX_POOLSERVERS	64
+#define	MIN_POOLUPTIME	10		// a server that crashes sooner isn't started again
+
+typedef struct
+{
+	int			pid;			// 0 if not running
+	int			port;
+	double		starttime;
+} poolserver_t;
+
+static	poolserver_t	host_pool[MAX_POOLSERVERS];
+static	int				host_poolcount;
+
+/*
+===============
+Host_StartPoolServer
+
+Returns true in the new process
+===============
+*/
+static qboolean Host_StartPoolServer (int index)
+{
+	poolserver_t	*ps;
+	double			forktime;
+	int				pid;
+
+	ps = &host_pool[index];
+	forktime = Sys_FloatTime ();
+	pid = Sys_ForkServer ();
+	if (pid == -1)
+	{
+		Con_Printf ("pool: couldn't start the server for port %i\n", ps->port);
+		ps->pid = 0;
+		return false;
+	}
+
+	if (pid)
+	{
+		ps->pid = pid;
+		ps->starttime = forktime;
+		return false;
+	}
+
+// the new server, nothing of the others is left but memory
+	host_poolcount = 0;
+	srand ((unsigned)(Sys_PreciseTime () * 1000000.0) + index);
+
+	Jobs_Init ();
+	COM_StartPrefetch ();
+	Con_StartLog ();
+
+	Cmd_ExecuteString (va("port %i", ps->port), src_command);
+	Cmd_ExecuteString ("listen 1", src_command);
+
+	Con_Printf ("pool: server %i on port %i, accepting %.1f ms after the fork\n", index, ps->port, (Sys_FloatTime () - forktime) * 1000.0);
+	return true;
+}
+
+/*
+===============
+Host_RunPool
+
+Returns only in the forked servers, the supervisor exits when it is done
+===============
+*/
+void Host_RunPool (void)
+{
+	int				i, count, pid;
+	double			starttime;
+	qboolean		crashed;
+	poolserver_t	*ps;
+
+	i = COM_CheckParm ("-pool");
+	if (!i)
+		return;
+
+	count = i < com_argc-1 ? Q_atoi (com_argv[i+1]) : 0;
+	if (count < 1 || count > MAX_POOLSERVERS)
+		Sys_Error ("-pool needs a count from 1 to %i", MAX_POOLSERVERS);
+	if (cls.state != ca_dedicated)
+		Sys_Error ("-pool needs -dedicated");
+
+// run quake.rc and the command line now, to load the map everything shares
+	starttime = Sys_FloatTime ();
+	Cbuf_Execute ();
+	if (!sv.active)
+		Sys_Error ("-pool needs a +map");
+
+// the servers open their own ports and start their own threads
+	Cmd_ExecuteString ("listen 0", src_command);
+	COM_ShutdownPrefetch ();
+	Jobs_Shutdown ();
+	Con_StopLog ();
+
+	Con_Printf ("pool: %s loaded in %.1f s, servers on ports %i to %i\n", sv.name,
+		Sys_FloatTime () - starttime, net_hostport, net_hostport + count - 1);
+
+	host_poolcount = count;
+	for (i=0 ; i<count ; i++)
+	{
+		host_pool[i].port = net_hostport + i;
+		if (Host_StartPoolServer (i))
+			return;
+	}
+
+	while (1)
+	{
+		pid = Sys_WaitServer (&crashed);
+		if (!pid)
+			break;
+
+		for (i=0, ps=host_pool ; i<host_poolcount ; i++, ps++)
+			if (ps->pid == pid)
+				break;
+		if (i == host_poolcount)
+			continue;
+		ps->pid = 0;
+
+		if (!crashed)
+		{
+			Con_Printf ("pool: server on port %i quit\n", ps->port);
+			continue;
+		}
+		if (Sys_FloatTime () - ps->starttime < MIN_POOLUPTIME)
+		{
+			Con_Printf ("pool: server on port %i crashed right after the start, not starting it again\n", ps->port);
+			continue;
+		}
+
+		Con_Printf ("pool: server on port %i crashed, starting it again\n", ps->port);
+		if (Host_StartPoolServer (i))
+			return;
+	}
+
+	for (i=0, ps=host_pool ; i<host_poolcount ; i++, ps++)
+		if (ps->pid)
+			Sys_StopServer (ps->pid);
+
+	Sys_Quit ();
+}
+
+
 /*
 ===============
 Host_Shutdown
@@ -945,10 +1120,14 @@ void Host_Shutdown(void)
 	NET_Shutdown ();
 	S_Shutdown();
 	IN_Shutdown ();
+	COM_ShutdownPrefetch ();
+	Jobs_Shutdown ();
 
 	if (cls.state != ca_dedicated)
 	{
 		VID_Shutdown();
 	}
+
+	Con_StopLog ();
 }
 
@@ -269,6 +269,7 @@ void Host_Map_f (void)
 
 	key_dest = key_game;			// remove console or menu
 	SCR_BeginLoadingPlaque ();
+	cls.maploadstart = Sys_FloatTime ();
 
 	cls.mapstring[0] = 0;
 	for (i=0 ; i<Cmd_Argc() ; i++)
@@ -336,6 +337,7 @@ void Host_Changelevel_f (void)
 		startspot = _startspot;
 	}
 
+	cls.maploadstart = Sys_FloatTime ();
 	SV_SaveSpawnparms ();
 	SV_SpawnServer (level, startspot);
 #else
@@ -351,6 +353,7 @@ void Host_Changelevel_f (void)
 		Con_Printf ("Only the server may changelevel\n");
 		return;
 	}
+	cls.maploadstart = Sys_FloatTime ();
 	SV_SaveSpawnparms ();
 	strcpy (level, Cmd_Argv(1));
 	SV_SpawnServer (level);
@@ -694,6 +697,7 @@ void Host_Loadgame_f (void)
 	
 	sv.num_edicts = entnum;
 	sv.time = time;
+	ED_ResetFreeList ();
 
 	fclose (f);
 
@@ -854,6 +858,7 @@ int LoadGamestate(char *level, char *startspot)
 	
 //	sv.num_edicts = entnum;
 	sv.time = time;
+	ED_ResetFreeList ();
 	fclose (f);
 
 //	for (i=0 ; i<NUM_SPAWN_PARMS ; i++)
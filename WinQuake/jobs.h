@@ -0,0 +1,73 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs.h -- running loops on all cpu cores
+
+// Jobs_Run calls func (index, thread, arg) once for every index from 0 to
+// count-1, on the calling thread and the worker threads, and returns when all
+// the calls are done. thread is 0 for the calling thread and goes up to
+// Jobs_NumThreads () - 1, so it can be used to pick per-thread scratch data.
+// Calls can come in any order, so func must only write data of its own index
+// or thread. Only the main thread may call Jobs_Run, and func may not call it.
+
+void Jobs_Init (void);
+void Jobs_Shutdown (void);
+
+int Jobs_NumThreads (void);
+
+void Jobs_Run (void (*func)(int index, int thread, void *arg), int count, void *arg);
+
+// Jobs_RunGraph calls func (arg) of every node once, after the nodes in its
+// deps bits are done. Nodes that don't depend on each other run at the same
+// time, in batches of Jobs_Run.
+
+#define	MAX_GRAPHJOBS	32
+
+typedef struct
+{
+	void		(*func)(void *arg);
+	void		*arg;
+	unsigned	deps;		// bit i - node i of the same array runs first
+} jobnode_t;
+
+void Jobs_RunGraph (jobnode_t *nodes, int count);
+
+// threads of their own, for work that runs in the background for a long time,
+// like loading. A semaphore wakes the thread up when there is work for it,
+// a mutex guards the data it shares with the main thread.
+
+void *Jobs_CreateThread (int (*func)(void *arg), char *name, void *arg);
+void Jobs_WaitThread (void *thread);
+
+void *Jobs_CreateSemaphore (void);
+void Jobs_DestroySemaphore (void *sem);
+void Jobs_SemaphorePost (void *sem);
+void Jobs_SemaphoreWait (void *sem);
+
+void *Jobs_CreateMutex (void);
+void Jobs_DestroyMutex (void *mutex);
+void Jobs_LockMutex (void *mutex);
+void Jobs_UnlockMutex (void *mutex);
+
+// for counters shared by exactly one writer and one reader, like the index
+// of a ring buffer. Get sees everything written before the matching Set.
+
+int Jobs_AtomicGet (int *p);
+void Jobs_AtomicSet (int *p, int value);
@@ -0,0 +1,327 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs_sdl.c -- worker threads for Jobs_Run
+
+#include <SDL.h>
+
+#include "quakedef.h"
+
+#define	MAX_JOBTHREADS	16
+
+static int			jobs_numworkers;
+static SDL_Thread	*jobs_workers[MAX_JOBTHREADS];
+
+static SDL_mutex	*jobs_mutex;
+static SDL_cond		*jobs_startcond;	// signaled when a new batch is started
+static SDL_cond		*jobs_donecond;		// signaled when the last worker leaves a batch
+
+// current batch, changed only with all workers waiting
+static void			(*jobs_func)(int index, int thread, void *arg);
+static void			*jobs_arg;
+static int			jobs_count;
+static SDL_atomic_t	jobs_nextindex;
+
+static int			jobs_generation;	// incremented for every batch
+static int			jobs_busyworkers;	// workers still in the current batch
+static qboolean		jobs_quit;
+
+
+static void Jobs_Work (int thread)
+{
+	int		index;
+
+	while ((index = SDL_AtomicAdd (&jobs_nextindex, 1)) < jobs_count)
+		jobs_func (index, thread, jobs_arg);
+}
+
+
+static int SDLCALL Jobs_WorkerThread (void *data)
+{
+	int		thread;
+	int		generation;
+
+	thread = (int)(intptr_t)data;
+	generation = 0;
+
+	SDL_LockMutex (jobs_mutex);
+	while (1)
+	{
+		while (generation == jobs_generation && !jobs_quit)
+			SDL_CondWait (jobs_startcond, jobs_mutex);
+		if (jobs_quit)
+			break;
+		generation = jobs_generation;
+		SDL_UnlockMutex (jobs_mutex);
+
+		Jobs_Work (thread);
+
+		SDL_LockMutex (jobs_mutex);
+		if (--jobs_busyworkers == 0)
+			SDL_CondSignal (jobs_donecond);
+	}
+	SDL_UnlockMutex (jobs_mutex);
+
+	return 0;
+}
+
+
+/*
+================
+Jobs_Init
+
+Starts a worker for every cpu core but the one of the main thread.
+-threads <n> sets the total number of threads, 1 runs everything serially.
+================
+*/
+void Jobs_Init (void)
+{
+	int		i, numthreads;
+
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc-1)
+		numthreads = Q_atoi (com_argv[i+1]);
+	else
+		numthreads = SDL_GetCPUCount ();
+
+	jobs_numworkers = numthreads - 1;
+	if (jobs_numworkers < 0)
+		jobs_numworkers = 0;
+	if (jobs_numworkers > MAX_JOBTHREADS)
+		jobs_numworkers = MAX_JOBTHREADS;
+
+	if (!jobs_numworkers)
+		return;
+
+	jobs_mutex = SDL_CreateMutex ();
+	jobs_startcond = SDL_CreateCond ();
+	jobs_donecond = SDL_CreateCond ();
+	if (!jobs_mutex || !jobs_startcond || !jobs_donecond)
+		Sys_Error ("Jobs_Init: %s", SDL_GetError ());
+
+	jobs_generation = 0;
+	jobs_quit = false;
+	for (i=0 ; i<jobs_numworkers ; i++)
+	{
+		jobs_workers[i] = SDL_CreateThread (Jobs_WorkerThread, "quake worker", (void *)(intptr_t)(i+1));
+		if (!jobs_workers[i])
+		{
+			Con_Printf ("Unable to start worker thread: %s\n", SDL_GetError ());
+			break;
+		}
+	}
+	jobs_numworkers = i;
+
+	Con_Printf ("%i worker threads\n", jobs_numworkers);
+}
+
+
+/*
+================
+Jobs_Shutdown
+================
+*/
+void Jobs_Shutdown (void)
+{
+	int		i;
+
+	if (!jobs_mutex)
+		return;
+
+	SDL_LockMutex (jobs_mutex);
+	jobs_quit = true;
+	SDL_CondBroadcast (jobs_startcond);
+	SDL_UnlockMutex (jobs_mutex);
+
+	for (i=0 ; i<jobs_numworkers ; i++)
+		SDL_WaitThread (jobs_workers[i], NULL);
+	jobs_numworkers = 0;
+
+	SDL_DestroyCond (jobs_donecond);
+	SDL_DestroyCond (jobs_startcond);
+	SDL_DestroyMutex (jobs_mutex);
+	jobs_mutex = NULL;
+}
+
+
+int Jobs_NumThreads (void)
+{
+	return jobs_numworkers + 1;
+}
+
+
+/*
+================
+Jobs_Run
+================
+*/
+void Jobs_Run (void (*func)(int index, int thread, void *arg), int count, void *arg)
+{
+	int		i;
+
+	if (count <= 0)
+		return;
+
+	if (!jobs_numworkers || count == 1)
+	{
+		for (i=0 ; i<count ; i++)
+			func (i, 0, arg);
+		return;
+	}
+
+	SDL_LockMutex (jobs_mutex);
+	jobs_func = func;
+	jobs_arg = arg;
+	jobs_count = count;
+	SDL_AtomicSet (&jobs_nextindex, 0);
+	jobs_busyworkers = jobs_numworkers;
+	jobs_generation++;
+	SDL_CondBroadcast (jobs_startcond);
+	SDL_UnlockMutex (jobs_mutex);
+
+	Jobs_Work (0);
+
+	SDL_LockMutex (jobs_mutex);
+	while (jobs_busyworkers)
+		SDL_CondWait (jobs_donecond, jobs_mutex);
+	SDL_UnlockMutex (jobs_mutex);
+}
+
+
+static void Jobs_RunGraphNode (int index, int thread, void *arg)
+{
+	jobnode_t	**ready;
+
+	ready = arg;
+	ready[index]->func (ready[index]->arg);
+}
+
+/*
+================
+Jobs_RunGraph
+
+Runs the graph level by level, every batch has all the nodes whose
+dependencies are done
+================
+*/
+void Jobs_RunGraph (jobnode_t *nodes, int count)
+{
+	jobnode_t	*ready[MAX_GRAPHJOBS];
+	unsigned	done, all;
+	int			i, numready;
+
+	if (count > MAX_GRAPHJOBS)
+		Sys_Error ("Jobs_RunGraph: %i nodes", count);
+
+	all = count == 32 ? ~0u : (1u << count) - 1;
+	done = 0;
+	while (done != all)
+	{
+		numready = 0;
+		for (i=0 ; i<count ; i++)
+			if (!(done & (1u << i)) && !(nodes[i].deps & ~done))
+				ready[numready++] = &nodes[i];
+		if (!numready)
+			Sys_Error ("Jobs_RunGraph: dependency cycle");
+
+		Jobs_Run (Jobs_RunGraphNode, numready, ready);
+
+		for (i=0 ; i<numready ; i++)
+			done |= 1u << (ready[i] - nodes);
+	}
+}
+
+
+//=============================================================================
+
+void *Jobs_CreateThread (int (*func)(void *arg), char *name, void *arg)
+{
+	SDL_Thread	*thread;
+
+	thread = SDL_CreateThread (func, name, arg);
+	if (!thread)
+		Con_Printf ("Unable to start %s thread: %s\n", name, SDL_GetError ());
+	return thread;
+}
+
+void Jobs_WaitThread (void *thread)
+{
+	SDL_WaitThread (thread, NULL);
+}
+
+void *Jobs_CreateSemaphore (void)
+{
+	SDL_sem		*sem;
+
+	sem = SDL_CreateSemaphore (0);
+	if (!sem)
+		Sys_Error ("Jobs_CreateSemaphore: %s", SDL_GetError ());
+	return sem;
+}
+
+void Jobs_DestroySemaphore (void *sem)
+{
+	SDL_DestroySemaphore (sem);
+}
+
+void Jobs_SemaphorePost (void *sem)
+{
+	SDL_SemPost (sem);
+}
+
+void Jobs_SemaphoreWait (void *sem)
+{
+	SDL_SemWait (sem);
+}
+
+void *Jobs_CreateMutex (void)
+{
+	SDL_mutex	*mutex;
+
+	mutex = SDL_CreateMutex ();
+	if (!mutex)
+		Sys_Error ("Jobs_CreateMutex: %s", SDL_GetError ());
+	return mutex;
+}
+
+void Jobs_DestroyMutex (void *mutex)
+{
+	SDL_DestroyMutex (mutex);
+}
+
+void Jobs_LockMutex (void *mutex)
+{
+	SDL_LockMutex (mutex);
+}
+
+void Jobs_UnlockMutex (void *mutex)
+{
+	SDL_UnlockMutex (mutex);
+}
+
+int Jobs_AtomicGet (int *p)
+{
+	return SDL_AtomicGet ((SDL_atomic_t *)p);
+}
+
+void Jobs_AtomicSet (int *p, int value)
+{
+	SDL_AtomicSet ((SDL_atomic_t *)p, value);
+}
@@ -3041,12 +3041,7 @@ void M_Draw (void)
 		scr_copyeverything = 1;
 
 		if (scr_con_current)
-		{
 			Draw_ConsoleBackground (vid.height);
-			VID_UnlockBuffer ();
-			S_ExtraUpdate ();
-			VID_LockBuffer ();
-		}
 		else
 			Draw_FadeScreen ();
 
@@ -3140,10 +3135,6 @@ void M_Draw (void)
 		S_LocalSound ("misc/menu2.wav");
 		m_entersound = false;
 	}
-
-	VID_UnlockBuffer ();
-	S_ExtraUpdate ();
-	VID_LockBuffer ();
 }
 
 
@@ -0,0 +1,415 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// mod_cache.c -- on-disk cache of data derived from brush models
+
+#include "quakedef.h"
+
+#define	MAX_PVS_SIZE	(16*1024*1024)	// bigger maps decompress vis every time
+
+cvar_t	mod_cache = {"mod_cache", "1"};		// 0 - don't read or write cache files
+
+typedef struct
+{
+	short		texturemins[2];
+	short		extents[2];
+} dsurfextents_t;
+
+
+/*
+===============
+Mod_InitCache
+===============
+*/
+void Mod_InitCache (void)
+{
+	Cvar_RegisterVariable (&mod_cache);
+}
+
+
+static unsigned Mod_Checksum (byte *data, int size)
+{
+	unsigned	sum;
+	int			i;
+
+	// fnv-1a, 4 bytes at a time, bsp files are big
+	sum = 2166136261u;
+	for (i=0 ; i + 4 <= size ; i += 4)
+		sum = (sum ^ *(unsigned *)(data + i)) * 16777619u;
+	for ( ; i<size ; i++)
+		sum = (sum ^ data[i]) * 16777619u;
+
+	return sum;
+}
+
+/*
+===============
+Mod_BrushChecksum
+
+Of the whole bsp file, the header lumps must already be swapped
+===============
+*/
+unsigned Mod_BrushChecksum (dheader_t *header)
+{
+	int		i, size;
+
+	size = sizeof(*header);
+	for (i=0 ; i<HEADER_LUMPS ; i++)
+	{
+		if (header->lumps[i].fileofs + header->lumps[i].filelen > size)
+			size = header->lumps[i].fileofs + header->lumps[i].filelen;
+	}
+
+	return Mod_Checksum ((byte *)header, size);
+}
+
+
+/*
+===============
+Mod_CachePath
+
+Returns false if the path, or the temporary file name made from it, would
+not fit in MAX_OSPATH
+===============
+*/
+static qboolean Mod_CachePath (model_t *model, char *path)
+{
+	char	name[MAX_QPATH];
+
+	COM_StripExtension (model->name, name);
+	if (Q_strlen (com_gamedir) + Q_strlen (name) + sizeof("/cache/.bsc.tmp") > MAX_OSPATH)
+	{
+		Con_DPrintf ("%s: cache path too long\n", model->name);
+		return false;
+	}
+	sprintf (path, "%s/cache/%s.bsc", com_gamedir, name);
+	return true;
+}
+
+/*
+===============
+Mod_OpenCache
+
+Reads the cache file of the model in one go and checks it. The model
+checksum must be set.
+===============
+*/
+void Mod_OpenCache (modcache_t *mc, model_t *model)
+{
+	char		path[MAX_OSPATH];
+	FILE		*f;
+	int			i, size;
+	dmodcache_t	*header;
+
+	memset (mc, 0, sizeof(*mc));
+	mc->model = model;
+	mc->starttime = Sys_FloatTime ();
+
+	if (!mod_cache.value)
+		return;
+
+	if (!Mod_CachePath (model, path))
+		return;
+	f = fopen (path, "rb");
+	if (!f)
+		return;
+
+	fseek (f, 0, SEEK_END);
+	size = ftell (f);
+	fseek (f, 0, SEEK_SET);
+
+	if (size < sizeof(dmodcache_t))
+	{
+		fclose (f);
+		return;
+	}
+
+	mc->data = malloc (size);
+	if (!mc->data || fread (mc->data, 1, size, f) != size)
+	{
+		fclose (f);
+		free (mc->data);
+		mc->data = NULL;
+		return;
+	}
+	fclose (f);
+
+	header = (dmodcache_t *)mc->data;
+	if (memcmp (header->id, "QBSC", 4) || header->version != MODCACHE_VERSION
+		|| header->bspchecksum != model->checksum
+		|| header->checksum != Mod_Checksum (mc->data + sizeof(*header), size - sizeof(*header)))
+	{
+		Con_DPrintf ("%s: stale cache file\n", model->name);
+		free (mc->data);
+		mc->data = NULL;
+		return;
+	}
+
+	for (i=0 ; i<MCL_NUMLUMPS ; i++)
+	{
+		if (header->lumps[i].fileofs < sizeof(*header) || header->lumps[i].filelen < 0
+			|| header->lumps[i].fileofs + header->lumps[i].filelen > size
+			|| (header->lumps[i].fileofs & 3))
+		{
+			Con_DPrintf ("%s: bad cache file\n", model->name);
+			free (mc->data);
+			mc->data = NULL;
+			return;
+		}
+	}
+}
+
+/*
+===============
+Mod_CacheLump
+
+Returns NULL if the lump is not in the cache
+===============
+*/
+void *Mod_CacheLump (modcache_t *mc, int lump, int *size)
+{
+	dmodcache_t	*header;
+
+	if (!mc->data)
+		return NULL;
+
+	header = (dmodcache_t *)mc->data;
+	if (!header->lumps[lump].filelen)
+		return NULL;
+
+	mc->used++;
+	*size = header->lumps[lump].filelen;
+	return mc->data + header->lumps[lump].fileofs;
+}
+
+/*
+===============
+Mod_SetCacheLump
+
+The data is copied, the file is written by Mod_CloseCache
+===============
+*/
+void Mod_SetCacheLump (modcache_t *mc, int lump, void *data, int size)
+{
+	free (mc->newlumps[lump]);
+
+	mc->newlumps[lump] = malloc (size);
+	if (!mc->newlumps[lump])
+		return;		// not worth an error, it's only the cache
+	memcpy (mc->newlumps[lump], data, size);
+	mc->newsizes[lump] = size;
+	mc->rebuilt++;
+}
+
+/*
+===============
+Mod_CloseCache
+
+Writes the file again if any lump was rebuilt, keeping the valid lumps
+of the old file
+===============
+*/
+void Mod_CloseCache (modcache_t *mc)
+{
+	char		path[MAX_OSPATH], temppath[MAX_OSPATH];
+	FILE		*f;
+	int			i, size, ofs, len;
+	byte		*buf, *src;
+	dmodcache_t	*header, *oldheader;
+	qboolean	write;
+
+	Con_DPrintf ("%s: %i cached lumps used, %i rebuilt, %.1f ms\n", mc->model->name,
+		mc->used, mc->rebuilt, (Sys_FloatTime () - mc->starttime) * 1000.0);
+
+	write = false;
+	for (i=0 ; i<MCL_NUMLUMPS ; i++)
+		if (mc->newlumps[i])
+			write = true;
+
+	if (write && mod_cache.value && Mod_CachePath (mc->model, path))
+	{
+		oldheader = (dmodcache_t *)mc->data;
+
+		size = sizeof(*header);
+		for (i=0 ; i<MCL_NUMLUMPS ; i++)
+		{
+			if (mc->newlumps[i])
+				size += (mc->newsizes[i] + 3) & ~3;
+			else if (oldheader)
+				size += (oldheader->lumps[i].filelen + 3) & ~3;
+		}
+
+		buf = malloc (size);
+		if (buf)
+		{
+			memset (buf, 0, size);
+			header = (dmodcache_t *)buf;
+			memcpy (header->id, "QBSC", 4);
+			header->version = MODCACHE_VERSION;
+			header->bspchecksum = mc->model->checksum;
+
+			ofs = sizeof(*header);
+			for (i=0 ; i<MCL_NUMLUMPS ; i++)
+			{
+				if (mc->newlumps[i])
+				{
+					src = mc->newlumps[i];
+					len = mc->newsizes[i];
+				}
+				else if (oldheader)
+				{
+					src = mc->data + oldheader->lumps[i].fileofs;
+					len = oldheader->lumps[i].filelen;
+				}
+				else
+				{
+					src = NULL;
+					len = 0;
+				}
+
+				header->lumps[i].fileofs = ofs;
+				header->lumps[i].filelen = len;
+				if (len)
+					memcpy (buf + ofs, src, len);
+				ofs += (len + 3) & ~3;
+			}
+			header->checksum = Mod_Checksum (buf + sizeof(*header), size - sizeof(*header));
+
+			// write a temporary file first, so other processes loading
+			// the same map never see a half written one
+			sprintf (temppath, "%s.tmp", path);
+			COM_CreatePath (temppath);
+			f = fopen (temppath, "wb");
+			if (f)
+			{
+				len = fwrite (buf, 1, size, f);
+				fclose (f);
+				if (len == size)
+				{
+					remove (path);
+					rename (temppath, path);
+				}
+				else
+					remove (temppath);
+			}
+			free (buf);
+		}
+	}
+
+	for (i=0 ; i<MCL_NUMLUMPS ; i++)
+		free (mc->newlumps[i]);
+	free (mc->data);
+	memset (mc, 0, sizeof(*mc));
+}
+
+//=============================================================================
+
+/*
+===============
+Mod_CachedSurfaceExtents
+
+Returns false if the extents have to be calculated
+===============
+*/
+qboolean Mod_CachedSurfaceExtents (modcache_t *mc, model_t *model)
+{
+	dsurfextents_t	*in;
+	msurface_t		*out;
+	int				i, size;
+
+	in = Mod_CacheLump (mc, MCL_EXTENTS, &size);
+	if (!in || size != model->numsurfaces * sizeof(*in))
+		return false;
+
+	for (i=0, out=model->surfaces ; i<model->numsurfaces ; i++, in++, out++)
+	{
+		out->texturemins[0] = in->texturemins[0];
+		out->texturemins[1] = in->texturemins[1];
+		out->extents[0] = in->extents[0];
+		out->extents[1] = in->extents[1];
+	}
+
+	return true;
+}
+
+/*
+===============
+Mod_CacheSurfaceExtents
+===============
+*/
+void Mod_CacheSurfaceExtents (modcache_t *mc, model_t *model)
+{
+	dsurfextents_t	*extents, *out;
+	msurface_t		*in;
+	int				i;
+
+	extents = malloc (model->numsurfaces * sizeof(*extents));
+	if (!extents)
+		return;
+
+	for (i=0, in=model->surfaces, out=extents ; i<model->numsurfaces ; i++, in++, out++)
+	{
+		out->texturemins[0] = in->texturemins[0];
+		out->texturemins[1] = in->texturemins[1];
+		out->extents[0] = in->extents[0];
+		out->extents[1] = in->extents[1];
+	}
+
+	Mod_SetCacheLump (mc, MCL_EXTENTS, extents, model->numsurfaces * sizeof(*extents));
+	free (extents);
+}
+
+/*
+===============
+Mod_BuildPVS
+
+Decompresses the visibility of all the leafs for Mod_LeafPVS. numleafs
+must already be the number of visible leafs of the world.
+===============
+*/
+void Mod_BuildPVS (modcache_t *mc, model_t *model)
+{
+	int		i, row, size, cachedsize;
+	byte	*cached;
+
+	model->pvs = NULL;
+
+	if (!model->visdata)
+		return;
+
+	row = (model->numleafs+7)>>3;
+	size = row * model->numleafs;
+	if (size <= 0 || size > MAX_PVS_SIZE)
+		return;
+
+	model->pvs = Hunk_AllocName (size, "pvs");
+
+	cached = Mod_CacheLump (mc, MCL_PVS, &cachedsize);
+	if (cached && cachedsize == size)
+	{
+		memcpy (model->pvs, cached, size);
+		return;
+	}
+
+	for (i=0 ; i<model->numleafs ; i++)
+		memcpy (model->pvs + i*row, Mod_DecompressVis (model->leafs[i+1].compressed_vis, model), row);
+
+	Mod_SetCacheLump (mc, MCL_PVS, model->pvs, size);
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// mod_cache.h -- on-disk cache of data derived from brush models
+
+// Every bsp gets a <gamedir>/cache/<name>.bsc file with the data that is
+// otherwise rebuilt on each load. The file is only used if it was made from
+// a bsp with the same checksum by the same MODCACHE_VERSION, lumps that are
+// missing or don't fit are rebuilt and the file is written again.
+// Renderers keep their own lumps in the same file.
+
+#define	MODCACHE_VERSION	1
+
+#define	MCL_EXTENTS		0		// texturemins and extents of every surface
+#define	MCL_PVS			1		// decompressed visibility of every leaf
+#define	MCL_LIGHTMAPS	2		// gl lightmap blocks of every surface
+#define	MCL_POLYS		3		// gl surface polygons
+#define	MCL_NUMLUMPS	4
+
+typedef struct
+{
+	char		id[4];			// "QBSC"
+	int			version;
+	unsigned	bspchecksum;
+	unsigned	checksum;		// of everything after the header
+	lump_t		lumps[MCL_NUMLUMPS];
+} dmodcache_t;
+
+typedef struct
+{
+	model_t		*model;
+	byte		*data;			// the whole file, NULL if missing or stale
+	byte		*newlumps[MCL_NUMLUMPS];	// rebuilt during this load
+	int			newsizes[MCL_NUMLUMPS];
+	int			used, rebuilt;
+	double		starttime;
+} modcache_t;
+
+void	Mod_InitCache (void);
+
+unsigned Mod_BrushChecksum (dheader_t *header);
+
+void	Mod_OpenCache (modcache_t *mc, model_t *model);
+void	*Mod_CacheLump (modcache_t *mc, int lump, int *size);
+void	Mod_SetCacheLump (modcache_t *mc, int lump, void *data, int size);
+void	Mod_CloseCache (modcache_t *mc);
+
+qboolean Mod_CachedSurfaceExtents (modcache_t *mc, model_t *model);
+void	Mod_CacheSurfaceExtents (modcache_t *mc, model_t *model);
+void	Mod_BuildPVS (modcache_t *mc, model_t *model);
+
+byte	*Mod_DecompressVis (byte *in, model_t *model);
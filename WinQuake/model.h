@@ -163,10 +163,21 @@ typedef struct mleaf_s
 	byte		ambient_sound_level[NUM_AMBIENTS];
 } mleaf_t;
 
+// a clipnode with its plane, what the tracer reads, 32 bytes aligned
+typedef struct
+{
+	vec3_t		normal;
+	float		dist;
+	int			type;			// of the plane, < 3 is axial
+	int			children[2];	// negative numbers are contents
+	int			pad;
+} mclipnode_t;
+
 typedef struct
 {
 	dclipnode_t	*clipnodes;
 	mplane_t	*planes;
+	mclipnode_t	*nodes;			// clipnodes and planes packed together
 	int			firstclipnode;
 	int			lastclipnode;
 	vec3_t		clip_mins;
@@ -357,6 +368,9 @@ typedef struct model_s
 	byte		*lightdata;
 	char		*entities;
 
+	byte		*pvs;			// decompressed visdata, NULL if too big
+	unsigned	checksum;		// of the bsp file, for the cache
+
 //
 // additional model data
 //
@@ -371,6 +385,7 @@ void	Mod_ClearAll (void);
 model_t *Mod_ForName (char *name, qboolean crash);
 void	*Mod_Extradata (model_t *mod);	// handles caching
 void	Mod_TouchModel (char *name);
+void	Mod_Prefetch (char *name);
 
 mleaf_t *Mod_PointInLeaf (float *p, model_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, model_t *model);
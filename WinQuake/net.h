@@ -42,6 +42,17 @@ struct qsockaddr
 #define NETFLAG_UNRELIABLE	0x00100000
 #define NETFLAG_CTL			0x80000000
 
+// Reliable messages are split into at most this many MAX_DATAGRAM fragments
+#define NET_MAXFRAGMENTS	((NET_MAXMESSAGE + MAX_DATAGRAM - 1) / MAX_DATAGRAM)
+
+// Optional connection flags, appended to CCREQ_CONNECT by the client and
+// echoed back in CCREP_ACCEPT by a server that supports them, each time
+// after NET_CONNECTMAGIC. Old peers never read or write the extra bytes.
+// ProQuake puts its mod byte (1 for ProQuake itself) in the same place,
+// the magic byte keeps the flags from being taken for one or the other.
+#define NET_CONNECTMAGIC			0xa7
+#define NET_CONNECTFLAG_WINDOWED	0x01
+
 
 #define NET_PROTOCOL_VERSION	3
 
@@ -57,6 +68,8 @@ struct qsockaddr
 // CCREQ_CONNECT
 //		string	game_name				"QUAKE"
 //		byte	net_protocol_version	NET_PROTOCOL_VERSION
+//		byte	connect_magic			(optional) NET_CONNECTMAGIC
+//		byte	connect_flags			(optional) NET_CONNECTFLAG_*
 //
 // CCREQ_SERVER_INFO
 //		string	game_name				"QUAKE"
@@ -72,6 +85,8 @@ struct qsockaddr
 //
 // CCREP_ACCEPT
 //		long	port
+//		byte	connect_magic	NET_CONNECTMAGIC, only if the request contained it
+//		byte	connect_flags	(only if the request contained them)
 //
 // CCREP_REJECT
 //		string	reason
@@ -147,6 +162,20 @@ typedef struct qsocket_s
 	struct qsockaddr	addr;
 	char				address[NET_NAMELEN];
 
+	// sliding window reliable transport, used if both peers agreed on it
+	// while connecting. All fragments of sendMessage may be in flight at once,
+	// each one is acknowledged separately and retransmitted on its own timer.
+	qboolean		windowed;
+	unsigned int	sendMessageSequence;	// sequence of the first fragment of sendMessage
+	int				sendFragmentCount;
+	int				sendFragmentTries[NET_MAXFRAGMENTS];	// 0 - not sent yet, -1 - acknowledged
+	double			sendFragmentTime[NET_MAXFRAGMENTS];
+	qboolean		receiveFragments[NET_MAXFRAGMENTS];
+	int				receiveFragmentCount;	// 0 until the EOM fragment arrives
+	double			rtt;					// smoothed round trip time, 0 if not measured yet
+	double			rttVariance;
+	double			retransmitTime;
+
 } qsocket_t;
 
 extern qsocket_t	*net_activeSockets;
@@ -176,6 +205,7 @@ typedef struct
 	int			(*AddrCompare) (struct qsockaddr *addr1, struct qsockaddr *addr2);
 	int			(*GetSocketPort) (struct qsockaddr *addr);
 	int			(*SetSocketPort) (struct qsockaddr *addr, int port);
+	void		(*Batch) (qboolean state);	// optional
 } net_landriver_t;
 
 #define	MAX_NET_DRIVERS		8
@@ -199,6 +229,7 @@ typedef struct
 	void		(*Close) (qsocket_t *sock);
 	void		(*Shutdown) (void);
 	int			controlSock;
+	void		(*Batch) (qboolean state);	// optional
 } net_driver_t;
 
 extern int			net_numdrivers;
@@ -310,6 +341,10 @@ void		NET_Close (struct qsocket_s *sock);
 
 void NET_Poll(void);
 
+void NET_Batch (qboolean state);
+// While batching is on, drivers may queue outgoing packets and send them
+// together. Turning it off flushes the queued packets.
+
 
 typedef struct _PollProcedure
 {
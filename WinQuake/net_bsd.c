@@ -56,7 +56,9 @@ net_driver_t net_drivers[MAX_NET_DRIVERS] =
 	Datagram_CanSendMessage,
 	Datagram_CanSendUnreliableMessage,
 	Datagram_Close,
-	Datagram_Shutdown
+	Datagram_Shutdown,
+	0,
+	Datagram_Batch
 	}
 };
 
@@ -87,7 +89,8 @@ net_landriver_t	net_landrivers[MAX_NET_DRIVERS] =
 	UDP_GetAddrFromName,
 	UDP_AddrCompare,
 	UDP_GetSocketPort,
-	UDP_SetSocketPort
+	UDP_SetSocketPort,
+	UDP_Batch
 	}
 };
 
@@ -72,6 +72,8 @@ int droppedDatagrams;
 
 static int myDriverLevel;
 
+cvar_t	net_windowed = {"net_windowed", "1"};
+
 struct
 {
 	unsigned int	length;
@@ -159,6 +161,250 @@ void NET_Ban_f (void)
 #endif
 
 
+/*
+=============================================================================
+
+SLIDING WINDOW RELIABLE TRANSPORT
+
+Used instead of the stop-and-wait scheme when both peers agreed on
+NET_CONNECTFLAG_WINDOWED while connecting. All fragments of a reliable
+message are sent at once, the receiver acknowledges each one separately and
+reassembles them in any order. Every fragment is resent when its own timer,
+derived from the measured round trip time, expires.
+The packet format is the same, so old peers just never enable it.
+
+=============================================================================
+*/
+
+#define NET_MIN_RETRANSMIT_TIME	0.05
+#define NET_MAX_RETRANSMIT_TIME	1.0
+
+static int Window_SendFragment (qsocket_t *sock, int fragment)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+	int				offset;
+
+	offset = fragment * MAX_DATAGRAM;
+	if (fragment == sock->sendFragmentCount - 1)
+	{
+		dataLen = sock->sendMessageLength - offset;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendMessageSequence + fragment);
+	Q_memcpy (packetBuffer.data, sock->sendMessage + offset, dataLen);
+
+	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	if (sock->sendFragmentTries[fragment] == 0)
+		packetsSent++;
+	else
+		packetsReSent++;
+	sock->sendFragmentTries[fragment]++;
+	sock->sendFragmentTime[fragment] = net_time;
+	sock->lastSendTime = net_time;
+	return 1;
+}
+
+
+/*
+==================
+Window_Transmit
+
+Sends fragments never sent before and resends unacknowledged fragments whose
+timer expired. Backs off the retransmit time if anything was resent.
+==================
+*/
+static int Window_Transmit (qsocket_t *sock)
+{
+	int			i;
+	qboolean	resent;
+
+	resent = false;
+	for (i = 0; i < sock->sendFragmentCount; i++)
+	{
+		if (sock->sendFragmentTries[i] == -1)
+			continue;
+		if (sock->sendFragmentTries[i] > 0)
+		{
+			if ((net_time - sock->sendFragmentTime[i]) < sock->retransmitTime)
+				continue;
+			resent = true;
+		}
+		if (Window_SendFragment (sock, i) == -1)
+			return -1;
+	}
+
+	if (resent)
+	{
+		sock->retransmitTime *= 2.0;
+		if (sock->retransmitTime > NET_MAX_RETRANSMIT_TIME)
+			sock->retransmitTime = NET_MAX_RETRANSMIT_TIME;
+	}
+	return 1;
+}
+
+
+static int Window_SendMessage (qsocket_t *sock)
+{
+	int		i;
+
+	sock->sendMessageSequence = sock->sendSequence;
+	sock->sendFragmentCount = (sock->sendMessageLength + MAX_DATAGRAM - 1) / MAX_DATAGRAM;
+	sock->sendSequence += sock->sendFragmentCount;
+	for (i = 0; i < sock->sendFragmentCount; i++)
+		sock->sendFragmentTries[i] = 0;
+
+	sock->canSend = false;
+
+	return Window_Transmit (sock);
+}
+
+
+// standard smoothed round trip time estimation, as TCP does it
+static void Window_UpdateRTT (qsocket_t *sock, double sample)
+{
+	if (sample < 0.001)
+		sample = 0.001;
+
+	if (sock->rtt == 0.0)
+	{
+		sock->rtt = sample;
+		sock->rttVariance = sample * 0.5;
+	}
+	else
+	{
+		sock->rttVariance = 0.75 * sock->rttVariance + 0.25 * fabs (sock->rtt - sample);
+		sock->rtt = 0.875 * sock->rtt + 0.125 * sample;
+	}
+
+	sock->retransmitTime = sock->rtt + 4.0 * sock->rttVariance;
+	if (sock->retransmitTime < NET_MIN_RETRANSMIT_TIME)
+		sock->retransmitTime = NET_MIN_RETRANSMIT_TIME;
+	if (sock->retransmitTime > NET_MAX_RETRANSMIT_TIME)
+		sock->retransmitTime = NET_MAX_RETRANSMIT_TIME;
+}
+
+
+static void Window_ReceiveAck (qsocket_t *sock, unsigned int sequence)
+{
+	unsigned int	fragment;
+
+	fragment = sequence - sock->sendMessageSequence;
+	if (fragment >= (unsigned int)sock->sendFragmentCount)
+	{
+		Con_DPrintf("Stale ACK received\n");
+		return;
+	}
+	if (sock->sendFragmentTries[fragment] == -1)
+	{
+		Con_DPrintf("Duplicate ACK received\n");
+		return;
+	}
+
+	// resent fragments give ambiguous samples, so skip them
+	if (sock->sendFragmentTries[fragment] == 1)
+		Window_UpdateRTT (sock, net_time - sock->sendFragmentTime[fragment]);
+	sock->sendFragmentTries[fragment] = -1;
+
+	while (sock->ackSequence != sock->sendSequence &&
+		sock->sendFragmentTries[sock->ackSequence - sock->sendMessageSequence] == -1)
+		sock->ackSequence++;
+
+	if (sock->ackSequence == sock->sendSequence)
+	{
+		sock->sendFragmentCount = 0;
+		sock->sendMessageLength = 0;
+		sock->canSend = true;
+	}
+}
+
+
+/*
+==================
+Window_ReceiveFragment
+
+Places the fragment into receiveMessage. All fragments except the last one
+have MAX_DATAGRAM size, so the position is known from the sequence.
+Returns -1 if the fragment was dropped and must not be acknowledged, 1 if it
+completed the message into net_message, else 0.
+==================
+*/
+static int Window_ReceiveFragment (qsocket_t *sock, unsigned int sequence, unsigned int flags, byte *data, int length)
+{
+	unsigned int	fragment;
+	int				offset;
+	int				i;
+
+	if (length < 0 || length > MAX_DATAGRAM)
+	{
+		shortPacketCount++;
+		return -1;
+	}
+
+	// duplicates are acknowledged again, the first ack may have been lost
+	if (sequence < sock->receiveSequence)
+	{
+		receivedDuplicateCount++;
+		return 0;
+	}
+
+	fragment = sequence - sock->receiveSequence;
+	if (fragment >= NET_MAXFRAGMENTS)
+	{
+		Con_DPrintf("Fragment out of window\n");
+		return -1;
+	}
+	if (sock->receiveFragments[fragment])
+	{
+		receivedDuplicateCount++;
+		return 0;
+	}
+	if (!(flags & NETFLAG_EOM) && length != MAX_DATAGRAM)
+	{
+		shortPacketCount++;
+		return -1;
+	}
+
+	offset = fragment * MAX_DATAGRAM;
+	Q_memcpy (sock->receiveMessage + offset, data, length);
+	sock->receiveFragments[fragment] = true;
+
+	if (flags & NETFLAG_EOM)
+	{
+		sock->receiveFragmentCount = fragment + 1;
+		sock->receiveMessageLength = offset + length;
+	}
+
+	if (sock->receiveFragmentCount == 0)
+		return 0;
+	for (i = 0; i < sock->receiveFragmentCount; i++)
+		if (!sock->receiveFragments[i])
+			return 0;
+
+	SZ_Clear (&net_message);
+	SZ_Write (&net_message, sock->receiveMessage, sock->receiveMessageLength);
+
+	sock->receiveSequence += sock->receiveFragmentCount;
+	sock->receiveFragmentCount = 0;
+	sock->receiveMessageLength = 0;
+	Q_memset (sock->receiveFragments, 0, sizeof(sock->receiveFragments));
+	return 1;
+}
+
+//=============================================================================
+
+
 int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 {
 	unsigned int	packetLen;
@@ -179,6 +425,9 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 	Q_memcpy(sock->sendMessage, data->data, data->cursize);
 	sock->sendMessageLength = data->cursize;
 
+	if (sock->windowed)
+		return Window_SendMessage (sock);
+
 	if (data->cursize <= MAX_DATAGRAM)
 	{
 		dataLen = data->cursize;
@@ -316,15 +565,21 @@ int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 int	Datagram_GetMessage (qsocket_t *sock)
 {
 	unsigned int	length;
+	unsigned int	readLength;
 	unsigned int	flags;
 	int				ret = 0;
 	struct qsockaddr readaddr;
 	unsigned int	sequence;
 	unsigned int	count;
+	int				fragmentRet;
 
 	if (!sock->canSend)
-		if ((net_time - sock->lastSendTime) > 1.0)
+	{
+		if (sock->windowed)
+			Window_Transmit (sock);
+		else if ((net_time - sock->lastSendTime) > 1.0)
 			ReSendMessage (sock);
+	}
 
 	while(1)
 	{	
@@ -358,6 +613,7 @@ int	Datagram_GetMessage (qsocket_t *sock)
 			continue;
 		}
 
+		readLength = length;
 		length = BigLong(packetBuffer.length);
 		flags = length & (~NETFLAG_LENGTH_MASK);
 		length &= NETFLAG_LENGTH_MASK;
@@ -365,6 +621,13 @@ int	Datagram_GetMessage (qsocket_t *sock)
 		if (flags & NETFLAG_CTL)
 			continue;
 
+		// the length comes from the peer, never trust more than was read
+		if (length < NET_HEADERSIZE || length > readLength)
+		{
+			shortPacketCount++;
+			continue;
+		}
+
 		sequence = BigLong(packetBuffer.sequence);
 		packetsReceived++;
 
@@ -395,6 +658,11 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 		if (flags & NETFLAG_ACK)
 		{
+			if (sock->windowed)
+			{
+				Window_ReceiveAck (sock, sequence);
+				continue;
+			}
 			if (sequence != (sock->sendSequence - 1))
 			{
 				Con_DPrintf("Stale ACK received\n");
@@ -427,6 +695,23 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 		if (flags & NETFLAG_DATA)
 		{
+			if (sock->windowed)
+			{
+				// only fragments that were kept are acknowledged
+				fragmentRet = Window_ReceiveFragment (sock, sequence, flags, packetBuffer.data, length - NET_HEADERSIZE);
+				if (fragmentRet == -1)
+					continue;
+				packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
+				packetBuffer.sequence = BigLong(sequence);
+				sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
+				if (fragmentRet == 1)
+				{
+					ret = 1;
+					break;
+				}
+				continue;
+			}
+
 			packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
 			packetBuffer.sequence = BigLong(sequence);
 			sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
@@ -469,6 +754,11 @@ void PrintStats(qsocket_t *s)
 	Con_Printf("canSend = %4u   \n", s->canSend);
 	Con_Printf("sendSeq = %4u   ", s->sendSequence);
 	Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+	if (s->windowed)
+	{
+		Con_Printf("rtt     = %4.0f ms   ", s->rtt * 1000.0);
+		Con_Printf("rto     = %4.0f ms\n", s->retransmitTime * 1000.0);
+	}
 	Con_Printf("\n");
 }
 
@@ -771,6 +1061,7 @@ int Datagram_Init (void)
 
 	myDriverLevel = net_driverlevel;
 	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	Cvar_RegisterVariable (&net_windowed);
 
 	if (COM_CheckParm("-nolan"))
 		return -1;
@@ -812,6 +1103,16 @@ void Datagram_Shutdown (void)
 }
 
 
+void Datagram_Batch (qboolean state)
+{
+	int i;
+
+	for (i = 0; i < net_numlandrivers; i++)
+		if (net_landrivers[i].initialized && net_landrivers[i].Batch)
+			net_landrivers[i].Batch (state);
+}
+
+
 void Datagram_Close (qsocket_t *sock)
 {
 	sfunc.CloseSocket(sock->socket);
@@ -839,6 +1140,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	int			len;
 	int			command;
 	int			control;
+	int			connectFlags;
 	int			ret;
 
 	acceptsock = dfunc.CheckNewConnections();
@@ -985,6 +1287,11 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 		return NULL;
 	}
 
+	// old clients don't send connection flags, ProQuake sends its mod byte
+	connectFlags = -1;
+	if (MSG_ReadByte() == NET_CONNECTMAGIC)
+		connectFlags = MSG_ReadByte();
+
 #ifdef BAN_TEST
 	// check for a ban
 	if (clientaddr.sa_family == AF_INET)
@@ -1024,6 +1331,11 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 				MSG_WriteByte(&net_message, CCREP_ACCEPT);
 				dfunc.GetSocketAddr(s->socket, &newaddr);
 				MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+				if (connectFlags != -1)
+				{
+					MSG_WriteByte(&net_message, NET_CONNECTMAGIC);
+					MSG_WriteByte(&net_message, s->windowed ? NET_CONNECTFLAG_WINDOWED : 0);
+				}
 				*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 				dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
 				SZ_Clear(&net_message);
@@ -1073,6 +1385,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	sock->landriver = net_landriverlevel;
 	sock->addr = clientaddr;
 	Q_strcpy(sock->address, dfunc.AddrToString(&clientaddr));
+	sock->windowed = connectFlags != -1 && (connectFlags & NET_CONNECTFLAG_WINDOWED) && net_windowed.value;
 
 	// send him back the info about the server connection he has been allocated
 	SZ_Clear(&net_message);
@@ -1082,6 +1395,11 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	dfunc.GetSocketAddr(newsock, &newaddr);
 	MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
 //	MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
+	if (connectFlags != -1)
+	{
+		MSG_WriteByte(&net_message, NET_CONNECTMAGIC);
+		MSG_WriteByte(&net_message, sock->windowed ? NET_CONNECTFLAG_WINDOWED : 0);
+	}
 	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 	dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
 	SZ_Clear(&net_message);
@@ -1254,6 +1572,8 @@ static qsocket_t *_Datagram_Connect (char *host)
 		MSG_WriteByte(&net_message, CCREQ_CONNECT);
 		MSG_WriteString(&net_message, "QUAKE");
 		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		MSG_WriteByte(&net_message, NET_CONNECTMAGIC);
+		MSG_WriteByte(&net_message, net_windowed.value ? NET_CONNECTFLAG_WINDOWED : 0);
 		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 		dfunc.Write (newsock, net_message.data, net_message.cursize, &sendaddr);
 		SZ_Clear(&net_message);
@@ -1340,6 +1660,13 @@ static qsocket_t *_Datagram_Connect (char *host)
 	{
 		Q_memcpy(&sock->addr, &sendaddr, sizeof(struct qsockaddr));
 		dfunc.SetSocketPort (&sock->addr, MSG_ReadLong());
+		// old servers don't reply with connection flags
+		sock->windowed = false;
+		if (MSG_ReadByte() == NET_CONNECTMAGIC)
+		{
+			ret = MSG_ReadByte();
+			sock->windowed = ret != -1 && (ret & NET_CONNECTFLAG_WINDOWED);
+		}
 	}
 	else
 	{
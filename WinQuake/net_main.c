@@ -142,6 +142,14 @@ qsocket_t *NET_NewQSocket (void)
 	sock->receiveSequence = 0;
 	sock->unreliableReceiveSequence = 0;
 	sock->receiveMessageLength = 0;
+	sock->windowed = false;
+	sock->sendMessageSequence = 0;
+	sock->sendFragmentCount = 0;
+	sock->receiveFragmentCount = 0;
+	Q_memset (sock->receiveFragments, 0, sizeof(sock->receiveFragments));
+	sock->rtt = 0.0;
+	sock->rttVariance = 0.0;
+	sock->retransmitTime = 1.0;
 
 	return sock;
 }
@@ -923,6 +931,24 @@ void		NET_Shutdown (void)
 }
 
 
+/*
+====================
+NET_Batch
+====================
+*/
+void NET_Batch (qboolean state)
+{
+	for (net_driverlevel=0 ; net_driverlevel<net_numdrivers; net_driverlevel++)
+	{
+		if (net_drivers[net_driverlevel].initialized == false)
+			continue;
+		if (dfunc.Batch)
+			dfunc.Batch (state);
+	}
+}
+
+//=============================================================================
+
 static PollProcedure *pollProcedureList = NULL;
 
 void NET_Poll(void)
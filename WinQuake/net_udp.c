@@ -20,6 +20,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // net_udp.c
 
+#ifdef __linux__
+#define _GNU_SOURCE	// for recvmmsg/sendmmsg
+#define UDP_BATCHING
+#endif
+
 #include "quakedef.h"
 
 #include <sys/types.h>
@@ -38,8 +43,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <libc.h>
 #endif
 
+#ifdef UDP_BATCHING
+#include <unistd.h>
+#else
 extern int gethostname (char *, int);
 extern int close (int);
+#endif
 
 extern cvar_t hostname;
 
@@ -52,6 +61,238 @@ static unsigned long myAddr;
 
 #include "net_udp.h"
 
+/* statistic counters */
+static int udpReadCalls = 0;
+static int udpWriteCalls = 0;
+static int udpPacketsRead = 0;
+static int udpPacketsWritten = 0;
+static int udpStatsFrame = 0;
+
+#ifdef UDP_BATCHING
+
+/*
+=============================================================================
+
+BATCHED I/O
+
+Every game socket has its own receive buffer, refilled with a single
+recvmmsg call when it runs out, so draining a socket takes one syscall per
+frame instead of one per datagram plus a final EWOULDBLOCK one.
+While batching is enabled (see NET_Batch), written datagrams are queued and
+sent with one sendmmsg call per socket when batching is turned off.
+
+=============================================================================
+*/
+
+cvar_t	udp_batch = {"udp_batch", "1"};
+
+#define UDP_BATCH_SIZE		16
+#define UDP_MAX_SOCKETS		(MAX_SCOREBOARD * 2 + 8)
+#define UDP_SENDQUEUE_SIZE	(MAX_SCOREBOARD * 8)
+
+typedef struct
+{
+	int					socket;		// -1 if not used
+	int					count;
+	int					current;
+	qboolean			drained;	// last recvmmsg emptied the socket
+	int					length[UDP_BATCH_SIZE];
+	struct qsockaddr	addr[UDP_BATCH_SIZE];
+	byte				data[UDP_BATCH_SIZE][NET_DATAGRAMSIZE];
+} udprecvbuffer_t;
+
+typedef struct
+{
+	int					socket;
+	int					length;
+	struct qsockaddr	addr;
+	byte				data[NET_DATAGRAMSIZE];
+} udpsendpacket_t;
+
+static udprecvbuffer_t	udp_recvbuffers[UDP_MAX_SOCKETS];
+
+static qboolean			udp_batching = false;
+static int				udp_sendqueuecount = 0;
+static udpsendpacket_t	udp_sendqueue[UDP_SENDQUEUE_SIZE];
+
+
+static udprecvbuffer_t *UDP_GetRecvBuffer (int socket, qboolean alloc)
+{
+	int		i;
+	udprecvbuffer_t	*free;
+
+	free = NULL;
+	for (i = 0; i < UDP_MAX_SOCKETS; i++)
+	{
+		if (udp_recvbuffers[i].socket == socket)
+			return &udp_recvbuffers[i];
+		if (free == NULL && udp_recvbuffers[i].socket == -1)
+			free = &udp_recvbuffers[i];
+	}
+
+	if (!alloc || free == NULL)
+		return NULL;
+
+	free->socket = socket;
+	free->count = 0;
+	free->current = 0;
+	free->drained = false;
+	return free;
+}
+
+
+static int UDP_FillRecvBuffer (udprecvbuffer_t *b)
+{
+	struct mmsghdr	msgs[UDP_BATCH_SIZE];
+	struct iovec	iovecs[UDP_BATCH_SIZE];
+	int		i;
+	int		ret;
+
+	Q_memset (msgs, 0, sizeof(msgs));
+	for (i = 0; i < UDP_BATCH_SIZE; i++)
+	{
+		iovecs[i].iov_base = b->data[i];
+		iovecs[i].iov_len = NET_DATAGRAMSIZE;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &b->addr[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(struct qsockaddr);
+	}
+
+	b->count = 0;
+	b->current = 0;
+
+	udpReadCalls++;
+	ret = recvmmsg (b->socket, msgs, UDP_BATCH_SIZE, MSG_DONTWAIT, NULL);
+	if (ret == -1)
+	{
+		if (errno == EWOULDBLOCK || errno == ECONNREFUSED)
+		{
+			b->drained = true;
+			return 0;
+		}
+		return -1;
+	}
+
+	for (i = 0; i < ret; i++)
+		b->length[i] = msgs[i].msg_len;
+	b->count = ret;
+	b->drained = ret < UDP_BATCH_SIZE;
+	udpPacketsRead += ret;
+	return ret;
+}
+
+
+static int UDP_ReadBatched (int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+	udprecvbuffer_t	*b;
+	int		ret;
+
+	b = UDP_GetRecvBuffer (socket, true);
+	if (b == NULL)
+		return -2;	// out of buffers, read directly
+
+	if (b->current == b->count)
+	{
+		// the last refill got everything, so report the socket as empty
+		// once and only ask the system again on the next read
+		if (b->drained)
+		{
+			b->drained = false;
+			b->count = b->current = 0;
+			return 0;
+		}
+		ret = UDP_FillRecvBuffer (b);
+		if (ret <= 0)
+		{
+			b->drained = false;
+			return ret;
+		}
+	}
+
+	ret = b->length[b->current];
+	if (ret > len)
+		ret = len;
+	Q_memcpy (buf, b->data[b->current], ret);
+	*addr = b->addr[b->current];
+	b->current++;
+	return ret;
+}
+
+
+static void UDP_FlushSocket (int socket)
+{
+	struct mmsghdr	msgs[UDP_SENDQUEUE_SIZE];
+	struct iovec	iovecs[UDP_SENDQUEUE_SIZE];
+	int		i;
+	int		count;
+	int		sent;
+	int		ret;
+
+	// gather the packets of this socket, keeping their order
+	count = 0;
+	for (i = 0; i < udp_sendqueuecount; i++)
+	{
+		if (udp_sendqueue[i].socket != socket)
+			continue;
+		Q_memset (&msgs[count], 0, sizeof(msgs[count]));
+		iovecs[count].iov_base = udp_sendqueue[i].data;
+		iovecs[count].iov_len = udp_sendqueue[i].length;
+		msgs[count].msg_hdr.msg_iov = &iovecs[count];
+		msgs[count].msg_hdr.msg_iovlen = 1;
+		msgs[count].msg_hdr.msg_name = &udp_sendqueue[i].addr;
+		msgs[count].msg_hdr.msg_namelen = sizeof(struct qsockaddr);
+		count++;
+		udp_sendqueue[i].socket = -1;
+	}
+
+	// a datagram the system refuses is dropped, like an unbatched one would be
+	for (sent = 0; sent < count; sent += ret > 0 ? ret : 1)
+	{
+		udpWriteCalls++;
+		ret = sendmmsg (socket, msgs + sent, count - sent, 0);
+	}
+	udpPacketsWritten += count;
+}
+
+
+static void UDP_FlushSendQueue (void)
+{
+	int		i;
+
+	for (i = 0; i < udp_sendqueuecount; i++)
+		if (udp_sendqueue[i].socket != -1)
+			UDP_FlushSocket (udp_sendqueue[i].socket);
+
+	udp_sendqueuecount = 0;
+}
+
+#endif	// UDP_BATCHING
+
+//=============================================================================
+
+static void UDP_Stats_f (void)
+{
+	int		frames;
+
+	frames = host_framecount - udpStatsFrame;
+	if (frames < 1)
+		frames = 1;
+
+	Con_Printf("frames           = %i\n", frames);
+	Con_Printf("read syscalls    = %i (%.2f per frame)\n", udpReadCalls, (float)udpReadCalls / frames);
+	Con_Printf("write syscalls   = %i (%.2f per frame)\n", udpWriteCalls, (float)udpWriteCalls / frames);
+	Con_Printf("datagrams read   = %i\n", udpPacketsRead);
+	Con_Printf("datagrams sent   = %i\n", udpPacketsWritten);
+
+	if (Cmd_Argc () > 1 && Q_strcmp(Cmd_Argv(1), "reset") == 0)
+	{
+		udpReadCalls = udpWriteCalls = 0;
+		udpPacketsRead = udpPacketsWritten = 0;
+		udpStatsFrame = host_framecount;
+	}
+}
+
 //=============================================================================
 
 int UDP_Init (void)
@@ -60,6 +301,9 @@ int UDP_Init (void)
 	char	buff[MAXHOSTNAMELEN];
 	struct qsockaddr addr;
 	char *colon;
+#ifdef UDP_BATCHING
+	int i;
+#endif
 	
 	if (COM_CheckParm ("-noudp"))
 		return -1;
@@ -67,7 +311,17 @@ int UDP_Init (void)
 	// determine my name & address
 	gethostname(buff, MAXHOSTNAMELEN);
 	local = gethostbyname(buff);
-	myAddr = *(int *)local->h_addr_list[0];
+	if (local)
+		myAddr = *(int *)local->h_addr_list[0];
+	else
+		myAddr = htonl(INADDR_LOOPBACK);
+
+#ifdef UDP_BATCHING
+	for (i = 0; i < UDP_MAX_SOCKETS; i++)
+		udp_recvbuffers[i].socket = -1;
+	Cvar_RegisterVariable (&udp_batch);
+#endif
+	Cmd_AddCommand ("udp_stats", UDP_Stats_f);
 
 	// if the quake hostname isn't set, set it to the machine name
 	if (Q_strcmp(hostname.string, "UNNAMED") == 0)
@@ -99,6 +353,11 @@ int UDP_Init (void)
 
 void UDP_Shutdown (void)
 {
+#ifdef UDP_BATCHING
+	udp_batching = false;
+	UDP_FlushSendQueue ();
+#endif
+
 	UDP_Listen (false);
 	UDP_CloseSocket (net_controlsocket);
 }
@@ -155,6 +414,17 @@ ErrorReturn:
 
 int UDP_CloseSocket (int socket)
 {
+#ifdef UDP_BATCHING
+	udprecvbuffer_t	*b;
+
+	// don't lose the last words, like a disconnect message
+	UDP_FlushSocket (socket);
+
+	b = UDP_GetRecvBuffer (socket, false);
+	if (b)
+		b->socket = -1;
+#endif
+
 	if (socket == net_broadcastsocket)
 		net_broadcastsocket = 0;
 	return close (socket);
@@ -234,6 +504,16 @@ int UDP_CheckNewConnections (void)
 	if (net_acceptsocket == -1)
 		return -1;
 
+#ifdef UDP_BATCHING
+	{
+		udprecvbuffer_t	*b;
+
+		b = UDP_GetRecvBuffer (net_acceptsocket, false);
+		if (b && b->current < b->count)
+			return net_acceptsocket;
+	}
+#endif
+
 	if (ioctl (net_acceptsocket, FIONREAD, &available) == -1)
 		Sys_Error ("UDP: ioctlsocket (FIONREAD) failed\n");
 	if (available)
@@ -248,9 +528,21 @@ int UDP_Read (int socket, byte *buf, int len, struct qsockaddr *addr)
 	int addrlen = sizeof (struct qsockaddr);
 	int ret;
 
+#ifdef UDP_BATCHING
+	if (udp_batch.value)
+	{
+		ret = UDP_ReadBatched (socket, buf, len, addr);
+		if (ret != -2)
+			return ret;
+	}
+#endif
+
+	udpReadCalls++;
 	ret = recvfrom (socket, buf, len, 0, (struct sockaddr *)addr, &addrlen);
 	if (ret == -1 && (errno == EWOULDBLOCK || errno == ECONNREFUSED))
 		return 0;
+	if (ret > 0)
+		udpPacketsRead++;
 	return ret;
 }
 
@@ -295,6 +587,25 @@ int UDP_Write (int socket, byte *buf, int len, struct qsockaddr *addr)
 {
 	int ret;
 
+#ifdef UDP_BATCHING
+	if (udp_batching && len <= NET_DATAGRAMSIZE)
+	{
+		udpsendpacket_t	*p;
+
+		if (udp_sendqueuecount == UDP_SENDQUEUE_SIZE)
+			UDP_FlushSendQueue ();
+
+		p = &udp_sendqueue[udp_sendqueuecount++];
+		p->socket = socket;
+		p->length = len;
+		p->addr = *addr;
+		Q_memcpy (p->data, buf, len);
+		return len;
+	}
+#endif
+
+	udpWriteCalls++;
+	udpPacketsWritten++;
 	ret = sendto (socket, buf, len, 0, (struct sockaddr *)addr, sizeof(struct qsockaddr));
 	if (ret == -1 && errno == EWOULDBLOCK)
 		return 0;
@@ -413,3 +724,14 @@ int UDP_SetSocketPort (struct qsockaddr *addr, int port)
 }
 
 //=============================================================================
+
+void UDP_Batch (qboolean state)
+{
+#ifdef UDP_BATCHING
+	udp_batching = state && udp_batch.value;
+	if (!state)
+		UDP_FlushSendQueue ();
+#endif
+}
+
+//=============================================================================
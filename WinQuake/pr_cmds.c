@@ -836,6 +836,45 @@ void PF_localcmd (void)
 	Cbuf_AddText (str);
 }
 
+/*
+=================
+PF_FindCvar
+
+Progs ask for the same few cvars with the same string constants every frame,
+so the variables are cached by the string offset. The name is compared
+again, strings in the string heap can change under the same offset.
+=================
+*/
+#define	CVARCACHE_SIZE	256		// power of two
+
+typedef struct
+{
+	int		ofs;
+	cvar_t	*var;
+} cvarcache_t;
+
+static	cvarcache_t	pr_cvarcache[CVARCACHE_SIZE];
+
+static cvar_t *PF_FindCvar (int ofs)
+{
+	cvarcache_t	*c;
+	char		*name;
+
+	name = pr_strings + ofs;
+	cmd_stats.progslookups++;
+
+	c = &pr_cvarcache[((unsigned)ofs * 2654435761u) >> 24 & (CVARCACHE_SIZE-1)];
+	if (c->var && c->ofs == ofs && !Q_strcmp (c->var->name, name))
+	{
+		cmd_stats.progshits++;
+		return c->var;
+	}
+
+	c->ofs = ofs;
+	c->var = Cvar_FindVar (name);
+	return c->var;
+}
+
 /*
 =================
 PF_cvar
@@ -845,11 +884,11 @@ float cvar (string)
 */
 void PF_cvar (void)
 {
-	char	*str;
+	cvar_t	*var;
 	
-	str = G_STRING(OFS_PARM0);
+	var = PF_FindCvar (G_INT(OFS_PARM0));
 	
-	G_FLOAT(OFS_RETURN) = Cvar_VariableValue (str);
+	G_FLOAT(OFS_RETURN) = var ? Q_atof (var->string) : 0;
 }
 
 /*
@@ -861,12 +900,16 @@ float cvar (string)
 */
 void PF_cvar_set (void)
 {
-	char	*var, *val;
+	cvar_t	*var;
+	char	*val;
 	
-	var = G_STRING(OFS_PARM0);
+	var = PF_FindCvar (G_INT(OFS_PARM0));
 	val = G_STRING(OFS_PARM1);
 	
-	Cvar_Set (var, val);
+	if (var)
+		Cvar_SetVar (var, val);
+	else
+		Cvar_Set (G_STRING(OFS_PARM0), val);	// prints the error
 }
 
 /*
@@ -921,6 +964,24 @@ void PF_dprint (void)
 	Con_DPrintf ("%s",PF_VarString(0));
 }
 
+/*
+=================
+PF_ReturnTempString
+
+Returns a heap copy of pr_tmp_string, so the result can be kept in a
+field. Falls back to pr_tmp_string itself when the heap is full.
+=================
+*/
+static void PF_ReturnTempString (void)
+{
+	char	*s;
+
+	s = ED_CopyString (pr_tmp_string);
+	if (!s)
+		s = pr_tmp_string;
+	G_INT(OFS_RETURN) = s - pr_strings;
+}
+
 void PF_ftos (void)
 {
 	float	v;
@@ -930,7 +991,7 @@ void PF_ftos (void)
 		sprintf (pr_tmp_string, "%d",(int)v);
 	else
 		sprintf (pr_tmp_string, "%5.1f",v);
-	G_INT(OFS_RETURN) = pr_tmp_string - pr_strings;
+	PF_ReturnTempString ();
 }
 
 void PF_fabs (void)
@@ -943,7 +1004,7 @@ void PF_fabs (void)
 void PF_vtos (void)
 {
 	sprintf (pr_tmp_string, "'%5.1f %5.1f %5.1f'", G_VECTOR(OFS_PARM0)[0], G_VECTOR(OFS_PARM0)[1], G_VECTOR(OFS_PARM0)[2]);
-	G_INT(OFS_RETURN) = pr_tmp_string - pr_strings;
+	PF_ReturnTempString ();
 }
 
 #ifdef QUAKE2
@@ -1329,11 +1390,18 @@ vector aim(entity, missilespeed)
 =============
 */
 cvar_t	sv_aim = {"sv_aim", "0.93"};
+
+static edict_t	*aim_ents[MAX_EDICTS];
+static float	aim_dists[MAX_EDICTS];
+static vec3_t	aim_starts[MAX_EDICTS];
+static vec3_t	aim_ends[MAX_EDICTS];
+static trace_t	aim_traces[MAX_EDICTS];
+
 void PF_aim (void)
 {
 	edict_t	*ent, *check, *bestent;
 	vec3_t	start, dir, end, bestdir;
-	int		i, j;
+	int		i, j, count;
 	trace_t	tr;
 	float	dist, bestdist;
 	float	speed;
@@ -1361,6 +1429,8 @@ void PF_aim (void)
 	bestdist = sv_aim.value;
 	bestent = NULL;
 	
+// trace to all the ones in the cone at once, then pick the best
+	count = 0;
 	check = NEXT_EDICT(sv.edicts);
 	for (i=1 ; i<sv.num_edicts ; i++, check = NEXT_EDICT(check) )
 	{
@@ -1378,11 +1448,23 @@ void PF_aim (void)
 		dist = DotProduct (dir, pr_global_struct->v_forward);
 		if (dist < bestdist)
 			continue;	// to far to turn
-		tr = SV_Move (start, vec3_origin, vec3_origin, end, false, ent);
-		if (tr.ent == check)
+		aim_ents[count] = check;
+		aim_dists[count] = dist;
+		VectorCopy (start, aim_starts[count]);
+		VectorCopy (end, aim_ends[count]);
+		count++;
+	}
+
+	SV_MoveBatch (count, aim_starts, vec3_origin, vec3_origin, aim_ends, false, ent, aim_traces);
+
+	for (i=0 ; i<count ; i++)
+	{
+		if (aim_dists[i] < bestdist)
+			continue;	// a better one came first
+		if (aim_traces[i].ent == aim_ents[i])
 		{	// can shoot at this one
-			bestdist = dist;
-			bestent = check;
+			bestdist = aim_dists[i];
+			bestent = aim_ents[i];
 		}
 	}
 	
@@ -69,6 +69,134 @@ typedef struct {
 
 static gefv_cache	gefvCache[GEFV_CACHESIZE] = {{NULL, ""}, {NULL, ""}};
 
+/*
+Free edicts after the client slots are kept in two sets, so ED_Alloc
+doesn't have to look at every edict. Edicts freed within the last half
+second wait in a list in the order they were freed, which is also the order
+of their freetimes. Once old enough they move to a bitmap of edicts ready
+for reuse, and ED_Alloc takes the lowest numbered one, the same edict the
+linear search found.
+*/
+
+#define	ED_UNLISTED		0
+#define	ED_WAITING		1
+#define	ED_READY		2
+
+#define	ED_READYWORDS	((MAX_EDICTS+31)>>5)
+
+static byte		ed_freestate[MAX_EDICTS];
+static int		ed_waitnext[MAX_EDICTS], ed_waitprev[MAX_EDICTS];
+static int		ed_waithead = -1, ed_waittail = -1;
+static unsigned	ed_readybits[ED_READYWORDS];
+static int		ed_numfree;
+
+static struct
+{
+	int		allocs;
+	int		reused;
+	int		frees;
+	int		peak;		// live edicts, counting world and clients
+	double	starttime;
+} ed_stats;
+
+static void ED_Unlist (int n)
+{
+	if (ed_freestate[n] == ED_WAITING)
+	{
+		if (ed_waitprev[n] != -1)
+			ed_waitnext[ed_waitprev[n]] = ed_waitnext[n];
+		else
+			ed_waithead = ed_waitnext[n];
+		if (ed_waitnext[n] != -1)
+			ed_waitprev[ed_waitnext[n]] = ed_waitprev[n];
+		else
+			ed_waittail = ed_waitprev[n];
+	}
+	else if (ed_freestate[n] == ED_READY)
+		ed_readybits[n>>5] &= ~(1u << (n&31));
+	else
+		return;
+
+	ed_freestate[n] = ED_UNLISTED;
+	ed_numfree--;
+}
+
+static void ED_SetReady (int n)
+{
+	ed_readybits[n>>5] |= 1u << (n&31);
+	ed_freestate[n] = ED_READY;
+}
+
+/*
+=================
+ED_List
+
+Puts a free edict into the waiting list, after the ones freed before it,
+or right into the ready set
+=================
+*/
+static void ED_List (int n)
+{
+	edict_t	*e;
+	int		prev;
+
+	e = EDICT_NUM(n);
+	ed_numfree++;
+
+	// the first couple seconds of server time can involve a lot of
+	// freeing and allocating, so relax the replacement policy
+	if (e->freetime < 2)
+	{
+		ED_SetReady (n);
+		return;
+	}
+
+	prev = ed_waittail;
+	while (prev != -1 && EDICT_NUM(prev)->freetime > e->freetime)
+		prev = ed_waitprev[prev];		// only when rebuilding
+
+	ed_waitprev[n] = prev;
+	if (prev != -1)
+	{
+		ed_waitnext[n] = ed_waitnext[prev];
+		ed_waitnext[prev] = n;
+	}
+	else
+	{
+		ed_waitnext[n] = ed_waithead;
+		ed_waithead = n;
+	}
+	if (ed_waitnext[n] != -1)
+		ed_waitprev[ed_waitnext[n]] = n;
+	else
+		ed_waittail = n;
+	ed_freestate[n] = ED_WAITING;
+}
+
+/*
+=================
+ED_ResetFreeList
+
+Called when sv.edicts has been filled in some other way than through
+ED_Alloc and ED_Free, when a level is spawned or a game is loaded
+=================
+*/
+void ED_ResetFreeList (void)
+{
+	int		i;
+
+	Q_memset (ed_freestate, ED_UNLISTED, sizeof(ed_freestate));
+	Q_memset (ed_readybits, 0, sizeof(ed_readybits));
+	ed_waithead = ed_waittail = -1;
+	ed_numfree = 0;
+
+	for (i=svs.maxclients+1 ; i<sv.num_edicts ; i++)
+		if (EDICT_NUM(i)->free)
+			ED_List (i);
+
+	ed_stats.peak = sv.num_edicts - ed_numfree;
+}
+
 /*
 =================
 ED_ClearEdict
@@ -95,28 +223,51 @@ angles and bad trails.
 */
 edict_t *ED_Alloc (void)
 {
-	int			i;
+	int			i, w;
+	unsigned	bits;
 	edict_t		*e;
 
-	for ( i=svs.maxclients+1 ; i<sv.num_edicts ; i++)
+// the waiting edicts that are old enough now can be reused
+	while (ed_waithead != -1)
 	{
-		e = EDICT_NUM(i);
-		// the first couple seconds of server time can involve a lot of
-		// freeing and allocating, so relax the replacement policy
-		if (e->free && ( e->freetime < 2 || sv.time - e->freetime > 0.5 ) )
-		{
-			ED_ClearEdict (e);
-			return e;
-		}
+		i = ed_waithead;
+		if (!(sv.time - EDICT_NUM(i)->freetime > 0.5))
+			break;
+		ED_Unlist (i);
+		ED_SetReady (i);
+		ed_numfree++;
 	}
-	
-	if (i == MAX_EDICTS)
-		Sys_Error ("ED_Alloc: no free edicts");
-		
-	sv.num_edicts++;
+
+	ed_stats.allocs++;
+
+	for (w=0 ; w<ED_READYWORDS ; w++)
+	{
+		bits = ed_readybits[w];
+		if (!bits)
+			continue;
+		for (i=0 ; !(bits & (1u << i)) ; i++)
+			;
+		i += w<<5;
+
+		ED_Unlist (i);
+		ed_stats.reused++;
+		break;
+	}
+
+	if (w == ED_READYWORDS)
+	{
+		i = sv.num_edicts;
+		if (i == MAX_EDICTS)
+			Sys_Error ("ED_Alloc: no free edicts");
+		sv.num_edicts++;
+	}
+
 	e = EDICT_NUM(i);
 	ED_ClearEdict (e);
 
+	if (sv.num_edicts - ed_numfree > ed_stats.peak)
+		ed_stats.peak = sv.num_edicts - ed_numfree;
+
 	return e;
 }
 
@@ -130,6 +281,8 @@ FIXME: walk all entities and NULL out references to this entity
 */
 void ED_Free (edict_t *ed)
 {
+	int		n;
+
 	SV_UnlinkEdict (ed);		// unlink from world bsp
 
 	ed->free = true;
@@ -145,6 +298,14 @@ void ED_Free (edict_t *ed)
 	ed->v.solid = 0;
 	
 	ed->freetime = sv.time;
+
+	ed_stats.frees++;
+	n = NUM_FOR_EDICT(ed);
+	if (n > svs.maxclients)
+	{	// freeing it again starts the wait over
+		ED_Unlist (n);
+		ED_List (n);
+	}
 }
 
 //===========================================================================
@@ -608,6 +769,42 @@ void ED_Count (void)
 
 }
 
+/*
+=============
+ED_Stats_f
+
+edictstats : prints allocations since the last reset
+edictstats reset
+=============
+*/
+void ED_Stats_f (void)
+{
+	double	elapsed;
+
+	if (Cmd_Argc () > 1 && !Q_strcmp (Cmd_Argv (1), "reset"))
+	{
+		Q_memset (&ed_stats, 0, sizeof(ed_stats));
+		ed_stats.peak = sv.active ? sv.num_edicts - ed_numfree : 0;
+		ed_stats.starttime = realtime;
+		return;
+	}
+
+	if (!sv.active)
+	{
+		Con_Printf ("no server running\n");
+		return;
+	}
+
+	elapsed = realtime - ed_stats.starttime;
+	if (elapsed <= 0.0)
+		elapsed = 1.0;
+
+	Con_Printf ("%3i live %3i peak %3i free edicts of %i\n",
+		sv.num_edicts - ed_numfree, ed_stats.peak, ed_numfree, MAX_EDICTS);
+	Con_Printf ("%i allocs, %i reused, %i frees, %.1f allocs/s\n",
+		ed_stats.allocs, ed_stats.reused, ed_stats.frees, ed_stats.allocs / elapsed);
+}
+
 /*
 ==============================================================================
 
@@ -694,31 +891,293 @@ void ED_ParseGlobals (char *data)
 //============================================================================
 
 
+/*
+==============================================================================
+
+					STRING HEAP
+
+Strings made at run time live in pr_dynamic_strings, each behind a
+strblock_t. Identical strings are stored once. When the heap fills, the
+strings no longer referenced from a string field of an edict, a string
+global or the server precache and lightstyle tables are dropped and the
+rest is slid down, fixing up the references.
+
+Collecting is only safe outside of the vm: strings held only in
+temporaries or parms of a running function can't be found.
+==============================================================================
+*/
+
+typedef struct
+{
+	int			size;		// of the whole block, header included
+	int			next;		// string offset of the next block in the hash chain
+	unsigned	hash;
+	int			forward;	// string offset after compaction, -1 if unreferenced
+} strblock_t;
+
+#define	STRHASH_SIZE	1024
+#define	STRHEAP_GRAINS	(PR_DYNAMIC_STRINGS_BUFF_SIZE / 4)
+
+static int		ed_strhash[STRHASH_SIZE];		// string offsets, 0 - empty
+static unsigned	ed_strstarts[(STRHEAP_GRAINS + 31) / 32];	// a block starts at this grain
+static int		ed_strlive;		// heap size after the last collection
+
+static struct
+{
+	int		allocs;
+	int		interned;
+	int		collections;
+	int		reclaimed;		// bytes
+	double	time;			// spent collecting, seconds
+} ed_strstats;
+
+extern int		pr_depth;
+
+#define	STRBLOCK(ofs)	((strblock_t *)(pr_strings + (ofs)) - 1)
+#define	STRHEAP_TOP		(pr_next_dynamic_string - pr_dynamic_strings)
+
+
+static unsigned ED_HashString (char *s)
+{
+	unsigned	hash;
+
+	hash = 2166136261u;
+	while (*s)
+		hash = (hash ^ (byte)*s++) * 16777619u;
+	return hash;
+}
+
 /*
 =============
-ED_NewString
+ED_InitStrings
+
+Empties the heap, called when progs are loaded
 =============
 */
-char *ED_NewString (char *string)
+static void ED_InitStrings (void)
 {
-	char	*new, *new_p;
-	int		i,l;
-	
-	l = strlen(string) + 1;
+	pr_next_dynamic_string = pr_dynamic_strings;
+	Q_memset (ed_strhash, 0, sizeof(ed_strhash));
+	Q_memset (&ed_strstats, 0, sizeof(ed_strstats));
+	ed_strlive = 0;
+}
 
-	new = pr_next_dynamic_string;
-	pr_next_dynamic_string += l;
-	if (pr_next_dynamic_string - pr_dynamic_strings > PR_DYNAMIC_STRINGS_BUFF_SIZE)
-	{
-		Sys_Error( "ED_NewString: out of string buffer\n" );
+/*
+=============
+ED_StringBlock
+
+Returns the block of a string offset, NULL if it isn't the start of a heap
+string. Only valid during a collection.
+=============
+*/
+static strblock_t *ED_StringBlock (int ofs)
+{
+	int		grain;
+
+	grain = ofs - (pr_dynamic_strings - pr_strings) - (int)sizeof(strblock_t);
+	if (grain < 0 || grain >= STRHEAP_TOP || (grain & 3))
+		return NULL;
+	grain >>= 2;
+	if (!(ed_strstarts[grain>>5] & (1u<<(grain&31))))
 		return NULL;
+	return STRBLOCK(ofs);
+}
+
+static void ED_MarkString (int *ofs)
+{
+	strblock_t	*b;
+
+	b = ED_StringBlock (*ofs);
+	if (b)
+		b->forward = 0;
+}
+
+static void ED_FixString (int *ofs)
+{
+	strblock_t	*b;
+
+	b = ED_StringBlock (*ofs);
+	if (b)
+		*ofs = b->forward;
+}
+
+/*
+=============
+ED_StringRoots
+
+Calls visit for every place outside the vm stack that can hold a heap string
+=============
+*/
+static void ED_StringRoots (void (*visit) (int *ofs))
+{
+	int		i, j, ofs;
+	ddef_t	*def;
+	edict_t	*ed;
+	char	**tables[3];
+	int		sizes[3];
+
+	for (i=0 ; i<progs->numglobaldefs ; i++)
+	{
+		def = &pr_globaldefs[i];
+		if ((def->type & ~DEF_SAVEGLOBAL) == ev_string)
+			visit ((int *)&pr_globals[def->ofs]);
+	}
+
+	// edicts past num_edicts are scanned too, a saved game is parsed
+	// before num_edicts is set. Free edicts keep their strings until they
+	// are reused, progs read the .classname of removed entities they still
+	// hold in .enemy or .owner
+	if (sv.edicts)
+	{
+		for (i=0 ; i<sv.max_edicts ; i++)
+		{
+			ed = EDICT_NUM(i);
+			for (j=0 ; j<progs->numfielddefs ; j++)
+			{
+				def = &pr_fielddefs[j];
+				if (def->type == ev_string)
+					visit ((int *)&ed->v + def->ofs);
+			}
+		}
+	}
+
+	tables[0] = sv.model_precache;
+	sizes[0] = MAX_MODELS;
+	tables[1] = sv.sound_precache;
+	sizes[1] = MAX_SOUNDS;
+	tables[2] = sv.lightstyles;
+	sizes[2] = MAX_LIGHTSTYLES;
+	for (i=0 ; i<3 ; i++)
+	{
+		for (j=0 ; j<sizes[i] ; j++)
+		{
+			if (tables[i][j] < pr_dynamic_strings || tables[i][j] >= pr_next_dynamic_string)
+				continue;
+			ofs = tables[i][j] - pr_strings;
+			visit (&ofs);
+			tables[i][j] = pr_strings + ofs;
+		}
+	}
+}
+
+/*
+=============
+ED_CollectStrings
+
+Drops unreferenced strings and compacts the heap, returns false inside
+the vm, where nothing can be dropped
+=============
+*/
+qboolean ED_CollectStrings (void)
+{
+	int			ofs, newofs, size, grain, base, hash;
+	strblock_t	*b;
+	double		time;
+
+	if (pr_depth > 0)
+		return false;
+
+	time = Sys_FloatTime ();
+	base = pr_dynamic_strings - pr_strings + sizeof(strblock_t);
+
+// find the blocks and clear the marks
+	Q_memset (ed_strstarts, 0, sizeof(ed_strstarts));
+	for (ofs=0 ; ofs<STRHEAP_TOP ; ofs += b->size)
+	{
+		b = (strblock_t *)(pr_dynamic_strings + ofs);
+		b->forward = -1;
+		grain = ofs >> 2;
+		ed_strstarts[grain>>5] |= 1u<<(grain&31);
+	}
+
+	ED_StringRoots (ED_MarkString);
+
+// give the referenced blocks their new places
+	newofs = 0;
+	for (ofs=0 ; ofs<STRHEAP_TOP ; ofs += b->size)
+	{
+		b = (strblock_t *)(pr_dynamic_strings + ofs);
+		if (b->forward < 0)
+			continue;
+		b->forward = base + newofs;
+		newofs += b->size;
+	}
+
+	ED_StringRoots (ED_FixString);
+
+// slide them down and hash them again
+	Q_memset (ed_strhash, 0, sizeof(ed_strhash));
+	newofs = 0;
+	for (ofs=0 ; ofs<STRHEAP_TOP ; ofs += size)
+	{
+		b = (strblock_t *)(pr_dynamic_strings + ofs);
+		size = b->size;
+		if (b->forward < 0)
+			continue;
+		if (newofs != ofs)
+			memmove (pr_dynamic_strings + newofs, b, size);
+		b = (strblock_t *)(pr_dynamic_strings + newofs);
+		hash = b->hash & (STRHASH_SIZE-1);
+		b->next = ed_strhash[hash];
+		ed_strhash[hash] = base + newofs;
+		newofs += size;
 	}
 
-	new_p = new;
+	ed_strstats.collections++;
+	ed_strstats.reclaimed += STRHEAP_TOP - newofs;
+	ed_strstats.time += Sys_FloatTime () - time;
+	Con_DPrintf ("string heap: %i bytes reclaimed, %i used\n", STRHEAP_TOP - newofs, newofs);
+
+	pr_next_dynamic_string = pr_dynamic_strings + newofs;
+	ed_strlive = newofs;
+	return true;
+}
+
+/*
+=============
+ED_CheckStrings
+
+Called between frames, collects early so strings made inside the vm rarely
+find the heap full
+=============
+*/
+void ED_CheckStrings (void)
+{
+	if (STRHEAP_TOP < PR_DYNAMIC_STRINGS_BUFF_SIZE / 4 * 3)
+		return;
+	if (STRHEAP_TOP - ed_strlive < PR_DYNAMIC_STRINGS_BUFF_SIZE / 8)
+		return;		// mostly live, collecting every frame would get nothing
+	ED_CollectStrings ();
+}
+
+/*
+=============
+ED_AllocString
+
+Returns NULL if the heap is full
+=============
+*/
+static char *ED_AllocString (char *string, qboolean escapes)
+{
+	char		*new, *new_p;
+	int			i, l, size, ofs;
+	strblock_t	*b, *other;
+
+	l = strlen(string) + 1;
+	size = (sizeof(strblock_t) + l + 3) & ~3;
+	if (STRHEAP_TOP + size > PR_DYNAMIC_STRINGS_BUFF_SIZE)
+	{
+		if (!ED_CollectStrings () || STRHEAP_TOP + size > PR_DYNAMIC_STRINGS_BUFF_SIZE)
+			return NULL;
+	}
+
+	// build the string at the top, it's only kept if it is new
+	b = (strblock_t *)pr_next_dynamic_string;
+	new = new_p = (char *)(b + 1);
 
 	for (i=0 ; i< l ; i++)
 	{
-		if (string[i] == '\\' && i < l-1)
+		if (escapes && string[i] == '\\' && i < l-1)
 		{
 			i++;
 			if (string[i] == 'n')
@@ -729,10 +1188,93 @@ char *ED_NewString (char *string)
 		else
 			*new_p++ = string[i];
 	}
-	
+
+	ed_strstats.allocs++;
+	b->hash = ED_HashString (new);
+	for (ofs = ed_strhash[b->hash & (STRHASH_SIZE-1)] ; ofs ; ofs = other->next)
+	{
+		other = STRBLOCK(ofs);
+		if (other->hash == b->hash && !strcmp (pr_strings + ofs, new))
+		{
+			ed_strstats.interned++;
+			return pr_strings + ofs;
+		}
+	}
+
+	b->size = (sizeof(strblock_t) + (new_p - new) + 3) & ~3;
+	b->next = ed_strhash[b->hash & (STRHASH_SIZE-1)];
+	ed_strhash[b->hash & (STRHASH_SIZE-1)] = new - pr_strings;
+	pr_next_dynamic_string += b->size;
+
 	return new;
 }
 
+/*
+=============
+ED_NewString
+
+Heap strings are shared, they must never be written to. string must not be
+a heap string itself, it may move.
+=============
+*/
+char *ED_NewString (char *string)
+{
+	char	*new;
+
+	new = ED_AllocString (string, true);
+	if (!new)
+		Sys_Error ("ED_NewString: out of string buffer\n");
+	return new;
+}
+
+/*
+=============
+ED_CopyString
+
+For builtins: no escapes, returns NULL if the heap is full
+=============
+*/
+char *ED_CopyString (char *string)
+{
+	return ED_AllocString (string, false);
+}
+
+/*
+=============
+ED_StringStats_f
+
+stringstats : prints the heap usage
+stringstats collect
+=============
+*/
+void ED_StringStats_f (void)
+{
+	int			ofs, count;
+	strblock_t	*b;
+
+	if (!sv.active)
+	{
+		Con_Printf ("no server running\n");
+		return;
+	}
+
+	if (Cmd_Argc () > 1 && !Q_strcmp (Cmd_Argv (1), "collect"))
+		ED_CollectStrings ();
+
+	count = 0;
+	for (ofs=0 ; ofs<STRHEAP_TOP ; ofs += b->size)
+	{
+		b = (strblock_t *)(pr_dynamic_strings + ofs);
+		count++;
+	}
+
+	Con_Printf ("%i strings, %iK of %iK used, %iK live at the last collection\n",
+		count, STRHEAP_TOP / 1024, PR_DYNAMIC_STRINGS_BUFF_SIZE / 1024, ed_strlive / 1024);
+	Con_Printf ("%i allocs, %i interned, %i collections, %iK reclaimed, %.1f ms collecting\n",
+		ed_strstats.allocs, ed_strstats.interned, ed_strstats.collections,
+		ed_strstats.reclaimed / 1024, ed_strstats.time * 1000.0);
+}
+
 
 /*
 =============
@@ -1028,10 +1570,13 @@ void PR_LoadProgs (void)
 
 	pr_functions = (dfunction_t *)((byte *)progs + progs->ofs_functions);
 
-	pr_strings = Hunk_AllocName( progs->numstrings + PR_TMP_STRING_SIZE + PR_DYNAMIC_STRINGS_BUFF_SIZE, "pr_strings" );
+	// the string heap is aligned for its block headers
+	i = (progs->numstrings + PR_TMP_STRING_SIZE + 3) & ~3;
+	pr_strings = Hunk_AllocName( i + PR_DYNAMIC_STRINGS_BUFF_SIZE, "pr_strings" );
 	Q_memcpy( pr_strings, ((char*)progs) + progs->ofs_strings, progs->numstrings );
 	pr_tmp_string = pr_strings + progs->numstrings;
-	pr_next_dynamic_string = pr_dynamic_strings = pr_tmp_string + PR_TMP_STRING_SIZE;
+	pr_dynamic_strings = pr_strings + i;
+	ED_InitStrings ();
 
 	pr_globaldefs = (ddef_t *)((byte *)progs + progs->ofs_globaldefs);
 	pr_fielddefs = (ddef_t *)((byte *)progs + progs->ofs_fielddefs);
@@ -1079,6 +1624,9 @@ void PR_LoadProgs (void)
 
 	for (i=0 ; i<progs->numglobals ; i++)
 		((int *)pr_globals)[i] = LittleLong (((int *)pr_globals)[i]);
+
+	PR_ProfileNewProgs ();
+	PR_JitCompile ();
 }
 
 
@@ -1092,7 +1640,11 @@ void PR_Init (void)
 	Cmd_AddCommand ("edict", ED_PrintEdict_f);
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
+	Cmd_AddCommand ("edictstats", ED_Stats_f);
+	Cmd_AddCommand ("stringstats", ED_StringStats_f);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	Cmd_AddCommand ("prof", PR_Prof_f);
+	PR_InitJit ();
 	Cvar_RegisterVariable (&nomonsters);
 	Cvar_RegisterVariable (&gamecfg);
 	Cvar_RegisterVariable (&scratch1);
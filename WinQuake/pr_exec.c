@@ -323,6 +323,8 @@ int PR_EnterFunction (dfunction_t *f)
 	}
 
 	pr_xfunction = f;
+	if (pr_profiling)
+		PR_ProfileEnter (f);
 	return f->first_statement - 1;	// offset the s++
 }
 
@@ -338,6 +340,9 @@ int PR_LeaveFunction (void)
 	if (pr_depth <= 0)
 		Sys_Error ("prog stack underflow");
 
+	if (pr_profiling)
+		PR_ProfileLeave ();
+
 // restore locals from the stack
 	c = pr_xfunction->locals;
 	localstack_used -= c;
@@ -370,6 +375,7 @@ void PR_ExecuteProgram (func_t fnum)
 	edict_t	*ed;
 	int		exitdepth;
 	eval_t	*ptr;
+	double	starttime;
 
 	if (!fnum || fnum >= progs->numfunctions)
 	{
@@ -385,6 +391,20 @@ void PR_ExecuteProgram (func_t fnum)
 
 // make a stack frame
 	exitdepth = pr_depth;
+	if (pr_profiling && !exitdepth)
+		PR_ProfileClearStack ();
+	starttime = exitdepth ? 0 : Sys_PreciseTime ();
+
+	if (pr_jitfuncs && pr_jitfuncs[fnum] && pr_jit.value && !pr_profiling && pr_jitcheck != JITCHECK_RECORD)
+	{
+		if (pr_jit.value == 2 && !exitdepth && pr_jitcheck == JITCHECK_OFF)
+			PR_JitCheck (fnum);
+		else
+			PR_JitExecute (fnum);
+		if (!exitdepth)
+			sv_stats.progstime += Sys_PreciseTime () - starttime;
+		return;
+	}
 
 	s = PR_EnterFunction (f);
 	
@@ -629,7 +649,16 @@ while (1)
 			i = -newf->first_statement;
 			if (i >= pr_numbuiltins)
 				PR_RunError ("Bad builtin call number");
-			pr_builtins[i] ();
+			if (pr_profiling)
+			{
+				PR_ProfileEnter (newf);
+				pr_builtins[i] ();
+				PR_ProfileLeave ();
+			}
+			else if (pr_jitcheck)
+				PR_JitBuiltin (i);
+			else
+				pr_builtins[i] ();
 			break;
 		}
 
@@ -644,7 +673,11 @@ while (1)
 	
 		s = PR_LeaveFunction ();
 		if (pr_depth == exitdepth)
+		{
+			if (!exitdepth)
+				sv_stats.progstime += Sys_PreciseTime () - starttime;
 			return;		// all done
+		}
 		break;
 		
 	case OP_STATE:
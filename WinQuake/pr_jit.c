@@ -0,0 +1,1226 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_jit.c -- compiles progs functions to x86-64 code
+
+/*
+With "pr_jit 1" (or -jit) every progs function is compiled when the progs
+are loaded, each statement to a few instructions on pr_globals, which is
+kept in rbx. The code does the same as the interpreter in PR_ExecuteProgram,
+float operations included, so both give the same results. Calls go
+through PR_JitCall, which does the stack frame like the interpreter and
+runs builtins, compiled functions or the interpreter for the functions
+that weren't compiled.
+
+The runaway counter and the statement counts of "profile" are updated
+once per block of statements instead of every statement, so a runaway
+loop stops at the start of the block. traceon has no effect on compiled
+functions, and "prof on" makes all the progs interpreted, as they are
+timed by the interpreter.
+
+"pr_jit 2" runs every call from the engine both ways and compares them, see
+PR_JitCheck. pr_jittest.c does the same with random progs that use every
+opcode. There is no jit on windows or other cpus.
+*/
+
+#include "quakedef.h"
+#include <stddef.h>
+
+cvar_t	pr_jit = {"pr_jit", "0"};	// compile progs when they are loaded, 2 - check against the interpreter
+
+jitfunc_t	*pr_jitfuncs;		// NULL - interpreted
+int			pr_jitrunaway;
+
+static byte	*jit_code;
+static int	jit_codesize;
+
+static struct
+{
+	int		functions;
+	int		compiled;
+	int		statements;
+	int		codesize;
+	double	time;
+	int		checks, differences;	// pr_jit 2
+} jit_stats;
+
+
+/*
+====================
+PR_JitCall
+
+Called by the compiled code for OP_CALL
+====================
+*/
+static void PR_JitCall (int fnum, int argc, int statement)
+{
+	dfunction_t	*newf;
+	int			i;
+
+	pr_xstatement = statement;
+	pr_argc = argc;
+	if (!fnum)
+		PR_RunError ("NULL function");
+
+	newf = &pr_functions[fnum];
+
+	if (newf->first_statement < 0)
+	{	// negative statements are built in functions
+		i = -newf->first_statement;
+		if (i >= pr_numbuiltins)
+			PR_RunError ("Bad builtin call number");
+		if (pr_jitcheck)
+			PR_JitBuiltin (i);
+		else
+			pr_builtins[i] ();
+		return;
+	}
+
+	if (!pr_jitfuncs[fnum])
+	{
+		PR_ExecuteProgram (fnum);
+		return;
+	}
+
+	PR_EnterFunction (newf);
+	pr_jitfuncs[fnum] ();
+	PR_LeaveFunction ();
+}
+
+static int PR_JitStrcmp (int a, int b)
+{
+	return strcmp (pr_strings + a, pr_strings + b);
+}
+
+static void PR_JitState (int statement)
+{
+	dstatement_t	*st;
+	edict_t			*ed;
+	eval_t			*a, *b;
+
+	st = &pr_statements[statement];
+	a = (eval_t *)&pr_globals[st->a];
+	b = (eval_t *)&pr_globals[st->b];
+
+	ed = PROG_TO_EDICT(pr_global_struct->self);
+#ifdef FPS_20
+	ed->v.nextthink = pr_global_struct->time + 0.05;
+#else
+	ed->v.nextthink = pr_global_struct->time + 0.1;
+#endif
+	if (a->_float != ed->v.frame)
+	{
+		ed->v.frame = a->_float;
+	}
+	ed->v.think = b->function;
+}
+
+#define	JITERR_RUNAWAY	0
+#define	JITERR_WORLD	1
+
+static void PR_JitError (int statement, int error)
+{
+	pr_xstatement = statement;
+	if (error == JITERR_RUNAWAY)
+		PR_RunError ("runaway loop error");
+	PR_RunError ("assignment to world entity");
+}
+
+/*
+====================
+PR_JitExecute
+
+Runs a compiled function from PR_ExecuteProgram
+====================
+*/
+void PR_JitExecute (func_t fnum)
+{
+	int		runaway;
+
+	runaway = pr_jitrunaway;
+	pr_jitrunaway = 100000;
+
+	PR_EnterFunction (&pr_functions[fnum]);
+	pr_jitfuncs[fnum] ();
+	PR_LeaveFunction ();
+
+	pr_jitrunaway = runaway;
+}
+
+/*
+==============================================================================
+
+					CHECKING
+
+==============================================================================
+*/
+
+/*
+With "pr_jit 2" every call of a compiled function from the engine runs
+twice, first interpreted and then compiled, from the same globals and
+edicts. Builtins only run in the interpreted pass. The globals and the
+edicts they change are recorded and put back when the compiled pass makes
+the same call, so the builtins have their effects once and both passes see
+the same world. The compiled pass must make the same builtin calls with the
+same globals and end with the same globals and edicts, the first difference
+is printed. The interpreted results are kept either way.
+
+Slow, for testing the jit with real progs. The statement counts of
+"profile" count both passes, and strings that builtins write to a static
+buffer, like ftos, hold what the last call of the interpreted pass wrote.
+*/
+
+typedef struct
+{
+	int			builtin;
+	int			argc;
+	unsigned	globals;		// checksum before the call
+	int			numedicts;		// after the call
+	int			data;			// in jit_checkdata: the globals, then the changed edicts
+	int			numchanged;
+} jitcall_t;
+
+int					pr_jitcheck;		// JITCHECK_*
+
+static jitcall_t	*jit_calls;
+static int			jit_numcalls, jit_maxcalls;
+static int			jit_replayed;
+static byte			*jit_checkdata;
+static int			jit_checksize, jit_checkmax;
+static byte			*jit_before, *jit_after, *jit_shadow;	// globals and edicts
+static int			jit_statesize;
+static int			jit_builtindepth;	// builtins called by builtins are only run
+static dfunction_t	*jit_checkfunc;
+static qboolean		jit_differs;
+
+// the payload of a NaN depends on the order the operands were in, which
+// the jit doesn't keep, so all NaNs are the same here
+static unsigned Jit_Bits (unsigned bits)
+{
+	if ((bits & 0x7f800000) == 0x7f800000 && (bits & 0x007fffff))
+		return 0x7fc00000;
+	return bits;
+}
+
+static unsigned Jit_Checksum (byte *data, int size)
+{
+	unsigned	sum;
+	int			i;
+
+	sum = 2166136261u;
+	for (i=0 ; i + 4 <= size ; i += 4)
+		sum = (sum ^ Jit_Bits (*(unsigned *)(data + i))) * 16777619u;
+	return sum;
+}
+
+static void *Jit_Grow (void *buf, int *max, int needed, int itemsize)
+{
+	if (needed <= *max)
+		return buf;
+	*max = needed * 2;
+	buf = realloc (buf, *max * itemsize);
+	if (!buf)
+		Sys_Error ("pr_jit 2: out of memory");
+	return buf;
+}
+
+static void Jit_CheckData (void *data, int size)
+{
+	jit_checkdata = Jit_Grow (jit_checkdata, &jit_checkmax, jit_checksize + size, 1);
+	memcpy (jit_checkdata + jit_checksize, data, size);
+	jit_checksize += size;
+}
+
+static void Jit_SaveState (byte *buf)
+{
+	memcpy (buf, pr_globals, progs->numglobals*4);
+	memcpy (buf + progs->numglobals*4, sv.edicts, sv.num_edicts*pr_edict_size);
+}
+
+static void Jit_RestoreState (byte *buf, int numedicts)
+{
+	memcpy (pr_globals, buf, progs->numglobals*4);
+	memcpy (sv.edicts, buf + progs->numglobals*4, numedicts*pr_edict_size);
+	sv.num_edicts = numedicts;
+}
+
+static char *Jit_BuiltinName (int num)
+{
+	int		i;
+
+	for (i=1 ; i<progs->numfunctions ; i++)
+		if (pr_functions[i].first_statement == -num)
+			return pr_strings + pr_functions[i].s_name;
+	return "?";
+}
+
+static void Jit_Differs (char *fmt, ...)
+{
+	va_list		argptr;
+	char		msg[1024];
+
+	if (jit_differs)
+		return;		// only the first one means anything
+	jit_differs = true;
+	jit_stats.differences++;
+
+	va_start (argptr, fmt);
+	vsprintf (msg, fmt, argptr);
+	va_end (argptr);
+	Con_Printf ("pr_jit 2: %s: %s\n", pr_strings + jit_checkfunc->s_name, msg);
+}
+
+/*
+====================
+PR_JitBuiltin
+
+Runs and records a builtin in the interpreted pass, puts back its changes
+in the compiled pass
+====================
+*/
+void PR_JitBuiltin (int num)
+{
+	jitcall_t	*c;
+	byte		*data, *ed;
+	int			i, numedicts, globalsize;
+
+	globalsize = progs->numglobals*4;
+
+	if (pr_jitcheck == JITCHECK_RECORD)
+	{
+		if (jit_builtindepth)
+		{
+			pr_builtins[num] ();
+			return;
+		}
+
+		jit_calls = Jit_Grow (jit_calls, &jit_maxcalls, jit_numcalls + 1, sizeof(*jit_calls));
+		c = &jit_calls[jit_numcalls++];
+		c->builtin = num;
+		c->argc = pr_argc;
+		c->globals = Jit_Checksum ((byte *)pr_globals, globalsize);
+
+		numedicts = sv.num_edicts;
+		memcpy (jit_shadow, sv.edicts, numedicts*pr_edict_size);
+
+		jit_builtindepth++;
+		pr_builtins[num] ();
+		jit_builtindepth--;
+
+		c->numedicts = sv.num_edicts;
+		c->data = jit_checksize;
+		c->numchanged = 0;
+		Jit_CheckData (pr_globals, globalsize);
+		for (i=0 ; i<sv.num_edicts ; i++)
+		{
+			ed = (byte *)EDICT_NUM(i);
+			if (i < numedicts && !memcmp (ed, jit_shadow + i*pr_edict_size, pr_edict_size))
+				continue;
+			Jit_CheckData (&i, sizeof(i));
+			Jit_CheckData (ed, pr_edict_size);
+			c->numchanged++;
+		}
+		return;
+	}
+
+// the compiled pass
+	if (jit_differs)
+		return;		// nothing to put back any more, the results are thrown away
+	if (jit_replayed == jit_numcalls)
+	{
+		Jit_Differs ("%s calls %s, the interpreter didn't", pr_strings + pr_xfunction->s_name, Jit_BuiltinName (num));
+		return;
+	}
+	c = &jit_calls[jit_replayed++];
+	if (c->builtin != num || c->argc != pr_argc)
+	{
+		Jit_Differs ("%s calls %s, the interpreter called %s", pr_strings + pr_xfunction->s_name,
+			Jit_BuiltinName (num), Jit_BuiltinName (c->builtin));
+		return;
+	}
+	if (c->globals != Jit_Checksum ((byte *)pr_globals, globalsize))
+	{
+		Jit_Differs ("the globals differ when %s calls %s", pr_strings + pr_xfunction->s_name, Jit_BuiltinName (num));
+		return;
+	}
+
+	data = jit_checkdata + c->data;
+	memcpy (pr_globals, data, globalsize);
+	data += globalsize;
+	for (i=0 ; i<c->numchanged ; i++)
+	{
+		memcpy (&numedicts, data, sizeof(numedicts));
+		data += sizeof(numedicts);
+		memcpy (EDICT_NUM(numedicts), data, pr_edict_size);
+		data += pr_edict_size;
+	}
+	sv.num_edicts = c->numedicts;
+}
+
+/*
+====================
+Jit_CompareResults
+====================
+*/
+static void Jit_CompareResults (int numedicts)
+{
+	int		*a, *b;
+	int		i, j, fieldofs;
+	ddef_t	*def;
+
+	if (jit_replayed != jit_numcalls)
+	{
+		Jit_Differs ("doesn't call %s, the interpreter did", Jit_BuiltinName (jit_calls[jit_replayed].builtin));
+		return;
+	}
+
+	a = (int *)pr_globals;
+	b = (int *)jit_after;
+	for (i=0 ; i<progs->numglobals ; i++)
+		if (Jit_Bits (a[i]) != Jit_Bits (b[i]))
+		{
+			def = ED_GlobalAtOfs (i);
+			Jit_Differs ("global %s differs", def ? pr_strings + def->s_name : va("%i", i));
+			return;
+		}
+
+	if (sv.num_edicts != numedicts)
+	{
+		Jit_Differs ("%i edicts, the interpreter has %i", sv.num_edicts, numedicts);
+		return;
+	}
+
+	fieldofs = (int)offsetof(edict_t, v) / 4;
+	for (i=0 ; i<numedicts ; i++)
+	{
+		a = (int *)EDICT_NUM(i);
+		b = (int *)(jit_after + progs->numglobals*4 + i*pr_edict_size);
+		for (j=0 ; j<pr_edict_size/4 ; j++)
+			if (Jit_Bits (a[j]) != Jit_Bits (b[j]))
+			{
+				def = j >= fieldofs ? ED_FieldAtOfs (j - fieldofs) : NULL;
+				Jit_Differs ("edict %i %s differs", i, def ? pr_strings + def->s_name : "header");
+				return;
+			}
+	}
+}
+
+/*
+====================
+PR_JitCheck
+
+Called by PR_ExecuteProgram for the calls from the engine with "pr_jit 2"
+====================
+*/
+void PR_JitCheck (func_t fnum)
+{
+	int		size, before, after;
+
+	size = progs->numglobals*4 + sv.max_edicts*pr_edict_size;
+	if (size != jit_statesize)
+	{
+		free (jit_before);
+		free (jit_after);
+		free (jit_shadow);
+		jit_before = malloc (size);
+		jit_after = malloc (size);
+		jit_shadow = malloc (size);
+		if (!jit_before || !jit_after || !jit_shadow)
+			Sys_Error ("pr_jit 2: out of memory");
+		jit_statesize = size;
+	}
+
+	jit_checkfunc = &pr_functions[fnum];
+	jit_numcalls = 0;
+	jit_checksize = 0;
+	jit_replayed = 0;
+	jit_builtindepth = 0;	// a Host_Error from a builtin ends a check anywhere
+	jit_differs = false;
+	jit_stats.checks++;
+
+	before = sv.num_edicts;
+	Jit_SaveState (jit_before);
+
+	pr_jitcheck = JITCHECK_RECORD;
+	PR_ExecuteProgram (fnum);
+
+	after = sv.num_edicts;
+	Jit_SaveState (jit_after);
+	Jit_RestoreState (jit_before, before);
+
+	pr_jitcheck = JITCHECK_REPLAY;
+	PR_JitExecute (fnum);
+	pr_jitcheck = JITCHECK_OFF;
+
+	Jit_CompareResults (after);
+	Jit_RestoreState (jit_after, after);
+}
+
+//============================================================================
+
+// PR_RunError longjmps out of the generated code. Win64 longjmp unwinds the
+// frames it skips and the generated functions have no unwind data, so there
+// is no jit on windows.
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_WIN32)
+
+/*
+==============================================================================
+
+					CODE GENERATION
+
+==============================================================================
+*/
+
+#define	MAX_STATEMENT_CODE	192		// no statement takes more
+
+typedef struct
+{
+	int		at;			// rel32 to patch
+	int		target;		// statement
+} jitfixup_t;
+
+static byte			*jit_p, *jit_end;
+static int			*jit_stofs;		// code offset of every statement
+static byte			*jit_leader;	// statement starts a block
+static jitfixup_t	*jit_fixups;
+static int			jit_numfixups;
+
+// first three integer arguments
+#define	JIT_ARG0	7		// edi
+#define	JIT_ARG1	6		// esi
+#define	JIT_ARG2	2		// edx
+
+// condition codes
+#define	CC_AE	0x3
+#define	CC_E	0x4
+#define	CC_NE	0x5
+#define	CC_A	0x7
+#define	CC_P	0xa
+#define	CC_NP	0xb
+#define	CC_G	0xf
+
+// registers
+#define	EAX		0
+#define	ECX		1
+#define	EDX		2
+
+static void Jit_Byte (int b)
+{
+	*jit_p++ = b;
+}
+
+static void Jit_Bytes (int count, int b0, int b1, int b2, int b3)
+{
+	Jit_Byte (b0);
+	if (count > 1)
+		Jit_Byte (b1);
+	if (count > 2)
+		Jit_Byte (b2);
+	if (count > 3)
+		Jit_Byte (b3);
+}
+
+static void Jit_Int (int i)
+{
+	memcpy (jit_p, &i, 4);
+	jit_p += 4;
+}
+
+static void Jit_Pointer (void *p)
+{
+	memcpy (jit_p, &p, sizeof(p));
+	jit_p += sizeof(p);
+}
+
+// [rbx + ofs*4] with reg in the modrm byte
+static void Jit_Global (int reg, int ofs)
+{
+	Jit_Byte (0x83 | (reg << 3));
+	Jit_Int (ofs * 4);
+}
+
+// mov reg, [rbx + ofs*4]
+static void Jit_LoadInt (int reg, int ofs)
+{
+	Jit_Byte (0x8b);
+	Jit_Global (reg, ofs);
+}
+
+// mov [rbx + ofs*4], reg
+static void Jit_StoreInt (int reg, int ofs)
+{
+	Jit_Byte (0x89);
+	Jit_Global (reg, ofs);
+}
+
+// movsxd reg64, [rbx + ofs*4]
+static void Jit_LoadIntSigned (int reg, int ofs)
+{
+	Jit_Bytes (2, 0x48, 0x63, 0, 0);
+	Jit_Global (reg, ofs);
+}
+
+// an sse op xmm, [rbx + ofs*4]: movss load 0x10, store 0x11, add 0x58,
+// mul 0x59, sub 0x5c, div 0x5e
+static void Jit_Sse (int op, int xmm, int ofs)
+{
+	Jit_Bytes (3, 0xf3, 0x0f, op, 0);
+	Jit_Global (xmm, ofs);
+}
+
+// ucomiss xmm0, [rbx + ofs*4]
+static void Jit_CompareFloat (int ofs)
+{
+	Jit_Bytes (2, 0x0f, 0x2e, 0, 0);
+	Jit_Global (0, ofs);
+}
+
+// mov reg, imm32
+static void Jit_MoveImm (int reg, int imm)
+{
+	if (reg >= 8)
+		Jit_Byte (0x41);
+	Jit_Byte (0xb8 + (reg & 7));
+	Jit_Int (imm);
+}
+
+// mov rax / rcx, imm64
+static void Jit_MovePointer (int reg, void *p)
+{
+	Jit_Bytes (2, 0x48, 0xb8 + reg, 0, 0);
+	Jit_Pointer (p);
+}
+
+static void Jit_CallHelper (void *func)
+{
+	Jit_MovePointer (EAX, func);
+	Jit_Bytes (2, 0xff, 0xd0, 0, 0);	// call rax
+}
+
+// setcc reg8
+static void Jit_SetCC (int cc, int reg)
+{
+	Jit_Bytes (3, 0x0f, 0x90 | cc, 0xc0 | reg, 0);
+}
+
+// jcc rel32 to a statement, cc -1 for jmp
+static void Jit_Jump (int cc, int target)
+{
+	if (cc < 0)
+		Jit_Byte (0xe9);
+	else
+		Jit_Bytes (2, 0x0f, 0x80 | cc, 0, 0);
+	jit_fixups[jit_numfixups].at = jit_p - jit_code;
+	jit_fixups[jit_numfixups].target = target;
+	jit_numfixups++;
+	Jit_Int (0);
+}
+
+// jcc rel8 forward, returns the place to patch with Jit_Label
+static byte *Jit_JumpShort (int cc)
+{
+	Jit_Bytes (2, 0x70 | cc, 0, 0, 0);
+	return jit_p;
+}
+
+static void Jit_Label (byte *jump)
+{
+	jump[-1] = jit_p - jump;
+}
+
+// al = float at ofs compared to 0.0 with the C rules: != 0 if ne, else == 0
+static void Jit_FloatIsZero (int ofs, qboolean ne, int reg)
+{
+	Jit_Bytes (3, 0x0f, 0x57, 0xc9, 0);		// xorps xmm1, xmm1
+	Jit_Sse (0x10, 0, ofs);
+	Jit_Bytes (3, 0x0f, 0x2e, 0xc1, 0);		// ucomiss xmm0, xmm1
+	Jit_SetCC (ne ? CC_NE : CC_E, reg);
+	Jit_SetCC (ne ? CC_P : CC_NP, 4 + reg);	// ah / ch as a temp
+	Jit_Bytes (2, ne ? 0x08 : 0x20, 0xc0 | ((4 + reg) << 3) | reg, 0, 0);	// or / and
+}
+
+// al = a == b, or a != b if ne
+static void Jit_FloatEqual (int a, int b, qboolean ne, int reg)
+{
+	Jit_Sse (0x10, 0, a);
+	Jit_CompareFloat (b);
+	Jit_SetCC (ne ? CC_NE : CC_E, reg);
+	Jit_SetCC (ne ? CC_P : CC_NP, 4 + reg);
+	Jit_Bytes (2, ne ? 0x08 : 0x20, 0xc0 | ((4 + reg) << 3) | reg, 0, 0);
+}
+
+// c = al as 0.0 or 1.0
+static void Jit_StoreBool (int c)
+{
+	Jit_Bytes (3, 0x0f, 0xb6, 0xc0, 0);		// movzx eax, al
+	Jit_Bytes (4, 0xf3, 0x0f, 0x2a, 0xc0);	// cvtsi2ss xmm0, eax
+	Jit_Sse (0x11, 0, c);
+}
+
+// rax = sv.edicts
+static void Jit_LoadEdicts (void)
+{
+	Jit_MovePointer (EAX, &sv.edicts);
+	Jit_Bytes (3, 0x48, 0x8b, 0x00, 0);		// mov rax, [rax]
+}
+
+/*
+====================
+Jit_Statement
+
+Returns false for statements that can't be compiled
+====================
+*/
+static qboolean Jit_Statement (int s)
+{
+	dstatement_t	*st;
+	int				a, b, c, i;
+	byte			*skip;
+
+	st = &pr_statements[s];
+	a = st->a;
+	b = st->b;
+	c = st->c;
+
+	switch (st->op)
+	{
+	case OP_ADD_F:
+	case OP_SUB_F:
+	case OP_MUL_F:
+	case OP_DIV_F:
+		Jit_Sse (0x10, 0, a);
+		Jit_Sse (st->op == OP_ADD_F ? 0x58 : st->op == OP_SUB_F ? 0x5c : st->op == OP_MUL_F ? 0x59 : 0x5e, 0, b);
+		Jit_Sse (0x11, 0, c);
+		break;
+
+	case OP_ADD_V:
+	case OP_SUB_V:
+		for (i=0 ; i<3 ; i++)
+		{
+			Jit_Sse (0x10, 0, a+i);
+			Jit_Sse (st->op == OP_ADD_V ? 0x58 : 0x5c, 0, b+i);
+			Jit_Sse (0x11, 0, c+i);
+		}
+		break;
+
+	case OP_MUL_V:
+		Jit_Sse (0x10, 0, a);
+		Jit_Sse (0x59, 0, b);
+		Jit_Sse (0x10, 1, a+1);
+		Jit_Sse (0x59, 1, b+1);
+		Jit_Bytes (4, 0xf3, 0x0f, 0x58, 0xc1);	// addss xmm0, xmm1
+		Jit_Sse (0x10, 1, a+2);
+		Jit_Sse (0x59, 1, b+2);
+		Jit_Bytes (4, 0xf3, 0x0f, 0x58, 0xc1);
+		Jit_Sse (0x11, 0, c);
+		break;
+
+	case OP_MUL_FV:
+	case OP_MUL_VF:
+		for (i=0 ; i<3 ; i++)
+		{
+			if (st->op == OP_MUL_FV)
+			{
+				Jit_Sse (0x10, 0, a);
+				Jit_Sse (0x59, 0, b+i);
+			}
+			else
+			{
+				Jit_Sse (0x10, 0, b);
+				Jit_Sse (0x59, 0, a+i);
+			}
+			Jit_Sse (0x11, 0, c+i);
+		}
+		break;
+
+	case OP_BITAND:
+	case OP_BITOR:
+		Jit_Bytes (3, 0xf3, 0x0f, 0x2c, 0);		// cvttss2si eax
+		Jit_Global (EAX, a);
+		Jit_Bytes (3, 0xf3, 0x0f, 0x2c, 0);		// cvttss2si ecx
+		Jit_Global (ECX, b);
+		Jit_Bytes (2, st->op == OP_BITAND ? 0x21 : 0x09, 0xc8, 0, 0);	// and / or eax, ecx
+		Jit_Bytes (4, 0xf3, 0x0f, 0x2a, 0xc0);	// cvtsi2ss xmm0, eax
+		Jit_Sse (0x11, 0, c);
+		break;
+
+	// unordered compares set CF, so these are false for NaNs like in C
+	case OP_GE:
+	case OP_GT:
+		Jit_Sse (0x10, 0, a);
+		Jit_CompareFloat (b);
+		Jit_SetCC (st->op == OP_GE ? CC_AE : CC_A, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_LE:
+	case OP_LT:
+		Jit_Sse (0x10, 0, b);
+		Jit_CompareFloat (a);
+		Jit_SetCC (st->op == OP_LE ? CC_AE : CC_A, EAX);
+		Jit_StoreBool (c);
+		break;
+
+	case OP_AND:
+	case OP_OR:
+		Jit_FloatIsZero (a, true, EAX);
+		Jit_FloatIsZero (b, true, ECX);
+		Jit_Bytes (2, st->op == OP_AND ? 0x20 : 0x08, 0xc8, 0, 0);	// and / or al, cl
+		Jit_StoreBool (c);
+		break;
+
+	case OP_NOT_F:
+		Jit_FloatIsZero (a, false, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_NOT_V:
+		Jit_FloatIsZero (a, false, EAX);
+		Jit_FloatIsZero (a+1, false, ECX);
+		Jit_Bytes (2, 0x20, 0xc8, 0, 0);			// and al, cl
+		Jit_FloatIsZero (a+2, false, ECX);
+		Jit_Bytes (2, 0x20, 0xc8, 0, 0);
+		Jit_StoreBool (c);
+		break;
+	case OP_NOT_S:
+		Jit_LoadIntSigned (EAX, a);
+		Jit_Bytes (2, 0x85, 0xc0, 0, 0);			// test eax, eax
+		skip = Jit_JumpShort (CC_E);				// al = 1 from sete
+		Jit_MovePointer (ECX, pr_strings);
+		Jit_Bytes (4, 0x80, 0x3c, 0x01, 0x00);	// cmp byte [rcx+rax], 0
+		Jit_Label (skip);
+		Jit_SetCC (CC_E, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_NOT_FNC:
+	case OP_NOT_ENT:
+		Jit_Bytes (1, 0x83, 0, 0, 0);				// cmp dword [a], 0
+		Jit_Global (7, a);
+		Jit_Byte (0);
+		Jit_SetCC (CC_E, EAX);
+		Jit_StoreBool (c);
+		break;
+
+	case OP_EQ_F:
+	case OP_NE_F:
+		Jit_FloatEqual (a, b, st->op == OP_NE_F, EAX);
+		Jit_StoreBool (c);
+		break;
+	case OP_EQ_V:
+	case OP_NE_V:
+		Jit_FloatEqual (a, b, st->op == OP_NE_V, EAX);
+		Jit_FloatEqual (a+1, b+1, st->op == OP_NE_V, ECX);
+		Jit_Bytes (2, st->op == OP_NE_V ? 0x08 : 0x20, 0xc8, 0, 0);
+		Jit_FloatEqual (a+2, b+2, st->op == OP_NE_V, ECX);
+		Jit_Bytes (2, st->op == OP_NE_V ? 0x08 : 0x20, 0xc8, 0, 0);
+		Jit_StoreBool (c);
+		break;
+	case OP_EQ_S:
+	case OP_NE_S:
+		Jit_LoadInt (JIT_ARG0, a);
+		Jit_LoadInt (JIT_ARG1, b);
+		Jit_CallHelper (PR_JitStrcmp);
+		if (st->op == OP_EQ_S)
+		{
+			Jit_Bytes (2, 0x85, 0xc0, 0, 0);		// test eax, eax
+			Jit_SetCC (CC_E, EAX);
+			Jit_StoreBool (c);
+		}
+		else
+		{	// the value of strcmp
+			Jit_Bytes (4, 0xf3, 0x0f, 0x2a, 0xc0);
+			Jit_Sse (0x11, 0, c);
+		}
+		break;
+	case OP_EQ_E:
+	case OP_EQ_FNC:
+	case OP_NE_E:
+	case OP_NE_FNC:
+		Jit_LoadInt (EAX, a);
+		Jit_Byte (0x3b);							// cmp eax, [b]
+		Jit_Global (EAX, b);
+		Jit_SetCC (st->op == OP_EQ_E || st->op == OP_EQ_FNC ? CC_E : CC_NE, EAX);
+		Jit_StoreBool (c);
+		break;
+
+	case OP_STORE_F:
+	case OP_STORE_ENT:
+	case OP_STORE_FLD:
+	case OP_STORE_S:
+	case OP_STORE_FNC:
+		Jit_LoadInt (EAX, a);
+		Jit_StoreInt (EAX, b);
+		break;
+	case OP_STORE_V:
+		for (i=0 ; i<3 ; i++)
+		{
+			Jit_LoadInt (EAX, a+i);
+			Jit_StoreInt (EAX, b+i);
+		}
+		break;
+
+	case OP_STOREP_F:
+	case OP_STOREP_ENT:
+	case OP_STOREP_FLD:
+	case OP_STOREP_S:
+	case OP_STOREP_FNC:
+	case OP_STOREP_V:
+		Jit_LoadEdicts ();
+		Jit_LoadIntSigned (ECX, b);
+		for (i=0 ; i<(st->op == OP_STOREP_V ? 3 : 1) ; i++)
+		{
+			Jit_LoadInt (EDX, a+i);
+			Jit_Bytes (4, 0x89, 0x54, 0x08, i*4);	// mov [rax+rcx+i*4], edx
+		}
+		break;
+
+	case OP_ADDRESS:
+		Jit_LoadInt (EAX, a);
+		Jit_Bytes (2, 0x85, 0xc0, 0, 0);			// test eax, eax
+		skip = Jit_JumpShort (CC_NE);
+		Jit_MovePointer (ECX, &sv.state);
+		Jit_Bytes (3, 0x83, 0x39, ss_active, 0);	// cmp dword [rcx], ss_active
+		Jit_Label (skip);
+		skip = Jit_JumpShort (CC_NE);
+		Jit_MoveImm (JIT_ARG0, s);
+		Jit_MoveImm (JIT_ARG1, JITERR_WORLD);
+		Jit_CallHelper (PR_JitError);
+		Jit_Label (skip);
+		Jit_LoadInt (EAX, a);
+		Jit_LoadInt (ECX, b);
+		Jit_Bytes (3, 0xc1, 0xe1, 0x02, 0);		// shl ecx, 2
+		Jit_Bytes (2, 0x01, 0xc8, 0, 0);			// add eax, ecx
+		Jit_Byte (0x05);							// add eax, imm32
+		Jit_Int ((int)offsetof(edict_t, v));
+		Jit_StoreInt (EAX, c);
+		break;
+
+	case OP_LOAD_F:
+	case OP_LOAD_FLD:
+	case OP_LOAD_ENT:
+	case OP_LOAD_S:
+	case OP_LOAD_FNC:
+	case OP_LOAD_V:
+		Jit_LoadEdicts ();
+		Jit_LoadIntSigned (ECX, a);
+		Jit_Bytes (3, 0x48, 0x01, 0xc8, 0);		// add rax, rcx
+		Jit_LoadIntSigned (ECX, b);
+		for (i=0 ; i<(st->op == OP_LOAD_V ? 3 : 1) ; i++)
+		{
+			Jit_Bytes (3, 0x8b, 0x94, 0x88, 0);	// mov edx, [rax+rcx*4+disp32]
+			Jit_Int ((int)offsetof(edict_t, v) + i*4);
+			Jit_StoreInt (EDX, c+i);
+		}
+		break;
+
+	case OP_IFNOT:
+	case OP_IF:
+		Jit_Bytes (1, 0x83, 0, 0, 0);				// cmp dword [a], 0
+		Jit_Global (7, a);
+		Jit_Byte (0);
+		Jit_Jump (st->op == OP_IF ? CC_NE : CC_E, s + b);
+		break;
+
+	case OP_GOTO:
+		Jit_Jump (-1, s + a);
+		break;
+
+	case OP_CALL0:
+	case OP_CALL1:
+	case OP_CALL2:
+	case OP_CALL3:
+	case OP_CALL4:
+	case OP_CALL5:
+	case OP_CALL6:
+	case OP_CALL7:
+	case OP_CALL8:
+		Jit_LoadInt (JIT_ARG0, a);
+		Jit_MoveImm (JIT_ARG1, st->op - OP_CALL0);
+		Jit_MoveImm (JIT_ARG2, s);
+		Jit_CallHelper (PR_JitCall);
+		break;
+
+	case OP_DONE:
+	case OP_RETURN:
+		for (i=0 ; i<3 ; i++)
+		{
+			Jit_LoadInt (EAX, a+i);
+			Jit_StoreInt (EAX, OFS_RETURN+i);
+		}
+		Jit_Bytes (2, 0x5b, 0xc3, 0, 0);			// pop rbx, ret
+		break;
+
+	case OP_STATE:
+		Jit_MoveImm (JIT_ARG0, s);
+		Jit_CallHelper (PR_JitState);
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/*
+====================
+Jit_Block
+
+Counts the statements of a block for the runaway check and "profile"
+====================
+*/
+static void Jit_Block (int s, int count, dfunction_t *f)
+{
+	byte	*skip;
+
+	Jit_MovePointer (EAX, &pr_jitrunaway);
+	Jit_Bytes (2, 0x81, 0x28, 0, 0);			// sub dword [rax], count
+	Jit_Int (count);
+	skip = Jit_JumpShort (CC_G);
+	Jit_MoveImm (JIT_ARG0, s);
+	Jit_MoveImm (JIT_ARG1, JITERR_RUNAWAY);
+	Jit_CallHelper (PR_JitError);
+	Jit_Label (skip);
+
+	Jit_MovePointer (EAX, &f->profile);
+	Jit_Bytes (2, 0x81, 0x00, 0, 0);			// add dword [rax], count
+	Jit_Int (count);
+}
+
+/*
+====================
+Jit_Function
+
+Compiles the statements first to last - 1, returns NULL if the function
+has anything that can't be compiled
+====================
+*/
+static jitfunc_t Jit_Function (dfunction_t *f, int first, int last)
+{
+	byte			*start;
+	dstatement_t	*st;
+	int				s, next, target, op;
+
+	if (last <= first)
+		return NULL;
+	if ((jit_end - jit_p) < (last - first) * MAX_STATEMENT_CODE + 64)
+		return NULL;
+
+// find the blocks and check the jumps stay inside
+	for (s=first ; s<last ; s++)
+		jit_leader[s] = false;
+	jit_leader[first] = true;
+	for (s=first ; s<last ; s++)
+	{
+		st = &pr_statements[s];
+		op = st->op;
+		if (op == OP_IF || op == OP_IFNOT || op == OP_GOTO)
+		{
+			target = s + (op == OP_GOTO ? st->a : st->b);
+			if (target < first || target >= last)
+				return NULL;
+			jit_leader[target] = true;
+		}
+		if ((op == OP_IF || op == OP_IFNOT || op == OP_GOTO || (op >= OP_CALL0 && op <= OP_CALL8)
+			|| op == OP_DONE || op == OP_RETURN) && s + 1 < last)
+			jit_leader[s+1] = true;
+	}
+	// the interpreter would run into the next function
+	op = pr_statements[last-1].op;
+	if (op != OP_DONE && op != OP_RETURN && op != OP_GOTO)
+		return NULL;
+
+	start = jit_p;
+	jit_numfixups = 0;
+
+	Jit_Byte (0x53);							// push rbx
+	Jit_Bytes (2, 0x48, 0xbb, 0, 0);			// mov rbx, pr_globals
+	Jit_Pointer (pr_globals);
+
+	for (s=first ; s<last ; s++)
+	{
+		jit_stofs[s] = jit_p - jit_code;
+		if (jit_leader[s])
+		{
+			for (next=s+1 ; next<last && !jit_leader[next] ; next++)
+				;
+			Jit_Block (s, next - s, f);
+		}
+		if (!Jit_Statement (s))
+		{
+			jit_p = start;
+			return NULL;
+		}
+	}
+
+	for (s=0 ; s<jit_numfixups ; s++)
+	{
+		target = jit_stofs[jit_fixups[s].target] - (jit_fixups[s].at + 4);
+		memcpy (jit_code + jit_fixups[s].at, &target, 4);
+	}
+
+	jit_stats.statements += last - first;
+	return (jitfunc_t)start;
+}
+
+static int		*jit_order;
+
+static int Jit_CompareStarts (const void *a, const void *b)
+{
+	return pr_functions[*(int *)a].first_statement - pr_functions[*(int *)b].first_statement;
+}
+
+/*
+====================
+PR_JitCompile
+
+Compiles all the progs functions, called from PR_LoadProgs
+====================
+*/
+void PR_JitCompile (void)
+{
+	int		i, j, count, fnum, last;
+	double	time;
+
+	PR_JitFree ();
+	if (!pr_jit.value)
+		return;
+
+	time = Sys_PreciseTime ();
+	Q_memset (&jit_stats, 0, sizeof(jit_stats));
+
+	jit_codesize = progs->numstatements * MAX_STATEMENT_CODE + progs->numfunctions * 64;
+	jit_code = Sys_AllocCode (jit_codesize);
+	jit_stofs = malloc (progs->numstatements * sizeof(*jit_stofs));
+	jit_leader = malloc (progs->numstatements);
+	jit_fixups = malloc (progs->numstatements * sizeof(*jit_fixups));
+	jit_order = malloc (progs->numfunctions * sizeof(*jit_order));
+	pr_jitfuncs = Hunk_AllocName (progs->numfunctions * sizeof(*pr_jitfuncs), "jitfuncs");
+	if (!jit_code || !jit_stofs || !jit_leader || !jit_fixups || !jit_order)
+	{
+		Con_Printf ("PR_JitCompile: not enough memory\n");
+		free (jit_stofs);
+		free (jit_leader);
+		free (jit_fixups);
+		free (jit_order);
+		PR_JitFree ();
+		return;
+	}
+	jit_p = jit_code;
+	jit_end = jit_code + jit_codesize;
+
+// a function ends where the next one starts
+	count = 0;
+	for (i=1 ; i<progs->numfunctions ; i++)
+		if (pr_functions[i].first_statement > 0)
+			jit_order[count++] = i;
+	qsort (jit_order, count, sizeof(*jit_order), Jit_CompareStarts);
+
+	for (i=0 ; i<count ; i++)
+	{
+		fnum = jit_order[i];
+		for (j=i+1 ; j<count && pr_functions[jit_order[j]].first_statement == pr_functions[fnum].first_statement ; j++)
+			;
+		last = j < count ? pr_functions[jit_order[j]].first_statement : progs->numstatements;
+		pr_jitfuncs[fnum] = Jit_Function (&pr_functions[fnum], pr_functions[fnum].first_statement, last);
+		if (pr_jitfuncs[fnum])
+			jit_stats.compiled++;
+	}
+
+	free (jit_stofs);
+	free (jit_leader);
+	free (jit_fixups);
+	free (jit_order);
+	jit_stofs = NULL;
+	jit_leader = NULL;
+	jit_fixups = NULL;
+	jit_order = NULL;
+
+	if (!Sys_MakeCodeExecutable (jit_code, jit_codesize))
+	{
+		Con_Printf ("PR_JitCompile: couldn't make the code executable\n");
+		PR_JitFree ();
+		return;
+	}
+
+	jit_stats.functions = count;
+	jit_stats.codesize = jit_p - jit_code;
+	jit_stats.time = Sys_PreciseTime () - time;
+	Con_DPrintf ("jit: %i of %i functions, %i statements, %iK code, %.1f ms\n", jit_stats.compiled,
+		jit_stats.functions, jit_stats.statements, jit_stats.codesize / 1024, jit_stats.time * 1000.0);
+}
+
+#else
+
+void PR_JitCompile (void)
+{
+	PR_JitFree ();
+	if (pr_jit.value)
+		Con_DPrintf ("no progs jit for this platform\n");
+}
+
+#endif
+
+/*
+====================
+PR_JitFree
+====================
+*/
+void PR_JitFree (void)
+{
+	pr_jitcheck = JITCHECK_OFF;
+	// pr_jitfuncs is on the hunk with the progs
+	pr_jitfuncs = NULL;
+	if (jit_code)
+		Sys_FreeCode (jit_code, jit_codesize);
+	jit_code = NULL;
+	jit_codesize = 0;
+}
+
+/*
+====================
+PR_JitStats_f
+====================
+*/
+void PR_JitStats_f (void)
+{
+	if (!pr_jitfuncs)
+	{
+		Con_Printf ("progs are interpreted%s\n", pr_jit.value ? ", the jit starts with the next map" : "");
+		return;
+	}
+	Con_Printf ("%i of %i functions compiled, %i statements, %iK code, %.1f ms\n", jit_stats.compiled,
+		jit_stats.functions, jit_stats.statements, jit_stats.codesize / 1024, jit_stats.time * 1000.0);
+	if (!pr_jit.value)
+		Con_Printf ("pr_jit is 0, the code isn't used\n");
+	if (jit_stats.checks)
+		Con_Printf ("%i calls checked against the interpreter, %i differed\n", jit_stats.checks, jit_stats.differences);
+}
+
+/*
+====================
+PR_InitJit
+====================
+*/
+void PR_InitJit (void)
+{
+	Cvar_RegisterVariable (&pr_jit);
+	Cmd_AddCommand ("jitstats", PR_JitStats_f);
+	if (COM_CheckParm ("-jit"))
+		Cvar_SetValue ("pr_jit", 1);
+}
@@ -0,0 +1,626 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_jittest.c -- checks the progs jit against the interpreter
+
+/*
+A program of its own, only pr_exec.c and pr_jit.c of the engine are linked
+in ("make pr_jittest" with cmake, or cc -fcommon pr_jittest.c pr_exec.c
+pr_jit.c -lm).
+
+Every seed builds random progs with all the opcodes the jit compiles, calls,
+loops, state changes and builtins that call back into the progs, and runs
+one of their functions from the same globals and edicts three times: with
+the interpreter, compiled, and with "pr_jit 2". The compiled run must end
+with the same globals and edicts bit for bit, except for the payloads of
+NaNs, or with the same run time error. The "pr_jit 2" run must report no
+difference and keep the results of the interpreter.
+
+	pr_jittest [seeds]
+
+Exits with 1 if anything differed. This checks the code generator, with
+real progs "pr_jit 2" does the same check in the engine.
+*/
+
+#include "quakedef.h"
+#include <setjmp.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define	NUMGLOBALS	4096
+#define	NUMFUNCS	24		// progs functions, the builtins come after them
+#define	NUMEDICTS	8
+#define	NUMFIELDS	30		// past entvars_t
+#define	NUMGENERAL	600		// globals the statements work on
+#define	MAX_TESTSTATEMENTS	200000
+#define	MAX_EDICT_SIZE_TEST	1024
+
+// what the engine would have
+dprograms_t		*progs;
+dfunction_t		*pr_functions;
+dstatement_t	*pr_statements;
+globalvars_t	*pr_global_struct;
+float			*pr_globals;
+char			*pr_strings;
+builtin_t		*pr_builtins;
+int				pr_numbuiltins;
+int				pr_edict_size;
+qboolean		pr_profiling;
+server_t		sv;
+server_stats_t	sv_stats;
+
+extern int		pr_depth, localstack_used;
+
+static jmp_buf	test_abort;
+static int		test_errors;
+static int		test_reports;		// "pr_jit 2" messages
+static qboolean	test_verbose;
+
+//============================================================================
+
+void Host_Error (char *error, ...)
+{
+	test_errors++;
+	pr_jitcheck = JITCHECK_OFF;
+	longjmp (test_abort, 1);
+}
+
+void Sys_Error (char *error, ...)
+{
+	va_list		argptr;
+
+	va_start (argptr, error);
+	vprintf (error, argptr);
+	va_end (argptr);
+	printf ("\n");
+	exit (1);
+}
+
+void Con_Printf (char *fmt, ...)
+{
+	va_list		argptr;
+	char		msg[1024];
+
+	va_start (argptr, fmt);
+	vsnprintf (msg, sizeof(msg), fmt, argptr);
+	va_end (argptr);
+	if (!strncmp (msg, "pr_jit 2", 8))
+	{
+		test_reports++;
+		if (test_verbose)
+			printf ("%s", msg);
+	}
+}
+
+void Con_DPrintf (char *fmt, ...)
+{
+}
+
+char *va (char *format, ...)
+{
+	va_list		argptr;
+	static char	string[1024];
+
+	va_start (argptr, format);
+	vsnprintf (string, sizeof(string), format, argptr);
+	va_end (argptr);
+	return string;
+}
+
+void Cvar_RegisterVariable (cvar_t *variable) {}
+void Cvar_SetValue (char *var_name, float value) {}
+void Cmd_AddCommand (char *cmd_name, xcommand_t function) {}
+int COM_CheckParm (char *parm) { return 0; }
+void Q_memset (void *dest, int fill, int count) { memset (dest, fill, count); }
+void *Hunk_AllocName (int size, char *name) { return calloc (1, size); }
+
+void ED_Print (edict_t *ed) {}
+ddef_t *ED_GlobalAtOfs (int ofs) { return NULL; }
+ddef_t *ED_FieldAtOfs (int ofs) { return NULL; }
+char *PR_GlobalString (int ofs) { return ""; }
+char *PR_GlobalStringNoContents (int ofs) { return ""; }
+void PR_ProfileClearStack (void) {}
+void PR_ProfileEnter (dfunction_t *f) {}
+void PR_ProfileLeave (void) {}
+
+edict_t *EDICT_NUM (int n)
+{
+	return (edict_t *)((byte *)sv.edicts + n*pr_edict_size);
+}
+
+void *Sys_AllocCode (int size)
+{
+	void	*code;
+
+	code = mmap (NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	return code == MAP_FAILED ? NULL : code;
+}
+
+qboolean Sys_MakeCodeExecutable (void *code, int size)
+{
+	return mprotect (code, size, PROT_READ|PROT_EXEC) == 0;
+}
+
+void Sys_FreeCode (void *code, int size)
+{
+	munmap (code, size);
+}
+
+double Sys_PreciseTime (void)
+{
+	struct timespec	ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+//============================================================================
+
+/*
+Global layout of the test progs, after globalvars_t:
+ofs_ent		8 edict references
+ofs_field	8 field offsets
+ofs_pointer	8 pointers written by OP_ADDRESS
+ofs_string	8 strings
+ofs_func	the 3 builtins, then every function
+ofs_const	0, 1, 3, -2.5
+ofs_general	what the statements read and write
+ofs_locals	the locals of every function
+*/
+static int	ofs_ent, ofs_field, ofs_pointer, ofs_string, ofs_func, ofs_const, ofs_general, ofs_locals;
+
+static int	localbase[NUMFUNCS+1], localsize[NUMFUNCS+1];
+
+static dstatement_t	statements[MAX_TESTSTATEMENTS];
+static int			numstatements;
+static dfunction_t	functions[NUMFUNCS+4];
+static dprograms_t	testprogs;
+
+static char	strings[256] = "\0hello\0world\0hello\0\0abc\0";
+static int	stringofs[6] = {0, 1, 7, 13, 19, 20};
+
+static unsigned	randseed;
+
+static unsigned Test_Rand (void)
+{
+	randseed = randseed*1103515245 + 12345;
+	return randseed >> 8;
+}
+
+static int Test_RandInt (int n)
+{
+	return Test_Rand () % n;
+}
+
+static void Test_Emit (int op, int a, int b, int c)
+{
+	if (numstatements == MAX_TESTSTATEMENTS)
+		Sys_Error ("too many statements");
+	statements[numstatements].op = op;
+	statements[numstatements].a = a;
+	statements[numstatements].b = b;
+	statements[numstatements].c = c;
+	numstatements++;
+}
+
+static int Test_ReadOfs (void)
+{
+	int		k;
+
+	k = Test_RandInt (10);
+	if (k < 6)
+		return ofs_general + Test_RandInt (NUMGENERAL-3);
+	if (k < 7)
+		return ofs_const + Test_RandInt (4);
+	if (k < 8)
+		return ofs_ent + Test_RandInt (8);
+	if (k < 9)
+		return 1 + Test_RandInt (27);		// return value and parms
+	return ofs_ent + Test_RandInt (ofs_general - ofs_ent);
+}
+
+static int Test_WriteOfs (int f)
+{
+	if (!Test_RandInt (4) && localsize[f] > 4)
+		return localbase[f] + 1 + Test_RandInt (localsize[f] - 4);
+	return ofs_general + Test_RandInt (NUMGENERAL-3);
+}
+
+// vectors may not partly overlap, the interpreter gives no defined result
+static qboolean Test_Overlaps (int c, int a)
+{
+	return c != a && abs (c - a) < 3;
+}
+
+static void Test_Operation (int f)
+{
+	static int	ops[] = {OP_ADD_F, OP_SUB_F, OP_MUL_F, OP_DIV_F, OP_ADD_V, OP_SUB_V,
+		OP_MUL_V, OP_MUL_FV, OP_MUL_VF, OP_BITAND, OP_BITOR, OP_GE, OP_LE, OP_GT, OP_LT,
+		OP_AND, OP_OR, OP_NOT_F, OP_NOT_V, OP_NOT_FNC, OP_NOT_ENT, OP_EQ_F, OP_NE_F,
+		OP_EQ_V, OP_NE_V, OP_EQ_E, OP_NE_E, OP_EQ_FNC, OP_NE_FNC, OP_STORE_F, OP_STORE_V,
+		OP_STORE_S};
+	int		op, a, b, c;
+
+	op = ops[Test_RandInt (sizeof(ops)/sizeof(ops[0]))];
+	a = Test_ReadOfs ();
+	b = Test_ReadOfs ();
+	c = Test_WriteOfs (f);
+
+	switch (op)
+	{
+	case OP_STORE_V:
+		while (Test_Overlaps (c, a))
+			c = Test_WriteOfs (f);
+		Test_Emit (op, a, c, 0);
+		return;
+	case OP_STORE_F:
+	case OP_STORE_S:
+		Test_Emit (op, a, c, 0);
+		return;
+	case OP_ADD_V:
+	case OP_SUB_V:
+	case OP_MUL_FV:
+	case OP_MUL_VF:
+		while (Test_Overlaps (c, a) || Test_Overlaps (c, b))
+			c = Test_WriteOfs (f);
+		break;
+	}
+	Test_Emit (op, a, b, c);
+}
+
+static void Test_Body (int f, int count, int depth)
+{
+	static int	loads[] = {OP_LOAD_F, OP_LOAD_V, OP_LOAD_S, OP_LOAD_ENT, OP_LOAD_FLD, OP_LOAD_FNC};
+	static int	stores[] = {OP_STOREP_F, OP_STOREP_V, OP_STOREP_S, OP_STOREP_ENT, OP_STOREP_FLD, OP_STOREP_FNC};
+	int		i, k, p, argc, callee, start;
+
+	for (i=0 ; i<count ; i++)
+	{
+		k = Test_RandInt (100);
+		if (k < 55)
+			Test_Operation (f);
+		else if (k < 60)
+		{
+			k = Test_RandInt (3);
+			Test_Emit (k == 0 ? OP_EQ_S : k == 1 ? OP_NE_S : OP_NOT_S,
+				ofs_string + Test_RandInt (6), ofs_string + Test_RandInt (6), Test_WriteOfs (f));
+		}
+		else if (k < 68)
+			Test_Emit (loads[Test_RandInt (6)], ofs_ent + Test_RandInt (8), ofs_field + Test_RandInt (8), Test_WriteOfs (f));
+		else if (k < 74)
+		{	// the world is hardly ever written, that's a run time error
+			p = ofs_pointer + Test_RandInt (8);
+			Test_Emit (OP_ADDRESS, ofs_ent + (Test_RandInt (50) ? 1 + Test_RandInt (7) : 0), ofs_field + Test_RandInt (8), p);
+			Test_Emit (stores[Test_RandInt (6)], Test_ReadOfs (), p, 0);
+		}
+		else if (k < 80 && f < NUMFUNCS)
+		{	// call a builtin or a later function, so there's no endless recursion
+			argc = Test_RandInt (9);
+			for (p=0 ; p<argc ; p++)
+				Test_Emit (OP_STORE_V, ofs_general + Test_RandInt (NUMGENERAL-3), OFS_PARM0 + p*3, 0);
+			if (!Test_RandInt (3))
+				callee = ofs_func + Test_RandInt (3);
+			else
+				callee = ofs_func + 3 + f + 1 + Test_RandInt (NUMFUNCS - f);
+			Test_Emit (OP_CALL0 + argc, callee, 0, 0);
+			if (Test_RandInt (2))
+				Test_Emit (OP_STORE_V, OFS_RETURN, Test_WriteOfs (f), 0);
+		}
+		else if (k < 84 && depth < 2)
+		{	// skip forward
+			start = numstatements;
+			Test_Emit (Test_RandInt (2) ? OP_IF : OP_IFNOT, Test_ReadOfs (), 0, 0);
+			Test_Body (f, 1 + Test_RandInt (4), depth + 1);
+			statements[start].b = numstatements - start;
+		}
+		else if (k < 86 && depth < 2)
+		{
+			start = numstatements;
+			Test_Emit (OP_GOTO, 0, 0, 0);
+			Test_Body (f, 1 + Test_RandInt (3), depth + 1);
+			statements[start].a = numstatements - start;
+		}
+		else if (k < 88)
+			Test_Emit (OP_STATE, Test_ReadOfs (), ofs_func + 3 + Test_RandInt (NUMFUNCS), 0);
+		else
+			Test_Operation (f);
+	}
+}
+
+/*
+=================
+Test_MakeProgs
+
+Makes the functions and the first globals and edicts
+=================
+*/
+static void Test_MakeProgs (float *globals, byte *edicts)
+{
+	int			f, i, k, ofs, counter, top;
+	dfunction_t	*func;
+	unsigned	*g;
+
+	memset (functions, 0, sizeof(functions));
+	numstatements = 1;
+
+	ofs = ofs_locals;
+	for (f=1 ; f<=NUMFUNCS ; f++)
+	{
+		localbase[f] = ofs;
+		localsize[f] = 4 + Test_RandInt (12);
+		ofs += localsize[f];
+	}
+	if (ofs > NUMGLOBALS)
+		Sys_Error ("NUMGLOBALS is too small");
+
+	for (f=1 ; f<=NUMFUNCS ; f++)
+	{
+		func = &functions[f];
+		func->first_statement = numstatements;
+		func->parm_start = localbase[f];
+		func->locals = localsize[f];
+		func->numparms = Test_RandInt (4);
+		ofs = 0;
+		for (i=0 ; i<func->numparms ; i++)
+		{
+			func->parm_size[i] = Test_RandInt (2) ? 1 : 3;
+			ofs += func->parm_size[i];
+		}
+		if (ofs >= localsize[f])
+			func->numparms = 0;
+
+		if (Test_RandInt (2))
+		{	// a loop, counting down the last local
+			counter = localbase[f] + localsize[f] - 1;
+			Test_Emit (OP_STORE_F, ofs_const + 2, counter, 0);
+			top = numstatements;
+			Test_Body (f, 5 + Test_RandInt (20), 0);
+			Test_Emit (OP_SUB_F, counter, ofs_const + 1, counter);
+			Test_Emit (OP_GT, counter, ofs_const, ofs_general + NUMGENERAL - 1);
+			Test_Emit (OP_IF, ofs_general + NUMGENERAL - 1, top - numstatements, 0);
+		}
+		Test_Body (f, 5 + Test_RandInt (40), 0);
+		Test_Emit (Test_RandInt (2) ? OP_RETURN : OP_DONE, Test_ReadOfs (), 0, 0);
+	}
+	for (i=0 ; i<3 ; i++)
+		functions[NUMFUNCS+1+i].first_statement = -(1 + i);
+
+	testprogs.numfunctions = NUMFUNCS + 4;
+	testprogs.numstatements = numstatements;
+	testprogs.numglobals = NUMGLOBALS;
+
+// globals of every kind of bits
+	g = (unsigned *)globals;
+	for (i=0 ; i<NUMGLOBALS ; i++)
+	{
+		k = Test_RandInt (10);
+		if (k < 5)
+			globals[i] = (float)(Test_RandInt (200) - 100) / (1 + Test_RandInt (4));
+		else if (k < 6)
+			g[i] = 0x7fc00000u | Test_RandInt (1000);		// NaN
+		else if (k < 7)
+			globals[i] = 0;
+		else if (k < 8)
+			g[i] = 0x80000000u;		// -0
+		else
+			g[i] = Test_Rand () ^ (Test_Rand () << 16);
+	}
+	for (i=0 ; i<8 ; i++)
+	{
+		g[ofs_ent + i] = i*pr_edict_size;
+		g[ofs_field + i] = Test_RandInt (NUMFIELDS + sizeof(entvars_t)/4 - 3);
+		g[ofs_pointer + i] = 0;
+		g[ofs_string + i] = stringofs[i % 6];
+	}
+	for (i=0 ; i<3 ; i++)
+		g[ofs_func + i] = NUMFUNCS + 1 + i;
+	for (f=1 ; f<=NUMFUNCS ; f++)
+		g[ofs_func + 3 + f] = f;
+	g[ofs_func + 3 + NUMFUNCS + 1] = 1;
+	globals[ofs_const] = 0;
+	globals[ofs_const+1] = 1;
+	globals[ofs_const+2] = 3;
+	globals[ofs_const+3] = -2.5;
+	g[offsetof(globalvars_t, self)/4] = pr_edict_size*2;
+	globals[offsetof(globalvars_t, time)/4] = 12.5;
+
+	for (i=0 ; i<NUMEDICTS*pr_edict_size ; i++)
+		edicts[i] = Test_Rand ();
+	for (i=0 ; i<NUMEDICTS ; i++)
+		memset (edicts + i*pr_edict_size, 0, offsetof(edict_t, v));
+}
+
+//============================================================================
+
+static void Test_Builtin1 (void)
+{
+	G_FLOAT(OFS_RETURN) = G_FLOAT(OFS_PARM0)*2 + pr_argc + pr_xstatement;
+	G_FLOAT(OFS_RETURN+1) = pr_xfunction - pr_functions;
+}
+
+static void Test_Builtin2 (void)
+{	// calls back into the progs
+	float	save;
+
+	save = G_FLOAT(OFS_PARM0);
+	G_FLOAT(OFS_PARM0) = pr_argc;
+	PR_ExecuteProgram (NUMFUNCS);
+	G_FLOAT(OFS_RETURN+2) += save;
+}
+
+static void Test_Builtin3 (void)
+{
+	G_INT(OFS_RETURN) = pr_depth*7 + pr_argc;
+}
+
+static builtin_t	test_builtins[] = {NULL, Test_Builtin1, Test_Builtin2, Test_Builtin3};
+
+//============================================================================
+
+typedef struct
+{
+	float		globals[NUMGLOBALS];
+	byte		edicts[NUMEDICTS*MAX_EDICT_SIZE_TEST];
+	int			errors;
+} teststate_t;
+
+static teststate_t	test_work;		// the compiled code has the address of pr_globals
+
+/*
+=================
+Test_Run
+
+Runs the function from start with "pr_jit jit", the results go to state
+=================
+*/
+static void Test_Run (teststate_t *state, teststate_t *start, func_t fnum, int jit)
+{
+	test_work = *start;
+	sv.num_edicts = NUMEDICTS;
+	sv.max_edicts = NUMEDICTS;
+	sv.state = ss_active;
+
+	pr_jit.value = jit;
+	pr_depth = 0;
+	localstack_used = 0;
+	test_errors = 0;
+	if (!setjmp (test_abort))
+		PR_ExecuteProgram (fnum);
+	test_work.errors = test_errors;
+	*state = test_work;
+}
+
+static qboolean Test_IsNan (unsigned bits)
+{
+	return (bits & 0x7f800000) == 0x7f800000 && (bits & 0x007fffff);
+}
+
+/*
+=================
+Test_Compare
+
+Prints the first few differences, NaNs are all the same if nans is set
+=================
+*/
+static qboolean Test_Compare (int seed, char *what, teststate_t *a, teststate_t *b, qboolean nans)
+{
+	unsigned	*ia, *ib;
+	int			i, count, size;
+
+	if (a->errors != b->errors)
+	{
+		printf ("seed %i: %s: %i errors, the interpreter had %i\n", seed, what, b->errors, a->errors);
+		return false;
+	}
+	if (a->errors)
+		return true;	// a Host_Error ends the server, it doesn't matter where
+
+	ia = (unsigned *)a->globals;
+	ib = (unsigned *)b->globals;
+	size = (NUMGLOBALS*4 + NUMEDICTS*pr_edict_size) / 4;	// edicts follow globals
+	count = 0;
+	for (i=0 ; i<size ; i++)
+	{
+		if (ia[i] == ib[i])
+			continue;
+		if (nans && Test_IsNan (ia[i]) && Test_IsNan (ib[i]))
+			continue;
+		if (count++ < 5)
+		{
+			if (i < NUMGLOBALS)
+				printf ("seed %i: %s: global %i is %08x, the interpreter's %08x\n", seed, what, i, ib[i], ia[i]);
+			else
+				printf ("seed %i: %s: edict byte %i differs\n", seed, what, (i - NUMGLOBALS)*4);
+		}
+	}
+	return count == 0;
+}
+
+int main (int argc, char **argv)
+{
+	static teststate_t	start, interpreted, compiled, checked;
+	int			seeds, seed, failed, errored, reports;
+	func_t		fnum;
+
+	seeds = argc > 1 ? atoi (argv[1]) : 1000;
+	test_verbose = argc > 2;
+
+	ofs_ent = sizeof(globalvars_t)/4 + 4;
+	ofs_field = ofs_ent + 8;
+	ofs_pointer = ofs_field + 8;
+	ofs_string = ofs_pointer + 8;
+	ofs_func = ofs_string + 8;
+	ofs_const = ofs_func + 3 + NUMFUNCS + 2;
+	ofs_general = ofs_const + 8;
+	ofs_locals = ofs_general + NUMGENERAL;
+
+	pr_edict_size = offsetof(edict_t, v) + sizeof(entvars_t) + NUMFIELDS*4;
+	if (pr_edict_size > MAX_EDICT_SIZE_TEST)
+		Sys_Error ("MAX_EDICT_SIZE_TEST is too small");
+
+	progs = &testprogs;
+	pr_functions = functions;
+	pr_statements = statements;
+	pr_strings = strings;
+	pr_builtins = test_builtins;
+	pr_globals = test_work.globals;
+	pr_global_struct = (globalvars_t *)pr_globals;
+	sv.edicts = (edict_t *)test_work.edicts;
+	pr_numbuiltins = sizeof(test_builtins)/sizeof(test_builtins[0]);
+
+	failed = errored = reports = 0;
+	for (seed=1 ; seed<=seeds ; seed++)
+	{
+		randseed = seed;
+		Test_MakeProgs (start.globals, start.edicts);
+		fnum = 1 + Test_RandInt (3);
+
+		PR_JitFree ();
+		Test_Run (&interpreted, &start, fnum, 0);
+
+		pr_jit.value = 1;
+		PR_JitCompile ();
+		if (!pr_jitfuncs)
+		{
+			printf ("no progs jit for this platform\n");
+			return 0;
+		}
+		Test_Run (&compiled, &start, fnum, 1);
+
+		test_reports = 0;
+		Test_Run (&checked, &start, fnum, 2);
+		if (test_reports)
+		{
+			printf ("seed %i: pr_jit 2 reported a difference\n", seed);
+			reports++;
+		}
+
+		if (!Test_Compare (seed, "compiled", &interpreted, &compiled, true)
+		|| !Test_Compare (seed, "pr_jit 2", &interpreted, &checked, false))
+			failed++;
+		if (interpreted.errors)
+			errored++;
+	}
+
+	printf ("%i seeds, %i failed, %i pr_jit 2 reports, %i ended in a run time error\n",
+		seeds, failed, reports, errored);
+	return failed || reports;
+}
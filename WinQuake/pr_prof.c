@@ -0,0 +1,517 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+2016 Atröm "Panzerschrek" Kunç.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pr_prof.c -- timing profiler for progs functions and builtins
+
+/*
+While "prof on", the interpreter calls PR_ProfileEnter and PR_ProfileLeave
+around every progs function and builtin. Time is kept per function and
+per call path in a call tree, whose root children are the functions the
+server calls directly (StartFrame, think functions, touches...). Builtins
+are nodes of the tree like progs functions, so a builtin's time is split
+from the time of its caller, and progs called back from a builtin (touches
+from walkmove) show below it.
+
+"prof dump <file>" writes the tree as folded stacks, one line per path
+with its exclusive microseconds, the input of flamegraph.pl and speedscope.
+*/
+
+#include "quakedef.h"
+
+#define	MAX_PROFNODES	16384
+#define	MAX_PROFSTACK	128
+
+typedef struct
+{
+	int		func;			// -1 for the root
+	int		parent;
+	int		child;			// first child
+	int		sibling;
+	int		calls;
+	double	inclusive, exclusive;
+} profnode_t;
+
+typedef struct
+{
+	int		calls;
+	int		active;			// recursion depth, inclusive time is only added by the outermost
+	double	inclusive, exclusive;
+} proffunc_t;
+
+typedef struct
+{
+	int		func;
+	int		node;
+	double	start;
+	double	childtime;
+} profframe_t;
+
+qboolean	pr_profiling;
+
+static profnode_t	prof_nodes[MAX_PROFNODES];
+static int			prof_numnodes;
+static int			prof_lostnodes;		// calls not in the tree, the tree was full
+
+static proffunc_t	*prof_funcs;
+static int			prof_numfuncs;
+static unsigned short	prof_crc;
+
+static profframe_t	prof_stack[MAX_PROFSTACK];
+static int			prof_depth;			// can be above MAX_PROFSTACK, those frames aren't timed
+
+static double		prof_starttime;
+static double		prof_elapsed;		// profiled time of earlier runs
+
+
+/*
+============
+PR_ProfileReset
+============
+*/
+static void PR_ProfileReset (void)
+{
+	free (prof_funcs);
+	prof_funcs = NULL;
+	prof_numfuncs = 0;
+	if (progs)
+	{
+		prof_numfuncs = progs->numfunctions;
+		prof_funcs = calloc (prof_numfuncs, sizeof(*prof_funcs));
+		if (!prof_funcs)
+			prof_numfuncs = 0;
+	}
+	prof_crc = pr_crc;
+
+	Q_memset (&prof_nodes[0], 0, sizeof(prof_nodes[0]));
+	prof_nodes[0].func = -1;
+	prof_nodes[0].parent = -1;
+	prof_numnodes = 1;
+	prof_lostnodes = 0;
+
+	prof_depth = 0;
+	prof_elapsed = 0;
+	prof_starttime = Sys_PreciseTime ();
+}
+
+/*
+============
+PR_ProfileNewProgs
+
+The collected data is kept over level changes, unless the progs are different
+============
+*/
+void PR_ProfileNewProgs (void)
+{
+	if (prof_numnodes && (prof_numfuncs != progs->numfunctions || prof_crc != pr_crc))
+	{
+		Con_Printf ("progs changed, profile reset\n");
+		PR_ProfileReset ();
+	}
+	PR_ProfileClearStack ();
+}
+
+/*
+============
+PR_ProfileClearStack
+
+Called when the server starts running progs, frames left over from a
+function aborted by an error are dropped
+============
+*/
+void PR_ProfileClearStack (void)
+{
+	int		i;
+
+	for (i=0 ; i<prof_depth && i<MAX_PROFSTACK ; i++)
+		if (prof_stack[i].func < prof_numfuncs)
+			prof_funcs[prof_stack[i].func].active--;
+	prof_depth = 0;
+}
+
+static int PR_ProfileNode (int parent, int func)
+{
+	int			n;
+	profnode_t	*node;
+
+	if (parent < 0)
+		return -1;
+
+	for (n = prof_nodes[parent].child ; n ; n = prof_nodes[n].sibling)
+		if (prof_nodes[n].func == func)
+			return n;
+
+	if (prof_numnodes == MAX_PROFNODES)
+	{
+		prof_lostnodes++;
+		return -1;
+	}
+
+	n = prof_numnodes++;
+	node = &prof_nodes[n];
+	node->func = func;
+	node->parent = parent;
+	node->child = 0;
+	node->sibling = prof_nodes[parent].child;
+	node->calls = 0;
+	node->inclusive = node->exclusive = 0;
+	prof_nodes[parent].child = n;
+	return n;
+}
+
+/*
+============
+PR_ProfileEnter
+============
+*/
+void PR_ProfileEnter (dfunction_t *f)
+{
+	profframe_t	*frame;
+	int			func;
+
+	if (prof_depth >= MAX_PROFSTACK)
+	{
+		prof_depth++;
+		return;
+	}
+
+	func = f - pr_functions;
+	frame = &prof_stack[prof_depth];
+	frame->func = func;
+	frame->node = PR_ProfileNode (prof_depth ? prof_stack[prof_depth-1].node : 0, func);
+	frame->childtime = 0;
+	prof_depth++;
+
+	if (func < prof_numfuncs)
+	{
+		prof_funcs[func].calls++;
+		prof_funcs[func].active++;
+	}
+	if (frame->node >= 0)
+		prof_nodes[frame->node].calls++;
+
+	frame->start = Sys_PreciseTime ();
+}
+
+/*
+============
+PR_ProfileLeave
+============
+*/
+void PR_ProfileLeave (void)
+{
+	profframe_t	*frame;
+	proffunc_t	*pf;
+	double		time, exclusive;
+
+	if (prof_depth <= 0)
+		return;		// profiling was turned on inside progs
+	prof_depth--;
+	if (prof_depth >= MAX_PROFSTACK)
+		return;
+
+	frame = &prof_stack[prof_depth];
+	time = Sys_PreciseTime () - frame->start;
+	exclusive = time - frame->childtime;
+	if (prof_depth)
+		prof_stack[prof_depth-1].childtime += time;
+
+	if (frame->func < prof_numfuncs)
+	{
+		pf = &prof_funcs[frame->func];
+		pf->exclusive += exclusive;
+		if (!--pf->active)
+			pf->inclusive += time;
+	}
+	if (frame->node >= 0)
+	{
+		prof_nodes[frame->node].inclusive += time;
+		prof_nodes[frame->node].exclusive += exclusive;
+	}
+}
+
+//============================================================================
+
+static char *PR_ProfileName (int func)
+{
+	if (func < 0)
+		return "(server)";
+	if (func >= progs->numfunctions)
+		return "?";
+	return pr_strings + pr_functions[func].s_name;
+}
+
+static qboolean PR_ProfileIsBuiltin (int func)
+{
+	return func >= 0 && func < progs->numfunctions && pr_functions[func].first_statement < 0;
+}
+
+static int		prof_sortkey;	// 0 - exclusive, 1 - inclusive
+
+static int PR_ProfileCompareFuncs (const void *a, const void *b)
+{
+	proffunc_t	*fa, *fb;
+	double		ta, tb;
+
+	fa = &prof_funcs[*(int *)a];
+	fb = &prof_funcs[*(int *)b];
+	ta = prof_sortkey ? fa->inclusive : fa->exclusive;
+	tb = prof_sortkey ? fb->inclusive : fb->exclusive;
+	if (ta != tb)
+		return ta < tb ? 1 : -1;
+	return *(int *)a - *(int *)b;
+}
+
+typedef struct
+{
+	int		caller, callee;
+	int		calls;
+	double	time;
+} profedge_t;
+
+static int PR_ProfileComparePairs (const void *a, const void *b)
+{
+	profedge_t	*ea, *eb;
+
+	ea = (profedge_t *)a;
+	eb = (profedge_t *)b;
+	if (ea->caller != eb->caller)
+		return ea->caller - eb->caller;
+	return ea->callee - eb->callee;
+}
+
+static int PR_ProfileCompareEdges (const void *a, const void *b)
+{
+	profedge_t	*ea, *eb;
+
+	ea = (profedge_t *)a;
+	eb = (profedge_t *)b;
+	if (ea->time != eb->time)
+		return ea->time < eb->time ? 1 : -1;
+	return PR_ProfileComparePairs (a, b);
+}
+
+static void PR_ProfileReport (int count)
+{
+	int			*order;
+	int			i, j, n, shown;
+	proffunc_t	*pf;
+	profedge_t	*edges;
+	double		total;
+
+	total = prof_elapsed;
+	if (pr_profiling)
+		total += Sys_PreciseTime () - prof_starttime;
+	Con_Printf ("%s, %.1f s profiled, %i call paths", pr_profiling ? "profiling" : "not profiling",
+		total, prof_numnodes - 1);
+	if (prof_lostnodes)
+		Con_Printf (", %i calls not in the tree", prof_lostnodes);
+	Con_Printf ("\n");
+
+	order = malloc (prof_numfuncs * sizeof(*order));
+	edges = malloc (prof_numnodes * sizeof(*edges));
+	if (!order || !edges)
+	{
+		free (order);
+		free (edges);
+		return;
+	}
+	for (i=0 ; i<prof_numfuncs ; i++)
+		order[i] = i;
+
+	for (prof_sortkey=0 ; prof_sortkey<2 ; prof_sortkey++)
+	{
+		qsort (order, prof_numfuncs, sizeof(*order), PR_ProfileCompareFuncs);
+
+		Con_Printf ("\nby %s time:\n", prof_sortkey ? "inclusive" : "exclusive");
+		Con_Printf ("   calls  incl ms  excl ms  us/call name\n");
+		for (i=0 ; i<prof_numfuncs && i<count ; i++)
+		{
+			pf = &prof_funcs[order[i]];
+			if (!pf->calls)
+				break;
+			Con_Printf ("%8i %8.1f %8.1f %8.2f %s%s\n", pf->calls, pf->inclusive * 1000.0,
+				pf->exclusive * 1000.0, pf->inclusive * 1000000.0 / pf->calls,
+				PR_ProfileName (order[i]), PR_ProfileIsBuiltin (order[i]) ? " (builtin)" : "");
+		}
+	}
+
+	prof_sortkey = 0;
+	qsort (order, prof_numfuncs, sizeof(*order), PR_ProfileCompareFuncs);
+	Con_Printf ("\nbuiltins:\n");
+	for (i=0, shown=0 ; i<prof_numfuncs && shown<count ; i++)
+	{
+		pf = &prof_funcs[order[i]];
+		if (!pf->calls)
+			break;
+		if (!PR_ProfileIsBuiltin (order[i]))
+			continue;
+		Con_Printf ("%8i %8.1f ms %8.2f us/call %s\n", pf->calls, pf->exclusive * 1000.0,
+			pf->exclusive * 1000000.0 / pf->calls, PR_ProfileName (order[i]));
+		shown++;
+	}
+
+// merge the tree nodes of the same caller and callee
+	n = 0;
+	for (i=1 ; i<prof_numnodes ; i++)
+	{
+		edges[n].caller = prof_nodes[prof_nodes[i].parent].func;
+		edges[n].callee = prof_nodes[i].func;
+		edges[n].calls = prof_nodes[i].calls;
+		edges[n].time = prof_nodes[i].inclusive;
+		n++;
+	}
+	qsort (edges, n, sizeof(*edges), PR_ProfileComparePairs);
+	for (i=0, j=-1 ; i<n ; i++)
+	{
+		if (j >= 0 && !PR_ProfileComparePairs (&edges[j], &edges[i]))
+		{
+			edges[j].calls += edges[i].calls;
+			edges[j].time += edges[i].time;
+		}
+		else
+			edges[++j] = edges[i];
+	}
+	n = j + 1;
+	qsort (edges, n, sizeof(*edges), PR_ProfileCompareEdges);
+
+	Con_Printf ("\ncalls:\n");
+	for (i=0 ; i<n && i<count ; i++)
+		Con_Printf ("%8i %8.1f ms %s -> %s\n", edges[i].calls, edges[i].time * 1000.0,
+			PR_ProfileName (edges[i].caller), PR_ProfileName (edges[i].callee));
+
+	free (order);
+	free (edges);
+}
+
+/*
+============
+PR_ProfileDump
+
+Writes the call tree as folded stacks
+============
+*/
+static void PR_ProfileDump (char *name)
+{
+	char		path[MAX_OSPATH];
+	FILE		*f;
+	int			i, n, len, pathnodes[MAX_PROFSTACK];
+	profnode_t	*node;
+
+	if (strstr (name, ".."))
+	{
+		Con_Printf ("Relative pathnames are not allowed.\n");
+		return;
+	}
+	if (name[0] == '/' || name[0] == '\\' || strchr (name, ':'))
+	{
+		Con_Printf ("Absolute pathnames are not allowed.\n");
+		return;
+	}
+	if (Q_strlen (com_gamedir) + 1 + Q_strlen (name) >= MAX_OSPATH)
+	{
+		Con_Printf ("Profile file name is too long.\n");
+		return;
+	}
+
+	sprintf (path, "%s/%s", com_gamedir, name);
+	f = fopen (path, "w");
+	if (!f)
+	{
+		Con_Printf ("couldn't write %s\n", path);
+		return;
+	}
+
+	for (i=1 ; i<prof_numnodes ; i++)
+	{
+		node = &prof_nodes[i];
+		if (node->exclusive < 0.0000005)
+			continue;
+
+		len = 0;
+		for (n=i ; n>0 && len<MAX_PROFSTACK ; n=prof_nodes[n].parent)
+			pathnodes[len++] = n;
+		while (len--)
+			fprintf (f, "%s%s", PR_ProfileName (prof_nodes[pathnodes[len]].func), len ? ";" : "");
+		fprintf (f, " %.0f\n", node->exclusive * 1000000.0);
+	}
+
+	fclose (f);
+	Con_Printf ("wrote %s\n", path);
+}
+
+/*
+============
+PR_Prof_f
+
+prof on / off
+prof reset
+prof [count] : prints the top functions, builtins and calls
+prof dump [file] : writes folded stacks for flamegraph tools
+============
+*/
+void PR_Prof_f (void)
+{
+	char	*cmd;
+
+	cmd = Cmd_Argc () > 1 ? Cmd_Argv (1) : "";
+
+	if (!Q_strcmp (cmd, "on"))
+	{
+		if (pr_profiling)
+			return;
+		if (!prof_numnodes || (progs && (prof_numfuncs != progs->numfunctions || prof_crc != pr_crc)))
+			PR_ProfileReset ();
+		prof_depth = 0;
+		prof_starttime = Sys_PreciseTime ();
+		pr_profiling = true;
+		return;
+	}
+
+	if (!Q_strcmp (cmd, "off"))
+	{
+		if (pr_profiling)
+			prof_elapsed += Sys_PreciseTime () - prof_starttime;
+		pr_profiling = false;
+		return;
+	}
+
+	if (!Q_strcmp (cmd, "reset"))
+	{
+		PR_ProfileReset ();
+		return;
+	}
+
+	if (!prof_numnodes || !sv.active)
+	{
+		Con_Printf ("prof on / off : start or stop profiling progs\n");
+		Con_Printf ("prof reset\n");
+		Con_Printf ("prof [count] : print the top functions, builtins and calls\n");
+		Con_Printf ("prof dump [file] : write folded stacks for flamegraph tools\n");
+		return;
+	}
+
+	if (!Q_strcmp (cmd, "dump"))
+	{
+		PR_ProfileDump (Cmd_Argc () > 2 ? Cmd_Argv (2) : "prof.folded");
+		return;
+	}
+
+	PR_ProfileReport (Cmd_Argc () > 1 ? Q_atoi (cmd) : 10);
+}
@@ -74,17 +74,53 @@ extern	int				pr_edict_size;	// in bytes
 void PR_Init (void);
 
 void PR_ExecuteProgram (func_t fnum);
+int PR_EnterFunction (dfunction_t *f);
+int PR_LeaveFunction (void);
 void PR_LoadProgs (void);
 
 void PR_Profile_f (void);
 
+extern	qboolean	pr_profiling;
+
+void PR_Prof_f (void);
+void PR_ProfileNewProgs (void);
+void PR_ProfileClearStack (void);
+void PR_ProfileEnter (dfunction_t *f);
+void PR_ProfileLeave (void);
+
+typedef void (*jitfunc_t) (void);
+
+extern	cvar_t		pr_jit;
+extern	jitfunc_t	*pr_jitfuncs;		// compiled functions, NULL - all interpreted
+
+void PR_InitJit (void);
+void PR_JitCompile (void);
+void PR_JitFree (void);
+void PR_JitExecute (func_t fnum);
+
+#define	JITCHECK_OFF	0
+#define	JITCHECK_RECORD	1		// the interpreted pass of "pr_jit 2"
+#define	JITCHECK_REPLAY	2		// the compiled pass
+
+extern	int			pr_jitcheck;
+
+void PR_JitCheck (func_t fnum);
+void PR_JitBuiltin (int num);
+// runs a builtin while checking
+
 edict_t *ED_Alloc (void);
 void ED_Free (edict_t *ed);
+void ED_ResetFreeList (void);
 
 char	*ED_NewString (char *string);
 // returns a copy of the string allocated from the server's string heap
+char	*ED_CopyString (char *string);
+qboolean ED_CollectStrings (void);
+void	ED_CheckStrings (void);
 
 void ED_Print (edict_t *ed);
+ddef_t *ED_GlobalAtOfs (int ofs);
+ddef_t *ED_FieldAtOfs (int ofs);
 void ED_Write (FILE *f, edict_t *ed);
 char *ED_ParseEdict (char *data, edict_t *ent);
 
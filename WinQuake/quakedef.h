@@ -195,6 +195,7 @@ void	VID_UnlockBuffer (void);
 #include "bspfile.h"
 #include "vid.h"
 #include "sys.h"
+#include "jobs.h"
 #include "zone.h"
 #include "mathlib.h"
 
@@ -231,8 +232,10 @@ typedef struct
 #include "model.h"
 #include "d_iface.h"
 #endif
+#include "mod_cache.h"
 
 #include "input.h"
+#include "collision.h"
 #include "world.h"
 #include "keys.h"
 #include "console.h"
@@ -290,6 +293,7 @@ void Host_ClearMemory (void);
 void Host_ServerFrame (void);
 void Host_InitCommands (void);
 void Host_Init (quakeparms_t *parms);
+void Host_RunPool (void);
 void Host_Shutdown(void);
 void Host_Error (char *error, ...);
 void Host_EndGame (char *message, ...);
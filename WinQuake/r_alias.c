@@ -25,6 +25,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "d_local.h"	// FIXME: shouldn't be needed (is needed for patch
 						// right now, but that should move)
 
+// the SSE2 path rounds exactly like the scalar one only where scalar float
+// math is done with SSE too
+#if defined(__SSE2_MATH__) || defined(_M_X64)
+#define	ALIAS_SSE2	1
+#include <emmintrin.h>
+#else
+#define	ALIAS_SSE2	0
+#endif
+
 #define LIGHT_MIN	5		// lowest light value we'll allow, to avoid the
 							//  need for inner-loop light clamping
 
@@ -79,6 +88,10 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv,
 void R_AliasSetUpTransform (int trivial_accept);
 void R_AliasTransformVector (vec3_t in, vec3_t out);
 void R_AliasProjectFinalVert (finalvert_t *fv, auxvert_t *av);
+static void R_AliasPrepareVerts (finalvert_t *fv, auxvert_t *av, stvert_t *pstverts,
+	trivertx_t *pverts0, trivertx_t *pverts1, int count);
+static void R_AliasTransformAndProjectVerts (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts0, trivertx_t *pverts1, int count);
 
 
 /*
@@ -102,6 +115,8 @@ qboolean R_AliasCheckBBox (void)
 
 	currententity->trivial_accept = 0;
 	pmodel = currententity->model;
+	if (!Cache_Check (&pmodel->cache))
+		D_FlushPolysets ();		// loading may free the skins of recorded draws
 	pahdr = Mod_Extradata (pmodel);
 	pmdl = (mdl_t *)((byte *)pahdr + pahdr->model);
 
@@ -262,36 +277,298 @@ void R_AliasTransformVector (vec3_t in, vec3_t out)
 	out[2] = DotProduct(in, aliastransform[2]) + aliastransform[2][3];
 }
 
+#if ALIAS_SSE2
+
+/*
+==============================================================================
+
+SSE2 VERTEX TRANSFORM
+
+Four verts go through every step at once, with the same float operations
+in the same order as the scalar code, so the results are bit for bit the
+same. r_aliassimd 2 runs both and reports any difference. Lighting only
+depends on the normal, so it's looked up from a table made per entity.
+
+==============================================================================
+*/
+
+static int			r_alightvalues[256];	// by lightnormalindex, the rest are 0
+static finalvert_t	r_checkfinalverts[MAXALIASVERTS];
+static auxvert_t	r_checkauxverts[MAXALIASVERTS];
 
 /*
 ================
-R_AliasPreparePoints
+R_AliasSetupLightValues
 
-General clipped case
+The scalar lighting, once for every normal
 ================
 */
-void R_AliasPreparePoints (void)
+static void R_AliasSetupLightValues (void)
+{
+	int		i, temp;
+	float	lightcos;
+
+	for (i=0 ; i<NUMVERTEXNORMALS ; i++)
+	{
+		lightcos = DotProduct (r_avertexnormals[i], r_plightvec);
+		temp = r_ambientlight;
+
+		if (lightcos < 0)
+		{
+			temp += (int)(r_shadelight * lightcos);
+			if (temp < 0)
+				temp = 0;
+		}
+
+		r_alightvalues[i] = temp;
+	}
+}
+
+// four trivertx_t, which are four bytes each, to x, y and z of each
+static void R_AliasUnpack4 (trivertx_t *pverts, __m128 *x, __m128 *y, __m128 *z)
+{
+	__m128i	v, lo, hi, zero;
+	__m128	a, b, c, d;
+
+	zero = _mm_setzero_si128 ();
+	v = _mm_loadu_si128 ((__m128i *)pverts);
+	lo = _mm_unpacklo_epi8 (v, zero);
+	hi = _mm_unpackhi_epi8 (v, zero);
+
+	a = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (lo, zero));
+	b = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (lo, zero));
+	c = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (hi, zero));
+	d = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (hi, zero));
+	_MM_TRANSPOSE4_PS (a, b, c, d);		// d gets the normal indexes
+
+	*x = a;
+	*y = b;
+	*z = c;
+}
+
+static void R_AliasLerp4 (trivertx_t *pverts0, trivertx_t *pverts1, __m128 w0, __m128 w1,
+	__m128 *x, __m128 *y, __m128 *z)
+{
+	__m128	x0, y0, z0, x1, y1, z1;
+
+	R_AliasUnpack4 (pverts0, &x0, &y0, &z0);
+	R_AliasUnpack4 (pverts1, &x1, &y1, &z1);
+
+	*x = _mm_add_ps (_mm_mul_ps (x0, w0), _mm_mul_ps (x1, w1));
+	*y = _mm_add_ps (_mm_mul_ps (y0, w0), _mm_mul_ps (y1, w1));
+	*z = _mm_add_ps (_mm_mul_ps (z0, w0), _mm_mul_ps (z1, w1));
+}
+
+static void R_AliasLoadTransform (__m128 m[3][4])
+{
+	int		i, j;
+
+	for (i=0 ; i<3 ; i++)
+		for (j=0 ; j<4 ; j++)
+			m[i][j] = _mm_set1_ps (aliastransform[i][j]);
+}
+
+// DotProduct (v, row) + row[3]
+static __m128 R_AliasTransformRow4 (__m128 x, __m128 y, __m128 z, __m128 *row)
+{
+	__m128	r;
+
+	r = _mm_add_ps (_mm_mul_ps (x, row[0]), _mm_mul_ps (y, row[1]));
+	r = _mm_add_ps (r, _mm_mul_ps (z, row[2]));
+	return _mm_add_ps (r, row[3]);
+}
+
+// 1.0 / z is done in double and rounded to float by the scalar code
+static __m128 R_AliasReciprocal4 (__m128 z)
+{
+	__m128d	one, lo, hi;
+
+	one = _mm_set1_pd (1.0);
+	lo = _mm_div_pd (one, _mm_cvtps_pd (z));
+	hi = _mm_div_pd (one, _mm_cvtps_pd (_mm_movehl_ps (z, z)));
+	return _mm_movelh_ps (_mm_cvtpd_ps (lo), _mm_cvtpd_ps (hi));
+}
+
+/*
+================
+R_AliasTransformAndProjectVertsSSE
+
+Trivial accept case
+================
+*/
+static void R_AliasTransformAndProjectVertsSSE (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts0, trivertx_t *pverts1, int count)
+{
+	int		i, k;
+	int		u[4], v[4], izi[4];
+	__m128	m[3][4], w0, w1, xcenter, ycenter;
+	__m128	x, y, z, zi;
+
+	R_AliasSetupLightValues ();
+	R_AliasLoadTransform (m);
+	w0 = _mm_set1_ps (r_verts_weight[0]);
+	w1 = _mm_set1_ps (r_verts_weight[1]);
+	xcenter = _mm_set1_ps (aliasxcenter);
+	ycenter = _mm_set1_ps (aliasycenter);
+
+	for (i=0 ; i+4<=count ; i+=4, fv+=4, pstverts+=4, pverts0+=4, pverts1+=4)
+	{
+		R_AliasLerp4 (pverts0, pverts1, w0, w1, &x, &y, &z);
+
+		zi = R_AliasReciprocal4 (R_AliasTransformRow4 (x, y, z, m[2]));
+		_mm_storeu_si128 ((__m128i *)izi, _mm_cvttps_epi32 (zi));
+		_mm_storeu_si128 ((__m128i *)u, _mm_cvttps_epi32 (_mm_add_ps (
+			_mm_mul_ps (R_AliasTransformRow4 (x, y, z, m[0]), zi), xcenter)));
+		_mm_storeu_si128 ((__m128i *)v, _mm_cvttps_epi32 (_mm_add_ps (
+			_mm_mul_ps (R_AliasTransformRow4 (x, y, z, m[1]), zi), ycenter)));
+
+		for (k=0 ; k<4 ; k++)
+		{
+			fv[k].v[0] = u[k];
+			fv[k].v[1] = v[k];
+			fv[k].v[2] = pstverts[k].s;
+			fv[k].v[3] = pstverts[k].t;
+			fv[k].v[4] = r_alightvalues[pverts0[k].lightnormalindex];
+			fv[k].v[5] = izi[k];
+			fv[k].flags = pstverts[k].onseam;
+		}
+	}
+
+	R_AliasTransformAndProjectVerts (fv, pstverts, pverts0, pverts1, count - i);
+}
+
+/*
+================
+R_AliasPrepareVertsSSE
+
+General clipped case, the clip flags of four verts are found at once
+================
+*/
+static void R_AliasPrepareVertsSSE (finalvert_t *fv, auxvert_t *av, stvert_t *pstverts,
+	trivertx_t *pverts0, trivertx_t *pverts1, int count)
+{
+	int		i, k;
+	int		u[4], v[4], izi[4], flags[4];
+	float	ax[4], ay[4], az[4];
+	__m128	m[3][4], w0, w1, xscale, yscale, xcenter, ycenter, zscale, zclipplane;
+	__m128	x, y, z, fx, fy, fz, zi;
+	__m128i	iu, iv, zclip, f;
+	__m128i	left, top, right, bottom;
+
+	R_AliasSetupLightValues ();
+	R_AliasLoadTransform (m);
+	w0 = _mm_set1_ps (r_verts_weight[0]);
+	w1 = _mm_set1_ps (r_verts_weight[1]);
+	xscale = _mm_set1_ps (aliasxscale);
+	yscale = _mm_set1_ps (aliasyscale);
+	xcenter = _mm_set1_ps (aliasxcenter);
+	ycenter = _mm_set1_ps (aliasycenter);
+	zscale = _mm_set1_ps (ziscale);
+	zclipplane = _mm_set1_ps (ALIAS_Z_CLIP_PLANE);
+	left = _mm_set1_epi32 (r_refdef.aliasvrect.x);
+	top = _mm_set1_epi32 (r_refdef.aliasvrect.y);
+	right = _mm_set1_epi32 (r_refdef.aliasvrectright);
+	bottom = _mm_set1_epi32 (r_refdef.aliasvrectbottom);
+
+	for (i=0 ; i+4<=count ; i+=4, fv+=4, av+=4, pstverts+=4, pverts0+=4, pverts1+=4)
+	{
+		R_AliasLerp4 (pverts0, pverts1, w0, w1, &x, &y, &z);
+
+		fx = R_AliasTransformRow4 (x, y, z, m[0]);
+		fy = R_AliasTransformRow4 (x, y, z, m[1]);
+		fz = R_AliasTransformRow4 (x, y, z, m[2]);
+		_mm_storeu_ps (ax, fx);
+		_mm_storeu_ps (ay, fy);
+		_mm_storeu_ps (az, fz);
+
+	// project all four, the ones behind the z clip plane are not stored
+		zi = R_AliasReciprocal4 (fz);
+		_mm_storeu_si128 ((__m128i *)izi, _mm_cvttps_epi32 (_mm_mul_ps (zi, zscale)));
+		iu = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (_mm_mul_ps (fx, xscale), zi), xcenter));
+		iv = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (_mm_mul_ps (fy, yscale), zi), ycenter));
+		_mm_storeu_si128 ((__m128i *)u, iu);
+		_mm_storeu_si128 ((__m128i *)v, iv);
+
+		f = _mm_and_si128 (_mm_cmplt_epi32 (iu, left), _mm_set1_epi32 (ALIAS_LEFT_CLIP));
+		f = _mm_or_si128 (f, _mm_and_si128 (_mm_cmplt_epi32 (iv, top), _mm_set1_epi32 (ALIAS_TOP_CLIP)));
+		f = _mm_or_si128 (f, _mm_and_si128 (_mm_cmpgt_epi32 (iu, right), _mm_set1_epi32 (ALIAS_RIGHT_CLIP)));
+		f = _mm_or_si128 (f, _mm_and_si128 (_mm_cmpgt_epi32 (iv, bottom), _mm_set1_epi32 (ALIAS_BOTTOM_CLIP)));
+		zclip = _mm_castps_si128 (_mm_cmplt_ps (fz, zclipplane));
+		f = _mm_or_si128 (_mm_and_si128 (zclip, _mm_set1_epi32 (ALIAS_Z_CLIP)), _mm_andnot_si128 (zclip, f));
+		_mm_storeu_si128 ((__m128i *)flags, f);
+
+		for (k=0 ; k<4 ; k++)
+		{
+			av[k].fv[0] = ax[k];
+			av[k].fv[1] = ay[k];
+			av[k].fv[2] = az[k];
+
+			fv[k].v[2] = pstverts[k].s;
+			fv[k].v[3] = pstverts[k].t;
+			fv[k].v[4] = r_alightvalues[pverts0[k].lightnormalindex];
+			fv[k].flags = pstverts[k].onseam | flags[k];
+
+			if (!(flags[k] & ALIAS_Z_CLIP))
+			{
+				fv[k].v[0] = u[k];
+				fv[k].v[1] = v[k];
+				fv[k].v[5] = izi[k];
+			}
+		}
+	}
+
+	R_AliasPrepareVerts (fv, av, pstverts, pverts0, pverts1, count - i);
+}
+
+/*
+================
+R_AliasCompareVerts
+
+r_aliassimd 2, after both paths ran
+================
+*/
+static void R_AliasCompareVerts (finalvert_t *fv, auxvert_t *av, int count)
+{
+	int		i, bad;
+
+	bad = 0;
+	for (i=0 ; i<count ; i++)
+	{
+		if (memcmp (&fv[i], &r_checkfinalverts[i], sizeof(finalvert_t))
+			|| (av && memcmp (&av[i], &r_checkauxverts[i], sizeof(auxvert_t))))
+			bad++;
+	}
+
+	if (bad)
+		Con_Printf ("%s: %i of %i verts differ from the scalar path\n",
+			currententity->model->name, bad, count);
+}
+
+#endif	// ALIAS_SSE2
+
+
+/*
+================
+R_AliasPrepareVerts
+
+Transforms the verts to view space and lights them, and projects and flags
+the ones in front of the z clip plane. The scalar reference of
+R_AliasPrepareVertsSSE.
+================
+*/
+static void R_AliasPrepareVerts (finalvert_t *fv, auxvert_t *av, stvert_t *pstverts,
+	trivertx_t *pverts0, trivertx_t *pverts1, int count)
 {
 	int			i, j;
-	stvert_t	*pstverts;
-	finalvert_t	*fv;
-	auxvert_t	*av;
-	mtriangle_t	*ptri;
-	finalvert_t	*pfv[3];
 	float		v[3];
 
 	int		temp;
 	float	lightcos, *plightnormal;
 
-	pstverts = (stvert_t *)((byte *)paliashdr + paliashdr->stverts);
-	r_anumverts = pmdl->numverts;
- 	fv = pfinalverts;
-	av = pauxverts;
-
-	for (i=0 ; i<r_anumverts ; i++, fv++, av++, r_apverts[0]++, r_apverts[1]++, pstverts++)
+	for (i=0 ; i<count ; i++, fv++, av++, pverts0++, pverts1++, pstverts++)
 	{
 		for (j = 0; j < 3; j++)
-			v[j] = r_apverts[0]->v[j] * r_verts_weight[0] + r_apverts[1]->v[j] * r_verts_weight[1];
+			v[j] = pverts0->v[j] * r_verts_weight[0] + pverts1->v[j] * r_verts_weight[1];
 
 		av->fv[0] = DotProduct(v, aliastransform[0]) +
 				aliastransform[0][3];
@@ -306,7 +583,7 @@ void R_AliasPreparePoints (void)
 		fv->flags = pstverts->onseam;
 
 		// lighting
-		plightnormal = r_avertexnormals[r_apverts[0]->lightnormalindex];
+		plightnormal = r_avertexnormals[pverts0->lightnormalindex];
 		lightcos = DotProduct (plightnormal, r_plightvec);
 		temp = r_ambientlight;
 
@@ -338,6 +615,47 @@ void R_AliasPreparePoints (void)
 				fv->flags |= ALIAS_BOTTOM_CLIP;	
 		}
 	}
+}
+
+
+/*
+================
+R_AliasPreparePoints
+
+General clipped case
+================
+*/
+void R_AliasPreparePoints (void)
+{
+	int			i;
+	stvert_t	*pstverts;
+	mtriangle_t	*ptri;
+	finalvert_t	*pfv[3];
+
+	pstverts = (stvert_t *)((byte *)paliashdr + paliashdr->stverts);
+	r_anumverts = pmdl->numverts;
+
+#if ALIAS_SSE2
+	if (r_aliassimd.value)
+	{
+		if (r_aliassimd.value == 2)
+		{
+			memcpy (r_checkfinalverts, pfinalverts, r_anumverts * sizeof(finalvert_t));
+			memcpy (r_checkauxverts, pauxverts, r_anumverts * sizeof(auxvert_t));
+			R_AliasPrepareVerts (r_checkfinalverts, r_checkauxverts, pstverts,
+				r_apverts[0], r_apverts[1], r_anumverts);
+		}
+
+		R_AliasPrepareVertsSSE (pfinalverts, pauxverts, pstverts,
+			r_apverts[0], r_apverts[1], r_anumverts);
+
+		if (r_aliassimd.value == 2)
+			R_AliasCompareVerts (pfinalverts, pauxverts, r_anumverts);
+	}
+	else
+#endif
+		R_AliasPrepareVerts (pfinalverts, pauxverts, pstverts,
+			r_apverts[0], r_apverts[1], r_anumverts);
 
 //
 // clip and draw all triangles
@@ -449,23 +767,22 @@ void R_AliasSetUpTransform (int trivial_accept)
 
 /*
 ================
-R_AliasTransformAndProjectFinalVerts
+R_AliasTransformAndProjectVerts
+
+The scalar reference of R_AliasTransformAndProjectVertsSSE
 ================
 */
-void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
+static void R_AliasTransformAndProjectVerts (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts0, trivertx_t *pverts1, int count)
 {
 	int			i, j, temp;
 	float		lightcos, *plightnormal, zi;
-	trivertx_t	*pverts[2];
 	float		v[3];
 
-	pverts[0] = r_apverts[0];
-	pverts[1] = r_apverts[1];
-
-	for (i=0 ; i<r_anumverts ; i++, fv++, pverts[0]++, pverts[1]++, pstverts++)
+	for (i=0 ; i<count ; i++, fv++, pverts0++, pverts1++, pstverts++)
 	{
 		for (j = 0; j < 3; j++)
-			v[j] = pverts[0]->v[j] * r_verts_weight[0] + pverts[1]->v[j] * r_verts_weight[1];
+			v[j] = pverts0->v[j] * r_verts_weight[0] + pverts1->v[j] * r_verts_weight[1];
 
 	// transform and project
 		zi = 1.0 / (DotProduct(v, aliastransform[2]) +
@@ -486,7 +803,7 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 		fv->flags = pstverts->onseam;
 
 	// lighting
-		plightnormal = r_avertexnormals[pverts[0]->lightnormalindex];
+		plightnormal = r_avertexnormals[pverts0->lightnormalindex];
 		lightcos = DotProduct (plightnormal, r_plightvec);
 		temp = r_ambientlight;
 
@@ -505,6 +822,37 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 }
 
 
+/*
+================
+R_AliasTransformAndProjectFinalVerts
+================
+*/
+void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
+{
+#if ALIAS_SSE2
+	if (r_aliassimd.value)
+	{
+		if (r_aliassimd.value == 2)
+		{
+			memcpy (r_checkfinalverts, fv, r_anumverts * sizeof(finalvert_t));
+			R_AliasTransformAndProjectVerts (r_checkfinalverts, pstverts,
+				r_apverts[0], r_apverts[1], r_anumverts);
+		}
+
+		R_AliasTransformAndProjectVertsSSE (fv, pstverts,
+			r_apverts[0], r_apverts[1], r_anumverts);
+
+		if (r_aliassimd.value == 2)
+			R_AliasCompareVerts (fv, NULL, r_anumverts);
+		return;
+	}
+#endif
+
+	R_AliasTransformAndProjectVerts (fv, pstverts,
+		r_apverts[0], r_apverts[1], r_anumverts);
+}
+
+
 
 /*
 ================
@@ -744,11 +1092,6 @@ void R_AliasDrawModel (alight_t *plighting)
 	r_affinetridesc.drawtype = (currententity->trivial_accept == 3) &&
 			r_recursiveaffinetriangles;
 
-	if (r_affinetridesc.drawtype)
-	{
-		D_PolysetUpdateTables ();		// FIXME: precalc...
-	}
-
 	acolormap = currententity->colormap;
 
 	if (currententity != &cl.viewent)
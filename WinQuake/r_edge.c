@@ -717,10 +717,6 @@ void R_ScanEdges (void)
 	// the next scan
 		if (span_p >= max_span_p)
 		{
-			VID_UnlockBuffer ();
-			S_ExtraUpdate ();	// don't let sound get messed up if going slow
-			VID_LockBuffer ();
-		
 			if (r_drawculledpolys)
 			{
 				R_DrawCulledPolys ();
@@ -137,6 +137,7 @@ cvar_t	r_maxedges = {"r_maxedges", "0"};
 cvar_t	r_numedges = {"r_numedges", "0"};
 cvar_t	r_aliastransbase = {"r_aliastransbase", "200"};
 cvar_t	r_aliastransadj = {"r_aliastransadj", "100"};
+cvar_t	r_aliassimd = {"r_aliassimd", "1"};		// 0 - scalar, 2 - compare with scalar
 
 extern cvar_t	scr_fov;
 
@@ -215,6 +216,7 @@ void R_Init (void)
 	Cvar_RegisterVariable (&r_numedges);
 	Cvar_RegisterVariable (&r_aliastransbase);
 	Cvar_RegisterVariable (&r_aliastransadj);
+	Cvar_RegisterVariable (&r_aliassimd);
 
 	Cvar_SetValue ("r_maxedges", (float)NUMSTACKEDGES);
 	Cvar_SetValue ("r_maxsurfs", (float)NUMSTACKSURFACES);
@@ -523,6 +525,7 @@ void R_DrawEntitiesOnList (void)
 		case mod_sprite:
 			VectorCopy (currententity->origin, r_entorigin);
 			VectorSubtract (r_origin, r_entorigin, modelorg);
+			D_FlushPolysets ();		// sprites test the z of the models before them
 			R_DrawSprite ();
 			break;
 
@@ -911,13 +914,6 @@ void R_EdgeDrawing (void)
 		se_time1 = db_time2;
 	}
 
-	if (!r_dspeeds.value)
-	{
-		VID_UnlockBuffer ();
-		S_ExtraUpdate ();	// don't let sound get messed up if going slow
-		VID_LockBuffer ();
-	}
-	
 	if (!(r_drawpolys | r_drawculledpolys))
 		R_ScanEdges ();
 }
@@ -948,22 +944,8 @@ SetVisibilityByPassages ();
 	if (!cl_entities[0].model || !cl.worldmodel)
 		Sys_Error ("R_RenderView: NULL worldmodel");
 		
-	if (!r_dspeeds.value)
-	{
-		VID_UnlockBuffer ();
-		S_ExtraUpdate ();	// don't let sound get messed up if going slow
-		VID_LockBuffer ();
-	}
-	
 	R_EdgeDrawing ();
 
-	if (!r_dspeeds.value)
-	{
-		VID_UnlockBuffer ();
-		S_ExtraUpdate ();	// don't let sound get messed up if going slow
-		VID_LockBuffer ();
-	}
-	
 	if (r_dspeeds.value)
 	{
 		se_time2 = Sys_FloatTime ();
@@ -971,6 +953,7 @@ SetVisibilityByPassages ();
 	}
 
 	R_DrawEntitiesOnList ();
+	D_FlushPolysets ();
 
 	if (r_dspeeds.value)
 	{
@@ -979,6 +962,7 @@ SetVisibilityByPassages ();
 	}
 
 	R_DrawViewModel ();
+	D_FlushPolysets ();
 
 	if (r_dspeeds.value)
 	{
@@ -203,6 +203,8 @@ void R_PrintTimes (void)
 	
 	Con_Printf ("%5.1f ms %3i/%3i/%3i poly %3i surf\n",
 				ms, c_faceclip, r_polycount, r_drawnpolycount, c_surf);
+	Con_Printf ("%5ik cache %4i hit %4i miss %4i evict%s\n",
+				D_CacheSize () / 1024, sc_hits, sc_misses, sc_evictions, r_cache_thrash ? " thrash" : "");
 	c_surf = 0;
 }
 
@@ -482,6 +484,8 @@ r_refdef.viewangles[2]=    0;
 
 	R_SetUpFrustumIndexes ();
 
+// resize the surface cache if the last frame asked for it
+	D_CheckCacheSize ();
 	r_cache_thrash = false;
 
 // clear frame counts
@@ -22,22 +22,27 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "r_local.h"
 
-#define MAX_PARTICLES			2048	// default max # of particles at one
-										//  time
+#if defined(__SSE2_MATH__) || defined(_M_X64)
+#define	PARTICLE_SSE2	1
+#include <emmintrin.h>
+#else
+#define	PARTICLE_SSE2	0
+#endif
+
 #define ABSOLUTE_MIN_PARTICLES	512		// no fewer than this no matter what's
 										//  on the command line
 
 // Size of particle in world space
 cvar_t	r_particle_size = { "r_particle_size", "2", true };
+// Takes effect on the next map
+cvar_t	r_maxparticles = { "r_maxparticles", "16384" };
 
 int		ramp1[8] = {0x6f, 0x6d, 0x6b, 0x69, 0x67, 0x65, 0x63, 0x61};
 int		ramp2[8] = {0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x68, 0x66};
 int		ramp3[8] = {0x6d, 0x6b, 6, 5, 4, 3};
 
-particle_t	*active_particles, *free_particles;
-
-particle_t	*particles;
-int			r_numparticles;
+particles_t	r_particles;
+static void	*r_particlesmem;
 
 vec3_t			r_pright, r_pup, r_ppn;
 
@@ -66,34 +71,99 @@ void R_InitParticles (void)
 	int		i;
 
 	Cvar_RegisterVariable( &r_particle_size );
+	Cvar_RegisterVariable( &r_maxparticles );
 
 	i = COM_CheckParm ("-particles");
 
-	if (i)
-	{
-		r_numparticles = (int)(Q_atoi(com_argv[i+1]));
-		if (r_numparticles < ABSOLUTE_MIN_PARTICLES)
-			r_numparticles = ABSOLUTE_MIN_PARTICLES;
-	}
-	else
-	{
-		r_numparticles = MAX_PARTICLES;
-	}
+	if (i && i < com_argc-1)
+		Cvar_Set ("r_maxparticles", com_argv[i+1]);
+}
+
+
+/*
+===============
+R_AllocParticles
+
+Makes room for r_maxparticles, every field gets its own array
+===============
+*/
+static void R_AllocParticles (void)
+{
+	int		max, size;
+	float	*f;
+	int		i;
+
+	max = (int)r_maxparticles.value;
+	if (max < ABSOLUTE_MIN_PARTICLES)
+		max = ABSOLUTE_MIN_PARTICLES;
+	max = (max + 3) & ~3;		// keeps the float arrays 16 byte aligned
+
+	if (max == r_particles.maxparticles)
+		return;
 
-	particles = (particle_t *)
-			Hunk_AllocName (r_numparticles * sizeof(particle_t), "particles");
+	size = max * (8 * sizeof(float) + 2);
+#ifdef GLQUAKE
+	size += max * 3 * sizeof(particle_vertex_t);
+#endif
 
+	free (r_particlesmem);
+	r_particlesmem = malloc (size);
+	if (!r_particlesmem)
+		Sys_Error ("R_AllocParticles: couldn't allocate %i particles", max);
+
+	f = (float *)r_particlesmem;
+	for (i=0 ; i<3 ; i++, f += max)
+		r_particles.org[i] = f;
+	for (i=0 ; i<3 ; i++, f += max)
+		r_particles.vel[i] = f;
+	r_particles.ramp = f;
+	f += max;
+	r_particles.die = f;
+	f += max;
 #ifdef GLQUAKE
-	particles_buffer = (particle_vertex_t *)
-			Hunk_AllocName( r_numparticles * sizeof(particle_vertex_t) * 3, "partvert" );
+	particles_buffer = (particle_vertex_t *)f;
+	f = (float *)(particles_buffer + max * 3);
 #endif
+	r_particles.color = (byte *)f;
+	r_particles.type = r_particles.color + max;
+
+	r_particles.maxparticles = max;
+	r_particles.numparticles = 0;
+
+	Con_DPrintf ("%i particles, %i kb\n", max, size / 1024);
+}
+
+
+/*
+===============
+R_AllocParticle
+
+Returns the index of a new particle, with everything but org cleared, or
+-1 if there is no room
+===============
+*/
+static int R_AllocParticle (void)
+{
+	int		p;
+
+	if (r_particles.numparticles == r_particles.maxparticles)
+		return -1;
+
+	p = r_particles.numparticles++;
+	r_particles.vel[0][p] = r_particles.vel[1][p] = r_particles.vel[2][p] = 0;
+	r_particles.ramp[p] = 0;
+	r_particles.die[p] = 0;
+	r_particles.color[p] = 0;
+	r_particles.type[p] = pt_static;
+
+	return p;
 }
 
 #ifdef QUAKE2
 void R_DarkFieldParticles (entity_t *ent)
 {
-	int			i, j, k;
-	particle_t	*p;
+	int			i, j, k, l;
+	int			p;
 	float		vel;
 	vec3_t		dir;
 	vec3_t		org;
@@ -105,28 +175,26 @@ void R_DarkFieldParticles (entity_t *ent)
 		for (j=-16 ; j<16 ; j+=8)
 			for (k=0 ; k<32 ; k+=8)
 			{
-				if (!free_particles)
+				p = R_AllocParticle ();
+				if (p < 0)
 					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
 		
-				p->die = cl.time + 0.2 + (rand()&7) * 0.02;
-				p->color = 150 + rand()%6;
-				p->type = pt_slowgrav;
+				r_particles.die[p] = cl.time + 0.2 + (rand()&7) * 0.02;
+				r_particles.color[p] = 150 + rand()%6;
+				r_particles.type[p] = pt_slowgrav;
 				
 				dir[0] = j*8;
 				dir[1] = i*8;
 				dir[2] = k*8;
 	
-				p->org[0] = org[0] + i + (rand()&3);
-				p->org[1] = org[1] + j + (rand()&3);
-				p->org[2] = org[2] + k + (rand()&3);
+				r_particles.org[0][p] = org[0] + i + (rand()&3);
+				r_particles.org[1][p] = org[1] + j + (rand()&3);
+				r_particles.org[2][p] = org[2] + k + (rand()&3);
 	
 				VectorNormalize (dir);						
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				for (l=0 ; l<3 ; l++)
+					r_particles.vel[l][p] = dir[l] * vel;
 			}
 }
 #endif
@@ -150,7 +218,7 @@ void R_EntityParticles (entity_t *ent)
 {
 	int			count;
 	int			i;
-	particle_t	*p;
+	int			p;
 	float		angle;
 	float		sr, sp, sy, cr, cp, cy;
 	vec3_t		forward;
@@ -182,20 +250,17 @@ avelocities[0][i] = (rand()&255) * 0.01;
 		forward[1] = cp*sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 0.01;
-		p->color = 0x6f;
-		p->type = pt_explode;
+
+		r_particles.die[p] = cl.time + 0.01;
+		r_particles.color[p] = 0x6f;
+		r_particles.type[p] = pt_explode;
 		
-		p->org[0] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;			
-		p->org[1] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;			
-		p->org[2] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;			
+		r_particles.org[0][p] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;			
+		r_particles.org[1][p] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;			
+		r_particles.org[2][p] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;			
 	}
 }
 
@@ -207,14 +272,9 @@ R_ClearParticles
 */
 void R_ClearParticles (void)
 {
-	int		i;
-	
-	free_particles = &particles[0];
-	active_particles = NULL;
+	R_AllocParticles ();
 
-	for (i=0 ;i<r_numparticles ; i++)
-		particles[i].next = &particles[i+1];
-	particles[r_numparticles-1].next = NULL;
+	r_particles.numparticles = 0;
 }
 
 
@@ -224,7 +284,7 @@ void R_ReadPointFile_f (void)
 	vec3_t	org;
 	int		r;
 	int		c;
-	particle_t	*p;
+	int		p, j;
 	char	name[MAX_OSPATH];
 	
 	sprintf (name,"maps/%s.pts", sv.name);
@@ -245,21 +305,18 @@ void R_ReadPointFile_f (void)
 			break;
 		c++;
 		
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 		{
 			Con_Printf ("Not enough free particles\n");
 			break;
 		}
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		
-		p->die = 99999;
-		p->color = (-c)&15;
-		p->type = pt_static;
-		VectorCopy (vec3_origin, p->vel);
-		VectorCopy (org, p->org);
+		r_particles.die[p] = 99999;
+		r_particles.color[p] = (-c)&15;
+		r_particles.type[p] = pt_static;
+		for (j=0 ; j<3 ; j++)
+			r_particles.org[j][p] = org[j];
 	}
 
 	fclose (f);
@@ -302,36 +359,33 @@ R_ParticleExplosion
 void R_ParticleExplosion (vec3_t org)
 {
 	int			i, j;
-	particle_t	*p;
+	int			p;
 	
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 5;
-		p->color = ramp1[0];
-		p->ramp = rand()&3;
+
+		r_particles.die[p] = cl.time + 5;
+		r_particles.color[p] = ramp1[0];
+		r_particles.ramp[p] = rand()&3;
 		if (i & 1)
 		{
-			p->type = pt_explode;
+			r_particles.type[p] = pt_explode;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+				r_particles.vel[j][p] = (rand()%512)-256;
 			}
 		}
 		else
 		{
-			p->type = pt_explode2;
+			r_particles.type[p] = pt_explode2;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+				r_particles.vel[j][p] = (rand()%512)-256;
 			}
 		}
 	}
@@ -346,27 +400,24 @@ R_ParticleExplosion2
 void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
 {
 	int			i, j;
-	particle_t	*p;
+	int			p;
 	int			colorMod = 0;
 
 	for (i=0; i<512; i++)
 	{
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
-		p->die = cl.time + 0.3;
-		p->color = colorStart + (colorMod % colorLength);
+		r_particles.die[p] = cl.time + 0.3;
+		r_particles.color[p] = colorStart + (colorMod % colorLength);
 		colorMod++;
 
-		p->type = pt_blob;
+		r_particles.type[p] = pt_blob;
 		for (j=0 ; j<3 ; j++)
 		{
-			p->org[j] = org[j] + ((rand()%32)-16);
-			p->vel[j] = (rand()%512)-256;
+			r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+			r_particles.vel[j][p] = (rand()%512)-256;
 		}
 	}
 }
@@ -380,37 +431,34 @@ R_BlobExplosion
 void R_BlobExplosion (vec3_t org)
 {
 	int			i, j;
-	particle_t	*p;
+	int			p;
 	
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
-		p->die = cl.time + 1 + (rand()&8)*0.05;
+		r_particles.die[p] = cl.time + 1 + (rand()&8)*0.05;
 
 		if (i & 1)
 		{
-			p->type = pt_blob;
-			p->color = 66 + rand()%6;
+			r_particles.type[p] = pt_blob;
+			r_particles.color[p] = 66 + rand()%6;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+				r_particles.vel[j][p] = (rand()%512)-256;
 			}
 		}
 		else
 		{
-			p->type = pt_blob2;
-			p->color = 150 + rand()%6;
+			r_particles.type[p] = pt_blob2;
+			r_particles.color[p] = 150 + rand()%6;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()%32)-16);
-				p->vel[j] = (rand()%512)-256;
+				r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+				r_particles.vel[j][p] = (rand()%512)-256;
 			}
 		}
 	}
@@ -425,50 +473,47 @@ R_RunParticleEffect
 void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
 {
 	int			i, j;
-	particle_t	*p;
+	int			p;
 	
 	for (i=0 ; i<count ; i++)
 	{
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
 		if (count == 1024)
 		{	// rocket explosion
-			p->die = cl.time + 5;
-			p->color = ramp1[0];
-			p->ramp = rand()&3;
+			r_particles.die[p] = cl.time + 5;
+			r_particles.color[p] = ramp1[0];
+			r_particles.ramp[p] = rand()&3;
 			if (i & 1)
 			{
-				p->type = pt_explode;
+				r_particles.type[p] = pt_explode;
 				for (j=0 ; j<3 ; j++)
 				{
-					p->org[j] = org[j] + ((rand()%32)-16);
-					p->vel[j] = (rand()%512)-256;
+					r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+					r_particles.vel[j][p] = (rand()%512)-256;
 				}
 			}
 			else
 			{
-				p->type = pt_explode2;
+				r_particles.type[p] = pt_explode2;
 				for (j=0 ; j<3 ; j++)
 				{
-					p->org[j] = org[j] + ((rand()%32)-16);
-					p->vel[j] = (rand()%512)-256;
+					r_particles.org[j][p] = org[j] + ((rand()%32)-16);
+					r_particles.vel[j][p] = (rand()%512)-256;
 				}
 			}
 		}
 		else
 		{
-			p->die = cl.time + 0.1*(rand()%5);
-			p->color = (color&~7) + (rand()&7);
-			p->type = pt_slowgrav;
+			r_particles.die[p] = cl.time + 0.1*(rand()%5);
+			r_particles.color[p] = (color&~7) + (rand()&7);
+			r_particles.type[p] = pt_slowgrav;
 			for (j=0 ; j<3 ; j++)
 			{
-				p->org[j] = org[j] + ((rand()&15)-8);
-				p->vel[j] = dir[j]*15;// + (rand()%300)-150;
+				r_particles.org[j][p] = org[j] + ((rand()&15)-8);
+				r_particles.vel[j][p] = dir[j]*15;// + (rand()%300)-150;
 			}
 		}
 	}
@@ -483,8 +528,8 @@ R_LavaSplash
 */
 void R_LavaSplash (vec3_t org)
 {
-	int			i, j, k;
-	particle_t	*p;
+	int			i, j, k, l;
+	int			p;
 	float		vel;
 	vec3_t		dir;
 
@@ -492,28 +537,26 @@ void R_LavaSplash (vec3_t org)
 		for (j=-16 ; j<16 ; j++)
 			for (k=0 ; k<1 ; k++)
 			{
-				if (!free_particles)
+				p = R_AllocParticle ();
+				if (p < 0)
 					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
 		
-				p->die = cl.time + 2 + (rand()&31) * 0.02;
-				p->color = 224 + (rand()&7);
-				p->type = pt_slowgrav;
+				r_particles.die[p] = cl.time + 2 + (rand()&31) * 0.02;
+				r_particles.color[p] = 224 + (rand()&7);
+				r_particles.type[p] = pt_slowgrav;
 				
 				dir[0] = j*8 + (rand()&7);
 				dir[1] = i*8 + (rand()&7);
 				dir[2] = 256;
 	
-				p->org[0] = org[0] + dir[0];
-				p->org[1] = org[1] + dir[1];
-				p->org[2] = org[2] + (rand()&63);
+				r_particles.org[0][p] = org[0] + dir[0];
+				r_particles.org[1][p] = org[1] + dir[1];
+				r_particles.org[2][p] = org[2] + (rand()&63);
 	
 				VectorNormalize (dir);						
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				for (l=0 ; l<3 ; l++)
+					r_particles.vel[l][p] = dir[l] * vel;
 			}
 }
 
@@ -525,8 +568,8 @@ R_TeleportSplash
 */
 void R_TeleportSplash (vec3_t org)
 {
-	int			i, j, k;
-	particle_t	*p;
+	int			i, j, k, l;
+	int			p;
 	float		vel;
 	vec3_t		dir;
 
@@ -534,28 +577,26 @@ void R_TeleportSplash (vec3_t org)
 		for (j=-16 ; j<16 ; j+=4)
 			for (k=-24 ; k<32 ; k+=4)
 			{
-				if (!free_particles)
+				p = R_AllocParticle ();
+				if (p < 0)
 					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
 		
-				p->die = cl.time + 0.2 + (rand()&7) * 0.02;
-				p->color = 7 + (rand()&7);
-				p->type = pt_slowgrav;
+				r_particles.die[p] = cl.time + 0.2 + (rand()&7) * 0.02;
+				r_particles.color[p] = 7 + (rand()&7);
+				r_particles.type[p] = pt_slowgrav;
 				
 				dir[0] = j*8;
 				dir[1] = i*8;
 				dir[2] = k*8;
 	
-				p->org[0] = org[0] + i + (rand()&3);
-				p->org[1] = org[1] + j + (rand()&3);
-				p->org[2] = org[2] + k + (rand()&3);
+				r_particles.org[0][p] = org[0] + i + (rand()&3);
+				r_particles.org[1][p] = org[1] + j + (rand()&3);
+				r_particles.org[2][p] = org[2] + k + (rand()&3);
 	
 				VectorNormalize (dir);						
 				vel = 50 + (rand()&63);
-				VectorScale (dir, vel, p->vel);
+				for (l=0 ; l<3 ; l++)
+					r_particles.vel[l][p] = dir[l] * vel;
 			}
 }
 
@@ -564,7 +605,7 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	vec3_t		vec;
 	float		len;
 	int			j;
-	particle_t	*p;
+	int			p;
 	int			dec;
 	static int	tracercount;
 
@@ -582,79 +623,76 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = R_AllocParticle ();
+		if (p < 0)
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		
-		VectorCopy (vec3_origin, p->vel);
-		p->die = cl.time + 2;
+				r_particles.die[p] = cl.time + 2;
 
 		switch (type)
 		{
 			case 0:	// rocket trail
-				p->ramp = (rand()&3);
-				p->color = ramp3[(int)p->ramp];
-				p->type = pt_fire;
+				r_particles.ramp[p] = (rand()&3);
+				r_particles.color[p] = ramp3[(int)r_particles.ramp[p]];
+				r_particles.type[p] = pt_fire;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					r_particles.org[j][p] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 1:	// smoke smoke
-				p->ramp = (rand()&3) + 2;
-				p->color = ramp3[(int)p->ramp];
-				p->type = pt_fire;
+				r_particles.ramp[p] = (rand()&3) + 2;
+				r_particles.color[p] = ramp3[(int)r_particles.ramp[p]];
+				r_particles.type[p] = pt_fire;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					r_particles.org[j][p] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 2:	// blood
-				p->type = pt_grav;
-				p->color = 67 + (rand()&3);
+				r_particles.type[p] = pt_grav;
+				r_particles.color[p] = 67 + (rand()&3);
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					r_particles.org[j][p] = start[j] + ((rand()%6)-3);
 				break;
 
 			case 3:
 			case 5:	// tracer
-				p->die = cl.time + 0.5;
-				p->type = pt_static;
+				r_particles.die[p] = cl.time + 0.5;
+				r_particles.type[p] = pt_static;
 				if (type == 3)
-					p->color = 52 + ((tracercount&4)<<1);
+					r_particles.color[p] = 52 + ((tracercount&4)<<1);
 				else
-					p->color = 230 + ((tracercount&4)<<1);
+					r_particles.color[p] = 230 + ((tracercount&4)<<1);
 			
 				tracercount++;
 
-				VectorCopy (start, p->org);
+				for (j=0 ; j<3 ; j++)
+					r_particles.org[j][p] = start[j];
 				if (tracercount & 1)
 				{
-					p->vel[0] = 30*vec[1];
-					p->vel[1] = 30*-vec[0];
+					r_particles.vel[0][p] = 30*vec[1];
+					r_particles.vel[1][p] = 30*-vec[0];
 				}
 				else
 				{
-					p->vel[0] = 30*-vec[1];
-					p->vel[1] = 30*vec[0];
+					r_particles.vel[0][p] = 30*-vec[1];
+					r_particles.vel[1][p] = 30*vec[0];
 				}
 				break;
 
 			case 4:	// slight blood
-				p->type = pt_grav;
-				p->color = 67 + (rand()&3);
+				r_particles.type[p] = pt_grav;
+				r_particles.color[p] = 67 + (rand()&3);
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()%6)-3);
+					r_particles.org[j][p] = start[j] + ((rand()%6)-3);
 				len -= 3;
 				break;
 
 			case 6:	// voor trail
-				p->color = 9*16 + 8 + (rand()&3);
-				p->type = pt_static;
-				p->die = cl.time + 0.3;
+				r_particles.color[p] = 9*16 + 8 + (rand()&3);
+				r_particles.type[p] = pt_static;
+				r_particles.die[p] = cl.time + 0.3;
 				for (j=0 ; j<3 ; j++)
-					p->org[j] = start[j] + ((rand()&15)-8);
+					r_particles.org[j][p] = start[j] + ((rand()&15)-8);
 				break;
 		}
 		
@@ -666,27 +704,171 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 
 /*
 ===============
-R_DrawParticles
+R_KillParticles
+
+Packs the live particles at the start of the arrays, keeping their order
+===============
+*/
+static void R_KillParticles (void)
+{
+	particles_t	*pt;
+	int			i, j, n;
+	double		time;
+
+	pt = &r_particles;
+	time = cl.time;
+
+	// nothing to move until the first dead one
+	for (i=0 ; i<pt->numparticles ; i++)
+		if (pt->die[i] < time)
+			break;
+
+	for (n=i ; i<pt->numparticles ; i++)
+	{
+		if (pt->die[i] < time)
+			continue;
+
+		for (j=0 ; j<3 ; j++)
+		{
+			pt->org[j][n] = pt->org[j][i];
+			pt->vel[j][n] = pt->vel[j][i];
+		}
+		pt->ramp[n] = pt->ramp[i];
+		pt->die[n] = pt->die[i];
+		pt->color[n] = pt->color[i];
+		pt->type[n] = pt->type[i];
+		n++;
+	}
+
+	pt->numparticles = n;
+}
+
+
+/*
+===============
+R_MoveParticles
+
+Every type changes the velocity by the same formula with its own factors:
+vel += vel * scale, then vel[2] += gravity. Factors of 0 change nothing, so
+the result is the same as applying only the terms of the type.
 ===============
 */
 extern	cvar_t	sv_gravity;
 
+static void R_MoveParticles (float frametime)
+{
+	particles_t	*pt;
+	float		grav, dvel;
+	float		scalexy[8], scalez[8], gravity[8];
+	float		rampstep[3];
+	int			*ramps[3] = {ramp3, ramp1, ramp2};	// pt_fire, pt_explode, pt_explode2
+	int			ramplimit[3] = {6, 8, 8};
+	int			i, j, t, n;
+
+	pt = &r_particles;
+	n = pt->numparticles;
+
+	grav = frametime * sv_gravity.value * 0.05;
+	dvel = 4*frametime;
+
+	for (i=0 ; i<8 ; i++)
+	{
+		scalexy[i] = 0;
+		scalez[i] = 0;
+		gravity[i] = -grav;
+	}
+	gravity[pt_static] = 0;
+	gravity[pt_fire] = grav;
+#ifdef QUAKE2
+	gravity[pt_grav] = -(grav * 20);
+#endif
+	scalexy[pt_explode] = scalez[pt_explode] = dvel;
+	scalexy[pt_explode2] = scalez[pt_explode2] = -frametime;
+	scalexy[pt_blob] = scalez[pt_blob] = dvel;
+	scalexy[pt_blob2] = -dvel;
+
+	rampstep[0] = frametime * 5;
+	rampstep[1] = frametime * 10; // 15;
+	rampstep[2] = frametime * 15;
+
+	i = 0;
+#if PARTICLE_SSE2
+	{
+		__m128	ft, sxy, sz, g, v;
+		byte	*type;
+
+		ft = _mm_set1_ps (frametime);
+		for ( ; i + 4 <= n ; i += 4)
+		{
+			for (j=0 ; j<3 ; j++)
+			{
+				v = _mm_loadu_ps (pt->vel[j] + i);
+				_mm_storeu_ps (pt->org[j] + i, _mm_add_ps (_mm_loadu_ps (pt->org[j] + i), _mm_mul_ps (v, ft)));
+			}
+
+			type = pt->type + i;
+			sxy = _mm_setr_ps (scalexy[type[0]], scalexy[type[1]], scalexy[type[2]], scalexy[type[3]]);
+			sz = _mm_setr_ps (scalez[type[0]], scalez[type[1]], scalez[type[2]], scalez[type[3]]);
+			g = _mm_setr_ps (gravity[type[0]], gravity[type[1]], gravity[type[2]], gravity[type[3]]);
+
+			v = _mm_loadu_ps (pt->vel[0] + i);
+			_mm_storeu_ps (pt->vel[0] + i, _mm_add_ps (v, _mm_mul_ps (v, sxy)));
+			v = _mm_loadu_ps (pt->vel[1] + i);
+			_mm_storeu_ps (pt->vel[1] + i, _mm_add_ps (v, _mm_mul_ps (v, sxy)));
+			v = _mm_loadu_ps (pt->vel[2] + i);
+			v = _mm_add_ps (v, _mm_mul_ps (v, sz));
+			_mm_storeu_ps (pt->vel[2] + i, _mm_add_ps (v, g));
+		}
+	}
+#endif
+	for ( ; i<n ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
+			pt->org[j][i] += pt->vel[j][i]*frametime;
+
+		t = pt->type[i];
+		pt->vel[0][i] += pt->vel[0][i]*scalexy[t];
+		pt->vel[1][i] += pt->vel[1][i]*scalexy[t];
+		pt->vel[2][i] += pt->vel[2][i]*scalez[t];
+		pt->vel[2][i] += gravity[t];
+	}
+
+	// color ramps
+	for (i=0 ; i<n ; i++)
+	{
+		t = pt->type[i] - pt_fire;
+		if (t < 0 || t > pt_explode2 - pt_fire)
+			continue;
+
+		pt->ramp[i] += rampstep[t];
+		if (pt->ramp[i] >= ramplimit[t])
+			pt->die[i] = -1;
+		else
+			pt->color[i] = ramps[t][(int)pt->ramp[i]];
+	}
+}
+
+
+/*
+===============
+R_DrawParticles
+===============
+*/
 void R_DrawParticles (void)
 {
-	particle_t		*p, *kill;
-	float			grav;
-	int				i;
-	float			time2, time3;
-	float			time1;
-	float			dvel;
-	float			frametime;
-	
 #ifdef GLQUAKE
-	vec3_t			up, right;
+	particles_t		*pt;
+	int				i;
+	vec3_t			org, up, right;
 	float			scale;
 	float			min_distance, max_distance, half_fov_tan, min_pix_size;
 	particle_vertex_t*	vert;
+#endif
 
+	R_KillParticles ();
+
+#ifdef GLQUAKE
+	pt = &r_particles;
 	vert = particles_buffer;
 
 	GL_Bind(particletexture);
@@ -706,52 +888,16 @@ void R_DrawParticles (void)
 	if (min_pix_size < 2.0f)
 		min_pix_size = 2.0f;
 	max_distance = r_refdef.vrect.width * r_particle_size.value / ( half_fov_tan * 2.0f * min_pix_size );
-#else
-	D_StartParticles ();
 
-	VectorScale (vright, xscaleshrink, r_pright);
-	VectorScale (vup, yscaleshrink, r_pup);
-	VectorCopy (vpn, r_ppn);
-#endif
-	frametime = cl.time - cl.oldtime;
-	time3 = frametime * 15;
-	time2 = frametime * 10; // 15;
-	time1 = frametime * 5;
-	grav = frametime * sv_gravity.value * 0.05;
-	dvel = 4*frametime;
-	
-	for ( ;; ) 
+	for (i=0 ; i<pt->numparticles ; i++)
 	{
-		kill = active_particles;
-		if (kill && kill->die < cl.time)
-		{
-			active_particles = kill->next;
-			kill->next = free_particles;
-			free_particles = kill;
-			continue;
-		}
-		break;
-	}
+		org[0] = pt->org[0][i];
+		org[1] = pt->org[1][i];
+		org[2] = pt->org[2][i];
 
-	for (p=active_particles ; p ; p=p->next)
-	{
-		for ( ;; )
-		{
-			kill = p->next;
-			if (kill && kill->die < cl.time)
-			{
-				p->next = kill->next;
-				kill->next = free_particles;
-				free_particles = kill;
-				continue;
-			}
-			break;
-		}
-
-#ifdef GLQUAKE
 		// hack a scale up to keep particles from disapearing
-		scale = (p->org[0] - r_origin[0])*vpn[0] + (p->org[1] - r_origin[1])*vpn[1]
-			+ (p->org[2] - r_origin[2])*vpn[2];
+		scale = (org[0] - r_origin[0])*vpn[0] + (org[1] - r_origin[1])*vpn[1]
+			+ (org[2] - r_origin[2])*vpn[2];
 		if (scale > 0.0f)
 		{
 			if (scale < min_distance)
@@ -762,83 +908,19 @@ void R_DrawParticles (void)
 				scale = 1.0;
 		}
 		
-		VectorCopy(p->org, vert[0].v);
+		VectorCopy(org, vert[0].v);
 		vert[0].tc[0] = 0; vert[0].tc[1] = 0;
 
-		VectorMA(p->org, scale, up, vert[1].v);
+		VectorMA(org, scale, up, vert[1].v);
 		vert[1].tc[0] = 1; vert[1].tc[1] = 0;
 
-		VectorMA(p->org, scale, right, vert[2].v);
+		VectorMA(org, scale, right, vert[2].v);
 		vert[2].tc[0] = 0; vert[2].tc[1] = 1;
 
-		vert[0].color = vert[1].color = vert[2].color = d_8to24table[(int)p->color];
+		vert[0].color = vert[1].color = vert[2].color = d_8to24table[pt->color[i]];
 		vert += 3;
-#else
-		D_DrawParticle (p);
-#endif
-		p->org[0] += p->vel[0]*frametime;
-		p->org[1] += p->vel[1]*frametime;
-		p->org[2] += p->vel[2]*frametime;
-		
-		switch (p->type)
-		{
-		case pt_static:
-			break;
-		case pt_fire:
-			p->ramp += time1;
-			if (p->ramp >= 6)
-				p->die = -1;
-			else
-				p->color = ramp3[(int)p->ramp];
-			p->vel[2] += grav;
-			break;
-
-		case pt_explode:
-			p->ramp += time2;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp1[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
-
-		case pt_explode2:
-			p->ramp += time3;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp2[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] -= p->vel[i]*frametime;
-			p->vel[2] -= grav;
-			break;
-
-		case pt_blob:
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
-
-		case pt_blob2:
-			for (i=0 ; i<2 ; i++)
-				p->vel[i] -= p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
-
-		case pt_grav:
-#ifdef QUAKE2
-			p->vel[2] -= grav * 20;
-			break;
-#endif
-		case pt_slowgrav:
-			p->vel[2] -= grav;
-			break;
-		}
 	}
 
-#ifdef GLQUAKE
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
@@ -856,7 +938,16 @@ void R_DrawParticles (void)
 	glDisable (GL_BLEND);
 	glDisable (GL_ALPHA_TEST);
 #else
+	D_StartParticles ();
+
+	VectorScale (vright, xscaleshrink, r_pright);
+	VectorScale (vup, yscaleshrink, r_pup);
+	VectorCopy (vpn, r_ppn);
+
+	D_DrawParticles (&r_particles);
+
 	D_EndParticles ();
 #endif
-}
 
+	R_MoveParticles (cl.time - cl.oldtime);
+}
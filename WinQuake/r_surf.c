@@ -23,40 +23,41 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "r_local.h"
 
-drawsurf_t	r_drawsurf;
-
-int				lightleft, sourcesstep, blocksize, sourcetstep;
-int				lightdelta, lightdeltastep;
-int				lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned		blockdivmask;
-void			*prowdestbase;
-unsigned char	*pbasesource;
-int				surfrowpixels;
-unsigned		*r_lightptr;
-int				r_stepback;
-int				r_lightwidth;
-int				r_numhblocks, r_numvblocks;
-unsigned char	*r_source, *r_sourcemax;
-
-void R_DrawSurfaceBlock8_mip0 (void);
-void R_DrawSurfaceBlock8_mip1 (void);
-void R_DrawSurfaceBlock8_mip2 (void);
-void R_DrawSurfaceBlock8_mip3 (void);
-
-void R_DrawSurfaceBlock32_mip0 (void);
-void R_DrawSurfaceBlock32_mip1 (void);
-void R_DrawSurfaceBlock32_mip2 (void);
-void R_DrawSurfaceBlock32_mip3 (void);
-
-
-static void	(*surfmiptable8[4])(void) = {
+// state of the block drawers, kept on the stack of R_DrawSurface, so
+// several surfaces can be drawn at once on different threads
+typedef struct
+{
+	unsigned		blocklights[18*18];
+	unsigned		*lightptr;
+	int				lightwidth;
+	void			*prowdestbase;
+	unsigned char	*pbasesource;
+	int				surfrowpixels;
+	int				sourcetstep;
+	int				stepback;
+	int				numvblocks;
+	unsigned char	*sourcemax;
+} surfblock_t;
+
+void R_DrawSurfaceBlock8_mip0 (surfblock_t *sb);
+void R_DrawSurfaceBlock8_mip1 (surfblock_t *sb);
+void R_DrawSurfaceBlock8_mip2 (surfblock_t *sb);
+void R_DrawSurfaceBlock8_mip3 (surfblock_t *sb);
+
+void R_DrawSurfaceBlock32_mip0 (surfblock_t *sb);
+void R_DrawSurfaceBlock32_mip1 (surfblock_t *sb);
+void R_DrawSurfaceBlock32_mip2 (surfblock_t *sb);
+void R_DrawSurfaceBlock32_mip3 (surfblock_t *sb);
+
+
+static void	(*surfmiptable8[4])(surfblock_t *sb) = {
 	R_DrawSurfaceBlock8_mip0,
 	R_DrawSurfaceBlock8_mip1,
 	R_DrawSurfaceBlock8_mip2,
 	R_DrawSurfaceBlock8_mip3
 };
 
-static void	(*surfmiptable32[4])(void) = {
+static void	(*surfmiptable32[4])(surfblock_t *sb) = {
 	R_DrawSurfaceBlock32_mip0,
 	R_DrawSurfaceBlock32_mip1,
 	R_DrawSurfaceBlock32_mip2,
@@ -65,14 +66,12 @@ static void	(*surfmiptable32[4])(void) = {
 
 
 
-unsigned		blocklights[18*18];
-
 /*
 ===============
 R_AddDynamicLights
 ===============
 */
-void R_AddDynamicLights (void)
+void R_AddDynamicLights (drawsurf_t *ds, unsigned *blocklights)
 {
 	msurface_t *surf;
 	int			lnum;
@@ -84,7 +83,7 @@ void R_AddDynamicLights (void)
 	int			smax, tmax;
 	mtexinfo_t	*tex;
 
-	surf = r_drawsurf.surf;
+	surf = ds->surf;
 	smax = (surf->extents[0]>>4)+1;
 	tmax = (surf->extents[1]>>4)+1;
 	tex = surf->texinfo;
@@ -160,7 +159,7 @@ R_BuildLightMap
 Combine and scale multiple lightmaps into the 8.8 format in blocklights
 ===============
 */
-void R_BuildLightMap (void)
+void R_BuildLightMap (drawsurf_t *ds, unsigned *blocklights)
 {
 	int			smax, tmax;
 	int			t;
@@ -170,7 +169,7 @@ void R_BuildLightMap (void)
 	int			maps;
 	msurface_t	*surf;
 
-	surf = r_drawsurf.surf;
+	surf = ds->surf;
 
 	smax = (surf->extents[0]>>4)+1;
 	tmax = (surf->extents[1]>>4)+1;
@@ -194,7 +193,7 @@ void R_BuildLightMap (void)
 		for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
 			 maps++)
 		{
-			scale = r_drawsurf.lightadj[maps];	// 8.8 fraction		
+			scale = ds->lightadj[maps];	// 8.8 fraction		
 			for (i=0 ; i<size ; i++)
 				blocklights[i] += lightmap[i] * scale;
 			lightmap += size;	// skip to next lightmap
@@ -202,7 +201,7 @@ void R_BuildLightMap (void)
 
 // add all the dynamic lights
 	if (surf->dlightframe == r_framecount)
-		R_AddDynamicLights ();
+		R_AddDynamicLights (ds, blocklights);
 
 	if (r_pixbytes == 1)
 	{
@@ -264,84 +263,91 @@ texture_t *R_TextureAnimation (texture_t *base)
 /*
 ===============
 R_DrawSurface
+
+Draws and lights the texture of ds->surf into ds->surfdat.
+Uses no global state but the read-only refresh data, so it can be called
+from several threads at once for different surfaces.
 ===============
 */
-void R_DrawSurface (void)
+void R_DrawSurface (drawsurf_t *ds)
 {
+	surfblock_t		sb;
 	unsigned char	*basetptr;
+	unsigned char	*source;
 	int				smax, tmax, twidth;
 	int				u;
 	int				soffset, basetoffset, texwidth;
+	int				blocksize, blockdivshift;
+	int				numhblocks;
 	int				horzblockstep;
 	unsigned char	*pcolumndest;
-	void			(*pblockdrawer)(void);
+	void			(*pblockdrawer)(surfblock_t *sb);
 	texture_t		*mt;
 
 // calculate the lightings
-	R_BuildLightMap ();
+	R_BuildLightMap (ds, sb.blocklights);
 	
-	surfrowpixels = r_drawsurf.rowpixels;
+	sb.surfrowpixels = ds->rowpixels;
 
-	mt = r_drawsurf.texture;
+	mt = ds->texture;
 	
-	r_source = (byte *)mt + mt->offsets[r_drawsurf.surfmip];
+	source = (byte *)mt + mt->offsets[ds->surfmip];
 	
 // the fractional light values should range from 0 to (VID_GRADES - 1) << 16
 // from a source range of 0 - 255
 	
-	texwidth = mt->width >> r_drawsurf.surfmip;
+	texwidth = mt->width >> ds->surfmip;
 
-	blocksize = 16 >> r_drawsurf.surfmip;
-	blockdivshift = 4 - r_drawsurf.surfmip;
-	blockdivmask = (1 << blockdivshift) - 1;
+	blocksize = 16 >> ds->surfmip;
+	blockdivshift = 4 - ds->surfmip;
 	
-	r_lightwidth = (r_drawsurf.surf->extents[0]>>4)+1;
+	sb.lightwidth = (ds->surf->extents[0]>>4)+1;
 
-	r_numhblocks = r_drawsurf.surfwidth >> blockdivshift;
-	r_numvblocks = r_drawsurf.surfheight >> blockdivshift;
+	numhblocks = ds->surfwidth >> blockdivshift;
+	sb.numvblocks = ds->surfheight >> blockdivshift;
 
 //==============================
 
 	if (r_pixbytes == 1)
 	{
-		pblockdrawer = surfmiptable8[r_drawsurf.surfmip];
+		pblockdrawer = surfmiptable8[ds->surfmip];
 	// TODO: only needs to be set when there is a display settings change
 		horzblockstep = blocksize;
 	}
 	else
 	{
-		pblockdrawer = surfmiptable32[r_drawsurf.surfmip];
+		pblockdrawer = surfmiptable32[ds->surfmip];
 	// TODO: only needs to be set when there is a display settings change
 		horzblockstep = blocksize << 2;
 	}
 
-	smax = mt->width >> r_drawsurf.surfmip;
+	smax = mt->width >> ds->surfmip;
 	twidth = texwidth;
-	tmax = mt->height >> r_drawsurf.surfmip;
-	sourcetstep = texwidth;
-	r_stepback = tmax * twidth;
+	tmax = mt->height >> ds->surfmip;
+	sb.sourcetstep = texwidth;
+	sb.stepback = tmax * twidth;
 
-	r_sourcemax = r_source + (tmax * smax);
+	sb.sourcemax = source + (tmax * smax);
 
-	soffset = r_drawsurf.surf->texturemins[0];
-	basetoffset = r_drawsurf.surf->texturemins[1];
+	soffset = ds->surf->texturemins[0];
+	basetoffset = ds->surf->texturemins[1];
 
 // << 16 components are to guarantee positive values for %
-	soffset = ((soffset >> r_drawsurf.surfmip) + (smax << 16)) % smax;
-	basetptr = &r_source[((((basetoffset >> r_drawsurf.surfmip) 
+	soffset = ((soffset >> ds->surfmip) + (smax << 16)) % smax;
+	basetptr = &source[((((basetoffset >> ds->surfmip) 
 		+ (tmax << 16)) % tmax) * twidth)];
 
-	pcolumndest = r_drawsurf.surfdat;
+	pcolumndest = (unsigned char *)ds->surfdat;
 
-	for (u=0 ; u<r_numhblocks; u++)
+	for (u=0 ; u<numhblocks; u++)
 	{
-		r_lightptr = blocklights + u;
+		sb.lightptr = sb.blocklights + u;
 
-		prowdestbase = pcolumndest;
+		sb.prowdestbase = pcolumndest;
 
-		pbasesource = basetptr + soffset;
+		sb.pbasesource = basetptr + soffset;
 
-		(*pblockdrawer)();
+		(*pblockdrawer)(&sb);
 
 		soffset = soffset + blocksize;
 		if (soffset >= smax)
@@ -378,23 +384,23 @@ static int c_bayer_matrix_2x2[2][2];
 R_DrawSurfaceBlock8_mip0
 ================
 */
-void R_DrawSurfaceBlock8_mip0 (void)
+void R_DrawSurfaceBlock8_mip0 (surfblock_t *sb)
 {
 	int				v, i, b, lightstep, lighttemp, light, light_add;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
 	unsigned char	pix, *psource, *prowdest;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 4;
-		lightrightstep = (r_lightptr[1] - lightright) >> 4;
+		lightleft = sb->lightptr[0];
+		lightright = sb->lightptr[1];
+		sb->lightptr += sb->lightwidth;
+		lightleftstep = (sb->lightptr[0] - lightleft) >> 4;
+		lightrightstep = (sb->lightptr[1] - lightright) >> 4;
 
 		for (i=0 ; i<16 ; i++)
 		{
@@ -413,14 +419,14 @@ void R_DrawSurfaceBlock8_mip0 (void)
 				light += lightstep;
 			}
 	
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowpixels;
+			prowdest += sb->surfrowpixels;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -430,23 +436,23 @@ void R_DrawSurfaceBlock8_mip0 (void)
 R_DrawSurfaceBlock8_mip1
 ================
 */
-void R_DrawSurfaceBlock8_mip1 (void)
+void R_DrawSurfaceBlock8_mip1 (surfblock_t *sb)
 {
 	int				v, i, b, lightstep, lighttemp, light, light_add;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
 	unsigned char	pix, *psource, *prowdest;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 3;
-		lightrightstep = (r_lightptr[1] - lightright) >> 3;
+		lightleft = sb->lightptr[0];
+		lightright = sb->lightptr[1];
+		sb->lightptr += sb->lightwidth;
+		lightleftstep = (sb->lightptr[0] - lightleft) >> 3;
+		lightrightstep = (sb->lightptr[1] - lightright) >> 3;
 
 		for (i=0 ; i<8 ; i++)
 		{
@@ -465,14 +471,14 @@ void R_DrawSurfaceBlock8_mip1 (void)
 				light += lightstep;
 			}
 	
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowpixels;
+			prowdest += sb->surfrowpixels;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -482,23 +488,23 @@ void R_DrawSurfaceBlock8_mip1 (void)
 R_DrawSurfaceBlock8_mip2
 ================
 */
-void R_DrawSurfaceBlock8_mip2 (void)
+void R_DrawSurfaceBlock8_mip2 (surfblock_t *sb)
 {
 	int				v, i, b, lightstep, lighttemp, light, light_add;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
 	unsigned char	pix, *psource, *prowdest;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 2;
-		lightrightstep = (r_lightptr[1] - lightright) >> 2;
+		lightleft = sb->lightptr[0];
+		lightright = sb->lightptr[1];
+		sb->lightptr += sb->lightwidth;
+		lightleftstep = (sb->lightptr[0] - lightleft) >> 2;
+		lightrightstep = (sb->lightptr[1] - lightright) >> 2;
 
 		for (i=0 ; i<4 ; i++)
 		{
@@ -517,14 +523,14 @@ void R_DrawSurfaceBlock8_mip2 (void)
 				light += lightstep;
 			}
 	
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowpixels;
+			prowdest += sb->surfrowpixels;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -534,23 +540,23 @@ void R_DrawSurfaceBlock8_mip2 (void)
 R_DrawSurfaceBlock8_mip3
 ================
 */
-void R_DrawSurfaceBlock8_mip3 (void)
+void R_DrawSurfaceBlock8_mip3 (surfblock_t *sb)
 {
 	int				v, i, b, lightstep, lighttemp, light, light_add;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
 	unsigned char	pix, *psource, *prowdest;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 1;
-		lightrightstep = (r_lightptr[1] - lightright) >> 1;
+		lightleft = sb->lightptr[0];
+		lightright = sb->lightptr[1];
+		sb->lightptr += sb->lightwidth;
+		lightleftstep = (sb->lightptr[0] - lightleft) >> 1;
+		lightrightstep = (sb->lightptr[1] - lightright) >> 1;
 
 		for (i=0 ; i<2 ; i++)
 		{
@@ -570,35 +576,36 @@ void R_DrawSurfaceBlock8_mip3 (void)
 				light += lightstep;
 			}
 	
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowpixels;
+			prowdest += sb->surfrowpixels;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
 
 #define DEFINE_DRAW_SURF_FUNC(name, mip_level) \
-void name(void)\
+void name(surfblock_t *sb)\
 {\
 	int				v, i, b, lightstep, light;\
+	int				lightleft, lightright, lightleftstep, lightrightstep;\
 	unsigned char	*psource;\
 	unsigned int	*prowdest, color, ulight, comp[4];\
 \
-	psource = pbasesource;\
-	prowdest = prowdestbase;\
+	psource = sb->pbasesource;\
+	prowdest = sb->prowdestbase;\
 \
-	for (v=0 ; v<r_numvblocks ; v++)\
+	for (v=0 ; v<sb->numvblocks ; v++)\
 	{\
-		lightleft  = (int)r_lightptr[0] << 4;\
-		lightright = (int)r_lightptr[1] << 4;\
-		r_lightptr += r_lightwidth;\
-		lightleftstep  = ((((int)r_lightptr[0])<<4) - lightleft ) >> (4-mip_level);\
-		lightrightstep = ((((int)r_lightptr[1])<<4) - lightright) >> (4-mip_level);\
+		lightleft  = (int)sb->lightptr[0] << 4;\
+		lightright = (int)sb->lightptr[1] << 4;\
+		sb->lightptr += sb->lightwidth;\
+		lightleftstep  = ((((int)sb->lightptr[0])<<4) - lightleft ) >> (4-mip_level);\
+		lightrightstep = ((((int)sb->lightptr[1])<<4) - lightright) >> (4-mip_level);\
 \
 		for (i=0 ; i<(1<<(4-mip_level)) ; i++)\
 		{\
@@ -627,14 +634,14 @@ void name(void)\
 				light += lightstep;\
 			}\
 \
-			psource += sourcetstep;\
+			psource += sb->sourcetstep;\
 			lightright += lightrightstep;\
 			lightleft  += lightleftstep ;\
-			prowdest += surfrowpixels;\
+			prowdest += sb->surfrowpixels;\
 		}\
 \
-		if (psource >= r_sourcemax)\
-			psource -= r_stepback;\
+		if (psource >= sb->sourcemax)\
+			psource -= sb->stepback;\
 	}\
 }
 
@@ -154,9 +154,15 @@ void R_PushDlights (void);
 extern	int		reinit_surfcache;	// if 1, surface cache is currently empty and
 extern qboolean	r_cache_thrash;	// set if thrashing the surface cache
 
+extern int		sc_hits, sc_misses, sc_evictions;	// counted per frame
+
 int	D_SurfaceCacheForRes (int width, int height);
 void D_FlushCaches (void);
 void D_DeleteSurfaceCache (void);
 void D_InitCaches (void *buffer, int size);
+void D_AllocCaches (int size);
+void D_FreeCaches (void);
+void D_CheckCacheSize (void);
+int	D_CacheSize (void);
 void R_SetVrect (vrect_t *pvrect, vrect_t *pvrectin, int lineadj);
 
@@ -29,6 +29,22 @@ typedef struct
 	qboolean	changelevel_issued;	// cleared when at SV_SpawnServer
 } server_static_t;
 
+// load statistics, printed by "serverstats"
+typedef struct
+{
+	double		starttime;
+	int			frames;
+	double		frametime;			// total time of all server frames
+	double		maxframetime;
+	double		progstime;			// spent running progs
+	int			premoves;			// moves traced on the job threads
+	int			premovesused;		// of them still good when the entity moved
+	int			premovesdiffered;	// from the serial trace, with sv_parallelphysics 2
+	int			bytessent;
+	int			overflows;			// clients dropped for an overflowed message
+	int			datagramsclipped;	// server datagram didn't fit into a client one
+} server_stats_t;
+
 //=============================================================================
 
 typedef enum {ss_loading, ss_active} server_state_t;
@@ -205,6 +221,7 @@ extern	cvar_t	timelimit;
 
 extern	server_static_t	svs;				// persistant server info
 extern	server_t		sv;					// local server
+extern	server_stats_t	sv_stats;
 
 extern	client_t	*host_client;
 
@@ -227,6 +244,9 @@ void SV_DropClient (qboolean crash);
 void SV_SendClientMessages (void);
 void SV_ClearDatagram (void);
 
+void SV_FrameStats (double frametime);
+void SV_PrintStats (qboolean reset);
+
 int SV_ModelIndex (char *name);
 
 void SV_SetIdealPitch (void);
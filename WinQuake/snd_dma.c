@@ -32,25 +32,83 @@ void S_SoundList(void);
 void S_StopAllSounds(qboolean clear);
 void S_StopAllSoundsC(void);
 
+/*
+The game never touches the channels. It puts commands into a ring, which the
+mixing thread takes at the start of every audio callback, so mixing never
+waits for a game frame and a slow frame can't starve the output. Each side
+only ever increases its own index of the ring, so it needs no lock.
+
+Samples of a sound stay loaded while sfx->playing is set. The game counts
+the sounds it sends up, the mixer gives the sfx of every channel that stops
+back through a second ring, and the game counts them down again.
+*/
+
+#define	MAX_SNDCMDS		1024	// power of two
+#define	MAX_SNDRELEASES	2048	// power of two, more than MAX_SNDCMDS + MAX_CHANNELS
+
+typedef enum
+{
+	SND_START,
+	SND_STATIC,
+	SND_STOP,
+	SND_STOPALL,
+	SND_UPDATE
+} sndcmdtype_t;
+
+typedef struct
+{
+	sndcmdtype_t	type;
+	sfx_t			*sfx;
+	sfxcache_t		*sc;
+	int				entnum;
+	int				entchannel;
+	vec3_t			origin;
+	int				vol;
+	vec_t			dist_mult;
+
+// SND_UPDATE
+	sndlistener_t	listener;
+	qboolean		ambientupdate;		// else leave the ambients as they are
+	sfx_t			*ambientsfx[NUM_AMBIENTS];
+	sfxcache_t		*ambientsc[NUM_AMBIENTS];
+	int				ambientvol[NUM_AMBIENTS];
+} sndcmd_t;
+
+static sndcmd_t	snd_cmds[MAX_SNDCMDS];
+static int		snd_cmdhead;		// written by the game
+static int		snd_cmdtail;		// written by the mixer
+static int		snd_cmddrops;
+
+static sfx_t	*snd_releases[MAX_SNDRELEASES];
+static int		snd_releasehead;	// written by the mixer
+static int		snd_releasetail;	// written by the game
+static int		snd_references;		// game side, sent up and not counted down yet
+
 // =======================================================================
 // Internal sound data & structures
 // =======================================================================
 
+// mixer side
 channel_t   channels[MAX_CHANNELS];
 int			total_channels;
+static sndlistener_t	snd_mixlistener;
+static unsigned	snd_mixseed;
+static int		snd_audible;		// channels painted, for snd_show
+
+// game side
+sndlistener_t	snd_listener;
+static int		snd_numstatics;
+static int		snd_ambientvol[NUM_AMBIENTS];
 
 int				snd_blocked = 0;
 static qboolean	snd_ambient = 1;
+static qboolean	snd_precaching;
 qboolean		snd_initialized = false;
 
 // pointer should go away
 volatile dma_t  *shm = 0;
 volatile dma_t sn;
 
-vec3_t		listener_origin;
-vec3_t		listener_forward;
-vec3_t		listener_right;
-vec3_t		listener_up;
 vec_t		sound_nominal_clip_dist=1000.0;
 
 //int			soundtime;		// sample PAIRS
@@ -74,7 +132,6 @@ cvar_t loadas8bit = {"loadas8bit", "0"};
 cvar_t bgmbuffer = {"bgmbuffer", "4096"};
 cvar_t ambient_level = {"ambient_level", "0.3"};
 cvar_t ambient_fade = {"ambient_fade", "100"};
-cvar_t snd_noextraupdate = {"snd_noextraupdate", "0"};
 cvar_t snd_show = {"snd_show", "0"};
 cvar_t _snd_mixahead = {"_snd_mixahead", "0.1", true};
 
@@ -107,7 +164,8 @@ void S_SoundInfo_f(void)
     Con_Printf("%5d submission_chunk\n", shm->submission_chunk);
     Con_Printf("%5d speed\n", shm->speed);
     Con_Printf("0x%x dma buffer\n", shm->buffer);
-	Con_Printf("%5d total_channels\n", total_channels);
+	Con_Printf("%5d static channels\n", snd_numstatics);
+	Con_Printf("%5d dropped commands\n", snd_cmddrops);
 }
 
 
@@ -162,7 +220,6 @@ void S_Init (void)
 	Cvar_RegisterVariable(&bgmbuffer);
 	Cvar_RegisterVariable(&ambient_level);
 	Cvar_RegisterVariable(&ambient_fade);
-	Cvar_RegisterVariable(&snd_noextraupdate);
 	Cvar_RegisterVariable(&snd_show);
 	Cvar_RegisterVariable(&_snd_mixahead);
 
@@ -180,6 +237,8 @@ void S_Init (void)
 
 	SND_InitScaletable ();
 
+	S_InitLoader ();
+
 	known_sfx = Hunk_AllocName (MAX_SFX*sizeof(sfx_t), "sfx_t");
 	num_sfx = 0;
 
@@ -207,6 +266,8 @@ void S_Shutdown(void)
 	if (!sound_started)
 		return;
 
+	S_ShutdownLoader ();
+
 	if (shm)
 		shm->gamealive = 0;
 
@@ -281,15 +342,15 @@ sfx_t *S_PrecacheSound (char *name)
 	if (!sound_started || nosound.value)
 		return NULL;
 
-	SNDDMA_LockSoundData();
+	S_LockSamples ();
 
 	sfx = S_FindName (name);
 	
-// cache it in
+// cache it in, in the background if it's a level precache
 	if (precache.value)
-		S_LoadSound (sfx);
+		S_CacheSound (sfx, snd_precaching);
 	
-	SNDDMA_UnlockSoundData();
+	S_UnlockSamples ();
 
 	return sfx;
 }
@@ -297,6 +358,123 @@ sfx_t *S_PrecacheSound (char *name)
 
 //=============================================================================
 
+/*
+=================
+S_GetCommand
+
+Returns the next free command of the ring, or NULL if the mixer is too far
+behind to take more. The command is sent up by S_PostCommand.
+=================
+*/
+static sndcmd_t *S_GetCommand (sndcmdtype_t type)
+{
+	sndcmd_t	*cmd;
+
+	if ((unsigned)(snd_cmdhead - Jobs_AtomicGet (&snd_cmdtail)) >= MAX_SNDCMDS)
+	{
+		snd_cmddrops++;
+		Con_DPrintf ("S_GetCommand: queue full\n");
+		return NULL;
+	}
+
+	cmd = &snd_cmds[snd_cmdhead & (MAX_SNDCMDS-1)];
+	memset (cmd, 0, sizeof(*cmd));
+	cmd->type = type;
+	return cmd;
+}
+
+static void S_PostCommand (void)
+{
+	Jobs_AtomicSet (&snd_cmdhead, snd_cmdhead + 1);
+}
+
+/*
+=================
+S_CountReleases
+
+Counts down the sfx of the channels the mixer has stopped, called with the
+samples locked
+=================
+*/
+static void S_CountReleases (void)
+{
+	int		head;
+
+	head = Jobs_AtomicGet (&snd_releasehead);
+	while (snd_releasetail != head)
+	{
+		snd_releases[snd_releasetail & (MAX_SNDRELEASES-1)]->playing--;
+		snd_releasetail++;
+		snd_references--;
+	}
+}
+
+static void S_DrainReleases (void)
+{
+	if (Jobs_AtomicGet (&snd_releasehead) == snd_releasetail)
+		return;
+
+	S_LockSamples ();
+	S_CountReleases ();
+	S_UnlockSamples ();
+}
+
+/*
+=================
+S_HoldSfx
+
+Counts the reference to sfx a command sends up, called with the samples
+locked. Every reference out can come back through the release ring before
+the game drains it, so no more are given out than the ring holds.
+=================
+*/
+static qboolean S_HoldSfx (sfx_t *sfx)
+{
+	S_CountReleases ();
+	if (snd_references == MAX_SNDRELEASES)
+	{	// the mixer holds all of them
+		snd_cmddrops++;
+		Con_DPrintf ("S_HoldSfx: too many references\n");
+		return false;
+	}
+	snd_references++;
+	sfx->playing++;
+	return true;
+}
+
+// =======================================================================
+// Mixer side, everything down to S_UpdateMixer runs in the mixing thread
+// =======================================================================
+
+// S_HoldSfx never lets out more references than the ring holds, so it
+// can't overflow
+static void S_ReleaseSfx (sfx_t *sfx)
+{
+	snd_releases[snd_releasehead & (MAX_SNDRELEASES-1)] = sfx;
+	Jobs_AtomicSet (&snd_releasehead, snd_releasehead + 1);
+}
+
+/*
+=================
+S_ReleaseChannel
+=================
+*/
+void S_ReleaseChannel (channel_t *ch)
+{
+	// ambient sounds are never freed, so they aren't counted
+	if (ch->sfx && ch >= channels + NUM_AMBIENTS)
+		S_ReleaseSfx (ch->sfx);
+	ch->sfx = NULL;
+	ch->cache = NULL;
+}
+
+// rand () is for the game
+static int S_MixRandom (void)
+{
+	snd_mixseed = snd_mixseed * 1103515245 + 12345;
+	return (snd_mixseed >> 16) & 0x7fff;
+}
+
 /*
 =================
 SND_PickChannel
@@ -322,7 +500,7 @@ channel_t *SND_PickChannel(int entnum, int entchannel)
 		}
 
 		// don't let monster sounds override player sounds
-		if (channels[ch_idx].entnum == cl.viewentity && entnum != cl.viewentity && channels[ch_idx].sfx)
+		if (channels[ch_idx].entnum == snd_mixlistener.viewentity && entnum != snd_mixlistener.viewentity && channels[ch_idx].sfx)
 			continue;
 
 		if (channels[ch_idx].end - paintedtime < life_left)
@@ -335,8 +513,7 @@ channel_t *SND_PickChannel(int entnum, int entchannel)
 	if (first_to_die == -1)
 		return NULL;
 
-	if (channels[first_to_die].sfx)
-		channels[first_to_die].sfx = NULL;
+	S_ReleaseChannel (&channels[first_to_die]);
 
     return &channels[first_to_die];    
 }       
@@ -344,18 +521,19 @@ channel_t *SND_PickChannel(int entnum, int entchannel)
 /*
 =================
 SND_Spatialize
+
+Also used by the game to skip sounds that can't be heard
 =================
 */
-void SND_Spatialize(channel_t *ch)
+void SND_Spatialize(channel_t *ch, sndlistener_t *listener)
 {
     vec_t dot;
     vec_t ldist, rdist, dist;
     vec_t lscale, rscale, scale;
     vec3_t source_vec;
-	sfx_t *snd;
 
 // anything coming from the view entity will allways be full volume
-	if (ch->entnum == cl.viewentity)
+	if (ch->entnum == listener->viewentity)
 	{
 		ch->leftvol = ch->master_vol;
 		ch->rightvol = ch->master_vol;
@@ -364,12 +542,11 @@ void SND_Spatialize(channel_t *ch)
 
 // calculate stereo seperation and distance attenuation
 
-	snd = ch->sfx;
-	VectorSubtract(ch->origin, listener_origin, source_vec);
+	VectorSubtract(ch->origin, listener->origin, source_vec);
 	
 	dist = VectorNormalize(source_vec) * ch->dist_mult;
 	
-	dot = DotProduct(listener_right, source_vec);
+	dot = DotProduct(listener->right, source_vec);
 
 	if (shm->channels == 1)
 	{
@@ -394,59 +571,40 @@ void SND_Spatialize(channel_t *ch)
 		ch->leftvol = 0;
 }           
 
-
-// =======================================================================
-// Start a sound effect
-// =======================================================================
-void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
+static void S_MixStart (sndcmd_t *cmd)
 {
 	channel_t *target_chan, *check;
-	sfxcache_t	*sc;
-	int		vol;
 	int		ch_idx;
 	int		skip;
 
-	if (!sound_started)
-		return;
-
-	if (!sfx)
-		return;
-
-	if (nosound.value)
-		return;
-
-	vol = fvol*255;
-
-	SNDDMA_LockSoundData();
-
 // pick a channel to play on
-	target_chan = SND_PickChannel(entnum, entchannel);
+	target_chan = SND_PickChannel(cmd->entnum, cmd->entchannel);
 	if (!target_chan)
-		goto return_;
+	{
+		S_ReleaseSfx (cmd->sfx);
+		return;
+	}
 		
 // spatialize
 	memset (target_chan, 0, sizeof(*target_chan));
-	VectorCopy(origin, target_chan->origin);
-	target_chan->dist_mult = attenuation / sound_nominal_clip_dist;
-	target_chan->master_vol = vol;
-	target_chan->entnum = entnum;
-	target_chan->entchannel = entchannel;
-	SND_Spatialize(target_chan);
+	VectorCopy(cmd->origin, target_chan->origin);
+	target_chan->dist_mult = cmd->dist_mult;
+	target_chan->master_vol = cmd->vol;
+	target_chan->entnum = cmd->entnum;
+	target_chan->entchannel = cmd->entchannel;
+	SND_Spatialize(target_chan, &snd_mixlistener);
 
 	if (!target_chan->leftvol && !target_chan->rightvol)
-		goto return_;		// not audible at all
-
-// new channel
-	sc = S_LoadSound (sfx);
-	if (!sc)
 	{
-		target_chan->sfx = NULL;
-		goto return_;		// couldn't load the sound's data
+		S_ReleaseSfx (cmd->sfx);
+		return;		// not audible at all
 	}
 
-	target_chan->sfx = sfx;
+// new channel
+	target_chan->sfx = cmd->sfx;
+	target_chan->cache = cmd->sc;
 	target_chan->pos = 0.0;
-    target_chan->end = paintedtime + sc->length;	
+    target_chan->end = paintedtime + cmd->sc->length;	
 
 // if an identical sound has also been started this frame, offset the pos
 // a bit to keep it from just making the first one louder
@@ -455,9 +613,9 @@ void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float f
     {
 		if (check == target_chan)
 			continue;
-		if (check->sfx == sfx && !check->pos)
+		if (check->sfx == cmd->sfx && !check->pos)
 		{
-			skip = rand () % (int)(0.1*shm->speed);
+			skip = S_MixRandom () % (int)(0.1*shm->speed);
 			if (skip >= target_chan->end)
 				skip = target_chan->end - 1;
 			target_chan->pos += skip;
@@ -466,50 +624,260 @@ void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float f
 		}
 		
 	}
+}
 
-return_:
-	SNDDMA_UnlockSoundData();
+static void S_MixStatic (sndcmd_t *cmd)
+{
+	channel_t	*ss;
+
+	if (total_channels == MAX_CHANNELS)
+	{
+		S_ReleaseSfx (cmd->sfx);
+		return;
+	}
+
+	ss = &channels[total_channels];
+	total_channels++;
+
+	ss->sfx = cmd->sfx;
+	ss->cache = cmd->sc;
+	VectorCopy (cmd->origin, ss->origin);
+	ss->master_vol = cmd->vol;
+	ss->dist_mult = cmd->dist_mult;
+    ss->end = paintedtime + cmd->sc->length;	
+	
+	SND_Spatialize (ss, &snd_mixlistener);
 }
 
-void S_StopSound(int entnum, int entchannel)
+static void S_MixStop (sndcmd_t *cmd)
 {
 	int i;
 
-	SNDDMA_LockSoundData();
-
 	for (i=0 ; i<MAX_DYNAMIC_CHANNELS ; i++)
 	{
-		if (channels[i].entnum == entnum
-			&& channels[i].entchannel == entchannel)
+		if (channels[i].entnum == cmd->entnum
+			&& channels[i].entchannel == cmd->entchannel)
 		{
 			channels[i].end = 0;
-			channels[i].sfx = NULL;
-			goto return_;
+			S_ReleaseChannel (&channels[i]);
+			return;
 		}
 	}
+}
+
+static void S_MixStopAll (void)
+{
+	int		i;
+
+	total_channels = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;	// no statics
+
+	for (i=0 ; i<MAX_CHANNELS ; i++)
+		S_ReleaseChannel (&channels[i]);
+
+	Q_memset(channels, 0, MAX_CHANNELS * sizeof(channel_t));
+}
+
+static void S_MixUpdate (sndcmd_t *cmd)
+{
+	int			i;
+	channel_t	*chan;
+
+	snd_mixlistener = cmd->listener;
+
+	if (!cmd->ambientupdate)
+		return;
+
+	for (i=0, chan=channels ; i<NUM_AMBIENTS ; i++, chan++)
+	{
+		chan->sfx = cmd->ambientsfx[i];
+		chan->cache = cmd->ambientsc[i];
+		chan->master_vol = cmd->ambientvol[i];
+		chan->leftvol = chan->rightvol = chan->master_vol;
+	}
+}
+
+/*
+============
+S_UpdateMixer
+
+Runs the commands the game has sent since the last call and spatializes
+the channels for the newest listener
+============
+*/
+void S_UpdateMixer (void)
+{
+	int			i, j;
+	int			head, total;
+	sndcmd_t	*cmd;
+	channel_t	*ch;
+	channel_t	*combine;
+
+	head = Jobs_AtomicGet (&snd_cmdhead);
+	while (snd_cmdtail != head)
+	{
+		cmd = &snd_cmds[snd_cmdtail & (MAX_SNDCMDS-1)];
+		switch (cmd->type)
+		{
+		case SND_START:
+			S_MixStart (cmd);
+			break;
+		case SND_STATIC:
+			S_MixStatic (cmd);
+			break;
+		case SND_STOP:
+			S_MixStop (cmd);
+			break;
+		case SND_STOPALL:
+			S_MixStopAll ();
+			break;
+		case SND_UPDATE:
+			S_MixUpdate (cmd);
+			break;
+		}
+		Jobs_AtomicSet (&snd_cmdtail, snd_cmdtail + 1);
+	}
+
+	combine = NULL;
+
+// update spatialization for static and dynamic sounds	
+	ch = channels+NUM_AMBIENTS;
+	for (i=NUM_AMBIENTS ; i<total_channels; i++, ch++)
+	{
+		if (!ch->sfx)
+			continue;
+		SND_Spatialize(ch, &snd_mixlistener);         // respatialize channel
+		if (!ch->leftvol && !ch->rightvol)
+			continue;
+
+	// try to combine static sounds with a previous channel of the same
+	// sound effect so we don't mix five torches every frame
+	
+		if (i >= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS)
+		{
+		// see if it can just use the last one
+			if (combine && combine->sfx == ch->sfx)
+			{
+				combine->leftvol += ch->leftvol;
+				combine->rightvol += ch->rightvol;
+				ch->leftvol = ch->rightvol = 0;
+				continue;
+			}
+		// search for one
+			combine = channels+MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;
+			for (j=MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS ; j<i; j++, combine++)
+				if (combine->sfx == ch->sfx)
+					break;
+					
+			if (j == total_channels)
+			{
+				combine = NULL;
+			}
+			else
+			{
+				if (combine != ch)
+				{
+					combine->leftvol += ch->leftvol;
+					combine->rightvol += ch->rightvol;
+					ch->leftvol = ch->rightvol = 0;
+				}
+				continue;
+			}
+		}
+	}
+
+// for snd_show
+	total = 0;
+	ch = channels;
+	for (i=0 ; i<total_channels; i++, ch++)
+		if (ch->sfx && (ch->leftvol || ch->rightvol) )
+			total++;
+	Jobs_AtomicSet (&snd_audible, total);
+}
+
+
+// =======================================================================
+// Start a sound effect
+// =======================================================================
+void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
+{
+	channel_t	check;
+	sfxcache_t	*sc;
+	sndcmd_t	*cmd;
+	int		vol;
+
+	if (!sound_started)
+		return;
+
+	if (!sfx)
+		return;
+
+	if (nosound.value)
+		return;
+
+	vol = fvol*255;
+
+// don't load what can't be heard, the mixer checks again for its listener
+	memset (&check, 0, sizeof(check));
+	VectorCopy(origin, check.origin);
+	check.dist_mult = attenuation / sound_nominal_clip_dist;
+	check.master_vol = vol;
+	check.entnum = entnum;
+	SND_Spatialize(&check, &snd_listener);
+
+	if (!check.leftvol && !check.rightvol)
+		return;		// not audible at all
+
+	S_LockSamples ();
+
+	sc = S_LoadSound (sfx);
+	if (!sc)
+		goto return_;		// couldn't load the sound's data
+
+	cmd = S_GetCommand (SND_START);
+	if (!cmd)
+		goto return_;
+
+	cmd->sfx = sfx;
+	cmd->sc = sc;
+	cmd->entnum = entnum;
+	cmd->entchannel = entchannel;
+	VectorCopy(origin, cmd->origin);
+	cmd->vol = vol;
+	cmd->dist_mult = check.dist_mult;
+	if (!S_HoldSfx (sfx))
+		goto return_;
+	S_PostCommand ();
 
 return_:
-	SNDDMA_UnlockSoundData();
+	S_UnlockSamples ();
 }
 
-void S_StopAllSounds(qboolean clear)
+void S_StopSound(int entnum, int entchannel)
 {
-	int		i;
+	sndcmd_t	*cmd;
 
 	if (!sound_started)
 		return;
 
-	total_channels = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;	// no statics
+	cmd = S_GetCommand (SND_STOP);
+	if (!cmd)
+		return;
 
-	SNDDMA_LockSoundData();
+	cmd->entnum = entnum;
+	cmd->entchannel = entchannel;
+	S_PostCommand ();
+}
 
-	for (i=0 ; i<MAX_CHANNELS ; i++)
-		if (channels[i].sfx)
-			channels[i].sfx = NULL;
+void S_StopAllSounds(qboolean clear)
+{
+	if (!sound_started)
+		return;
 
-	Q_memset(channels, 0, MAX_CHANNELS * sizeof(channel_t));
+	snd_numstatics = 0;
+	Q_memset(snd_ambientvol, 0, sizeof(snd_ambientvol));
 
-	SNDDMA_UnlockSoundData();
+	if (S_GetCommand (SND_STOPALL))
+		S_PostCommand ();
 }
 
 void S_StopAllSoundsC (void)
@@ -529,22 +897,19 @@ S_StaticSound
 */
 void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 {
-	channel_t	*ss;
-	sfxcache_t		*sc;
+	sfxcache_t	*sc;
+	sndcmd_t	*cmd;
 
 	if (!sfx)
 		return;
 
-	SNDDMA_LockSoundData();
-
-	if (total_channels == MAX_CHANNELS)
+	if (snd_numstatics == MAX_CHANNELS - MAX_DYNAMIC_CHANNELS - NUM_AMBIENTS)
 	{
 		Con_Printf ("total_channels == MAX_CHANNELS\n");
-		goto return_;
+		return;
 	}
 
-	ss = &channels[total_channels];
-	total_channels++;
+	S_LockSamples ();
 
 	sc = S_LoadSound (sfx);
 	if (!sc)
@@ -555,17 +920,23 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 		Con_Printf ("Sound %s not looped\n", sfx->name);
 		goto return_;
 	}
-	
-	ss->sfx = sfx;
-	VectorCopy (origin, ss->origin);
-	ss->master_vol = vol;
-	ss->dist_mult = (attenuation/64) / sound_nominal_clip_dist;
-    ss->end = paintedtime + sc->length;	
-	
-	SND_Spatialize (ss);
+
+	cmd = S_GetCommand (SND_STATIC);
+	if (!cmd)
+		goto return_;
+
+	cmd->sfx = sfx;
+	cmd->sc = sc;
+	VectorCopy (origin, cmd->origin);
+	cmd->vol = vol;
+	cmd->dist_mult = (attenuation/64) / sound_nominal_clip_dist;
+	if (!S_HoldSfx (sfx))
+		goto return_;
+	S_PostCommand ();
+	snd_numstatics++;
 
 return_:
-	SNDDMA_UnlockSoundData();
+	S_UnlockSamples ();
 }
 
 
@@ -574,14 +945,16 @@ return_:
 /*
 ===================
 S_UpdateAmbientSounds
+
+Fills in the ambient levels of an update command
 ===================
 */
-void S_UpdateAmbientSounds (void)
+static void S_UpdateAmbientSounds (sndcmd_t *cmd)
 {
 	mleaf_t		*l;
 	float		vol;
 	int			ambient_channel;
-	channel_t	*chan;
+	sfx_t		*sfx;
 
 	if (!snd_ambient)
 		return;
@@ -590,44 +963,42 @@ void S_UpdateAmbientSounds (void)
 	if (!cl.worldmodel)
 		return;
 
-	SNDDMA_LockSoundData();
+	cmd->ambientupdate = true;
 
-	l = Mod_PointInLeaf (listener_origin, cl.worldmodel);
+	l = Mod_PointInLeaf (snd_listener.origin, cl.worldmodel);
 	if (!l || !ambient_level.value)
 	{
 		for (ambient_channel = 0 ; ambient_channel< NUM_AMBIENTS ; ambient_channel++)
-			channels[ambient_channel].sfx = NULL;
-		goto return_;
+			cmd->ambientvol[ambient_channel] = snd_ambientvol[ambient_channel];
+		return;
 	}
 
 	for (ambient_channel = 0 ; ambient_channel< NUM_AMBIENTS ; ambient_channel++)
 	{
-		chan = &channels[ambient_channel];	
-		chan->sfx = ambient_sfx[ambient_channel];
-	
 		vol = ambient_level.value * l->ambient_sound_level[ambient_channel];
 		if (vol < 8)
 			vol = 0;
 
 	// don't adjust volume too fast
-		if (chan->master_vol < vol)
+		if (snd_ambientvol[ambient_channel] < vol)
 		{
-			chan->master_vol += host_frametime * ambient_fade.value;
-			if (chan->master_vol > vol)
-				chan->master_vol = vol;
+			snd_ambientvol[ambient_channel] += host_frametime * ambient_fade.value;
+			if (snd_ambientvol[ambient_channel] > vol)
+				snd_ambientvol[ambient_channel] = vol;
 		}
-		else if (chan->master_vol > vol)
+		else if (snd_ambientvol[ambient_channel] > vol)
 		{
-			chan->master_vol -= host_frametime * ambient_fade.value;
-			if (chan->master_vol < vol)
-				chan->master_vol = vol;
+			snd_ambientvol[ambient_channel] -= host_frametime * ambient_fade.value;
+			if (snd_ambientvol[ambient_channel] < vol)
+				snd_ambientvol[ambient_channel] = vol;
 		}
-		
-		chan->leftvol = chan->rightvol = chan->master_vol;
-	}
 
-return_:
-	SNDDMA_UnlockSoundData();
+	// ambient samples are loaded by S_Init and never freed
+		sfx = ambient_sfx[ambient_channel];
+		cmd->ambientsfx[ambient_channel] = sfx;
+		cmd->ambientsc[ambient_channel] = sfx ? sfx->cache.data : NULL;
+		cmd->ambientvol[ambient_channel] = snd_ambientvol[ambient_channel];
+	}
 }
 
 
@@ -635,100 +1006,39 @@ return_:
 ============
 S_Update
 
-Called once each time through the main loop
+Called once each time through the main loop, only sends the listener to
+the mixer, which mixes on its own
 ============
 */
 void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 {
-	int			i, j;
-	int			total;
-	channel_t	*ch;
-	channel_t	*combine;
+	sndcmd_t	*cmd;
 
 	if (!sound_started || (snd_blocked > 0))
 		return;
 
-	SNDDMA_LockSoundData();
+	S_DrainReleases ();
 
-	VectorCopy(origin, listener_origin);
-	VectorCopy(forward, listener_forward);
-	VectorCopy(right, listener_right);
-	VectorCopy(up, listener_up);
-	
-// update general area ambient sound sources
-	S_UpdateAmbientSounds ();
-
-	combine = NULL;
+	VectorCopy(origin, snd_listener.origin);
+	VectorCopy(forward, snd_listener.forward);
+	VectorCopy(right, snd_listener.right);
+	VectorCopy(up, snd_listener.up);
+	snd_listener.viewentity = cl.viewentity;
 
-// update spatialization for static and dynamic sounds	
-	ch = channels+NUM_AMBIENTS;
-	for (i=NUM_AMBIENTS ; i<total_channels; i++, ch++)
+	cmd = S_GetCommand (SND_UPDATE);
+	if (cmd)
 	{
-		if (!ch->sfx)
-			continue;
-		SND_Spatialize(ch);         // respatialize channel
-		if (!ch->leftvol && !ch->rightvol)
-			continue;
-
-	// try to combine static sounds with a previous channel of the same
-	// sound effect so we don't mix five torches every frame
-	
-		if (i >= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS)
-		{
-		// see if it can just use the last one
-			if (combine && combine->sfx == ch->sfx)
-			{
-				combine->leftvol += ch->leftvol;
-				combine->rightvol += ch->rightvol;
-				ch->leftvol = ch->rightvol = 0;
-				continue;
-			}
-		// search for one
-			combine = channels+MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;
-			for (j=MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS ; j<i; j++, combine++)
-				if (combine->sfx == ch->sfx)
-					break;
-					
-			if (j == total_channels)
-			{
-				combine = NULL;
-			}
-			else
-			{
-				if (combine != ch)
-				{
-					combine->leftvol += ch->leftvol;
-					combine->rightvol += ch->rightvol;
-					ch->leftvol = ch->rightvol = 0;
-				}
-				continue;
-			}
-		}
+		cmd->listener = snd_listener;
+	// update general area ambient sound sources
+		S_UpdateAmbientSounds (cmd);
+		S_PostCommand ();
 	}
 
 //
 // debugging output
 //
 	if (snd_show.value)
-	{
-		total = 0;
-		ch = channels;
-		for (i=0 ; i<total_channels; i++, ch++)
-			if (ch->sfx && (ch->leftvol || ch->rightvol) )
-			{
-				//Con_Printf ("%3i %3i %s\n", ch->leftvol, ch->rightvol, ch->sfx->name);
-				total++;
-			}
-		
-		Con_Printf ("----(%i)----\n", total);
-	}
-
-	SNDDMA_UnlockSoundData();
-}
-
-
-void S_ExtraUpdate (void)
-{
+		Con_Printf ("----(%i)----\n", Jobs_AtomicGet (&snd_audible));
 }
 
 /*
@@ -757,7 +1067,7 @@ void S_Play(void)
 		else
 			Q_strcpy(name, Cmd_Argv(i));
 		sfx = S_PrecacheSound(name);
-		S_StartSound(hash++, 0, sfx, listener_origin, 1.0, 1.0);
+		S_StartSound(hash++, 0, sfx, snd_listener.origin, 1.0, 1.0);
 		i++;
 	}
 }
@@ -782,7 +1092,7 @@ void S_PlayVol(void)
 			Q_strcpy(name, Cmd_Argv(i));
 		sfx = S_PrecacheSound(name);
 		vol = Q_atof(Cmd_Argv(i+1));
-		S_StartSound(hash++, 0, sfx, listener_origin, vol, 1.0);
+		S_StartSound(hash++, 0, sfx, snd_listener.origin, vol, 1.0);
 		i+=2;
 	}
 }
@@ -794,7 +1104,7 @@ void S_SoundList(void)
 	sfxcache_t	*sc;
 	int		size, total;
 
-	SNDDMA_LockSoundData();
+	S_LockSamples ();
 
 	total = 0;
 	for (sfx=known_sfx, i=0 ; i<num_sfx ; i++, sfx++)
@@ -812,7 +1122,7 @@ void S_SoundList(void)
 	}
 	Con_Printf ("Total resident: %i\n", total);
 
-	SNDDMA_UnlockSoundData();
+	S_UnlockSamples ();
 }
 
 
@@ -842,10 +1152,16 @@ void S_ClearPrecache (void)
 
 void S_BeginPrecaching (void)
 {
+	snd_precaching = true;
 }
 
 
 void S_EndPrecaching (void)
 {
+	snd_precaching = false;
+
+	S_LockSamples ();
+	S_StartLoading ();
+	S_UnlockSamples ();
 }
 
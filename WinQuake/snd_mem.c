@@ -22,28 +22,55 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
-int			cache_full_cycle;
+/*
+Samples are malloced, and freed again by the least recently used first, when
+snd_cachesize kilobytes are not enough for all of them. Samples of sounds
+the mixer is playing are never freed.
+
+Sounds precached for a level are loaded by a thread of their own after
+S_EndPrecaching, so the level starts without waiting for them. A sound,
+that is played before it is loaded, is loaded right away (a late load).
+
+All the sample data is guarded by S_LockSamples. The mixer doesn't take the
+lock, it only reads samples the game has counted in sfx->playing.
+*/
+
+#define	MAX_LOADQUEUE	1024
+
+cvar_t	snd_cachesize = {"snd_cachesize", "32768"};	// kilobytes, 0 - no limit
+
+int		snd_cachebytes;			// resident sample bytes
+
+static int		snd_cacheclock;		// increased by every use of a sample
+static int		snd_hits, snd_lateloads, snd_backgroundloads, snd_evictions;
 
-byte *S_Alloc (int size);
+static sfx_t	*snd_loadqueue[MAX_LOADQUEUE];
+static int		snd_loadqueuehead, snd_loadqueuetail;
+static void		*snd_loaderthread;
+static void		*snd_loadersem;
+static qboolean	snd_loaderquit;
+static void		*snd_samplesmutex;
+
+extern int		sound_started;
+extern sfx_t	*known_sfx;
+extern int		num_sfx;
+extern sfx_t	*ambient_sfx[NUM_AMBIENTS];
+
+static wavinfo_t S_ParseWavinfo (char *name, byte *wav, int wavlength, qboolean quiet);
 
 /*
 ================
 ResampleSfx
 ================
 */
-void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfx (sfxcache_t *sc, int inrate, int inwidth, byte *data)
 {
 	int		outcount;
 	int		srcsample;
 	float	stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
-	sfxcache_t	*sc;
 	
-	sc = sfx->cache.data;
-	if (!sc)
-		return;
-
 	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
 
 	outcount = sc->length / stepscale;
@@ -88,27 +115,138 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	}
 }
 
+/*
+==============
+S_DecodeSound
+
+Converts a wav file into a malloced sample. Quiet is for the loader thread,
+which can't print.
+==============
+*/
+static sfxcache_t *S_DecodeSound (char *name, byte *data, int size, qboolean quiet)
+{
+	wavinfo_t	info;
+	int		len;
+	float	stepscale;
+	sfxcache_t	*sc;
+
+	info = S_ParseWavinfo (name, data, size, quiet);
+	if (info.channels != 1)
+	{
+		if (!quiet)
+			Con_Printf ("%s is a stereo sample\n",name);
+		return NULL;
+	}
+
+	stepscale = (float)info.rate / shm->speed;	
+	len = info.samples / stepscale;
+
+	len = len * info.width * info.channels;
+
+	sc = malloc( len + sizeof(sfxcache_t) );
+	if (!sc)
+		return NULL;
+	
+	sc->length = info.samples;
+	sc->loopstart = info.loopstart;
+	sc->speed = info.rate;
+	sc->width = info.width;
+	sc->stereo = info.channels;
+
+	ResampleSfx (sc, sc->speed, sc->width, data + info.dataofs);
+
+	return sc;
+}
+
+static int S_SampleBytes (sfxcache_t *sc)
+{
+	return sc->length * sc->width + sizeof(sfxcache_t);
+}
+
+/*
+==============
+S_FreeSamples
+
+Frees the least recently used samples until size more bytes fit into
+snd_cachesize, or nothing more can be freed
+==============
+*/
+static void S_FreeSamples (int size)
+{
+	int			i, j;
+	sfx_t		*sfx, *oldest;
+	int			budget;
+
+	budget = (int)snd_cachesize.value * 1024;
+	if (budget <= 0)
+		return;
+
+	while (snd_cachebytes + size > budget)
+	{
+		oldest = NULL;
+		for (i=0, sfx=known_sfx ; i<num_sfx ; i++, sfx++)
+		{
+			if (!sfx->cache.data)
+				continue;
+			if (oldest && sfx->lastused - oldest->lastused >= 0)
+				continue;
+
+			for (j=0 ; j<NUM_AMBIENTS ; j++)
+				if (sfx == ambient_sfx[j])
+					break;
+			if (j < NUM_AMBIENTS)
+				continue;
+
+			if (sfx->playing)
+				continue;
+
+			oldest = sfx;
+		}
+		if (!oldest)
+			return;
+
+		snd_cachebytes -= S_SampleBytes (oldest->cache.data);
+		free (oldest->cache.data);
+		oldest->cache.data = NULL;
+		snd_evictions++;
+	}
+}
+
+static void S_StoreSamples (sfx_t *s, sfxcache_t *sc)
+{
+	S_FreeSamples (S_SampleBytes (sc));
+
+	s->cache.data = sc;
+	s->lastused = ++snd_cacheclock;
+	snd_cachebytes += S_SampleBytes (sc);
+}
+
+void S_LockSamples (void)
+{
+	if (snd_samplesmutex)
+		Jobs_LockMutex (snd_samplesmutex);
+}
+
+void S_UnlockSamples (void)
+{
+	if (snd_samplesmutex)
+		Jobs_UnlockMutex (snd_samplesmutex);
+}
+
 //=============================================================================
 
 /*
 ==============
-S_LoadSound
+S_LoadSoundNow
 ==============
 */
-sfxcache_t *S_LoadSound (sfx_t *s)
+static sfxcache_t *S_LoadSoundNow (sfx_t *s)
 {
     char	namebuffer[256];
 	byte	*data;
-	wavinfo_t	info;
-	int		len;
-	float	stepscale;
 	sfxcache_t	*sc;
 	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
 
-	sc = s->cache.data;
-	if (sc)
-		return sc;
-
 //Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
 // load it in
     Q_strcpy(namebuffer, "sound/");
@@ -124,36 +262,240 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		return NULL;
 	}
 
-	info = GetWavinfo (s->name, data, com_filesize);
-	if (info.channels != 1)
-	{
-		Con_Printf ("%s is a stereo sample\n",s->name);
+	sc = S_DecodeSound (s->name, data, com_filesize, false);
+	if (!sc)
 		return NULL;
+
+	S_StoreSamples (s, sc);
+
+	return sc;
+}
+
+/*
+==============
+S_LoadSound
+
+Returns the samples of a sound to play, loading them if needed
+==============
+*/
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	sfxcache_t	*sc;
+
+	sc = s->cache.data;
+	if (sc)
+	{
+		s->lastused = ++snd_cacheclock;
+		snd_hits++;
+		return sc;
 	}
 
-	stepscale = (float)info.rate / shm->speed;	
-	len = info.samples / stepscale;
+	snd_lateloads++;
+	return S_LoadSoundNow (s);
+}
 
-	len = len * info.width * info.channels;
+/*
+==============
+S_CacheSound
 
-	// PANZER - remove caching
-	// Use malloc without "free" until game death
-	sc = malloc( len + sizeof(sfxcache_t) );
-	s->cache.data = sc;
-	if (!sc)
+Called for precached sounds, loads them now or, during level precaching,
+leaves them to the loader thread
+==============
+*/
+void S_CacheSound (sfx_t *s, qboolean background)
+{
+	int		next;
+
+	if (s->cache.data)
+	{
+		s->lastused = ++snd_cacheclock;
+		return;
+	}
+
+	if (background && snd_loaderthread && !s->queued)
+	{
+		next = (snd_loadqueuehead + 1) % MAX_LOADQUEUE;
+		if (next != snd_loadqueuetail)
+		{
+			snd_loadqueue[snd_loadqueuehead] = s;
+			snd_loadqueuehead = next;
+			s->queued = true;
+			return;
+		}
+	}
+
+	if (!s->queued)
+		S_LoadSoundNow (s);
+}
+
+/*
+==============
+S_StartLoading
+
+Wakes the loader thread up to load the queued sounds
+==============
+*/
+void S_StartLoading (void)
+{
+	if (snd_loaderthread && snd_loadqueuehead != snd_loadqueuetail)
+		Jobs_SemaphorePost (snd_loadersem);
+}
+
+/*
+==============
+S_ReadSound
+
+Loads a sound in the loader thread
+==============
+*/
+static sfxcache_t *S_ReadSound (sfx_t *s)
+{
+	char		namebuffer[256];
+	FILE		*f;
+	int			size;
+	byte		*data;
+	sfxcache_t	*sc;
+
+	Q_strcpy(namebuffer, "sound/");
+	Q_strcat(namebuffer, s->name);
+
+	size = COM_ThreadFOpenFile (namebuffer, &f);
+	if (!f)
 		return NULL;
-	
-	sc->length = info.samples;
-	sc->loopstart = info.loopstart;
-	sc->speed = info.rate;
-	sc->width = info.width;
-	sc->stereo = info.channels;
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	data = malloc (size);
+	if (!data || fread (data, 1, size, f) != size)
+	{
+		free (data);
+		fclose (f);
+		return NULL;
+	}
+	fclose (f);
+
+	sc = S_DecodeSound (s->name, data, size, true);
+	free (data);
 
 	return sc;
 }
 
+static int S_LoaderThread (void *arg)
+{
+	sfx_t		*s;
+	sfxcache_t	*sc;
+
+	UNUSED(arg);
+
+	while (1)
+	{
+		Jobs_SemaphoreWait (snd_loadersem);
+		if (snd_loaderquit)
+			break;
+
+		while (!snd_loaderquit)
+		{
+			S_LockSamples ();
+			s = NULL;
+			if (snd_loadqueuetail != snd_loadqueuehead)
+			{
+				s = snd_loadqueue[snd_loadqueuetail];
+				snd_loadqueuetail = (snd_loadqueuetail + 1) % MAX_LOADQUEUE;
+			}
+			S_UnlockSamples ();
+
+			if (!s)
+				break;
+
+		// failed sounds are left for S_LoadSound, to print the reason
+			sc = NULL;
+			if (!s->cache.data)
+				sc = S_ReadSound (s);
+
+			S_LockSamples ();
+			s->queued = false;
+			if (sc && !s->cache.data)
+			{
+				S_StoreSamples (s, sc);
+				snd_backgroundloads++;
+			}
+			else
+				free (sc);
+			S_UnlockSamples ();
+		}
+	}
+
+	return 0;
+}
+
+/*
+==============
+S_SoundCache_f
+==============
+*/
+static void S_SoundCache_f (void)
+{
+	int		i, count, queued;
+
+	if (Cmd_Argc () == 2 && !Q_strcmp (Cmd_Argv (1), "reset"))
+	{
+		snd_hits = snd_lateloads = snd_backgroundloads = snd_evictions = 0;
+		return;
+	}
+
+	S_LockSamples ();
+
+	count = 0;
+	for (i=0 ; i<num_sfx ; i++)
+		if (known_sfx[i].cache.data)
+			count++;
+	queued = (snd_loadqueuehead - snd_loadqueuetail + MAX_LOADQUEUE) % MAX_LOADQUEUE;
+
+	Con_Printf ("%i of %i sounds resident, %ik of %ik\n", count, num_sfx,
+		snd_cachebytes / 1024, (int)snd_cachesize.value);
+	Con_Printf ("%i hits, %i late loads, %i background loads, %i queued\n",
+		snd_hits, snd_lateloads, snd_backgroundloads, queued);
+	Con_Printf ("%i evictions\n", snd_evictions);
+
+	S_UnlockSamples ();
+}
+
+/*
+==============
+S_InitLoader
+==============
+*/
+void S_InitLoader (void)
+{
+	Cvar_RegisterVariable (&snd_cachesize);
+	Cmd_AddCommand ("soundcache", S_SoundCache_f);
+
+	if (!sound_started)
+		return;
+
+	snd_samplesmutex = Jobs_CreateMutex ();
+	snd_loaderquit = false;
+	snd_loadersem = Jobs_CreateSemaphore ();
+	snd_loaderthread = Jobs_CreateThread (S_LoaderThread, "sound loader", NULL);
+}
+
+/*
+==============
+S_ShutdownLoader
+==============
+*/
+void S_ShutdownLoader (void)
+{
+	if (!snd_loaderthread)
+		return;
+
+	snd_loaderquit = true;
+	Jobs_SemaphorePost (snd_loadersem);
+	Jobs_WaitThread (snd_loaderthread);
+	Jobs_DestroySemaphore (snd_loadersem);
+	snd_loaderthread = NULL;
+	Jobs_DestroyMutex (snd_samplesmutex);
+	snd_samplesmutex = NULL;
+}
+
 
 
 /*
@@ -165,151 +507,159 @@ WAV loading
 */
 
 
-byte	*data_p;
-byte 	*iff_end;
-byte 	*last_chunk;
-byte 	*iff_data;
-int 	iff_chunk_len;
+typedef struct
+{
+	byte	*data_p;
+	byte 	*iff_end;
+	byte 	*last_chunk;
+	byte 	*iff_data;
+	int 	iff_chunk_len;
+} iffreader_t;
 
 
-short GetLittleShort(void)
+static short GetLittleShort(iffreader_t *r)
 {
 	short val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	data_p += 2;
+	val = *r->data_p;
+	val = val + (*(r->data_p+1)<<8);
+	r->data_p += 2;
 	return val;
 }
 
-int GetLittleLong(void)
+static int GetLittleLong(iffreader_t *r)
 {
 	int val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	val = val + (*(data_p+2)<<16);
-	val = val + (*(data_p+3)<<24);
-	data_p += 4;
+	val = *r->data_p;
+	val = val + (*(r->data_p+1)<<8);
+	val = val + (*(r->data_p+2)<<16);
+	val = val + (*(r->data_p+3)<<24);
+	r->data_p += 4;
 	return val;
 }
 
-void FindNextChunk(char *name)
+static void FindNextChunk(iffreader_t *r, char *name)
 {
 	while (1)
 	{
-		data_p=last_chunk;
+		r->data_p=r->last_chunk;
 
-		if (data_p >= iff_end)
+		if (r->data_p >= r->iff_end)
 		{	// didn't find the chunk
-			data_p = NULL;
+			r->data_p = NULL;
 			return;
 		}
 		
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		if (iff_chunk_len < 0)
+		r->data_p += 4;
+		r->iff_chunk_len = GetLittleLong(r);
+		if (r->iff_chunk_len < 0)
 		{
-			data_p = NULL;
+			r->data_p = NULL;
 			return;
 		}
 //		if (iff_chunk_len > 1024*1024)
 //			Sys_Error ("FindNextChunk: %i length is past the 1 meg sanity limit", iff_chunk_len);
-		data_p -= 8;
-		last_chunk = data_p + 8 + ( (iff_chunk_len + 1) & ~1 );
-		if (!Q_strncmp(data_p, name, 4))
+		r->data_p -= 8;
+		r->last_chunk = r->data_p + 8 + ( (r->iff_chunk_len + 1) & ~1 );
+		if (!Q_strncmp(r->data_p, name, 4))
 			return;
 	}
 }
 
-void FindChunk(char *name)
+static void FindChunk(iffreader_t *r, char *name)
 {
-	last_chunk = iff_data;
-	FindNextChunk (name);
+	r->last_chunk = r->iff_data;
+	FindNextChunk (r, name);
 }
 
 
-void DumpChunks(void)
+void DumpChunks(iffreader_t *r)
 {
 	char	str[5];
 	
 	str[4] = 0;
-	data_p=iff_data;
+	r->data_p=r->iff_data;
 	do
 	{
-		memcpy (str, data_p, 4);
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		Con_Printf ("0x%x : %s (%d)\n", (int)(data_p - 4), str, iff_chunk_len);
-		data_p += (iff_chunk_len + 1) & ~1;
-	} while (data_p < iff_end);
+		memcpy (str, r->data_p, 4);
+		r->data_p += 4;
+		r->iff_chunk_len = GetLittleLong(r);
+		Con_Printf ("0x%x : %s (%d)\n", (int)(r->data_p - 4), str, r->iff_chunk_len);
+		r->data_p += (r->iff_chunk_len + 1) & ~1;
+	} while (r->data_p < r->iff_end);
 }
 
 /*
 ============
-GetWavinfo
+S_ParseWavinfo
 ============
 */
-wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength)
+static wavinfo_t S_ParseWavinfo (char *name, byte *wav, int wavlength, qboolean quiet)
 {
+	iffreader_t	reader, *r;
 	wavinfo_t	info;
 	int     i;
 	int     format;
 	int		samples;
 
 	memset (&info, 0, sizeof(info));
+	r = &reader;
 
 	if (!wav)
 		return info;
 		
-	iff_data = wav;
-	iff_end = wav + wavlength;
+	r->iff_data = wav;
+	r->iff_end = wav + wavlength;
 
 // find "RIFF" chunk
-	FindChunk("RIFF");
-	if (!(data_p && !Q_strncmp(data_p+8, "WAVE", 4)))
+	FindChunk(r, "RIFF");
+	if (!(r->data_p && !Q_strncmp(r->data_p+8, "WAVE", 4)))
 	{
-		Con_Printf("Missing RIFF/WAVE chunks\n");
+		if (!quiet)
+			Con_Printf("Missing RIFF/WAVE chunks\n");
 		return info;
 	}
 
 // get "fmt " chunk
-	iff_data = data_p + 12;
-// DumpChunks ();
+	r->iff_data = r->data_p + 12;
+// DumpChunks (r);
 
-	FindChunk("fmt ");
-	if (!data_p)
+	FindChunk(r, "fmt ");
+	if (!r->data_p)
 	{
-		Con_Printf("Missing fmt chunk\n");
+		if (!quiet)
+			Con_Printf("Missing fmt chunk\n");
 		return info;
 	}
-	data_p += 8;
-	format = GetLittleShort();
+	r->data_p += 8;
+	format = GetLittleShort(r);
 	if (format != 1)
 	{
-		Con_Printf("Microsoft PCM format only\n");
+		if (!quiet)
+			Con_Printf("Microsoft PCM format only\n");
 		return info;
 	}
 
-	info.channels = GetLittleShort();
-	info.rate = GetLittleLong();
-	data_p += 4+2;
-	info.width = GetLittleShort() / 8;
+	info.channels = GetLittleShort(r);
+	info.rate = GetLittleLong(r);
+	r->data_p += 4+2;
+	info.width = GetLittleShort(r) / 8;
 
 // get cue chunk
-	FindChunk("cue ");
-	if (data_p)
+	FindChunk(r, "cue ");
+	if (r->data_p)
 	{
-		data_p += 32;
-		info.loopstart = GetLittleLong();
+		r->data_p += 32;
+		info.loopstart = GetLittleLong(r);
 //		Con_Printf("loopstart=%d\n", sfx->loopstart);
 
 	// if the next chunk is a LIST chunk, look for a cue length marker
-		FindNextChunk ("LIST");
-		if (data_p)
+		FindNextChunk (r, "LIST");
+		if (r->data_p)
 		{
-			if (!strncmp (data_p + 28, "mark", 4))
+			if (!strncmp (r->data_p + 28, "mark", 4))
 			{	// this is not a proper parse, but it works with cooledit...
-				data_p += 24;
-				i = GetLittleLong ();	// samples in loop
+				r->data_p += 24;
+				i = GetLittleLong (r);	// samples in loop
 				info.samples = info.loopstart + i;
 //				Con_Printf("looped length: %i\n", i);
 			}
@@ -319,26 +669,44 @@ wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength)
 		info.loopstart = -1;
 
 // find data chunk
-	FindChunk("data");
-	if (!data_p)
+	FindChunk(r, "data");
+	if (!r->data_p)
 	{
-		Con_Printf("Missing data chunk\n");
+		if (!quiet)
+			Con_Printf("Missing data chunk\n");
 		return info;
 	}
 
-	data_p += 4;
-	samples = GetLittleLong () / info.width;
+	r->data_p += 4;
+	samples = GetLittleLong (r) / info.width;
 
 	if (info.samples)
 	{
 		if (samples < info.samples)
+		{
+			if (quiet)
+			{
+				info.channels = 0;
+				return info;
+			}
 			Sys_Error ("Sound %s has a bad loop length", name);
+		}
 	}
 	else
 		info.samples = samples;
 
-	info.dataofs = data_p - wav;
+	info.dataofs = r->data_p - wav;
 	
 	return info;
 }
 
+
+/*
+============
+GetWavinfo
+============
+*/
+wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength)
+{
+	return S_ParseWavinfo (name, wav, wavlength, false);
+}
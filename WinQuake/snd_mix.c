@@ -97,7 +97,7 @@ void S_PaintChannels(int endtime)
 			if (!ch->leftvol && !ch->rightvol)
 				continue;
 
-			sc = ch->sfx->cache.data;
+			sc = ch->cache;
 			if (!sc)
 				continue;
 
@@ -130,7 +130,7 @@ void S_PaintChannels(int endtime)
 					}
 					else				
 					{	// channel just stopped
-						ch->sfx = NULL;
+						S_ReleaseChannel (ch);
 						break;
 					}
 				}
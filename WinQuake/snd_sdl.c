@@ -32,8 +32,6 @@ struct
 	qboolean		initialized;
 	SDL_AudioSpec	format;
 	int				device_id;
-
-	SDL_mutex*		mutex;
 } g_sdl_audio = { false };
 
 enum MusicState
@@ -43,20 +41,36 @@ enum MusicState
 	MUSIC_STOPPED,
 };
 
+// Music is streamed from the file by a thread of its own, that converts it
+// into the output format and rate and puts it into a ring buffer.
+// The audio callback takes it from there. Read and write positions are only
+// ever increased, each by one side, so the ring needs no lock.
+
+#define MUSIC_RING_FRAMES	65536 // power of two, stereo frames at output rate
+#define MUSIC_CHUNK_FRAMES	4096 // source frames converted at once
+
 static struct
 {
-	sample_t*	buffer;
+	FILE*		file;
 	int			sample_bits;
 	int			channels;
 	int			freq; // samples/sec
 
-	// Size - in samples
-	int			buffer_size;
-	int			buffer_pos;
+	int			data_start; // file offset
+	int			data_size; // in bytes
 
 	qboolean	looping;
 
-	enum MusicState		state;
+	enum MusicState		state; // changed under the audio device lock
+
+	SDL_Thread*	thread;
+	SDL_sem*	wakeup; // posted, when the callback has made room in the ring
+	SDL_atomic_t	quit;
+	SDL_atomic_t	finished; // all of the track is in the ring
+
+	SDL_atomic_t	read_pos; // frames
+	SDL_atomic_t	write_pos;
+	sample_t	ring[ MUSIC_RING_FRAMES * 2 ];
 } g_music;
 
 static int NearestPowerOfTwoFloor( int x )
@@ -70,14 +84,12 @@ static void MixMusic(Uint8* stream, int len)
 {
 	int			out_len_in_samples;
 	int			out_len_to_write;
-	int			in_samples_count;
-	int			in_end;
 	int			i;
-	int			channels[2], sample, sample_pos;
+	int			channels[2], pos;
 	fixed8_t	volume;
-	fixed16_t	step, inv_step;
 	sample_t*	out;
-	Uint8*		src_8bit;
+	sample_t*	in;
+	unsigned	read_pos;
 
 	if (g_music.state != MUSIC_PLAYING)
 		return;
@@ -89,116 +101,186 @@ static void MixMusic(Uint8* stream, int len)
 	out_len_in_samples = len / ( sizeof(sample_t) * g_sdl_audio.format.channels );
 	out = (sample_t*) stream;
 
-	step = ( ((long long int)g_music.freq) << 16 ) / g_sdl_audio.format.freq;
-	in_samples_count = (step * out_len_in_samples) >> 16;
-	in_end = g_music.buffer_pos + in_samples_count;
+	read_pos = SDL_AtomicGet( &g_music.read_pos );
+	out_len_to_write = (unsigned)SDL_AtomicGet( &g_music.write_pos ) - read_pos;
+	if( out_len_to_write > out_len_in_samples )
+		out_len_to_write = out_len_in_samples;
 
-	if( in_end > g_music.buffer_size )
+	for (i= 0; i < out_len_to_write; i++)
 	{
-		in_end = g_music.buffer_size;
-		inv_step = ( ((long long int)g_sdl_audio.format.freq) << 16 ) / g_music.freq;
+		pos = ( ( read_pos + i ) & ( MUSIC_RING_FRAMES - 1 ) ) * 2;
+		in = g_music.ring + pos;
+
+		channels[0] = out[i*2  ] + ( ( in[0] * volume ) >> 8 );
+		channels[1] = out[i*2+1] + ( ( in[1] * volume ) >> 8 );
+
+		if( channels[0] >  32767 ) channels[0] =  32767;
+		if( channels[0] < -32768 ) channels[0] = -32768;
+		if( channels[1] >  32767 ) channels[1] =  32767;
+		if( channels[1] < -32768 ) channels[1] = -32768;
+		out[i*2  ] = channels[0];
+		out[i*2+1] = channels[1];
+	}
 
-		out_len_to_write= Fixed16Mul( in_end - g_music.buffer_pos, inv_step );
+	SDL_AtomicSet( &g_music.read_pos, read_pos + out_len_to_write );
+	SDL_SemPost( g_music.wakeup );
 
-		// Cut just a little - we have calculating errors - we do not want read outside src buffer.
-		if( out_len_to_write > 0 )
-			out_len_to_write--;
-	}
-	else
-		out_len_to_write = out_len_in_samples;
+	// Track is over, when the streaming thread has put all of it in the ring, and we have played the ring.
+	if( out_len_to_write < out_len_in_samples && SDL_AtomicGet( &g_music.finished ) )
+		g_music.state = MUSIC_STOPPED;
+}
+
+// Reads source frames and converts them into 16bit stereo. Returns count of frames read, 0 at end of data.
+static int ReadMusicFrames( sample_t* dst, int max_frames, int* data_left )
+{
+	Uint8		raw[ MUSIC_CHUNK_FRAMES * 4 ];
+	int			frame_size;
+	int			frames;
+	int			i;
+
+	frame_size = g_music.channels * g_music.sample_bits / 8;
+
+	frames = *data_left / frame_size;
+	if( frames > max_frames )
+		frames = max_frames;
+	if( frames == 0 )
+		return 0;
+
+	frames = fread( raw, frame_size, frames, g_music.file );
+	*data_left -= frames * frame_size;
 
 	if( g_music.sample_bits == 16 )
 	{
 		if( g_music.channels == 1 )
-		{
-			for (i= 0; i < out_len_to_write; i++)
-			{
-				channels[0] = out[i*2  ];
-				channels[1] = out[i*2+1];
-				sample = g_music.buffer[ g_music.buffer_pos + Fixed16Mul(step, i) ];
-				channels[0] += ( sample * volume ) >> 8;
-				channels[1] += ( sample * volume ) >> 8;
-
-				if( channels[0] >  32767 ) channels[0] =  32767;
-				if( channels[0] < -32768 ) channels[0] = -32768;
-				if( channels[1] >  32767 ) channels[1] =  32767;
-				if( channels[1] < -32768 ) channels[1] = -32768;
-				out[i*2  ] = channels[0];
-				out[i*2+1] = channels[1];
-			}
-		} // mono
+			for( i = 0; i < frames; i++ )
+				dst[i*2] = dst[i*2+1] = LittleShort( ((short*)raw)[i] );
 		else
-		{
-			for (i= 0; i < out_len_to_write; i++)
-			{
-				channels[0] = out[i*2  ];
-				channels[1] = out[i*2+1];
-				sample_pos = 2 * ( g_music.buffer_pos + Fixed16Mul(step, i) );
-				channels[0] += ( g_music.buffer[ sample_pos     ] * volume ) >> 8;
-				channels[1] += ( g_music.buffer[ sample_pos + 1 ] * volume ) >> 8;
-
-				if( channels[0] >  32767 ) channels[0] =  32767;
-				if( channels[0] < -32768 ) channels[0] = -32768;
-				if( channels[1] >  32767 ) channels[1] =  32767;
-				if( channels[1] < -32768 ) channels[1] = -32768;
-				out[i*2  ] = channels[0];
-				out[i*2+1] = channels[1];
-			}
-		} // stereo
-	} //16bit
+			for( i = 0; i < frames * 2; i++ )
+				dst[i] = LittleShort( ((short*)raw)[i] );
+	}
 	else
 	{
-		src_8bit= (Uint8*) g_music.buffer;
 		if( g_music.channels == 1 )
-		{
-			for (i= 0; i < out_len_to_write; i++)
-			{
-				channels[0] = out[i*2  ];
-				channels[1] = out[i*2+1];
-				sample = (int)src_8bit[ g_music.buffer_pos + Fixed16Mul(step, i) ] - 128;
-				channels[0] += sample * volume;
-				channels[1] += sample * volume;
-
-				if( channels[0] >  32767 ) channels[0] =  32767;
-				if( channels[0] < -32768 ) channels[0] = -32768;
-				if( channels[1] >  32767 ) channels[1] =  32767;
-				if( channels[1] < -32768 ) channels[1] = -32768;
-				out[i*2  ] = channels[0];
-				out[i*2+1] = channels[1];
-			}
-		} // mono
+			for( i = 0; i < frames; i++ )
+				dst[i*2] = dst[i*2+1] = ( (int)raw[i] - 128 ) << 8;
 		else
+			for( i = 0; i < frames * 2; i++ )
+				dst[i] = ( (int)raw[i] - 128 ) << 8;
+	}
+
+	return frames;
+}
+
+static int SDLCALL MusicThread( void* userdata )
+{
+	sample_t	src[ MUSIC_CHUNK_FRAMES * 2 ];
+	int			src_frames, max_src_frames;
+	int			data_left;
+	fixed16_t	step, pos;
+	int			free_frames;
+	unsigned	write_pos;
+	sample_t*	dst;
+
+	step = ( ((long long int)g_music.freq) << 16 ) / g_sdl_audio.format.freq;
+	pos = 0;
+	data_left = g_music.data_size;
+
+	while( !SDL_AtomicGet( &g_music.quit ) )
+	{
+		write_pos = SDL_AtomicGet( &g_music.write_pos );
+		free_frames = MUSIC_RING_FRAMES - ( write_pos - (unsigned)SDL_AtomicGet( &g_music.read_pos ) );
+
+		// Source frames, which surely fit into free space after resampling.
+		max_src_frames = ( (long long int)( free_frames - 2 ) * step ) >> 16;
+		if( max_src_frames > MUSIC_CHUNK_FRAMES )
+			max_src_frames = MUSIC_CHUNK_FRAMES;
+		if( max_src_frames < MUSIC_CHUNK_FRAMES / 4 )
+		{
+			SDL_SemWaitTimeout( g_music.wakeup, 100 );
+			continue;
+		}
+
+		src_frames = ReadMusicFrames( src, max_src_frames, &data_left );
+		if( src_frames == 0 )
 		{
-			for (i= 0; i < out_len_to_write; i++)
+			if( g_music.looping && g_music.data_size > 0 && data_left != g_music.data_size )
 			{
-				channels[0] = out[i*2  ];
-				channels[1] = out[i*2+1];
-				sample_pos = 2 * ( g_music.buffer_pos + Fixed16Mul(step, i) );
-				channels[0] += ((int)src_8bit[ sample_pos     ] - 128) * volume;
-				channels[1] += ((int)src_8bit[ sample_pos + 1 ] - 128) * volume;
-
-				if( channels[0] >  32767 ) channels[0] =  32767;
-				if( channels[0] < -32768 ) channels[0] = -32768;
-				if( channels[1] >  32767 ) channels[1] =  32767;
-				if( channels[1] < -32768 ) channels[1] = -32768;
-				out[i*2  ] = channels[0];
-				out[i*2+1] = channels[1];
+				fseek( g_music.file, g_music.data_start, SEEK_SET );
+				data_left = g_music.data_size;
+				continue;
 			}
-		} // stereo
-	} // 8bit
+			SDL_AtomicSet( &g_music.finished, 1 );
+			break;
+		}
+
+		while( ( pos >> 16 ) < src_frames )
+		{
+			dst = g_music.ring + ( write_pos & ( MUSIC_RING_FRAMES - 1 ) ) * 2;
+			dst[0] = src[ ( pos >> 16 ) * 2     ];
+			dst[1] = src[ ( pos >> 16 ) * 2 + 1 ];
+			write_pos++;
+			pos += step;
+		}
+		pos -= src_frames << 16;
+
+		SDL_AtomicSet( &g_music.write_pos, write_pos );
+	}
+
+	return 0;
+}
+
+// Finds format and data chunk of wav file.
+static qboolean OpenMusicFile( const char* file_name )
+{
+	Uint8		header[16];
+	int			chunk_len;
+	int			format;
+	qboolean	got_format;
+
+	g_music.file = fopen( file_name, "rb" );
+	if( g_music.file == NULL )
+		return false;
 
-	g_music.buffer_pos= in_end;
+	if( fread( header, 1, 12, g_music.file ) != 12 ||
+		Q_strncmp( (char*)header, "RIFF", 4 ) != 0 || Q_strncmp( (char*)header + 8, "WAVE", 4 ) != 0 )
+		goto fail;
 
-	if( g_music.buffer_pos == g_music.buffer_size )
+	got_format = false;
+	while( fread( header, 1, 8, g_music.file ) == 8 )
 	{
-		if( g_music.looping )
-			g_music.buffer_pos= 0;
-		else
+		chunk_len = header[4] | (header[5] << 8) | (header[6] << 16) | (header[7] << 24);
+		if( chunk_len < 0 )
+			goto fail;
+
+		if( Q_strncmp( (char*)header, "fmt ", 4 ) == 0 && chunk_len >= 16 )
 		{
-			g_music.state = MUSIC_STOPPED;
-			SDL_FreeWAV( (Uint8*) g_music.buffer );
+			if( fread( header, 1, 16, g_music.file ) != 16 )
+				goto fail;
+			format = header[0] | (header[1] << 8);
+			g_music.channels = header[2] | (header[3] << 8);
+			g_music.freq = header[4] | (header[5] << 8) | (header[6] << 16) | (header[7] << 24);
+			g_music.sample_bits = header[14] | (header[15] << 8);
+			if( format != 1 )
+				goto fail;
+			got_format = true;
+			fseek( g_music.file, ( ( chunk_len + 1 ) & ~1 ) - 16, SEEK_CUR );
 		}
+		else if( Q_strncmp( (char*)header, "data", 4 ) == 0 )
+		{
+			if( !got_format )
+				goto fail;
+			g_music.data_start = ftell( g_music.file );
+			g_music.data_size = chunk_len;
+			return true;
+		}
+		else
+			fseek( g_music.file, ( chunk_len + 1 ) & ~1, SEEK_CUR );
 	}
+
+fail:
+	fclose( g_music.file );
+	g_music.file = NULL;
+	return false;
 }
 
 static void SDLCALL AudioCallback( void* userdata, Uint8* stream, int len )
@@ -210,14 +292,14 @@ static void SDLCALL AudioCallback( void* userdata, Uint8* stream, int len )
 	samples = (sample_t*) stream;
 	len_in_samples = len / ( sizeof(sample_t) * g_sdl_audio.format.channels );
 
-	SNDDMA_LockSoundData();
+	// All the mixing happens here, in the audio thread. Sounds of the game
+	// come through the command queue, so the game never holds us up.
+	S_UpdateMixer();
 
 	shm->buffer = stream;
 	S_PaintChannels( paintedtime + len_in_samples );
 
 	MixMusic(stream, len);
-
-	SNDDMA_UnlockSoundData();
 }
 
 qboolean SNDDMA_Init(void)
@@ -277,8 +359,6 @@ qboolean SNDDMA_Init(void)
 		return false;
 	}
 
-	g_sdl_audio.mutex = SDL_CreateMutex();
-
 	SDL_PauseAudioDevice( g_sdl_audio.device_id , 0 );
 
 	shm = (void *) malloc(sizeof(dma_t));
@@ -294,6 +374,7 @@ qboolean SNDDMA_Init(void)
 	shm->buffer = NULL;
 
 	g_music.state= MUSIC_STOPPED;
+	g_music.wakeup = SDL_CreateSemaphore( 0 );
 
 	g_sdl_audio.initialized = true;
 
@@ -307,96 +388,98 @@ void SNDDMA_Shutdown(void)
 
 	SDL_CloseAudioDevice( g_sdl_audio.device_id );
 	SDL_CloseAudio();
-	SDL_DestroyMutex( g_sdl_audio.mutex );
+	SDL_DestroySemaphore( g_music.wakeup );
 
 	g_sdl_audio.initialized = false;
 }
 
-void SNDDMA_LockSoundData(void)
-{
-	SDL_LockMutex( g_sdl_audio.mutex );
-}
-
-void SNDDMA_UnlockSoundData(void)
-{
-	SDL_UnlockMutex( g_sdl_audio.mutex );
-}
-
 void CDAudio_Play(byte track, qboolean looping)
 {
 	char			track_name[1024];
 	int				cd_path_param;
-	SDL_AudioSpec	spec;
-	Uint8*			buff;
-	Uint32			len;
 
 	cd_path_param = COM_CheckParm( "-cdpath" );
-	if( cd_path_param <= 0 )
+	if( cd_path_param <= 0 || !g_sdl_audio.initialized )
 		return;
 
+	CDAudio_Stop();
+
 	sprintf( track_name, "%s/%02d.wav", com_argv[cd_path_param + 1], track );
 
-	// Yes, we load full wav file.
-	// For 10 minutes 22kHz 16bits mono we spend about 25 megabytes of memory.
-	// But who cares about memory in year 2016?
-	if( !SDL_LoadWAV( track_name, &spec, &buff, &len ) )
+	if( !OpenMusicFile( track_name ) )
 	{
 		Con_Printf( "Failed to load \"%s\"\n", track_name );
 		return;
 	}
 
-	if( !( spec.channels == 1 || spec.channels == 2 ) ||
-		!( spec.format == AUDIO_S16 || spec.format == AUDIO_U8 ) )
+	if( !( g_music.channels == 1 || g_music.channels == 2 ) ||
+		!( g_music.sample_bits == 16 || g_music.sample_bits == 8 ) || g_music.freq <= 0 )
 	{
-		SDL_FreeWAV( buff );
+		fclose( g_music.file );
+		g_music.file = NULL;
 		Con_Printf( "\"%s\" - invalid audio format. Supported 8 or 16 bits mono or stereo.\n",track_name );
 		return;
 	}
 
-	g_music.buffer= (sample_t*) buff;
-	g_music.freq= spec.freq;
-	g_music.channels= spec.channels;
-	g_music.sample_bits= SDL_AUDIO_BITSIZE(spec.format);
-
-	g_music.buffer_size= len / (g_music.channels * g_music.sample_bits / 8);
+	g_music.looping = looping;
+	SDL_AtomicSet( &g_music.quit, 0 );
+	SDL_AtomicSet( &g_music.finished, 0 );
+	SDL_AtomicSet( &g_music.read_pos, 0 );
+	SDL_AtomicSet( &g_music.write_pos, 0 );
 
-	g_music.buffer_pos= 0;
+	g_music.thread = SDL_CreateThread( MusicThread, "music", NULL );
+	if( g_music.thread == NULL )
+	{
+		fclose( g_music.file );
+		g_music.file = NULL;
+		Con_Printf( "Failed to start music thread: %s\n", SDL_GetError() );
+		return;
+	}
 
+	SDL_LockAudioDevice( g_sdl_audio.device_id );
 	g_music.state = MUSIC_PLAYING;
-	g_music.looping = looping;
+	SDL_UnlockAudioDevice( g_sdl_audio.device_id );
 }
 
 void CDAudio_Stop(void)
 {
-	SNDDMA_LockSoundData();
+	SDL_LockAudioDevice( g_sdl_audio.device_id );
+	g_music.state = MUSIC_STOPPED;
+	SDL_UnlockAudioDevice( g_sdl_audio.device_id );
 
-	if( g_music.state != MUSIC_STOPPED )
+	if( g_music.thread != NULL )
 	{
-		g_music.state = MUSIC_STOPPED;
-		SDL_FreeWAV( (Uint8*) g_music.buffer );
+		SDL_AtomicSet( &g_music.quit, 1 );
+		SDL_SemPost( g_music.wakeup );
+		SDL_WaitThread( g_music.thread, NULL );
+		g_music.thread = NULL;
 	}
 
-	SNDDMA_UnlockSoundData();
+	if( g_music.file != NULL )
+	{
+		fclose( g_music.file );
+		g_music.file = NULL;
+	}
 }
 
 void CDAudio_Pause(void)
 {
-	SNDDMA_LockSoundData();
+	SDL_LockAudioDevice( g_sdl_audio.device_id );
 
 	if( g_music.state == MUSIC_PLAYING )
 		g_music.state = MUSIC_PAUSED;
 
-	SNDDMA_UnlockSoundData();
+	SDL_UnlockAudioDevice( g_sdl_audio.device_id );
 }
 
 void CDAudio_Resume(void)
 {
-	SNDDMA_LockSoundData();
+	SDL_LockAudioDevice( g_sdl_audio.device_id );
 
 	if( g_music.state == MUSIC_PAUSED )
 		g_music.state = MUSIC_PLAYING;
 
-	SNDDMA_UnlockSoundData();
+	SDL_UnlockAudioDevice( g_sdl_audio.device_id );
 }
 
 void CDAudio_Update(void)
@@ -36,6 +36,9 @@ typedef struct sfx_s
 {
 	char 	name[MAX_QPATH];
 	cache_user_t	cache;
+	int		lastused;		// for freeing the least recently used samples
+	qboolean	queued;		// waiting for the loader thread
+	int		playing;		// references held by the mixer, the samples stay
 } sfx_t;
 
 typedef struct
@@ -65,6 +68,7 @@ typedef struct
 typedef struct
 {
 	sfx_t	*sfx;			// sfx number
+	sfxcache_t	*cache;		// samples of sfx, only the mixer reads them
 	int		leftvol;		// 0-255 volume
 	int		rightvol;		// 0-255 volume
 	int		end;			// end time in global paintsamples
@@ -87,6 +91,15 @@ typedef struct
 	int		dataofs;		// chunk starts this many bytes from file start
 } wavinfo_t;
 
+typedef struct
+{
+	vec3_t	origin;
+	vec3_t	forward;
+	vec3_t	right;
+	vec3_t	up;
+	int		viewentity;		// sounds of it are always full volume
+} sndlistener_t;
+
 void S_Init (void);
 void S_Startup (void);
 void S_Shutdown (void);
@@ -96,7 +109,6 @@ void S_StopSound (int entnum, int entchannel);
 void S_StopAllSounds(qboolean clear);
 void S_ClearBuffer (void);
 void S_Update (vec3_t origin, vec3_t v_forward, vec3_t v_right, vec3_t v_up);
-void S_ExtraUpdate (void);
 
 sfx_t *S_PrecacheSound (char *sample);
 void S_TouchSound (char *sample);
@@ -106,18 +118,25 @@ void S_EndPrecaching (void);
 void S_PaintChannels(int endtime);
 void S_InitPaintChannels (void);
 
+// runs the commands of the game and updates the channels, called by the
+// mixing thread before every S_PaintChannels
+void S_UpdateMixer (void);
+
+// stops a channel and gives its sfx back to the game
+void S_ReleaseChannel (channel_t *ch);
+
 // picks a channel based on priorities, empty slots, number of channels
 channel_t *SND_PickChannel(int entnum, int entchannel);
 
 // spatializes a channel
-void SND_Spatialize(channel_t *ch);
+void SND_Spatialize(channel_t *ch, sndlistener_t *listener);
 
 // initializes cycling through a DMA buffer and returns information on it
 qboolean SNDDMA_Init(void);
 
-// Lock for channels data
-void SNDDMA_LockSoundData(void);
-void SNDDMA_UnlockSoundData(void);
+// guards the sample cache, which the game and the loader thread share
+void S_LockSamples (void);
+void S_UnlockSamples (void);
 
 // ====================================================================
 // User-setable variables
@@ -127,6 +146,9 @@ void SNDDMA_UnlockSoundData(void);
 #define	MAX_DYNAMIC_CHANNELS	8
 
 
+// the channels belong to the mixing thread, the game starts and stops
+// sounds through the command queue of snd_dma.c
+
 extern	channel_t   channels[MAX_CHANNELS];
 // 0 to MAX_DYNAMIC_CHANNELS-1	= normal entity sounds
 // MAX_DYNAMIC_CHANNELS to MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS -1 = water, etc
@@ -143,10 +165,7 @@ extern	int			total_channels;
 extern qboolean 		fakedma;
 extern int 			fakedma_updates;
 extern int		paintedtime;
-extern vec3_t listener_origin;
-extern vec3_t listener_forward;
-extern vec3_t listener_right;
-extern vec3_t listener_up;
+extern sndlistener_t	snd_listener;
 extern volatile dma_t *shm;
 extern volatile dma_t sn;
 extern vec_t sound_nominal_clip_dist;
@@ -161,6 +180,10 @@ extern int		snd_blocked;
 
 void S_LocalSound (char *s);
 sfxcache_t *S_LoadSound (sfx_t *s);
+void S_CacheSound (sfx_t *s, qboolean background);
+void S_StartLoading (void);
+void S_InitLoader (void);
+void S_ShutdownLoader (void);
 
 wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength);
 
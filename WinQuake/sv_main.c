@@ -24,9 +24,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 server_t		sv;
 server_static_t	svs;
+server_stats_t	sv_stats;
 
 char	localmodels[MAX_MODELS][5];			// inline model names for precache
 
+cvar_t	sv_statsreport = {"sv_statsreport", "0"};	// seconds between reports, 0 - never
+
+void SV_Stats_f (void);
+
 //============================================================================
 
 /*
@@ -40,6 +45,7 @@ void SV_Init (void)
 	extern	cvar_t	sv_maxvelocity;
 	extern	cvar_t	sv_gravity;
 	extern	cvar_t	sv_nostep;
+	extern	cvar_t	sv_parallelphysics;
 	extern	cvar_t	sv_friction;
 	extern	cvar_t	sv_edgefriction;
 	extern	cvar_t	sv_stopspeed;
@@ -58,9 +64,82 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_idealpitchscale);
 	Cvar_RegisterVariable (&sv_aim);
 	Cvar_RegisterVariable (&sv_nostep);
+	Cvar_RegisterVariable (&sv_parallelphysics);
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
+
+	Cvar_RegisterVariable (&sv_statsreport);
+	Cmd_AddCommand ("serverstats", SV_Stats_f);
+}
+
+/*
+=============================================================================
+
+LOAD STATISTICS
+
+=============================================================================
+*/
+
+/*
+==================
+SV_PrintStats
+
+Prints frame time, outgoing bandwidth and overflows since the last reset
+==================
+*/
+void SV_PrintStats (qboolean reset)
+{
+	double	elapsed;
+	int		i, c;
+
+	elapsed = realtime - sv_stats.starttime;
+	if (elapsed <= 0.0)
+		elapsed = 1.0;
+
+	c = 0;
+	for (i=0 ; i<svs.maxclients ; i++)
+		if (svs.clients[i].active)
+			c++;
+
+	Con_Printf ("server: %2i clients %4i frames ", c, sv_stats.frames);
+	if (sv_stats.frames)
+	{
+		Con_Printf ("%5.2f avg %5.2f max msec ", sv_stats.frametime * 1000.0 / sv_stats.frames, sv_stats.maxframetime * 1000.0);
+		Con_Printf ("%5.2f progs%s ", sv_stats.progstime * 1000.0 / sv_stats.frames, pr_jitfuncs && pr_jit.value ? " (jit)" : "");
+	}
+	Con_Printf ("%6.1f kb/s out %i overflows %i clipped\n", sv_stats.bytessent / elapsed / 1024.0, sv_stats.overflows, sv_stats.datagramsclipped);
+	if (sv_stats.premoves)
+		Con_Printf ("        %i of %i premoves used, %i differed\n", sv_stats.premovesused, sv_stats.premoves, sv_stats.premovesdiffered);
+
+	if (reset)
+	{
+		Q_memset (&sv_stats, 0, sizeof(sv_stats));
+		sv_stats.starttime = realtime;
+	}
+}
+
+/*
+==================
+SV_FrameStats
+
+Called after every server frame with the time it took
+==================
+*/
+void SV_FrameStats (double frametime)
+{
+	sv_stats.frames++;
+	sv_stats.frametime += frametime;
+	if (frametime > sv_stats.maxframetime)
+		sv_stats.maxframetime = frametime;
+
+	if (sv_statsreport.value > 0 && realtime - sv_stats.starttime >= sv_statsreport.value)
+		SV_PrintStats (true);
+}
+
+void SV_Stats_f (void)
+{
+	SV_PrintStats (Cmd_Argc () > 1 && Q_strcmp (Cmd_Argv (1), "reset") == 0);
 }
 
 /*
@@ -738,6 +817,10 @@ qboolean SV_SendClientDatagram (client_t *client)
 // copy the server datagram if there is space
 	if (msg.cursize + sv.datagram.cursize < msg.maxsize)
 		SZ_Write (&msg, sv.datagram.data, sv.datagram.cursize);
+	else
+		sv_stats.datagramsclipped++;
+
+	sv_stats.bytessent += msg.cursize;
 
 // send the datagram
 	if (NET_SendUnreliableMessage (client->netconnection, &msg) == -1)
@@ -824,6 +907,9 @@ void SV_SendClientMessages (void)
 // update frags, names, etc
 	SV_UpdateToReliableMessages ();
 
+// queue all outgoing packets and send them together at the end
+	NET_Batch (true);
+
 // build individual updates
 	for (i=0, host_client = svs.clients ; i<svs.maxclients ; i++, host_client++)
 	{
@@ -855,6 +941,7 @@ void SV_SendClientMessages (void)
 		// changes level
 		if (host_client->message.overflowed)
 		{
+			sv_stats.overflows++;
 			SV_DropClient (true);
 			host_client->message.overflowed = false;
 			continue;
@@ -872,6 +959,7 @@ void SV_SendClientMessages (void)
 				SV_DropClient (false);	// went to another level
 			else
 			{
+				sv_stats.bytessent += host_client->message.cursize;
 				if (NET_SendMessage (host_client->netconnection
 				, &host_client->message) == -1)
 					SV_DropClient (true);	// if the message couldn't send, kick off
@@ -881,7 +969,8 @@ void SV_SendClientMessages (void)
 			}
 		}
 	}
-	
+
+	NET_Batch (false);
 	
 // clear muzzle flashes
 	SV_CleanupEnts ();
@@ -1120,6 +1209,7 @@ void SV_SpawnServer (char *server)
 		ent = EDICT_NUM(i+1);
 		svs.clients[i].edict = ent;
 	}
+	ED_ResetFreeList ();
 	
 	sv.state = ss_loading;
 	sv.paused = false;
@@ -38,8 +38,9 @@ int c_yes, c_no;
 qboolean SV_CheckBottom (edict_t *ent)
 {
 	vec3_t	mins, maxs, start, stop;
-	trace_t	trace;
-	int		x, y;
+	vec3_t	corners[4], cornerstops[4];
+	trace_t	trace, cornertraces[4];
+	int		i, x, y;
 	float	mid, bottom;
 	
 	VectorAdd (ent->v.origin, ent->v.mins, mins);
@@ -82,17 +83,23 @@ realcheck:
 	for	(x=0 ; x<=1 ; x++)
 		for	(y=0 ; y<=1 ; y++)
 		{
-			start[0] = stop[0] = x ? maxs[0] : mins[0];
-			start[1] = stop[1] = y ? maxs[1] : mins[1];
-			
-			trace = SV_Move (start, vec3_origin, vec3_origin, stop, true, ent);
-			
-			if (trace.fraction != 1.0 && trace.endpos[2] > bottom)
-				bottom = trace.endpos[2];
-			if (trace.fraction == 1.0 || mid - trace.endpos[2] > STEPSIZE)
-				return false;
+			i = x*2 + y;
+			corners[i][0] = cornerstops[i][0] = x ? maxs[0] : mins[0];
+			corners[i][1] = cornerstops[i][1] = y ? maxs[1] : mins[1];
+			corners[i][2] = start[2];
+			cornerstops[i][2] = stop[2];
 		}
 
+	SV_MoveBatch (4, corners, vec3_origin, vec3_origin, cornerstops, true, ent, cornertraces);
+
+	for (i=0 ; i<4 ; i++)
+	{
+		if (cornertraces[i].fraction != 1.0 && cornertraces[i].endpos[2] > bottom)
+			bottom = cornertraces[i].endpos[2];
+		if (cornertraces[i].fraction == 1.0 || mid - cornertraces[i].endpos[2] > STEPSIZE)
+			return false;
+	}
+
 	c_yes++;
 	return true;
 }
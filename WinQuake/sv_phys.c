@@ -45,6 +45,11 @@ cvar_t	sv_stopspeed = {"sv_stopspeed","100"};
 cvar_t	sv_gravity = {"sv_gravity","800",false,true};
 cvar_t	sv_maxvelocity = {"sv_maxvelocity","2000"};
 cvar_t	sv_nostep = {"sv_nostep","0"};
+cvar_t	sv_parallelphysics = {"sv_parallelphysics","0"};	// 1 - trace flying entities on the job threads first, 2 - and check those traces
+
+static	premove_t	sv_premoves[MAX_EDICTS];
+static	int			sv_numpremoves;
+static	premove_t	*sv_edictpremove[MAX_EDICTS];
 
 #ifdef QUAKE2
 static	vec3_t	vec_origin = {0.0, 0.0, 0.0};
@@ -399,6 +404,61 @@ PUSHMOVE
 ===============================================================================
 */
 
+static int SV_PushType (edict_t *ent)
+{
+	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
+		return MOVE_MISSILE;
+	if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
+		return MOVE_NOMONSTERS;		// only clip against bmodels
+	return MOVE_NORMAL;
+}
+
+static qboolean SV_TracesEqual (trace_t *a, trace_t *b)
+{
+	return a->allsolid == b->allsolid && a->startsolid == b->startsolid
+		&& a->inopen == b->inopen && a->inwater == b->inwater
+		&& !memcmp (&a->fraction, &b->fraction, sizeof(float))
+		&& !memcmp (a->endpos, b->endpos, sizeof(vec3_t))
+		&& !memcmp (&a->plane, &b->plane, sizeof(plane_t))
+		&& a->ent == b->ent;
+}
+
+/*
+============
+SV_PushTrace
+
+Uses the premove of the entity if it is still good
+============
+*/
+static trace_t SV_PushTrace (edict_t *ent, vec3_t end, int type)
+{
+	premove_t	*pm;
+	trace_t		trace;
+	int			num;
+
+	if (!sv_numpremoves)
+		return SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent);
+
+	num = NUM_FOR_EDICT(ent);
+	pm = sv_edictpremove[num];
+	sv_edictpremove[num] = NULL;	// only good for the first move
+
+	if (!pm || !SV_CheckPremove (pm, ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent))
+		return SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent);
+
+	sv_stats.premovesused++;
+	if (sv_parallelphysics.value < 2)
+		return pm->trace;
+
+	trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, type, ent);
+	if (!SV_TracesEqual (&trace, &pm->trace))
+	{
+		Con_Printf ("SV_PushTrace: premove of %s differs\n", pr_strings + ent->v.classname);
+		sv_stats.premovesdiffered++;
+	}
+	return trace;
+}
+
 /*
 ============
 SV_PushEntity
@@ -413,13 +473,7 @@ trace_t SV_PushEntity (edict_t *ent, vec3_t push)
 		
 	VectorAdd (ent->v.origin, push, end);
 
-	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_MISSILE, ent);
-	else if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
-	// only clip against bmodels
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NOMONSTERS, ent);
-	else
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NORMAL, ent);	
+	trace = SV_PushTrace (ent, end, SV_PushType (ent));
 	
 	VectorCopy (trace.endpos, ent->v.origin);
 	SV_LinkEdict (ent, true);
@@ -1499,6 +1553,121 @@ void SV_Physics_Step (edict_t *ent)
 
 //============================================================================
 
+static void SV_StopPremoves (void)
+{
+	if (!sv_numpremoves)
+		return;
+	SV_EndPremoves ();
+	sv_numpremoves = 0;
+}
+
+#ifndef QUAKE2
+/*
+================
+SV_PredictToss
+
+The end of the move SV_Physics_Toss will make if no progs run before it,
+false if it won't move or progs will run
+================
+*/
+static qboolean SV_PredictToss (edict_t *ent, vec3_t end)
+{
+	vec3_t	velocity, move;
+	float	ent_gravity;
+	eval_t	*val;
+	int		i;
+
+	if (ent->v.nextthink > 0 && ent->v.nextthink <= sv.time + host_frametime)
+		return false;
+	if ((int)ent->v.flags & FL_ONGROUND)
+		return false;
+
+// same as SV_CheckVelocity and SV_AddGravity
+	VectorCopy (ent->v.velocity, velocity);
+	for (i=0 ; i<3 ; i++)
+	{
+		if (IS_NAN(velocity[i]) || IS_NAN(ent->v.origin[i]))
+			return false;
+		if (velocity[i] > sv_maxvelocity.value)
+			velocity[i] = sv_maxvelocity.value;
+		else if (velocity[i] < -sv_maxvelocity.value)
+			velocity[i] = -sv_maxvelocity.value;
+	}
+
+	if (ent->v.movetype != MOVETYPE_FLY
+	&& ent->v.movetype != MOVETYPE_FLYMISSILE)
+	{
+		val = GetEdictFieldValue(ent, "gravity");
+		if (val && val->_float)
+			ent_gravity = val->_float;
+		else
+			ent_gravity = 1.0;
+		velocity[2] -= ent_gravity * sv_gravity.value * host_frametime;
+	}
+
+	VectorScale (velocity, host_frametime, move);
+	VectorAdd (ent->v.origin, move, end);
+	return true;
+}
+
+static void SV_PremoveJob (int index, int thread, void *arg)
+{
+	UNUSED(arg);
+
+	SV_Premove (&sv_premoves[index], thread);
+}
+
+/*
+================
+SV_StartPremoves
+
+Traces the moves of all the flying entities on the job threads, against the
+world as it is before any of them moved. SV_PushEntity takes the traces that
+nothing changed since, and traces the others again, so the outcome is the
+same as tracing all of them one after the other.
+================
+*/
+static void SV_StartPremoves (void)
+{
+	int			i;
+	edict_t		*ent;
+	premove_t	*pm;
+
+	memset (sv_edictpremove, 0, sizeof(sv_edictpremove));
+	sv_numpremoves = 0;
+
+	ent = EDICT_NUM(svs.maxclients + 1);
+	for (i=svs.maxclients+1 ; i<sv.num_edicts ; i++, ent = NEXT_EDICT(ent))
+	{
+		if (ent->free)
+			continue;
+		if (ent->v.movetype != MOVETYPE_TOSS
+		&& ent->v.movetype != MOVETYPE_BOUNCE
+		&& ent->v.movetype != MOVETYPE_FLY
+		&& ent->v.movetype != MOVETYPE_FLYMISSILE)
+			continue;
+
+		pm = &sv_premoves[sv_numpremoves];
+		if (!SV_PredictToss (ent, pm->end))
+			continue;
+		VectorCopy (ent->v.origin, pm->start);
+		VectorCopy (ent->v.mins, pm->mins);
+		VectorCopy (ent->v.maxs, pm->maxs);
+		pm->type = SV_PushType (ent);
+		pm->passedict = ent;
+		sv_edictpremove[i] = pm;
+		sv_numpremoves++;
+	}
+
+	if (!sv_numpremoves)
+		return;
+
+	SV_BeginPremoves ();
+	Jobs_Run (SV_PremoveJob, sv_numpremoves, NULL);
+	sv_stats.premoves += sv_numpremoves;
+}
+#endif
+
 /*
 ================
 SV_Physics
@@ -1510,6 +1679,8 @@ void SV_Physics (void)
 	int		i;
 	edict_t	*ent;
 
+	SV_StopPremoves ();		// a Host_Error can skip the end of a frame
+
 // let the progs know that a new frame has started
 	pr_global_struct->self = EDICT_TO_PROG(sv.edicts);
 	pr_global_struct->other = EDICT_TO_PROG(sv.edicts);
@@ -1518,6 +1689,12 @@ void SV_Physics (void)
 
 //SV_CheckAllEnts ();
 
+#ifndef QUAKE2	// conveyors and water checks come before the move there
+// a forced retouch links everything again, no premove would be any good
+	if (sv_parallelphysics.value && !pr_global_struct->force_retouch)
+		SV_StartPremoves ();
+#endif
+
 //
 // treat each object in turn
 //
@@ -1558,9 +1735,13 @@ void SV_Physics (void)
 			Sys_Error ("SV_Physics: bad movetype %i", (int)ent->v.movetype);			
 	}
 	
+	SV_StopPremoves ();
+
 	if (pr_global_struct->force_retouch)
 		pr_global_struct->force_retouch--;	
 
+	ED_CheckStrings ();
+
 	sv.time += host_frametime;
 }
 
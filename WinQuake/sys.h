@@ -53,6 +53,23 @@ void Sys_Quit (void);
 
 double Sys_FloatTime (void);
 
+double Sys_PreciseTime (void);
+// sub-microsecond resolution, for profiling
+
+void *Sys_AllocCode (int size);
+qboolean Sys_MakeCodeExecutable (void *code, int size);
+void Sys_FreeCode (void *code, int size);
+// writable memory for generated code, made read only and executable when done
+
+int Sys_ForkServer (void);
+// -1 if it failed or can't be done, 0 in the new process, the process id of
+// the new one in the old process
+int Sys_WaitServer (qboolean *crashed);
+// waits for a forked server to end and returns its process id, 0 when the
+// supervisor was told to stop or none are left. crashed is false for a
+// normal quit
+void Sys_StopServer (int pid);
+
 char *Sys_ConsoleInput (void);
 
 void Sys_SendKeyEvents (void);
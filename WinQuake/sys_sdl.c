@@ -26,6 +26,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <windows.h>
 #else
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
 #endif
 
 #include <SDL.h>
@@ -189,7 +195,10 @@ void Sys_Error (char *error, ...)
 
 	SDL_ShowSimpleMessageBox( 0, "Error", text, NULL );
 
-	Sys_Quit();
+	// not Sys_Quit, a server pool restarts servers that exit with an error
+	Host_Shutdown();
+	SDL_Quit();
+	exit(1);
 }
 
 void Sys_Printf (char *fmt, ...)
@@ -217,6 +226,146 @@ double Sys_FloatTime (void)
 	return ( (double)SDL_GetTicks() ) * 0.001;
 }
 
+double Sys_PreciseTime (void)
+{
+	static double	scale;
+
+	if (!scale)
+		scale = 1.0 / (double)SDL_GetPerformanceFrequency();
+	return (double)SDL_GetPerformanceCounter() * scale;
+}
+
+void *Sys_AllocCode (int size)
+{
+#ifdef _WIN32
+	return VirtualAlloc (NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	void	*code;
+
+	code = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return code == MAP_FAILED ? NULL : code;
+#endif
+}
+
+qboolean Sys_MakeCodeExecutable (void *code, int size)
+{
+#ifdef _WIN32
+	DWORD	old;
+
+	if (!VirtualProtect (code, size, PAGE_EXECUTE_READ, &old))
+		return false;
+	FlushInstructionCache (GetCurrentProcess (), code, size);
+	return true;
+#else
+	return mprotect (code, size, PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+void Sys_FreeCode (void *code, int size)
+{
+#ifdef _WIN32
+	VirtualFree (code, 0, MEM_RELEASE);
+#else
+	munmap (code, size);
+#endif
+}
+
+#ifndef _WIN32
+static volatile sig_atomic_t	sys_stopservers;
+
+static void Sys_StopServersSignal (int sig)
+{
+	sys_stopservers = 1;
+}
+
+static void Sys_ServerExitSignal (int sig)
+{
+	// only there to wake up the sigsuspend of Sys_WaitServer
+}
+#endif
+
+int Sys_ForkServer (void)
+{
+#ifdef _WIN32
+	return -1;
+#else
+	static qboolean	handlers;
+	struct sigaction	sa;
+	pid_t	pid;
+
+	if (!handlers)
+	{	// the supervisor stops the servers itself, so they don't look crashed
+		memset (&sa, 0, sizeof(sa));
+		sa.sa_handler = Sys_StopServersSignal;
+		sigemptyset (&sa.sa_mask);
+		sigaction (SIGINT, &sa, NULL);
+		sigaction (SIGTERM, &sa, NULL);
+		sigaction (SIGHUP, &sa, NULL);
+		sa.sa_handler = Sys_ServerExitSignal;
+		sigaction (SIGCHLD, &sa, NULL);
+		handlers = true;
+	}
+
+	fflush (stdout);
+	pid = fork ();
+	if (pid == 0)
+	{
+		signal (SIGINT, SIG_DFL);
+		signal (SIGTERM, SIG_DFL);
+		signal (SIGHUP, SIG_DFL);
+		signal (SIGCHLD, SIG_DFL);
+		setpgid (0, 0);		// ctrl-c goes to the supervisor only
+	}
+	return pid;
+#endif
+}
+
+int Sys_WaitServer (qboolean *crashed)
+{
+#ifdef _WIN32
+	return 0;
+#else
+	pid_t		pid;
+	int			status;
+	sigset_t	set, oldset;
+
+// with the signals blocked none can come between the check of
+// sys_stopservers and the wait, sigsuspend unblocks them while it sleeps
+	sigemptyset (&set);
+	sigaddset (&set, SIGINT);
+	sigaddset (&set, SIGTERM);
+	sigaddset (&set, SIGHUP);
+	sigaddset (&set, SIGCHLD);
+	sigprocmask (SIG_BLOCK, &set, &oldset);
+	while (1)
+	{
+		pid = 0;
+		if (sys_stopservers)
+			break;
+		pid = waitpid (-1, &status, WNOHANG);
+		if (pid != 0)
+			break;		// a server exited, or none are left
+		sigsuspend (&oldset);
+	}
+	sigprocmask (SIG_SETMASK, &oldset, NULL);
+
+	if (pid <= 0)
+		return 0;
+	*crashed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	return pid;
+#endif
+}
+
+void Sys_StopServer (int pid)
+{
+#ifndef _WIN32
+	int		status;
+
+	kill (pid, SIGTERM);
+	waitpid (pid, &status, 0);
+#endif
+}
+
 char *Sys_ConsoleInput (void)
 {
 	// panzer - stub
@@ -283,6 +432,7 @@ int main(int argc, const char* argv[])
 
 	Sys_Printf ("Host_Init\n");
 	Host_Init (&parms);
+	Host_RunPool ();
 
 	oldtime = Sys_FloatTime ();
 
@@ -50,8 +50,6 @@ enum
 modestate_t	modestate = MS_UNINIT;
 cvar_t		_windowed_mouse = {"_windowed_mouse","0", true};
 
-static byte		*g_vid_surfcache;
-static int		g_vid_surfcachesize;
 
 unsigned short	d_8to16table[256];
 unsigned		d_8to24table[256];
@@ -437,9 +435,7 @@ static void UpdateMode (unsigned char *palette)
 
 	VID_SetPalette(palette);
 
-	g_vid_surfcachesize = D_SurfaceCacheForRes (vid.width, vid.height) * r_pixbytes;
-	g_vid_surfcache = malloc( g_vid_surfcachesize );
-	D_InitCaches (g_vid_surfcache, g_vid_surfcachesize);
+	D_AllocCaches (D_SurfaceCacheForRes (vid.width, vid.height) * r_pixbytes);
 
 	g_initialized = true;
 }
@@ -525,7 +521,7 @@ void	VID_Shutdown (void)
 		free( vid.buffer );
 
 	free( vid.warpbuffer );
-	free( g_vid_surfcache );
+	D_FreeCaches();
 	free( d_pzbuffer );
 
 	VID_RestoreSystemGamma( g_sdl.window );
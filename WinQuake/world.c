@@ -40,11 +40,10 @@ typedef struct
 	trace_t		trace;
 	int			type;
 	edict_t		*passedict;
+	struct boxhull_s	*box;	// of the thread doing the move
+	premove_t	*premove;		// records what it looks at, NULL for a plain move
 } moveclip_t;
 
-
-int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
-
 /*
 ===============================================================================
 
@@ -54,44 +53,19 @@ HULL BOXES
 */
 
 
-static	hull_t		box_hull;
-static	dclipnode_t	box_clipnodes[6];
-static	mplane_t	box_planes[6];
+static	boxhull_t	box_hulls[MAX_PREMOVETHREADS];	// one for every job thread, 0 is the main thread
 
 /*
 ===================
 SV_InitBoxHull
-
-Set up the planes and clipnodes so that the six floats of a bounding box
-can just be stored out and get a proper hull_t structure.
 ===================
 */
 void SV_InitBoxHull (void)
 {
 	int		i;
-	int		side;
 
-	box_hull.clipnodes = box_clipnodes;
-	box_hull.planes = box_planes;
-	box_hull.firstclipnode = 0;
-	box_hull.lastclipnode = 5;
-
-	for (i=0 ; i<6 ; i++)
-	{
-		box_clipnodes[i].planenum = i;
-		
-		side = i&1;
-		
-		box_clipnodes[i].children[side] = CONTENTS_EMPTY;
-		if (i != 5)
-			box_clipnodes[i].children[side^1] = i + 1;
-		else
-			box_clipnodes[i].children[side^1] = CONTENTS_SOLID;
-		
-		box_planes[i].type = i>>1;
-		box_planes[i].normal[i>>1] = 1;
-	}
-	
+	for (i=0 ; i<MAX_PREMOVETHREADS ; i++)
+		CM_InitBoxHull (&box_hulls[i]);
 }
 
 
@@ -105,14 +79,7 @@ BSP trees instead of being compared directly.
 */
 hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
 {
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = mins[0];
-	box_planes[2].dist = maxs[1];
-	box_planes[3].dist = mins[1];
-	box_planes[4].dist = maxs[2];
-	box_planes[5].dist = mins[2];
-
-	return &box_hull;
+	return CM_HullForBox (&box_hulls[0], mins, maxs);
 }
 
 
@@ -127,10 +94,9 @@ Offset is filled in to contain the adjustment that must be added to the
 testing object's origin to get a point to use with the returned hull.
 ================
 */
-hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
+static hull_t *SV_HullForEntityBox (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset, boxhull_t *box)
 {
 	model_t		*model;
-	vec3_t		size;
 	vec3_t		hullmins, hullmaxs;
 	hull_t		*hull;
 
@@ -145,13 +111,7 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 		if (!model || model->type != mod_brush)
 			Sys_Error ("MOVETYPE_PUSH with a non bsp model");
 
-		VectorSubtract (maxs, mins, size);
-		if (size[0] < 3)
-			hull = &model->hulls[0];
-		else if (size[0] <= 32)
-			hull = &model->hulls[1];
-		else
-			hull = &model->hulls[2];
+		hull = CM_HullForSize (model, mins, maxs);
 
 // calculate an offset value to center the origin
 		VectorSubtract (hull->clip_mins, mins, offset);
@@ -162,7 +122,7 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 
 		VectorSubtract (ent->v.mins, maxs, hullmins);
 		VectorSubtract (ent->v.maxs, mins, hullmaxs);
-		hull = SV_HullForBox (hullmins, hullmaxs);
+		hull = CM_HullForBox (box, hullmins, hullmaxs);
 		
 		VectorCopy (ent->v.origin, offset);
 	}
@@ -171,6 +131,11 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 	return hull;
 }
 
+hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
+{
+	return SV_HullForEntityBox (ent, mins, maxs, offset, &box_hulls[0]);
+}
+
 /*
 ===============================================================================
 
@@ -194,6 +159,9 @@ typedef struct areanode_s
 static	areanode_t	sv_areanodes[AREA_NODES];
 static	int			sv_numareanodes;
 
+static	qboolean	sv_premoving;		// between SV_BeginPremoves and SV_EndPremoves
+static void SV_PremoveLink (edict_t *ent);
+
 /*
 ===============
 SV_CreateAreaNode
@@ -265,6 +233,8 @@ void SV_UnlinkEdict (edict_t *ent)
 {
 	if (!ent->area.prev)
 		return;		// not linked in anywhere
+	if (sv_premoving)
+		SV_PremoveLink (ent);
 	RemoveLink (&ent->area);
 	ent->area.prev = ent->area.next = NULL;
 }
@@ -465,6 +435,8 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 		InsertLinkBefore (&ent->area, &node->trigger_edicts);
 	else
 		InsertLinkBefore (&ent->area, &node->solid_edicts);
+	if (sv_premoving)
+		SV_PremoveLink (ent);
 	
 // if touch_triggers, touch all entities at this node and decend for more
 	if (touch_triggers)
@@ -482,41 +454,6 @@ POINT TESTING IN HULLS
 */
 
 
-/*
-==================
-SV_HullPointContents
-
-==================
-*/
-int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
-{
-	float		d;
-	dclipnode_t	*node;
-	mplane_t	*plane;
-
-	while (num >= 0)
-	{
-		if (num < hull->firstclipnode || num > hull->lastclipnode)
-			Sys_Error ("SV_HullPointContents: bad node number");
-	
-		node = hull->clipnodes + num;
-		plane = hull->planes + node->planenum;
-		
-		if (plane->type < 3)
-			d = p[plane->type] - plane->dist;
-		else
-			d = DotProduct (plane->normal, p) - plane->dist;
-		if (d < 0)
-			num = node->children[1];
-		else
-			num = node->children[0];
-	}
-	
-	return num;
-}
-
-
-
 /*
 ==================
 SV_PointContents
@@ -527,7 +464,7 @@ int SV_PointContents (vec3_t p)
 {
 	int		cont;
 
-	cont = SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	cont = CM_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
 	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
 		cont = CONTENTS_WATER;
 	return cont;
@@ -535,7 +472,7 @@ int SV_PointContents (vec3_t p)
 
 int SV_TruePointContents (vec3_t p)
 {
-	return SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	return CM_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
 }
 
 //===========================================================================
@@ -563,153 +500,11 @@ edict_t	*SV_TestEntityPosition (edict_t *ent)
 /*
 ===============================================================================
 
-LINE TESTING IN HULLS
+CLIPPING TO EDICTS
 
 ===============================================================================
 */
 
-// 1/32 epsilon to keep floating point happy
-#define	DIST_EPSILON	(0.03125)
-
-/*
-==================
-SV_RecursiveHullCheck
-
-==================
-*/
-qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
-{
-	dclipnode_t	*node;
-	mplane_t	*plane;
-	float		t1, t2;
-	float		frac;
-	int			i;
-	vec3_t		mid;
-	int			side;
-	float		midf;
-
-// check for empty
-	if (num < 0)
-	{
-		if (num != CONTENTS_SOLID)
-		{
-			trace->allsolid = false;
-			if (num == CONTENTS_EMPTY)
-				trace->inopen = true;
-			else
-				trace->inwater = true;
-		}
-		else
-			trace->startsolid = true;
-		return true;		// empty
-	}
-
-	if (num < hull->firstclipnode || num > hull->lastclipnode)
-		Sys_Error ("SV_RecursiveHullCheck: bad node number");
-
-//
-// find the point distances
-//
-	node = hull->clipnodes + num;
-	plane = hull->planes + node->planenum;
-
-	if (plane->type < 3)
-	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
-	}
-	else
-	{
-		t1 = DotProduct (plane->normal, p1) - plane->dist;
-		t2 = DotProduct (plane->normal, p2) - plane->dist;
-	}
-	
-#if 1
-	if (t1 >= 0 && t2 >= 0)
-		return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
-	if (t1 < 0 && t2 < 0)
-		return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
-#else
-	if ( (t1 >= DIST_EPSILON && t2 >= DIST_EPSILON) || (t2 > t1 && t1 >= 0) )
-		return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
-	if ( (t1 <= -DIST_EPSILON && t2 <= -DIST_EPSILON) || (t2 < t1 && t1 <= 0) )
-		return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
-#endif
-
-// put the crosspoint DIST_EPSILON pixels on the near side
-	if (t1 < 0)
-		frac = (t1 + DIST_EPSILON)/(t1-t2);
-	else
-		frac = (t1 - DIST_EPSILON)/(t1-t2);
-	if (frac < 0)
-		frac = 0;
-	if (frac > 1)
-		frac = 1;
-		
-	midf = p1f + (p2f - p1f)*frac;
-	for (i=0 ; i<3 ; i++)
-		mid[i] = p1[i] + frac*(p2[i] - p1[i]);
-
-	side = (t1 < 0);
-
-// move up to the node
-	if (!SV_RecursiveHullCheck (hull, node->children[side], p1f, midf, p1, mid, trace) )
-		return false;
-
-#ifdef PARANOID
-	if (SV_HullPointContents (sv_hullmodel, mid, node->children[side])
-	== CONTENTS_SOLID)
-	{
-		Con_Printf ("mid PointInHullSolid\n");
-		return false;
-	}
-#endif
-	
-	if (SV_HullPointContents (hull, node->children[side^1], mid)
-	!= CONTENTS_SOLID)
-// go past the node
-		return SV_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
-	
-	if (trace->allsolid)
-		return false;		// never got out of the solid area
-		
-//==================
-// the other side of the node is solid, this is the impact point
-//==================
-	if (!side)
-	{
-		VectorCopy (plane->normal, trace->plane.normal);
-		trace->plane.dist = plane->dist;
-	}
-	else
-	{
-		VectorSubtract (vec3_origin, plane->normal, trace->plane.normal);
-		trace->plane.dist = -plane->dist;
-	}
-
-	while (SV_HullPointContents (hull, hull->firstclipnode, mid)
-	== CONTENTS_SOLID)
-	{ // shouldn't really happen, but does occasionally
-		frac -= 0.1;
-		if (frac < 0)
-		{
-			trace->fraction = midf;
-			VectorCopy (mid, trace->endpos);
-			Con_DPrintf ("backup past 0\n");
-			return false;
-		}
-		midf = p1f + (p2f - p1f)*frac;
-		for (i=0 ; i<3 ; i++)
-			mid[i] = p1[i] + frac*(p2[i] - p1[i]);
-	}
-
-	trace->fraction = midf;
-	VectorCopy (mid, trace->endpos);
-
-	return false;
-}
-
-
 /*
 ==================
 SV_ClipMoveToEntity
@@ -718,7 +513,7 @@ Handles selection or creation of a clipping hull, and offseting (and
 eventually rotation) of the end points
 ==================
 */
-trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+static trace_t SV_ClipMoveToEntityBox (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, boxhull_t *box, premove_t *premove)
 {
 	trace_t		trace;
 	vec3_t		offset;
@@ -732,7 +527,7 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	VectorCopy (end, trace.endpos);
 
 // get the clipping hull
-	hull = SV_HullForEntity (ent, mins, maxs, offset);
+	hull = SV_HullForEntityBox (ent, mins, maxs, offset, box);
 
 	VectorSubtract (start, offset, start_l);
 	VectorSubtract (end, offset, end_l);
@@ -761,7 +556,14 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 #endif
 
 // trace a line through the apropriate clipping hull
-	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	CM_HullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	if (trace.backedup)
+	{	// a job thread can't print, the move is traced again serially
+		if (premove)
+			premove->traced = false;
+		else
+			Con_DPrintf ("backup past 0\n");
+	}
 
 #ifdef QUAKE2
 	// rotate endpos back to world frame of reference
@@ -801,8 +603,60 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	return trace;
 }
 
+trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+{
+	return SV_ClipMoveToEntityBox (ent, start, mins, maxs, end, &box_hulls[0], NULL);
+}
+
 //===========================================================================
 
+/*
+====================
+SV_PremoveRead
+
+Remembers an edict a premove looks at. Returns false if the move has to be
+traced serially, also for anything that would be a Sys_Error.
+====================
+*/
+static qboolean SV_PremoveRead (moveclip_t *clip, edict_t *touch)
+{
+	premove_t	*pm;
+	model_t		*model;
+
+	pm = clip->premove;
+
+	if (touch->v.solid == SOLID_TRIGGER)
+		pm->traced = false;
+	else if (touch->v.solid == SOLID_BSP)
+	{
+		model = NULL;
+		if (touch->v.movetype == MOVETYPE_PUSH && touch->v.modelindex >= 0 && touch->v.modelindex < MAX_MODELS)
+			model = sv.models[(int)touch->v.modelindex];
+		if (!model || model->type != mod_brush)
+			pm->traced = false;
+	}
+	if (!pm->traced)
+		return false;
+
+	if (touch == clip->passedict)
+		return true;
+	if (clip->boxmins[0] > touch->v.absmax[0]
+	|| clip->boxmins[1] > touch->v.absmax[1]
+	|| clip->boxmins[2] > touch->v.absmax[2]
+	|| clip->boxmaxs[0] < touch->v.absmin[0]
+	|| clip->boxmaxs[1] < touch->v.absmin[1]
+	|| clip->boxmaxs[2] < touch->v.absmin[2] )
+		return true;	// nothing else of it matters
+
+	if (pm->numreads == MAX_PREMOVEREADS)
+	{
+		pm->traced = false;
+		return false;
+	}
+	pm->reads[pm->numreads++] = ((byte *)touch - (byte *)sv.edicts) / pr_edict_size;
+	return true;
+}
+
 /*
 ====================
 SV_ClipToLinks
@@ -821,6 +675,8 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 	{
 		next = l->next;
 		touch = EDICT_FROM_AREA(l);
+		if (clip->premove && !SV_PremoveRead (clip, touch))
+			return;
 		if (touch->v.solid == SOLID_NOT)
 			continue;
 		if (touch == clip->passedict)
@@ -854,9 +710,9 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 		}
 
 		if ((int)touch->v.flags & FL_MONSTER)
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins2, clip->maxs2, clip->end);
+			trace = SV_ClipMoveToEntityBox (touch, clip->start, clip->mins2, clip->maxs2, clip->end, clip->box, clip->premove);
 		else
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins, clip->maxs, clip->end);
+			trace = SV_ClipMoveToEntityBox (touch, clip->start, clip->mins, clip->maxs, clip->end, clip->box, clip->premove);
 		if (trace.allsolid || trace.startsolid ||
 		trace.fraction < clip->trace.fraction)
 		{
@@ -914,6 +770,49 @@ boxmaxs[0] = boxmaxs[1] = boxmaxs[2] = 9999;
 #endif
 }
 
+/*
+==================
+SV_StartMove
+
+Clips to the world and sets up the clip for SV_ClipToLinks
+==================
+*/
+static void SV_StartMove (moveclip_t *clip, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict, boxhull_t *box, premove_t *premove)
+{
+	int			i;
+
+	memset ( clip, 0, sizeof ( moveclip_t ) );
+
+// clip to world
+	clip->trace = SV_ClipMoveToEntityBox ( sv.edicts, start, mins, maxs, end, box, premove );
+
+	clip->start = start;
+	clip->end = end;
+	clip->mins = mins;
+	clip->maxs = maxs;
+	clip->type = type;
+	clip->passedict = passedict;
+	clip->box = box;
+	clip->premove = premove;
+
+	if (type == MOVE_MISSILE)
+	{
+		for (i=0 ; i<3 ; i++)
+		{
+			clip->mins2[i] = -15;
+			clip->maxs2[i] = 15;
+		}
+	}
+	else
+	{
+		VectorCopy (mins, clip->mins2);
+		VectorCopy (maxs, clip->maxs2);
+	}
+	
+// create the bounding box of the entire move
+	SV_MoveBounds ( start, clip->mins2, clip->maxs2, end, clip->boxmins, clip->boxmaxs );
+}
+
 /*
 ==================
 SV_Move
@@ -922,15 +821,108 @@ SV_Move
 trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
 {
 	moveclip_t	clip;
-	int			i;
 
-	memset ( &clip, 0, sizeof ( moveclip_t ) );
+	SV_StartMove ( &clip, start, mins, maxs, end, type, passedict, &box_hulls[0], NULL );
 
-// clip to world
-	clip.trace = SV_ClipMoveToEntity ( sv.edicts, start, mins, maxs, end );
+// clip to entities
+	SV_ClipToLinks ( sv_areanodes, &clip );
+
+	return clip.trace;
+}
+
+
+/*
+===============================================================================
+
+BATCHED MOVES
+
+===============================================================================
+*/
+
+static	edict_t	*sv_batchedicts[MAX_EDICTS];
+static	int		sv_numbatchedicts;
+
+/*
+====================
+SV_BatchLinks
+
+Collects the solid edicts, that any move of the batch could hit, in the
+order SV_ClipToLinks would try them
+====================
+*/
+static void SV_BatchLinks (areanode_t *node, moveclip_t *clip)
+{
+	link_t		*l, *next;
+	edict_t		*touch;
+
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
+	{
+		next = l->next;
+		touch = EDICT_FROM_AREA(l);
+		if (touch->v.solid == SOLID_NOT)
+			continue;
+		if (touch == clip->passedict)
+			continue;
+		if (touch->v.solid == SOLID_TRIGGER)
+			Sys_Error ("Trigger in clipping list");
+
+		if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
+			continue;
+
+		if (clip->boxmins[0] > touch->v.absmax[0]
+		|| clip->boxmins[1] > touch->v.absmax[1]
+		|| clip->boxmins[2] > touch->v.absmax[2]
+		|| clip->boxmaxs[0] < touch->v.absmin[0]
+		|| clip->boxmaxs[1] < touch->v.absmin[1]
+		|| clip->boxmaxs[2] < touch->v.absmin[2] )
+			continue;
+
+		if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
+			continue;	// points never interact
+
+		if (clip->passedict)
+		{
+		 	if (PROG_TO_EDICT(touch->v.owner) == clip->passedict)
+				continue;	// don't clip against own missiles
+			if (PROG_TO_EDICT(clip->passedict->v.owner) == touch)
+				continue;	// don't clip against owner
+		}
+
+		sv_batchedicts[sv_numbatchedicts++] = touch;
+	}
+	
+// recurse down both sides
+	if (node->axis == -1)
+		return;
+
+	if ( clip->boxmaxs[node->axis] > node->dist )
+		SV_BatchLinks ( node->children[0], clip );
+	if ( clip->boxmins[node->axis] < node->dist )
+		SV_BatchLinks ( node->children[1], clip );
+}
+
+/*
+==================
+SV_MoveBatch
+
+Same as calling SV_Move for every start and end, with the same size, type
+and passedict. All the moves are traced through the world first, while its
+clipnodes are in the cache, and the edicts near them are only looked up once.
+==================
+*/
+void SV_MoveBatch (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, int type, edict_t *passedict, trace_t *traces)
+{
+	moveclip_t	clip;
+	vec3_t		boxmins, boxmaxs;
+	edict_t		*touch;
+	trace_t		trace;
+	int			i, j;
+
+	if (count <= 0)
+		return;
+
+	memset ( &clip, 0, sizeof ( moveclip_t ) );
 
-	clip.start = start;
-	clip.end = end;
 	clip.mins = mins;
 	clip.maxs = maxs;
 	clip.type = type;
@@ -949,13 +941,251 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 		VectorCopy (mins, clip.mins2);
 		VectorCopy (maxs, clip.maxs2);
 	}
-	
-// create the bounding box of the entire move
-	SV_MoveBounds ( start, clip.mins2, clip.maxs2, end, clip.boxmins, clip.boxmaxs );
 
-// clip to entities
+// clip to world, and find the box of all the moves
+	for (i=0 ; i<count ; i++)
+	{
+		traces[i] = SV_ClipMoveToEntity ( sv.edicts, starts[i], mins, maxs, ends[i] );
+
+		SV_MoveBounds ( starts[i], clip.mins2, clip.maxs2, ends[i], boxmins, boxmaxs );
+		for (j=0 ; j<3 ; j++)
+		{
+			if (!i || boxmins[j] < clip.boxmins[j])
+				clip.boxmins[j] = boxmins[j];
+			if (!i || boxmaxs[j] > clip.boxmaxs[j])
+				clip.boxmaxs[j] = boxmaxs[j];
+		}
+	}
+
+	sv_numbatchedicts = 0;
+	SV_BatchLinks ( sv_areanodes, &clip );
+
+// clip every move to the edicts its own box touches
+	for (i=0 ; i<count ; i++)
+	{
+		clip.start = starts[i];
+		clip.end = ends[i];
+		clip.trace = traces[i];
+		SV_MoveBounds ( starts[i], clip.mins2, clip.maxs2, ends[i], clip.boxmins, clip.boxmaxs );
+
+		for (j=0 ; j<sv_numbatchedicts ; j++)
+		{
+			touch = sv_batchedicts[j];
+
+			if (clip.boxmins[0] > touch->v.absmax[0]
+			|| clip.boxmins[1] > touch->v.absmax[1]
+			|| clip.boxmins[2] > touch->v.absmax[2]
+			|| clip.boxmaxs[0] < touch->v.absmin[0]
+			|| clip.boxmaxs[1] < touch->v.absmin[1]
+			|| clip.boxmaxs[2] < touch->v.absmin[2] )
+				continue;
+
+		// SV_ClipToLinks clips nothing more once it is allsolid
+			if (clip.trace.allsolid)
+				break;
+
+			if ((int)touch->v.flags & FL_MONSTER)
+				trace = SV_ClipMoveToEntity (touch, clip.start, clip.mins2, clip.maxs2, clip.end);
+			else
+				trace = SV_ClipMoveToEntity (touch, clip.start, clip.mins, clip.maxs, clip.end);
+			if (trace.allsolid || trace.startsolid ||
+			trace.fraction < clip.trace.fraction)
+			{
+				trace.ent = touch;
+			 	if (clip.trace.startsolid)
+				{
+					clip.trace = trace;
+					clip.trace.startsolid = true;
+				}
+				else
+					clip.trace = trace;
+			}
+			else if (trace.startsolid)
+				clip.trace.startsolid = true;
+		}
+
+		traces[i] = clip.trace;
+	}
+}
+
+
+/*
+===============================================================================
+
+PREMOVES
+
+===============================================================================
+*/
+
+typedef struct
+{
+	float		solid, movetype, modelindex;
+	int			owner, monster, free;
+	float		size;
+	vec3_t		origin, mins, maxs, absmin, absmax;
+#ifdef QUAKE2
+	vec3_t		angles;
+#endif
+} premovefields_t;		// everything SV_ClipToLinks reads of a touched edict
+
+#define	MAX_PREMOVELINKS	1024
+
+static	premovefields_t	sv_premovefields[MAX_EDICTS];
+static	int			sv_numpremovefields;
+static	vec3_t		sv_premovelinks[MAX_PREMOVELINKS][2];	// boxes linked or unlinked since
+static	int			sv_numpremovelinks;		// MAX_PREMOVELINKS+1 after an overflow
+
+static void SV_PremoveFields (edict_t *ent, premovefields_t *f)
+{
+	memset (f, 0, sizeof(*f));
+	f->solid = ent->v.solid;
+	f->movetype = ent->v.movetype;
+	f->modelindex = ent->v.modelindex;
+	f->owner = ent->v.owner;
+	f->monster = (int)ent->v.flags & FL_MONSTER;
+	f->free = ent->free;
+	f->size = ent->v.size[0];
+	VectorCopy (ent->v.origin, f->origin);
+	VectorCopy (ent->v.mins, f->mins);
+	VectorCopy (ent->v.maxs, f->maxs);
+	VectorCopy (ent->v.absmin, f->absmin);
+	VectorCopy (ent->v.absmax, f->absmax);
+#ifdef QUAKE2
+	VectorCopy (ent->v.angles, f->angles);
+#endif
+}
+
+/*
+==================
+SV_PremoveLink
+
+The edict is linked in or unlinked from the box in its absmin and absmax
+==================
+*/
+static void SV_PremoveLink (edict_t *ent)
+{
+	if (sv_numpremovelinks >= MAX_PREMOVELINKS)
+	{
+		sv_numpremovelinks = MAX_PREMOVELINKS + 1;
+		return;
+	}
+	VectorCopy (ent->v.absmin, sv_premovelinks[sv_numpremovelinks][0]);
+	VectorCopy (ent->v.absmax, sv_premovelinks[sv_numpremovelinks][1]);
+	sv_numpremovelinks++;
+}
+
+/*
+==================
+SV_BeginPremoves
+==================
+*/
+void SV_BeginPremoves (void)
+{
+	int		i;
+
+	for (i=0 ; i<sv.num_edicts ; i++)
+		SV_PremoveFields (EDICT_NUM(i), &sv_premovefields[i]);
+	sv_numpremovefields = sv.num_edicts;
+
+	sv_numpremovelinks = 0;
+	sv_premoving = true;
+}
+
+/*
+==================
+SV_EndPremoves
+==================
+*/
+void SV_EndPremoves (void)
+{
+	sv_premoving = false;
+}
+
+/*
+==================
+SV_Premove
+
+Doesn't change anything but pm, so it can run on any job thread
+==================
+*/
+void SV_Premove (premove_t *pm, int thread)
+{
+	moveclip_t	clip;
+
+	pm->numreads = 0;
+	if (thread >= MAX_PREMOVETHREADS)
+	{
+		pm->traced = false;
+		return;
+	}
+	pm->traced = true;
+
+	if (pm->passedict)
+	{
+		pm->passowner = pm->passedict->v.owner;
+		pm->passsize = pm->passedict->v.size[0];
+	}
+
+	SV_StartMove ( &clip, pm->start, pm->mins, pm->maxs, pm->end, pm->type, pm->passedict, &box_hulls[thread], pm );
 	SV_ClipToLinks ( sv_areanodes, &clip );
 
-	return clip.trace;
+	pm->trace = clip.trace;
+	VectorCopy (clip.boxmins, pm->boxmins);
+	VectorCopy (clip.boxmaxs, pm->boxmaxs);
 }
 
+/*
+==================
+SV_CheckPremove
+
+Returns true if SV_Move with these arguments would give pm->trace now
+==================
+*/
+qboolean SV_CheckPremove (premove_t *pm, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict)
+{
+	premovefields_t	f;
+	int			i, n;
+	float		*absmin, *absmax;
+
+	if (!sv_premoving || !pm->traced)
+		return false;
+
+// the same move, compared bit for bit
+	if (type != pm->type || passedict != pm->passedict
+	|| memcmp (start, pm->start, sizeof(vec3_t)) || memcmp (end, pm->end, sizeof(vec3_t))
+	|| memcmp (mins, pm->mins, sizeof(vec3_t)) || memcmp (maxs, pm->maxs, sizeof(vec3_t)))
+		return false;
+	if (passedict && (passedict->v.owner != pm->passowner
+	|| memcmp (&passedict->v.size[0], &pm->passsize, sizeof(float))))
+		return false;
+
+// nothing came into or left the box of the move
+	if (sv_numpremovelinks > MAX_PREMOVELINKS)
+		return false;
+	for (i=0 ; i<sv_numpremovelinks ; i++)
+	{
+		absmin = sv_premovelinks[i][0];
+		absmax = sv_premovelinks[i][1];
+		if (pm->boxmins[0] > absmax[0]
+		|| pm->boxmins[1] > absmax[1]
+		|| pm->boxmins[2] > absmax[2]
+		|| pm->boxmaxs[0] < absmin[0]
+		|| pm->boxmaxs[1] < absmin[1]
+		|| pm->boxmaxs[2] < absmin[2] )
+			continue;
+		return false;
+	}
+
+// and what was in it is still the same
+	for (i=0 ; i<pm->numreads ; i++)
+	{
+		n = pm->reads[i];
+		if (n >= sv_numpremovefields)
+			return false;
+		SV_PremoveFields (EDICT_NUM(n), &f);
+		if (memcmp (&f, &sv_premovefields[n], sizeof(f)))
+			return false;
+	}
+
+	return true;
+}
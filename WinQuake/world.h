@@ -20,24 +20,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // world.h
 
-typedef struct
-{
-	vec3_t	normal;
-	float	dist;
-} plane_t;
-
-typedef struct
-{
-	qboolean	allsolid;	// if true, plane is not valid
-	qboolean	startsolid;	// if true, the initial point was in a solid area
-	qboolean	inopen, inwater;
-	float	fraction;		// time completed, 1.0 = didn't hit anything
-	vec3_t	endpos;			// final position
-	plane_t	plane;			// surface normal at impact
-	edict_t	*ent;			// entity the surface is on
-} trace_t;
-
-
 #define	MOVE_NORMAL		0
 #define	MOVE_NOMONSTERS	1
 #define	MOVE_MISSILE	2
@@ -77,3 +59,51 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 // shouldn't be considered solid objects
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
+
+void SV_MoveBatch (int count, vec3_t *starts, vec3_t mins, vec3_t maxs, vec3_t *ends, int type, edict_t *passedict, trace_t *traces);
+// same as SV_Move for every pair of starts and ends, faster for many moves
+// in the same area, like the aim and step checks
+
+// premoves are moves traced ahead of time on the job threads, against the
+// edicts as they were at SV_BeginPremoves. SV_CheckPremove tells if the same
+// SV_Move now would still give the same trace: nothing may have been linked
+// or unlinked in the box of the move since, and the edicts the trace looked
+// at must not have changed in any field the clipping reads.
+
+#define	MAX_PREMOVETHREADS	32		// more job threads trace serially
+#define	MAX_PREMOVEREADS	16
+
+typedef struct
+{
+	vec3_t		start, end, mins, maxs;
+	int			type;
+	edict_t		*passedict;
+	int			passowner;
+	float		passsize;
+	qboolean	traced;			// false if the move has to be traced again
+	trace_t		trace;
+	vec3_t		boxmins, boxmaxs;
+	int			numreads;
+	short		reads[MAX_PREMOVEREADS];	// edicts the trace looked at
+} premove_t;
+
+void SV_BeginPremoves (void);
+// takes a copy of what the traces will read, and starts tracking links
+
+void SV_Premove (premove_t *pm, int thread);
+// traces start to end of pm, may run on any job thread
+
+qboolean SV_CheckPremove (premove_t *pm, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict);
+
+void SV_EndPremoves (void);
+
+//
+// cl_world.c
+//
+void CL_ClearSolids (void);
+void CL_LinkSolid (entity_t *ent);
+// keeps the brush entities that were relinked this frame
+
+trace_t CL_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int *hitent);
+// same as SV_Move against the world and the linked brush entities, trace.ent
+// is NULL, hitent is set to the entity number or -1 if nothing was hit